@@ -251,6 +251,8 @@ WGET_BEGIN_DECLS
 #define WGET_HTTP_BODY                2017
 #define WGET_HTTP_BODY_SAVEAS         2018
 #define WGET_HTTP_USER_DATA           2019
+#define WGET_HTTP_PRIORITY_URGENCY    2020
+#define WGET_HTTP_PRIORITY_INCREMENTAL 2021
 
 // definition of error conditions
 typedef enum {
@@ -343,6 +345,10 @@ WGETAPI void
 	wget_millisleep(int ms);
 WGETAPI long long
 	wget_get_timemillis(void);
+WGETAPI long long
+	wget_get_monotonic_millis(void);
+WGETAPI long long
+	wget_get_coarse_millis(void);
 WGETAPI int
 	wget_percent_unescape(char *src);
 WGETAPI int
@@ -1136,7 +1142,9 @@ typedef enum {
 	wget_content_encoding_bzip2 = 5,
 	wget_content_encoding_brotli = 6,
 	wget_content_encoding_zstd = 7,
-	wget_content_encoding_max = 8
+	wget_content_encoding_dcb = 8, //!< Dictionary-Compressed Brotli
+	wget_content_encoding_dcz = 9, //!< Dictionary-Compressed Zstandard
+	wget_content_encoding_max = 10
 } wget_content_encoding_type_t;
 
 WGETAPI G_GNUC_WGET_PURE wget_content_encoding_type_t
@@ -1153,6 +1161,8 @@ WGETAPI void
 	wget_decompress_set_error_handler(wget_decompressor *dc, wget_decompressor_error_handler_t *error_handler);
 WGETAPI void *
 	wget_decompress_get_context(wget_decompressor *dc);
+WGETAPI void
+	wget_decompress_set_dictionary(wget_decompressor *dc, const void *data, size_t length, const unsigned char *hash);
 
 /*
  * URI/IRI routines
@@ -1201,7 +1211,7 @@ struct wget_iri_st {
 	const char *
 		password;
 	/**
-	 * Hostname (or literal IP address). Lowercase and unescaped.
+	 * Hostname (or literal IP address). Lowercase, unescaped and interned (see wget_intern()).
 	 */
 	const char *
 		host;
@@ -1370,6 +1380,8 @@ WGETAPI int
 	wget_cookie_db_load(wget_cookie_db *cookie_db, const char *fname);
 WGETAPI int
 	wget_cookie_db_load_psl(wget_cookie_db *cookie_db, const char *fname);
+WGETAPI const char *
+	wget_cookie_db_registrable_domain(const wget_cookie_db *cookie_db, const char *domain);
 WGETAPI char *
 	wget_cookie_create_request_header(wget_cookie_db *cookie_db, const wget_iri *iri);
 
@@ -2090,6 +2102,8 @@ WGETAPI int
 	wget_tcp_get_timeout(wget_tcp *tcp) G_GNUC_WGET_PURE;
 WGETAPI void
 	wget_tcp_set_connect_timeout(wget_tcp *tcp, int timeout);
+WGETAPI int
+	wget_tcp_get_connect_timeout(wget_tcp *tcp) G_GNUC_WGET_PURE;
 WGETAPI void
 	wget_tcp_set_tcp_fastopen(wget_tcp *tcp, int tcp_fastopen);
 WGETAPI void
@@ -2176,6 +2190,8 @@ WGETAPI bool
 #define WGET_SSL_HPKP_CACHE     20
 #define WGET_SSL_OCSP_NONCE     21
 #define WGET_SSL_OCSP_DATE      22
+#define WGET_SSL_CA_SNAPSHOT    23
+#define WGET_SSL_CA_SNAPSHOT_RESTRICT 24
 
 WGETAPI void
 	wget_ssl_init(void);
@@ -2227,8 +2243,10 @@ typedef struct {
 	enum {
 		link_rel_none = 0,
 		link_rel_describedby,
-		link_rel_duplicate
-	} rel; //!< value of 'rel' param, either none (if not found), 'describedby' or 'duplicate'
+		link_rel_duplicate,
+		link_rel_preload,
+		link_rel_modulepreload
+	} rel; //!< value of 'rel' param, either none (if not found), 'describedby', 'duplicate', 'preload' or 'modulepreload'
 } wget_http_link;
 
 /**
@@ -2299,9 +2317,23 @@ typedef struct {
 	bool
 		debug_skip_body : 1; //!< if set, do not print the request body (e.g. because it's binary)
 	long long
-		request_start; //!< When this request was sent out
+		request_start; //!< When this request was sent out (monotonic milliseconds)
 	long long
-		first_response_start; //!< The time we read the first bytes back
+		first_response_start; //!< The time we read the first bytes back (monotonic milliseconds)
+	const void *
+		dictionary; //!< compression dictionary for 'dcb' / 'dcz' responses, not owned by the request
+	size_t
+		dictionary_length; //!< length of the compression dictionary
+	const unsigned char *
+		dictionary_hash; //!< SHA-256 of the compression dictionary or NULL
+	signed char
+		priority_urgency; //!< RFC 9218 urgency, 0 (highest) to 7, -1 if not set
+	bool
+		priority_incremental : 1; //!< RFC 9218 incremental flag
+	wget_http_header_callback_t
+		*interim_callback; //!< called for each informational (1xx) response, e.g. 103 Early Hints
+	void *
+		interim_user_data; //!< meant to be used in interim callback function
 
 } wget_http_request;
 
@@ -2362,9 +2394,27 @@ struct wget_http_response_st {
 	bool
 		content_length_valid : 1,
 		hsts : 1, //!< if hsts_maxage and hsts_include_subdomains are valid
-		csp : 1;
+		csp : 1,
+		range_valid : 1, //!< if range_position has been taken from a Content-Range header
+		skip_body : 1, //!< set by the header callback if the body is of no use
+		accept_ranges : 1, //!< the server announced 'Accept-Ranges: bytes'
+		truncated : 1; //!< the connection broke before the complete body has been received
+	long long
+		response_end; //!< when this response was received (monotonic milliseconds)
+	bool
+		body_aborted : 1; //!< the header or body callback stopped receiving the body
+	const char *
+		use_as_dictionary; //!< value of the 'Use-As-Dictionary' header
+	const char *
+		content_type_boundary; //!< boundary of a 'multipart/byteranges' response
+	void *
+		byteranges; //!< internal state of the 'multipart/byteranges' parser
 	long long
-		response_end; //!< when this response was received
+		range_position; //!< file position of the body data passed to the body callback
+	size_t
+		body_skipped; //!< body bytes not passed to the body callback, see skip_body
+	time_t
+		date; //!< value of the 'Date' header, 0 if not given
 };
 
 typedef struct wget_http_connection_st wget_http_connection;
@@ -2413,6 +2463,8 @@ WGETAPI const char *
 	wget_http_parse_content_encoding(const char *s, char *content_encoding) G_GNUC_WGET_NONNULL_ALL;
 WGETAPI const char *
 	wget_http_parse_content_disposition(const char *s, const char **filename) G_GNUC_WGET_NONNULL((1));
+WGETAPI int
+	wget_http_parse_content_range(const char *s, long long *first, long long *last) G_GNUC_WGET_NONNULL_ALL;
 WGETAPI const char *
 	wget_http_parse_strict_transport_security(const char *s, time_t *maxage, char *include_subdomains) G_GNUC_WGET_NONNULL((1));
 WGETAPI const char *
@@ -2426,6 +2478,10 @@ WGETAPI const char *
 
 WGETAPI char *
 	wget_http_print_date(time_t t, char *buf, size_t bufsize) G_GNUC_WGET_NONNULL_ALL;
+WGETAPI char *
+	wget_http_print_priority(int urgency, bool incremental, char *buf, size_t bufsize) G_GNUC_WGET_NONNULL_ALL;
+WGETAPI int
+	wget_http_priority_weight(int urgency) G_GNUC_WGET_CONST;
 
 WGETAPI void
 	wget_http_add_param(wget_vector **params, wget_http_header_param *param) G_GNUC_WGET_NONNULL_ALL;
@@ -2499,6 +2555,12 @@ WGETAPI void
 	wget_http_exit(void);
 WGETAPI int
 	wget_http_open(wget_http_connection **_conn, const wget_iri *iri);
+WGETAPI int
+	wget_http_open_timeout(wget_http_connection **_conn, const wget_iri *iri, int connect_timeout);
+WGETAPI void
+	wget_http_set_timeout(wget_http_connection *conn, int timeout);
+WGETAPI int
+	wget_http_update_priority(wget_http_connection *conn, wget_http_request *req, int urgency, bool incremental) G_GNUC_WGET_NONNULL_ALL;
 WGETAPI wget_http_request *
 	wget_http_create_request(const wget_iri *iri, const char *method) G_GNUC_WGET_NONNULL_ALL;
 WGETAPI void
@@ -2507,6 +2569,8 @@ WGETAPI void
 	wget_http_request_set_header_cb(wget_http_request *req, wget_http_header_callback_t *cb, void *user_data) G_GNUC_WGET_NONNULL((1));
 WGETAPI void
 	wget_http_request_set_body_cb(wget_http_request *req, wget_http_body_callback_t *cb, void *user_data) G_GNUC_WGET_NONNULL((1));
+WGETAPI void
+	wget_http_request_set_interim_cb(wget_http_request *req, wget_http_header_callback_t *cb, void *user_data) G_GNUC_WGET_NONNULL((1));
 WGETAPI void
 	wget_http_request_set_int(wget_http_request *req, int key, int value) G_GNUC_WGET_NONNULL((1));
 WGETAPI int
@@ -2546,6 +2610,20 @@ WGETAPI void
 	wget_srandom(unsigned int seed);
 
 
+/*
+ * string interning routines
+ */
+
+WGETAPI void
+	wget_intern_init(void);
+WGETAPI void
+	wget_intern_exit(void);
+WGETAPI const char *
+	wget_intern(const char *s);
+WGETAPI const char *
+	wget_intern_mem(const char *s, size_t len);
+
+
 /**
  * \ingroup libwget-hash
  * \brief Type for hash / digest routines
@@ -2850,6 +2928,30 @@ typedef void wget_plugin_url_filter_t(wget_plugin_t *plugin, const wget_iri *iri
 WGETAPI void
 	wget_plugin_register_url_filter(wget_plugin_t *plugin, wget_plugin_url_filter_t *filter_fn);
 
+/**
+ * \ingroup libwget-plugin
+ *
+ * Prototype for the function for intercepting all URLs found in a document at once.
+ * The function is called concurrently only if it has been registered with #WGET_PLUGIN_THREAD_SAFE.
+ *
+ * \param[in] plugin The plugin handle
+ * \param[in] iris The URLs about to be fetched
+ * \param[in] actions Output the action to be taken, one per URL
+ * \param[in] n Number of URLs in the batch
+ */
+typedef void wget_plugin_url_filter_batch_t(wget_plugin_t *plugin, const wget_iri **iris, wget_intercept_action_t **actions, int n);
+
+/**
+ * \ingroup libwget-plugin
+ *
+ * The registered function may be called from several threads at the same time
+ */
+#define WGET_PLUGIN_THREAD_SAFE 1
+
+// Registers a plugin function for intercepting batches of URLs
+WGETAPI void
+	wget_plugin_register_url_filter_batch(wget_plugin_t *plugin, wget_plugin_url_filter_batch_t *filter_fn, int flags);
+
 // Provides wget2 with another HSTS database to use.
 WGETAPI void
 	wget_plugin_add_hsts_db(wget_plugin_t *plugin, wget_hsts_db_t *hsts_db, int priority);
@@ -2943,6 +3045,8 @@ struct wget_plugin_vtable
 	void (* add_hsts_db)(wget_plugin_t *, wget_hsts_db_t *, int);
 	void (* add_hpkp_db)(wget_plugin_t *, wget_hpkp_db_t *, int);
 	void (* add_ocsp_db)(wget_plugin_t *, wget_ocsp_db *, int);
+
+	void (* register_url_filter_batch)(wget_plugin_t *, wget_plugin_url_filter_batch_t *, int);
 };
 
 /**
@@ -158,7 +158,7 @@ static void _bar_update_speed_stats(_bar_slot_t *slotp)
 	if (slotp->bytes_downloaded == slotp->bytes_ring[ring_pos]) {
 		return;
 	}
-	uint64_t curtime = wget_get_timemillis();
+	uint64_t curtime = wget_get_coarse_millis();
 
 	// Increment the position pointer
 	if (++ring_pos == SPEED_RING_SIZE)
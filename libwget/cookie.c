@@ -57,6 +57,8 @@ struct wget_cookie_st {
 		value;
 	const char *
 		domain;
+	const char *
+		domain_interned; // set by normalization, to compare with IRI hosts by pointer
 	const char *
 		path;
 	time_t
@@ -78,15 +80,29 @@ struct wget_cookie_st {
 		http_only : 1; // just use the cookie via HTTP/HTTPS protocol
 };
 
+// max. number of cached PSL results, the cache is emptied when it is full
+#define PSL_CACHE_MAX 4096
+
+// cached PSL result for a domain
+typedef struct {
+	const char *
+		registrable; // interned registrable domain or NULL
+	bool
+		public_suffix : 1;
+} _psl_entry_t;
+
 struct wget_cookie_db_st {
 	wget_vector *
 		cookies;
 #ifdef WITH_LIBPSL
 	psl_ctx_t
 		*psl; // libpsl Publix Suffix List context
+	wget_stringmap *
+		psl_cache; // domain -> _psl_entry_t
 #endif
 	wget_thread_mutex
-		mutex;
+		mutex,
+		psl_mutex;
 	unsigned int
 		age;
 	bool
@@ -111,12 +127,80 @@ int wget_cookie_db_load_psl(G_GNUC_WGET_UNUSED wget_cookie_db *cookie_db, G_GNUC
 		cookie_db->psl = NULL;
 	}
 
+	// the cached results are from the old list
+	wget_thread_mutex_lock(cookie_db->psl_mutex);
+	wget_stringmap_clear(cookie_db->psl_cache);
+	wget_thread_mutex_unlock(cookie_db->psl_mutex);
+
 	return 0;
 #else
 	return -1;
 #endif
 }
 
+#ifdef WITH_LIBPSL
+// Looks up domain in the PSL, results are cached since cookies and scheduling ask for the same hosts again and again.
+// The cache is logically const, so const databases are accepted.
+static void _psl_lookup(const wget_cookie_db *_cookie_db, const char *domain, _psl_entry_t *result)
+{
+	wget_cookie_db *cookie_db = (wget_cookie_db *) _cookie_db;
+	_psl_entry_t *entry;
+	const char *registrable;
+
+	wget_thread_mutex_lock(cookie_db->psl_mutex);
+	if (wget_stringmap_get(cookie_db->psl_cache, domain, &entry)) {
+		*result = *entry;
+		wget_thread_mutex_unlock(cookie_db->psl_mutex);
+		return;
+	}
+	wget_thread_mutex_unlock(cookie_db->psl_mutex);
+
+	result->public_suffix = psl_is_public_suffix(cookie_db->psl, domain) != 0;
+	registrable = psl_registrable_domain(cookie_db->psl, domain);
+	result->registrable = registrable ? wget_intern(registrable) : NULL;
+
+	if (!(entry = wget_malloc(sizeof(_psl_entry_t))))
+		return;
+	*entry = *result;
+
+	wget_thread_mutex_lock(cookie_db->psl_mutex);
+	if (!cookie_db->psl_cache)
+		cookie_db->psl_cache = wget_stringmap_create(128);
+	else if (wget_stringmap_size(cookie_db->psl_cache) >= PSL_CACHE_MAX)
+		wget_stringmap_clear(cookie_db->psl_cache);
+	wget_stringmap_put(cookie_db->psl_cache, wget_strdup(domain), entry);
+	wget_thread_mutex_unlock(cookie_db->psl_mutex);
+}
+#endif
+
+/**
+ * \param[in] cookie_db Cookie database that holds the Public Suffix List
+ * \param[in] domain Lowercase domain or host name
+ * \return The registrable domain of \p domain or NULL
+ *
+ * Returns the registrable domain (public suffix plus one label) of \p domain,
+ * e.g. 'example.co.uk' for 'www.example.co.uk'. The returned string is interned and
+ * never freed (see wget_intern()).
+ *
+ * NULL is returned if \p domain is a public suffix, if there is no Public Suffix List
+ * or if libwget has been built without libpsl. Results are cached per database.
+ */
+const char *wget_cookie_db_registrable_domain(G_GNUC_WGET_UNUSED const wget_cookie_db *cookie_db, G_GNUC_WGET_UNUSED const char *domain)
+{
+#ifdef WITH_LIBPSL
+	_psl_entry_t entry;
+
+	if (!cookie_db || !cookie_db->psl || !domain)
+		return NULL;
+
+	_psl_lookup(cookie_db, domain, &entry);
+
+	return entry.registrable;
+#else
+	return NULL;
+#endif
+}
+
 // this is how we sort the entries in a cookie db
 static int G_GNUC_WGET_NONNULL_ALL G_GNUC_WGET_PURE _compare_cookie(const wget_cookie *c1, const wget_cookie *c2)
 {
@@ -559,6 +643,7 @@ static int _wget_cookie_normalize_cookie(const wget_iri *iri, wget_cookie *cooki
 		}
 	}
 
+	cookie->domain_interned = wget_intern(cookie->domain);
 	cookie->normalized = 1;
 
 /*
@@ -601,9 +686,12 @@ int wget_cookie_check_psl(G_GNUC_WGET_UNUSED const wget_cookie_db *cookie_db, G_
 #ifdef WITH_LIBPSL
 	int ret;
 
-	if (cookie_db->psl)
-		ret = psl_is_public_suffix(cookie_db->psl, cookie->domain) ? -1 : 0;
-	else
+	if (cookie_db->psl) {
+		_psl_entry_t entry;
+
+		_psl_lookup(cookie_db, cookie->domain, &entry);
+		ret = entry.public_suffix ? -1 : 0;
+	} else
 		ret = 0;
 #else
 	int ret = 0;
@@ -693,12 +781,13 @@ char *wget_cookie_create_request_header(wget_cookie_db *cookie_db, const wget_ir
 	for (it = 0; it < wget_vector_size(cookie_db->cookies); it++) {
 		wget_cookie *cookie = wget_vector_get(cookie_db->cookies, it);
 
-		if (cookie->host_only && strcmp(cookie->domain, iri->host)) {
+		// stored cookies are normalized, both strings are interned
+		if (cookie->host_only && cookie->domain_interned != iri->host) {
 			debug_printf("cookie host match failed (%s,%s)\n", cookie->domain, iri->host);
 			continue;
 		}
 
-		if (!cookie->host_only && !_domain_match(cookie->domain, iri->host)) {
+		if (!cookie->host_only && cookie->domain_interned != iri->host && !_domain_match(cookie->domain, iri->host)) {
 			debug_printf("cookie domain match failed (%s,%s)\n", cookie->domain, iri->host);
 			continue;
 		}
@@ -766,6 +855,7 @@ wget_cookie_db *wget_cookie_db_init(wget_cookie_db *cookie_db)
 	cookie_db->cookies = wget_vector_create(32, (wget_vector_compare_t *) _compare_cookie);
 	wget_vector_set_destructor(cookie_db->cookies, cookie_free);
 	wget_thread_mutex_init(&cookie_db->mutex);
+	wget_thread_mutex_init(&cookie_db->psl_mutex);
 #ifdef WITH_LIBPSL
 #if ((PSL_VERSION_MAJOR > 0) || (PSL_VERSION_MAJOR == 0 && PSL_VERSION_MINOR >= 16))
 	cookie_db->psl = psl_latest(NULL);
@@ -783,7 +873,9 @@ void wget_cookie_db_deinit(wget_cookie_db *cookie_db)
 #ifdef WITH_LIBPSL
 		psl_free(cookie_db->psl);
 		cookie_db->psl = NULL;
+		wget_stringmap_free(&cookie_db->psl_cache);
 #endif
+		wget_thread_mutex_destroy(&cookie_db->psl_mutex);
 		wget_thread_mutex_lock(cookie_db->mutex);
 		wget_vector_free(&cookie_db->cookies);
 		wget_thread_mutex_unlock(cookie_db->mutex);
@@ -31,6 +31,7 @@
  *   https://wiki.mozilla.org/LZMA2_Compression
  *   https://groups.google.com/forum/#!topic/mozilla.dev.platform/CBhSPWs3HS8
  *   https://github.com/google/brotli
+ *   https://datatracker.ietf.org/doc/draft-ietf-httpbis-compression-dictionary/
  */
 
 #include <config.h>
@@ -98,6 +99,18 @@ struct wget_decompressor_st {
 		*context; // given to sink()
 	wget_content_encoding_type_t
 		encoding;
+
+	// 'dcb' / 'dcz': the stream starts with a magic and the SHA-256 of the dictionary
+	const void
+		*dictionary; // not owned
+	size_t
+		dictionary_length,
+		dict_header_length;
+	unsigned char
+		dictionary_hash[32],
+		dict_header[40];
+	bool
+		dictionary_hashed : 1; // dictionary_hash is valid
 };
 
 #ifdef WITH_ZLIB
@@ -400,6 +413,100 @@ static void bzip2_exit(wget_decompressor *dc)
 }
 #endif // WITH_BZIP2
 
+#if (defined WITH_BROTLIDEC && defined HAVE_BROTLIDECODERATTACHDICTIONARY) || defined WITH_ZSTD
+static int dictionary_error(wget_decompressor *dc G_GNUC_WGET_UNUSED, char *src G_GNUC_WGET_UNUSED, size_t srclen G_GNUC_WGET_UNUSED)
+{
+	return -1;
+}
+
+static int dictionary_init(wget_decompressor *dc)
+{
+#if defined WITH_BROTLIDEC && defined HAVE_BROTLIDECODERATTACHDICTIONARY
+	if (dc->encoding == wget_content_encoding_dcb) {
+		if (brotli_init(&dc->brotli_strm))
+			return -1;
+
+		dc->exit = brotli_exit;
+
+		if (!BrotliDecoderAttachDictionary(dc->brotli_strm, BROTLI_SHARED_DICTIONARY_RAW,
+				dc->dictionary_length, dc->dictionary))
+		{
+			error_printf(_("Failed to attach Brotli dictionary\n"));
+			return -1;
+		}
+
+		dc->decompress = brotli_decompress;
+		return 0;
+	}
+#endif
+
+#ifdef WITH_ZSTD
+	if (dc->encoding == wget_content_encoding_dcz) {
+		if (zstd_init(&dc->zstd_strm))
+			return -1;
+
+		dc->exit = zstd_exit;
+
+		size_t rc = ZSTD_DCtx_loadDictionary(dc->zstd_strm, dc->dictionary, dc->dictionary_length);
+		if (ZSTD_isError(rc)) {
+			error_printf(_("Failed to load Zstandard dictionary: %s\n"), ZSTD_getErrorName(rc));
+			return -1;
+		}
+
+		dc->decompress = zstd_decompress;
+		return 0;
+	}
+#endif
+
+	return -1;
+}
+
+// collect and check the 'dcb' / 'dcz' header, then switch to the real decompressor
+static int dictionary_decompress(wget_decompressor *dc, char *src, size_t srclen)
+{
+	const char *magic = dc->encoding == wget_content_encoding_dcb ? "\xff\x44\x43\x42" : "\x5e\x2a\x4d\x18\x20\x00\x00\x00";
+	size_t magic_length = dc->encoding == wget_content_encoding_dcb ? 4 : 8;
+	size_t header_length = magic_length + sizeof(dc->dictionary_hash);
+	size_t n = header_length - dc->dict_header_length;
+
+	if (n > srclen)
+		n = srclen;
+
+	memcpy(dc->dict_header + dc->dict_header_length, src, n);
+	dc->dict_header_length += n;
+
+	if (dc->dict_header_length < header_length)
+		return 0; // wait for more data
+
+	dc->decompress = dictionary_error;
+
+	if (memcmp(dc->dict_header, magic, magic_length)) {
+		error_printf(_("Invalid header of dictionary-compressed stream\n"));
+		return -1;
+	}
+
+	if (!dc->dictionary) {
+		error_printf(_("Got dictionary-compressed stream but no dictionary was offered\n"));
+		return -1;
+	}
+
+	if (!dc->dictionary_hashed) {
+		wget_hash_fast(WGET_DIGTYPE_SHA256, dc->dictionary, dc->dictionary_length, dc->dictionary_hash);
+		dc->dictionary_hashed = 1;
+	}
+
+	if (memcmp(dc->dict_header + magic_length, dc->dictionary_hash, sizeof(dc->dictionary_hash))) {
+		error_printf(_("Dictionary-compressed stream doesn't match the offered dictionary\n"));
+		return -1;
+	}
+
+	if (dictionary_init(dc))
+		return -1;
+
+	return srclen > n ? dc->decompress(dc, src + n, srclen - n) : 0;
+}
+#endif
+
 static int identity(wget_decompressor *dc, char *src, size_t srclen)
 {
 	if (dc->sink)
@@ -457,6 +564,15 @@ wget_decompressor *wget_decompress_open(
 			dc->decompress = zstd_decompress;
 			dc->exit = zstd_exit;
 		}
+#endif
+	} else if (encoding == wget_content_encoding_dcb) {
+#if defined WITH_BROTLIDEC && defined HAVE_BROTLIDECODERATTACHDICTIONARY
+		// decoder is created when the stream header has been checked
+		dc->decompress = dictionary_decompress;
+#endif
+	} else if (encoding == wget_content_encoding_dcz) {
+#ifdef WITH_ZSTD
+		dc->decompress = dictionary_decompress;
 #endif
 	}
 
@@ -509,6 +625,20 @@ void *wget_decompress_get_context(wget_decompressor *dc)
 	return dc ? dc->context : NULL;
 }
 
+// Set the dictionary for the 'dcb' and 'dcz' content encodings (Compression Dictionary Transport).
+// The data must stay valid until the decompressor is closed.
+// \p hash is the SHA-256 of the dictionary, if NULL it is computed when a dictionary-compressed stream arrives.
+void wget_decompress_set_dictionary(wget_decompressor *dc, const void *data, size_t length, const unsigned char *hash)
+{
+	if (dc) {
+		dc->dictionary = data;
+		dc->dictionary_length = length;
+
+		if ((dc->dictionary_hashed = data && hash))
+			memcpy(dc->dictionary_hash, hash, sizeof(dc->dictionary_hash));
+	}
+}
+
 static char _encoding_names[wget_content_encoding_max][9] = {
 	[wget_content_encoding_identity] = "identity",
 	[wget_content_encoding_gzip] = "gzip",
@@ -518,6 +648,8 @@ static char _encoding_names[wget_content_encoding_max][9] = {
 	[wget_content_encoding_bzip2] = "bzip2",
 	[wget_content_encoding_brotli] = "br",
 	[wget_content_encoding_zstd] = "zstd",
+	[wget_content_encoding_dcb] = "dcb",
+	[wget_content_encoding_dcz] = "dcz",
 };
 
 wget_content_encoding_type_t wget_content_encoding_by_name(const char *name)
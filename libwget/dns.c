@@ -283,7 +283,7 @@ struct addrinfo *wget_dns_resolve(wget_dns *dns, const char *host, uint16_t port
 		dns = &default_dns;
 
 	if (dns->stats_callback)
-		before_millisecs = wget_get_timemillis();
+		before_millisecs = wget_get_monotonic_millis();
 
 	// get the IP address for the server
 	for (int tries = 0, max = 3; tries < max; tries++) {
@@ -315,7 +315,7 @@ struct addrinfo *wget_dns_resolve(wget_dns *dns, const char *host, uint16_t port
 	}
 
 	if (dns->stats_callback) {
-		long long after_millisecs = wget_get_timemillis();
+		long long after_millisecs = wget_get_monotonic_millis();
 		stats.dns_secs = after_millisecs - before_millisecs;
 		stats.hostname = host;
 		stats.port = port;
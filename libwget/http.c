@@ -121,6 +121,10 @@ typedef struct {
 		*scheme;
 } HOST;
 
+// Reading an unwanted body up to this size is cheaper than closing the connection and
+// paying for a new TCP (and TLS) handshake, which takes a few round trips.
+#define HTTP_DRAIN_MAX (64 * 1024)
+
 static wget_server_stats_callback_t
 	*server_stats_callback;
 static void
@@ -156,6 +160,7 @@ wget_http_request *wget_http_create_request(const wget_iri *iri, const char *met
 	wget_buffer_init(&req->esc_host, req->esc_host_buf, sizeof(req->esc_host_buf));
 
 	req->scheme = iri->scheme;
+	req->priority_urgency = -1;
 	wget_strscpy(req->method, method, sizeof(req->method));
 	wget_iri_get_escaped_resource(iri, &req->esc_resource);
 	wget_iri_get_escaped_host(iri, &req->esc_host);
@@ -174,6 +179,12 @@ void wget_http_request_set_header_cb(wget_http_request *req, wget_http_header_ca
 	req->header_user_data = user_data;
 }
 
+void wget_http_request_set_interim_cb(wget_http_request *req, wget_http_header_callback_t *callback, void *user_data)
+{
+	req->interim_callback = callback;
+	req->interim_user_data = user_data;
+}
+
 void wget_http_request_set_body_cb(wget_http_request *req, wget_http_body_callback_t *callback, void *user_data)
 {
 	req->body_callback = callback;
@@ -184,6 +195,8 @@ void wget_http_request_set_int(wget_http_request *req, int key, int value)
 {
 	switch (key) {
 	case WGET_HTTP_RESPONSE_KEEPHEADER: req->response_keepheader = !!value; break;
+	case WGET_HTTP_PRIORITY_URGENCY: req->priority_urgency = value < 0 ? -1 : value > 7 ? 7 : value; break;
+	case WGET_HTTP_PRIORITY_INCREMENTAL: req->priority_incremental = !!value; break;
 	default: error_printf(_("%s: Unknown key %d (or value must not be an integer)\n"), __func__, key);
 	}
 }
@@ -192,6 +205,8 @@ int wget_http_request_get_int(wget_http_request *req, int key)
 {
 	switch (key) {
 	case WGET_HTTP_RESPONSE_KEEPHEADER: return req->response_keepheader;
+	case WGET_HTTP_PRIORITY_URGENCY: return req->priority_urgency;
+	case WGET_HTTP_PRIORITY_INCREMENTAL: return req->priority_incremental;
 	default:
 		error_printf(_("%s: Unknown key %d (or value must not be an integer)\n"), __func__, key);
 		return -1;
@@ -407,6 +422,8 @@ struct _http2_stream_context {
 		*resp;
 	wget_decompressor
 		*decompressor;
+	bool
+		final_header : 1; // the final (non-1xx) response header has been received
 };
 
 static int _decompress_error_handler(wget_decompressor *dc, int err G_GNUC_WGET_UNUSED)
@@ -420,12 +437,131 @@ static int _decompress_error_handler(wget_decompressor *dc, int err G_GNUC_WGET_
 	return 0;
 }
 
+// multipart/byteranges parser, see RFC 7233 appendix A
+enum {
+	BYTERANGES_BOUNDARY, // skipping preamble or CRLF until the next boundary
+	BYTERANGES_HEADER, // reading the part header
+	BYTERANGES_DATA, // passing the part data to the body callback
+	BYTERANGES_END // ignoring the epilogue
+};
+
+typedef struct {
+	long long
+		remaining; // number of data bytes left in the current part
+	size_t
+		linelen;
+	int
+		state;
+	char
+		line[256]; // boundary or part header line, longer lines are truncated
+} _byteranges_t;
+
+static void _byteranges_parse_line(wget_http_response *resp, _byteranges_t *br)
+{
+	const char *boundary = resp->content_type_boundary;
+	size_t boundary_len = strlen(boundary);
+	char *line = br->line;
+
+	if (br->linelen && line[br->linelen - 1] == '\r')
+		line[--br->linelen] = 0;
+
+	if (br->state == BYTERANGES_BOUNDARY) {
+		if (br->linelen >= boundary_len + 2 && line[0] == '-' && line[1] == '-'
+			&& !memcmp(line + 2, boundary, boundary_len))
+		{
+			if (!strcmp(line + 2 + boundary_len, "--")) {
+				br->state = BYTERANGES_END;
+			} else {
+				br->state = BYTERANGES_HEADER;
+				resp->range_valid = 0;
+			}
+		}
+	} else if (!*line) {
+		// end of part header
+		if (resp->range_valid && br->remaining > 0)
+			br->state = BYTERANGES_DATA;
+		else {
+			error_printf(_("Missing Content-Range in multipart/byteranges part\n"));
+			br->state = BYTERANGES_BOUNDARY;
+		}
+	} else if (!wget_strncasecmp_ascii(line, "Content-Range:", 14)) {
+		long long first, last;
+
+		if (!wget_http_parse_content_range(line + 14, &first, &last)) {
+			resp->range_position = first;
+			resp->range_valid = 1;
+			br->remaining = last - first + 1;
+		}
+	}
+}
+
+// pass the data of each part to the body callback, with resp->range_position set to its file position
+static int _get_byteranges(wget_http_response *resp, const char *data, size_t length)
+{
+	_byteranges_t *br = resp->byteranges;
+
+	if (!br)
+		resp->byteranges = br = wget_calloc(1, sizeof(_byteranges_t));
+
+	while (length && br->state != BYTERANGES_END) {
+		if (br->state == BYTERANGES_DATA) {
+			size_t n = (unsigned long long) br->remaining < length ? (size_t) br->remaining : length;
+
+			int rc = resp->req->body_callback(resp, resp->req->body_user_data, data, n);
+
+			if (rc)
+				return rc;
+
+			resp->range_position += n;
+			data += n;
+			length -= n;
+
+			if (!(br->remaining -= n))
+				br->state = BYTERANGES_BOUNDARY;
+		} else {
+			const char *eol = memchr(data, '\n', length);
+			size_t n = eol ? (size_t) (eol - data) : length;
+
+			if (n > sizeof(br->line) - 1 - br->linelen)
+				n = sizeof(br->line) - 1 - br->linelen;
+			memcpy(br->line + br->linelen, data, n);
+			br->linelen += n;
+
+			n = eol ? (size_t) (eol - data) + 1 : length;
+			data += n;
+			length -= n;
+
+			if (eol) {
+				br->line[br->linelen] = 0;
+				_byteranges_parse_line(resp, br);
+				br->linelen = 0;
+			}
+		}
+	}
+
+	return 0;
+}
+
 static wget_decompressor_sink_t _get_body;
 static int _get_body(void *userdata, const char *data, size_t length)
 {
 	wget_http_response *resp = (wget_http_response *) userdata;
+	int rc;
+
+	if (resp->body_aborted)
+		return -1; // the decompressor may still have buffered output
+
+	if (resp->code == HTTP_STATUS_PARTIAL_CONTENTS && resp->content_type_boundary)
+		rc = _get_byteranges(resp, data, length);
+	else {
+		rc = resp->req->body_callback(resp, resp->req->body_user_data, data, length);
+		resp->range_position += length;
+	}
+
+	if (rc)
+		resp->body_aborted = 1; // stop requested by callback function
 
-	return resp->req->body_callback(resp, resp->req->body_user_data, data, length);
+	return rc;
 }
 
 static void _fix_broken_server_encoding(wget_http_response *resp)
@@ -513,9 +649,33 @@ static int _on_frame_recv_callback(nghttp2_session *session,
 		struct _http2_stream_context *ctx = nghttp2_session_get_stream_user_data(session, frame->hd.stream_id);
 		wget_http_response *resp = ctx ? ctx->resp : NULL;
 
-		if (resp) {
+		if (resp && !ctx->final_header && H_10X(resp->code)) {
+			// informational response (e.g. 103 Early Hints), the final response follows
+			wget_http_request *req = resp->req;
+
+			if (req->interim_callback)
+				req->interim_callback(resp, req->interim_user_data);
+
+			wget_http_free_response(&ctx->resp);
+			ctx->resp = wget_calloc(1, sizeof(wget_http_response));
+			ctx->resp->req = req;
+			ctx->resp->major = 2;
+			ctx->resp->keep_alive = 1;
+		} else if (resp && !ctx->final_header) {
+			ctx->final_header = 1;
+
 			if (resp->header && resp->req->header_callback) {
-				resp->req->header_callback(resp, resp->req->header_user_data);
+				if (resp->req->header_callback(resp, resp->req->header_user_data))
+					resp->body_aborted = 1; // stop requested by callback function
+			}
+
+			// cancel the stream instead of receiving an unwanted body, other streams go on
+			if ((resp->skip_body || resp->body_aborted) && !(frame->hd.flags & NGHTTP2_FLAG_END_STREAM)) {
+				debug_printf("cancel stream %d, body not needed\n", frame->hd.stream_id);
+				if (resp->skip_body)
+					resp->body_skipped = resp->content_length_valid ? resp->content_length : 0;
+				nghttp2_submit_rst_stream(session, NGHTTP2_FLAG_NONE, frame->hd.stream_id, NGHTTP2_CANCEL);
+				return 0;
 			}
 
 			_fix_broken_server_encoding(resp);
@@ -523,6 +683,7 @@ static int _on_frame_recv_callback(nghttp2_session *session,
 			if (!ctx->decompressor) {
 				ctx->decompressor = wget_decompress_open(resp->content_encoding, _get_body, resp);
 				wget_decompress_set_error_handler(ctx->decompressor, _decompress_error_handler);
+				wget_decompress_set_dictionary(ctx->decompressor, resp->req->dictionary, resp->req->dictionary_length, resp->req->dictionary_hash);
 			}
 		}
 	}
@@ -547,7 +708,8 @@ static int _on_header_callback(nghttp2_session *session,
 	}
 
 	if (frame->hd.type == NGHTTP2_HEADERS) {
-		if (frame->headers.cat == NGHTTP2_HCAT_RESPONSE) {
+		// after 1xx responses, the final response header comes as NGHTTP2_HCAT_HEADERS, trailers are ignored
+		if ((frame->headers.cat == NGHTTP2_HCAT_RESPONSE || frame->headers.cat == NGHTTP2_HCAT_HEADERS) && !ctx->final_header) {
 			debug_printf("%.*s: %.*s\n", (int) namelen, name, (int) valuelen, value);
 
 			if (resp->header)
@@ -572,7 +734,11 @@ static int _on_stream_close_callback(nghttp2_session *session, int32_t stream_id
 	if (ctx) {
 		wget_http_connection *conn = (wget_http_connection *) user_data;
 
-		ctx->resp->response_end = wget_get_timemillis(); // Final transmission time.
+		ctx->resp->response_end = wget_get_monotonic_millis(); // Final transmission time.
+
+		if (!ctx->resp->skip_body && !ctx->resp->body_aborted
+			&& ctx->resp->content_length_valid && ctx->resp->cur_downloaded < ctx->resp->content_length)
+			ctx->resp->truncated = 1; // e.g. RST_STREAM from the server
 
 		wget_vector_add(conn->received_http2_responses, ctx->resp);
 		wget_decompress_close(ctx->decompressor);
@@ -596,10 +762,23 @@ static int _on_data_chunk_recv_callback(nghttp2_session *session,
 		// debug_printf("[INFO] C <---------------------------- S%d (DATA chunk - %zu bytes)\n", stream_id, len);
 		// debug_printf("nbytes %zu\n", len);
 
-		ctx->resp->req->first_response_start = wget_get_timemillis();
+		ctx->resp->req->first_response_start = wget_get_monotonic_millis();
+
+		if (ctx->resp->skip_body || ctx->resp->body_aborted) {
+			// DATA frames already in flight when the stream was cancelled
+			if (ctx->resp->skip_body && !ctx->resp->content_length_valid)
+				ctx->resp->body_skipped += len;
+			return 0;
+		}
 
 		ctx->resp->cur_downloaded += len;
 		wget_decompress(ctx->decompressor, (char *) data, len);
+
+		if (ctx->resp->body_aborted) {
+			// stop requested by the body callback, just cancel this stream
+			debug_printf("cancel stream %d, stopped by body callback\n", stream_id);
+			nghttp2_submit_rst_stream(session, NGHTTP2_FLAG_NONE, stream_id, NGHTTP2_CANCEL);
+		}
 	}
 	return 0;
 }
@@ -710,6 +889,20 @@ static void _server_stats_add(wget_http_connection *conn, wget_http_response *re
 }
 
 int wget_http_open(wget_http_connection **_conn, const wget_iri *iri)
+{
+	return wget_http_open_timeout(_conn, iri, wget_tcp_get_connect_timeout(NULL));
+}
+
+/**
+ * \param[out] _conn Pointer to the new connection
+ * \param[in] iri URI to connect to
+ * \param[in] connect_timeout Connect timeout in milliseconds, -1 for infinite
+ * \return WGET_E_SUCCESS on success or an error code
+ *
+ * Like wget_http_open() but with a connect timeout that overrides the value
+ * set by wget_tcp_set_connect_timeout(NULL, ...) for this connection.
+ */
+int wget_http_open_timeout(wget_http_connection **_conn, const wget_iri *iri, int connect_timeout)
 {
 	static int next_http_proxy = -1;
 	static int next_https_proxy = -1;
@@ -751,6 +944,7 @@ int wget_http_open(wget_http_connection **_conn, const wget_iri *iri)
 	wget_thread_mutex_unlock(proxy_mutex);
 
 	conn->tcp = wget_tcp_init();
+	wget_tcp_set_connect_timeout(conn->tcp, connect_timeout);
 	if (ssl) {
 		wget_tcp_set_ssl(conn->tcp, 1); // switch SSL on
 		wget_tcp_set_ssl_hostname(conn->tcp, host); // enable host name checking
@@ -815,6 +1009,18 @@ int wget_http_open(wget_http_connection **_conn, const wget_iri *iri)
 	return rc;
 }
 
+/**
+ * \param[in] conn HTTP connection
+ * \param[in] timeout Read/write timeout in milliseconds, -1 for infinite
+ *
+ * Set the read and write timeout of an established connection.
+ */
+void wget_http_set_timeout(wget_http_connection *conn, int timeout)
+{
+	if (conn && conn->tcp)
+		wget_tcp_set_timeout(conn->tcp, timeout);
+}
+
 void wget_http_close(wget_http_connection **conn)
 {
 	if (*conn) {
@@ -841,7 +1047,44 @@ void wget_http_close(wget_http_connection **conn)
 	}
 }
 
+/**
+ * \param[in] urgency RFC 9218 urgency, 0 (highest) to 7
+ * \param[in] incremental RFC 9218 incremental flag
+ * \param[out] buf Output buffer
+ * \param[in] bufsize Size of \p buf
+ * \return \p buf
+ *
+ * Print the RFC 9218 Priority field value for \p urgency and \p incremental
+ * into \p buf, e.g. "u=1" or "u=5, i". Out of range urgencies are clamped.
+ */
+char *wget_http_print_priority(int urgency, bool incremental, char *buf, size_t bufsize)
+{
+	if (!bufsize)
+		return buf;
+
+	wget_snprintf(buf, bufsize, "u=%d%s", urgency < 0 ? 0 : urgency > 7 ? 7 : urgency, incremental ? ", i" : "");
+
+	return buf;
+}
+
+/**
+ * \param[in] urgency RFC 9218 urgency, 0 (highest) to 7
+ * \return RFC 7540 stream weight
+ *
+ * Map \p urgency to a HTTP/2 stream weight for servers without RFC 9218 support:
+ * 256 for urgency 0 down to 2 for urgency 7. Out of range urgencies are clamped.
+ */
+int wget_http_priority_weight(int urgency)
+{
+	return 256 >> (urgency < 0 ? 0 : urgency > 7 ? 7 : urgency);
+}
+
 #ifdef WITH_LIBNGHTTP2
+static void _priority_spec(const wget_http_request *req, nghttp2_priority_spec *pri_spec)
+{
+	nghttp2_priority_spec_init(pri_spec, 0, wget_http_priority_weight(req->priority_urgency), 0);
+}
+
 static void _init_nv(nghttp2_nv *nv, const char *name, const char *value)
 {
 	nv->name = (uint8_t *)name;
@@ -852,15 +1095,62 @@ static void _init_nv(nghttp2_nv *nv, const char *name, const char *value)
 }
 #endif
 
+/**
+ * \param[in] conn HTTP connection
+ * \param[in] req Request that has been sent over \p conn
+ * \param[in] urgency RFC 9218 urgency, 0 (highest) to 7
+ * \param[in] incremental RFC 9218 incremental flag
+ * \return WGET_E_SUCCESS on success or an error code
+ *
+ * Change the priority of a pending request, e.g. when the response header
+ * reveals a large body. On HTTP/2 connections a PRIORITY_UPDATE frame (RFC 9218)
+ * and a legacy PRIORITY frame (RFC 7540) are queued. HTTP/1.1 has nothing to reprioritize.
+ */
+int wget_http_update_priority(wget_http_connection *conn, wget_http_request *req, int urgency, bool incremental)
+{
+	wget_http_request_set_int(req, WGET_HTTP_PRIORITY_URGENCY, urgency < 0 ? 0 : urgency);
+	wget_http_request_set_int(req, WGET_HTTP_PRIORITY_INCREMENTAL, incremental);
+
+#ifdef WITH_LIBNGHTTP2
+	if (conn->protocol == WGET_PROTOCOL_HTTP_2_0 && req->stream_id > 0) {
+		nghttp2_priority_spec pri_spec;
+		int rc;
+
+#ifdef HAVE_NGHTTP2_SUBMIT_PRIORITY_UPDATE
+		char priority[16];
+
+		wget_http_print_priority(req->priority_urgency, req->priority_incremental, priority, sizeof(priority));
+		if ((rc = nghttp2_submit_priority_update(conn->http2_session, NGHTTP2_FLAG_NONE, req->stream_id,
+			(const uint8_t *) priority, strlen(priority))))
+		{
+			debug_printf("Failed to submit HTTP2 priority update (%d)\n", rc);
+		}
+#endif
+
+		_priority_spec(req, &pri_spec);
+		if ((rc = nghttp2_submit_priority(conn->http2_session, NGHTTP2_FLAG_NONE, req->stream_id, &pri_spec))) {
+			debug_printf("Failed to submit HTTP2 priority (%d)\n", rc);
+			return WGET_E_UNKNOWN;
+		}
+	}
+#else
+	(void) conn;
+#endif
+
+	return WGET_E_SUCCESS;
+}
+
 int wget_http_send_request(wget_http_connection *conn, wget_http_request *req)
 {
 	ssize_t nbytes;
 
 #ifdef WITH_LIBNGHTTP2
 	if (wget_tcp_get_protocol(conn->tcp) == WGET_PROTOCOL_HTTP_2_0) {
-		int n = 4 + wget_vector_size(req->headers);
+		int n = 5 + wget_vector_size(req->headers);
 		nghttp2_nv nvs[n], *nvp;
+		nghttp2_priority_spec pri_spec;
 		char resource[req->esc_resource.length + 2];
+		char priority[16];
 
 		resource[0] = '/';
 		memcpy(resource + 1, req->esc_resource.data, req->esc_resource.length + 1);
@@ -884,6 +1174,12 @@ int wget_http_send_request(wget_http_connection *conn, wget_http_request *req)
 			_init_nv(nvp++, param->name, param->value);
 		}
 
+		if (req->priority_urgency >= 0) {
+			wget_http_print_priority(req->priority_urgency, req->priority_incremental, priority, sizeof(priority));
+			_init_nv(nvp++, "priority", priority);
+			_priority_spec(req, &pri_spec);
+		}
+
 		struct _http2_stream_context *ctx = wget_calloc(1, sizeof(struct _http2_stream_context));
 		// HTTP/2.0 has the streamid as link between
 		ctx->resp = wget_calloc(1, sizeof(wget_http_response));
@@ -891,10 +1187,11 @@ int wget_http_send_request(wget_http_connection *conn, wget_http_request *req)
 		ctx->resp->major = 2;
 		// we do not get a Keep-Alive header in HTTP2 - let's assume the connection stays open
 		ctx->resp->keep_alive = 1;
-		req->request_start = wget_get_timemillis();
+		req->request_start = wget_get_monotonic_millis();
 
 		// nghttp2 does strdup of name+value and lowercase conversion of 'name'
-		req->stream_id = nghttp2_submit_request(conn->http2_session, NULL, nvs, nvp - nvs, NULL, ctx);
+		req->stream_id = nghttp2_submit_request(conn->http2_session, req->priority_urgency >= 0 ? &pri_spec : NULL,
+			nvs, nvp - nvs, NULL, ctx);
 
 		if (req->stream_id < 0) {
 			error_printf(_("Failed to submit HTTP2 request\n"));
@@ -916,7 +1213,7 @@ int wget_http_send_request(wget_http_connection *conn, wget_http_request *req)
 		return -1;
 	}
 
-	req->request_start = wget_get_timemillis();
+	req->request_start = wget_get_monotonic_millis();
 
 	if (wget_tcp_write(conn->tcp, conn->buf->data, nbytes) != nbytes) {
 		// An error will be written by the wget_tcp_write function.
@@ -983,6 +1280,39 @@ ssize_t wget_http_request_to_buffer(wget_http_request *req, wget_buffer *buf, in
 	return buf->length;
 }
 
+// Get rid of a HTTP/1.x body the application has no use for.
+// A short rest is drained to keep the connection, a large or unknown one closes it.
+static void _skip_body(wget_http_connection *conn, wget_http_response *resp, size_t body_len)
+{
+	char *buf = conn->buf->data;
+	size_t bufsize = conn->buf->size;
+	ssize_t nbytes;
+
+	if (!resp->keep_alive || resp->transfer_encoding != wget_transfer_encoding_identity || !resp->content_length_valid
+		|| (resp->content_length > body_len && resp->content_length - body_len > HTTP_DRAIN_MAX))
+	{
+		debug_printf("close connection, body not needed\n");
+		resp->body_skipped = resp->content_length_valid && resp->content_length > body_len ? resp->content_length : body_len;
+		resp->keep_alive = 0;
+		return;
+	}
+
+	debug_printf("drain %zu bytes, body not needed\n", resp->content_length - body_len);
+
+	while (body_len < resp->content_length) {
+		size_t n = resp->content_length - body_len < bufsize ? resp->content_length - body_len : bufsize;
+
+		if (conn->abort_indicator || _abort_indicator || (nbytes = wget_tcp_read(conn->tcp, buf, n)) <= 0) {
+			resp->keep_alive = 0;
+			break;
+		}
+
+		body_len += nbytes;
+	}
+
+	resp->body_skipped = body_len;
+}
+
 wget_http_response *wget_http_get_response_cb(wget_http_connection *conn)
 {
 	size_t bufsize, body_len = 0, body_size = 0;
@@ -1050,11 +1380,12 @@ wget_http_response *wget_http_get_response_cb(wget_http_connection *conn)
 	bufsize = conn->buf->size;
 
 	while ((nbytes = wget_tcp_read(conn->tcp, buf + nread, bufsize - nread)) > 0) {
-		req->first_response_start = wget_get_timemillis();
+		req->first_response_start = wget_get_monotonic_millis();
 		// debug_printf("nbytes %zd nread %zd %zu\n", nbytes, nread, bufsize);
 		nread += nbytes;
 		buf[nread] = 0; // 0-terminate to allow string functions
 
+next_header:
 		if (nread < 4) continue;
 
 		if (nread == nbytes)
@@ -1087,12 +1418,30 @@ wget_http_response *wget_http_get_response_cb(wget_http_connection *conn)
 
 			resp->req = req;
 
+			// informational responses (e.g. 103 Early Hints) precede the final response
+			if (H_10X(resp->code) && resp->code != HTTP_STATUS_SWITCHING_PROTOCOLS) {
+				if (req->interim_callback)
+					req->interim_callback(resp, req->interim_user_data);
+
+				wget_http_free_response(&resp);
+
+				// the final response header may already be in the buffer
+				p += 4;
+				nread -= p - buf;
+				memmove(buf, p, nread + 1);
+				nbytes = nread;
+				goto next_header;
+			}
+
 			if (server_stats_callback)
 				_server_stats_add(conn, resp);
 
 			if (req->header_callback) {
-				if (req->header_callback(resp, req->header_user_data))
+				if (req->header_callback(resp, req->header_user_data)) {
+					if (wget_strcasecmp_ascii(req->method, "HEAD"))
+						resp->body_aborted = 1;
 					goto cleanup; // stop requested by callback function
+				}
 			}
 
 			if (req && !wget_strcasecmp_ascii(req->method, "HEAD"))
@@ -1138,8 +1487,14 @@ wget_http_response *wget_http_get_response_cb(wget_http_connection *conn)
 		goto cleanup;
 	}
 
+	if (resp->skip_body) {
+		_skip_body(conn, resp, nread - (p - buf));
+		goto cleanup;
+	}
+
 	dc = wget_decompress_open(resp->content_encoding, _get_body, resp);
 	wget_decompress_set_error_handler(dc, _decompress_error_handler);
+	wget_decompress_set_dictionary(dc, resp->req->dictionary, resp->req->dictionary_length, resp->req->dictionary_hash);
 
 	// calculate number of body bytes so far read
 	body_len = nread - (p - buf);
@@ -1194,7 +1549,7 @@ wget_http_response *wget_http_get_response_cb(wget_http_connection *conn)
 		for (;;) {
 			// read: chunk-size [ chunk-extension ] CRLF
 			while ((!(end = strchr(p, '\r')) || end[1] != '\n')) {
-				if (conn->abort_indicator || _abort_indicator)
+				if (conn->abort_indicator || _abort_indicator || resp->body_aborted)
 					goto cleanup;
 
 				if ((nbytes = wget_tcp_read(conn->tcp, buf + body_len, bufsize - body_len)) <= 0)
@@ -1222,7 +1577,7 @@ wget_http_response *wget_http_get_response_cb(wget_http_connection *conn)
 						body_len = 3;
 					}
 
-					if (conn->abort_indicator || _abort_indicator)
+					if (conn->abort_indicator || _abort_indicator || resp->body_aborted)
 						goto cleanup;
 
 					if ((nbytes = wget_tcp_read(conn->tcp, buf + body_len, bufsize - body_len)) <= 0)
@@ -1260,7 +1615,7 @@ wget_http_response *wget_http_get_response_cb(wget_http_connection *conn)
 			debug_printf("need at least %zu more bytes\n", chunk_size);
 
 			while (chunk_size > 0) {
-				if (conn->abort_indicator || _abort_indicator)
+				if (conn->abort_indicator || _abort_indicator || resp->body_aborted)
 					goto cleanup;
 
 				if ((nbytes = wget_tcp_read(conn->tcp, buf, bufsize)) <= 0)
@@ -1306,7 +1661,7 @@ wget_http_response *wget_http_get_response_cb(wget_http_connection *conn)
 			wget_decompress(dc, buf, body_len);
 
 		while (body_len < resp->content_length) {
-			if (conn->abort_indicator || _abort_indicator)
+			if (conn->abort_indicator || _abort_indicator || resp->body_aborted)
 				break;
 
 			if (((nbytes = wget_tcp_read(conn->tcp, buf, bufsize)) <= 0))
@@ -1319,8 +1674,10 @@ wget_http_response *wget_http_get_response_cb(wget_http_connection *conn)
 		}
 		if (nbytes < 0)
 			error_printf(_("Failed to read %zd bytes (%d)\n"), nbytes, errno);
-		if (body_len < resp->content_length)
+		if (body_len < resp->content_length) {
 			error_printf(_("Just got %zu of %zu bytes\n"), body_len, resp->content_length);
+			resp->truncated = !conn->abort_indicator && !_abort_indicator && !resp->body_aborted;
+		}
 		else if (body_len > resp->content_length)
 			error_printf(_("Body too large: %zu instead of %zu bytes\n"), body_len, resp->content_length);
 		resp->content_length = body_len;
@@ -1331,7 +1688,7 @@ wget_http_response *wget_http_get_response_cb(wget_http_connection *conn)
 		if (body_len)
 			wget_decompress(dc, buf, body_len);
 
-		while (!conn->abort_indicator && !_abort_indicator && (nbytes = wget_tcp_read(conn->tcp, buf, bufsize)) > 0) {
+		while (!conn->abort_indicator && !_abort_indicator && !resp->body_aborted && (nbytes = wget_tcp_read(conn->tcp, buf, bufsize)) > 0) {
 			body_len += nbytes;
 			// debug_printf("nbytes %zd total %zu\n", nbytes, body_len);
 			resp->cur_downloaded += nbytes;
@@ -1342,8 +1699,12 @@ wget_http_response *wget_http_get_response_cb(wget_http_connection *conn)
 
 cleanup:
 
-	if (resp)
-		resp->response_end = wget_get_timemillis();
+	if (resp) {
+		resp->response_end = wget_get_monotonic_millis();
+
+		if (resp->body_aborted)
+			resp->keep_alive = 0; // the unread rest of the body makes the connection unusable
+	}
 
 	wget_decompress_close(dc);
 
@@ -60,6 +60,10 @@ struct wget_http_connection_st {
 /* HTTP/1.0 status codes from RFC1945 */
 #define H_10X(x)        (((x) >= 100) && ((x) < 200))
 
+/* Informational 1xx.  */
+#define HTTP_STATUS_SWITCHING_PROTOCOLS   101
+#define HTTP_STATUS_EARLY_HINTS           103 /* RFC 8297 */
+
 /* Successful 2xx.  */
 #define HTTP_STATUS_OK                    200
 #define HTTP_STATUS_CREATED               201
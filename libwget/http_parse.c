@@ -293,10 +293,23 @@ const char *wget_http_parse_link(const char *s, wget_http_link *link)
 				s = wget_http_parse_param(s, &name, &value);
 				if (name && value) {
 					if (!wget_strcasecmp_ascii(name, "rel")) {
-						if (!wget_strcasecmp_ascii(value, "describedby"))
-							link->rel = link_rel_describedby;
-						else if (!wget_strcasecmp_ascii(value, "duplicate"))
-							link->rel = link_rel_duplicate;
+						// the value may be a space separated list of relation types
+						for (const char *rel = value, *end; *rel; rel = end) {
+							size_t len;
+
+							while (c_isblank(*rel)) rel++;
+							for (end = rel; *end && !c_isblank(*end); end++);
+							len = end - rel;
+
+							if (len == 11 && !wget_strncasecmp_ascii(rel, "describedby", len))
+								link->rel = link_rel_describedby;
+							else if (len == 9 && !wget_strncasecmp_ascii(rel, "duplicate", len))
+								link->rel = link_rel_duplicate;
+							else if (len == 7 && !wget_strncasecmp_ascii(rel, "preload", len))
+								link->rel = link_rel_preload;
+							else if (len == 13 && !wget_strncasecmp_ascii(rel, "modulepreload", len))
+								link->rel = link_rel_modulepreload;
+						}
 					} else if (!wget_strcasecmp_ascii(name, "pri")) {
 						link->pri = atoi(value);
 					} else if (!wget_strcasecmp_ascii(name, "type")) {
@@ -316,7 +329,9 @@ const char *wget_http_parse_link(const char *s, wget_http_link *link)
 			//			if (!msg->contacts) msg->contacts=vec_create(1,1,NULL);
 			//			vec_add(msg->contacts,&contact,sizeof(contact));
 
-			while (*s && !c_isblank(*s)) s++;
+			// skip to the next link of a comma separated list
+			while (*s && *s != ',') s++;
+			if (*s == ',') s++;
 		}
 	}
 
@@ -496,6 +511,40 @@ const char *wget_http_parse_content_type(const char *s, const char **content_typ
 	return s;
 }
 
+// RFC 7233 4.2
+//
+// Content-Range       = byte-content-range / other-content-range
+// byte-content-range  = bytes-unit SP ( byte-range-resp / unsatisfied-range )
+// byte-range-resp     = byte-range "/" ( complete-length / "*" )
+// byte-range          = first-byte-pos "-" last-byte-pos
+//
+// We also accept a missing bytes-unit, some servers send it that way.
+
+int wget_http_parse_content_range(const char *s, long long *first, long long *last)
+{
+	char *end;
+
+	while (c_isblank(*s)) s++;
+
+	if (!wget_strncasecmp_ascii(s, "bytes", 5)) {
+		s += 5;
+		while (c_isblank(*s)) s++;
+	}
+
+	if (!c_isdigit(*s))
+		return -1;
+
+	*first = strtoll(s, &end, 10);
+	if (*end != '-' || !c_isdigit(end[1]))
+		return -1;
+
+	*last = strtoll(end + 1, &end, 10);
+	if (*last < *first)
+		return -1;
+
+	return 0;
+}
+
 // RFC 2183
 //
 // disposition := "Content-Disposition" ":" disposition-type *(";" disposition-parm)
@@ -694,6 +743,10 @@ const char *wget_http_parse_content_encoding(const char *s, char *content_encodi
 		*content_encoding = wget_content_encoding_brotli;
 	else if (!wget_strcasecmp_ascii(s, "zstd"))
 		*content_encoding = wget_content_encoding_zstd;
+	else if (!wget_strcasecmp_ascii(s, "dcb"))
+		*content_encoding = wget_content_encoding_dcb;
+	else if (!wget_strcasecmp_ascii(s, "dcz"))
+		*content_encoding = wget_content_encoding_dcz;
 	else
 		*content_encoding = wget_content_encoding_identity;
 
@@ -1061,6 +1114,12 @@ int wget_http_parse_header_line(wget_http_response *resp, const char *name, size
 		value0 = wget_strmemdup(value, valuelen);
 
 	switch (*name | 0x20) {
+	case 'a':
+		if (!wget_strncasecmp_ascii(name, "accept-ranges", namelen)) {
+			resp->accept_ranges = !wget_strcasecmp_ascii(value0, "bytes");
+		} else
+			ret = -1;
+		break;
 	case ':':
 		if (!memcmp(name, ":status", namelen) && valuelen == 3) {
 			resp->code = ((value[0] - '0') * 10 + (value[1] - '0')) * 10 + (value[2] - '0');
@@ -1071,8 +1130,32 @@ int wget_http_parse_header_line(wget_http_response *resp, const char *name, size
 		if (!wget_strncasecmp_ascii(name, "content-encoding", namelen)) {
 			wget_http_parse_content_encoding(value0, &resp->content_encoding);
 		} else if (!wget_strncasecmp_ascii(name, "content-type", namelen)) {
-			if (!resp->content_type && !resp->content_type_encoding)
+			if (!resp->content_type && !resp->content_type_encoding) {
 				wget_http_parse_content_type(value0, &resp->content_type, &resp->content_type_encoding);
+
+				// RFC 7233 appendix A: the parts are separated by the 'boundary' parameter
+				if (!wget_strcasecmp_ascii(resp->content_type, "multipart/byteranges")) {
+					wget_http_header_param param;
+					const char *s = strchr(value0, ';');
+
+					while (s && *s) {
+						s = wget_http_parse_param(s, &param.name, &param.value);
+						if (param.value && !resp->content_type_boundary && !wget_strcasecmp_ascii("boundary", param.name)) {
+							resp->content_type_boundary = param.value;
+							param.value = NULL;
+						}
+						xfree(param.name);
+						xfree(param.value);
+					}
+				}
+			}
+		} else if (!wget_strncasecmp_ascii(name, "content-range", namelen)) {
+			long long first, last;
+
+			if (!wget_http_parse_content_range(value0, &first, &last)) {
+				resp->range_position = first;
+				resp->range_valid = 1;
+			}
 		} else if (!wget_strncasecmp_ascii(name, "content-length", namelen)) {
 			resp->content_length = (size_t)atoll(value0);
 			resp->content_length_valid = 1;
@@ -1097,6 +1180,8 @@ int wget_http_parse_header_line(wget_http_response *resp, const char *name, size
 				wget_vector_set_destructor(resp->digests, (wget_vector_destructor_t *) wget_http_free_digest);
 			}
 			wget_vector_add_memdup(resp->digests, &digest, sizeof(digest));
+		} else if (!wget_strncasecmp_ascii(name, "date", namelen)) {
+			resp->date = wget_http_parse_full_date(value0);
 		} else
 			ret = -1;
 		break;
@@ -1120,16 +1205,28 @@ int wget_http_parse_header_line(wget_http_response *resp, const char *name, size
 		} else if (resp->code / 100 == 3 && !wget_strncasecmp_ascii(name, "location", namelen)) {
 			if (!resp->location)
 				wget_http_parse_location(value0, &resp->location);
-		} else if (resp->code / 100 == 3 && !wget_strncasecmp_ascii(name, "link", namelen)) {
-			// debug_printf("s=%.31s\n",s);
-			wget_http_link link;
-			wget_http_parse_link(value0, &link);
-			// debug_printf("link->uri=%s\n",link.uri);
-			if (!resp->links) {
-				resp->links = wget_vector_create(8, NULL);
-				wget_vector_set_destructor(resp->links, (wget_vector_destructor_t *) wget_http_free_link);
+		} else if (resp->code / 100 <= 3 && !wget_strncasecmp_ascii(name, "link", namelen)) {
+			// 3xx: mirrors (RFC 6249), 1xx/2xx: preload hints, e.g. from 103 Early Hints (RFC 8297)
+			for (const char *s = value0; *s;) {
+				wget_http_link link;
+
+				s = wget_http_parse_link(s, &link);
+				// debug_printf("link->uri=%s\n",link.uri);
+				if (!link.uri)
+					break;
+
+				if (resp->code / 100 != 3 && link.rel != link_rel_preload && link.rel != link_rel_modulepreload) {
+					xfree(link.uri);
+					xfree(link.type);
+					continue;
+				}
+
+				if (!resp->links) {
+					resp->links = wget_vector_create(8, NULL);
+					wget_vector_set_destructor(resp->links, (wget_vector_destructor_t *) wget_http_free_link);
+				}
+				wget_vector_add_memdup(resp->links, &link, sizeof(link));
 			}
-			wget_vector_add_memdup(resp->links, &link, sizeof(link));
 		} else
 			ret = -1;
 		break;
@@ -1179,6 +1276,14 @@ int wget_http_parse_header_line(wget_http_response *resp, const char *name, size
 		} else
 			ret = -1;
 		break;
+	case 'u':
+		if (!wget_strncasecmp_ascii(name, "use-as-dictionary", namelen)) {
+			// https://datatracker.ietf.org/doc/draft-ietf-httpbis-compression-dictionary/
+			if (!resp->use_as_dictionary)
+				resp->use_as_dictionary = wget_strdup(value0);
+		} else
+			ret = -1;
+		break;
 	case 'w':
 		if (!wget_strncasecmp_ascii(name, "www-authenticate", namelen)) {
 			wget_http_challenge *challenge = wget_malloc(sizeof(wget_http_challenge));
@@ -1339,6 +1444,9 @@ void wget_http_free_response(wget_http_response **resp)
 		xfree((*resp)->content_filename);
 		xfree((*resp)->location);
 		xfree((*resp)->etag);
+		xfree((*resp)->use_as_dictionary);
+		xfree((*resp)->content_type_boundary);
+		xfree((*resp)->byteranges);
 		// xfree((*resp)->reason);
 		wget_buffer_free(&(*resp)->header);
 		wget_buffer_free(&(*resp)->body);
@@ -92,6 +92,7 @@ void wget_global_init(int first_key, ...)
 
 	wget_console_init();
 	wget_random_init();
+	wget_intern_init();
 	wget_http_init();
 
 	va_start (args, first_key);
@@ -0,0 +1,146 @@
+/*
+ * Copyright(c) 2019 Free Software Foundation, Inc.
+ *
+ * This file is part of libwget.
+ *
+ * Libwget is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Libwget is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libwget.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *
+ * String interning
+ *
+ */
+
+#include <config.h>
+
+#include <string.h>
+
+#include <wget.h>
+#include "private.h"
+
+/**
+ * \file
+ * \brief String interning functions
+ * \defgroup libwget-intern String interning functions
+ * @{
+ *
+ * Low-cardinality strings like host names, MIME types and charset names are
+ * kept just once in a global, thread-safe table. Equal interned strings have
+ * the same address, so they can be compared by pointer.
+ *
+ * Interned strings must not be modified or free'd. They stay valid until
+ * wget_intern_exit() is called or the library is unloaded.
+ *
+ * The host part of an IRI created by wget_iri_parse() is interned.
+ */
+
+static wget_stringmap *strings;
+static wget_thread_mutex mutex;
+static bool initialized;
+
+static void __attribute__ ((constructor)) _wget_intern_init(void)
+{
+	if (!initialized) {
+		wget_thread_mutex_init(&mutex);
+		initialized = 1;
+	}
+}
+
+static void __attribute__ ((destructor)) _wget_intern_exit(void)
+{
+	if (initialized) {
+		wget_stringmap_free(&strings);
+		wget_thread_mutex_destroy(&mutex);
+		initialized = 0;
+	}
+}
+
+/**
+ * String interning initialization, allocating/preparing the internal resources.
+ *
+ * On systems with automatic library constructors, this function
+ * doesn't have to be called explicitly.
+ *
+ * This function is not thread-safe.
+ */
+void wget_intern_init(void)
+{
+	_wget_intern_init();
+}
+
+/**
+ * String interning deinitialization, free'ing all interned strings.
+ *
+ * On systems with automatic library destructors, this function
+ * doesn't have to be called explicitly.
+ *
+ * This function is not thread-safe.
+ */
+void wget_intern_exit(void)
+{
+	_wget_intern_exit();
+}
+
+/**
+ * \param[in] s String to be interned
+ * \param[in] len Length of \p s
+ * \return Interned copy of \p s or NULL if \p s is NULL
+ *
+ * Returns the interned copy of the first \p len bytes of \p s, creating it if needed.
+ */
+const char *wget_intern_mem(const char *s, size_t len)
+{
+	char *interned, buf[256], *key;
+
+	if (!s)
+		return NULL;
+
+	// the stringmap needs a 0-terminated key
+	if (len < sizeof(buf)) {
+		memcpy(buf, s, len);
+		buf[len] = 0;
+		key = buf;
+	} else
+		key = wget_strmemdup(s, len);
+
+	wget_thread_mutex_lock(mutex);
+
+	if (!strings)
+		strings = wget_stringmap_create(128);
+
+	if (!wget_stringmap_get(strings, key, &interned)) {
+		interned = key == buf ? wget_strmemdup(s, len) : key;
+		key = NULL;
+		wget_stringmap_put(strings, interned, interned); // key and value are the same string
+	}
+
+	wget_thread_mutex_unlock(mutex);
+
+	if (key != buf)
+		xfree(key);
+
+	return interned;
+}
+
+/**
+ * \param[in] s 0-terminated string to be interned
+ * \return Interned copy of \p s or NULL if \p s is NULL
+ *
+ * Returns the interned copy of \p s, creating it if needed.
+ */
+const char *wget_intern(const char *s)
+{
+	return s ? wget_intern_mem(s, strlen(s)) : NULL;
+}
+
+/**@}*/
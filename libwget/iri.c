@@ -597,6 +597,14 @@ wget_iri *wget_iri_parse(const char *url, const char *encoding)
 		// Finally, if the host is a literal IPv4 or IPv6 address, mark it as so
 		if (wget_ip_is_family(iri->host, WGET_NET_FAMILY_IPV4) || wget_ip_is_family(iri->host, WGET_NET_FAMILY_IPV6))
 			iri->is_ip_address = true;
+
+		// hosts are interned, equal hosts can be compared by pointer
+		p = (char *) wget_intern(iri->host);
+		if (iri->host_allocated) {
+			xfree(iri->host);
+			iri->host_allocated = false;
+		}
+		iri->host = p;
 	}
 	else {
 		if (iri->scheme == WGET_IRI_SCHEME_HTTP || iri->scheme == WGET_IRI_SCHEME_HTTPS) {
@@ -663,10 +671,7 @@ wget_iri *wget_iri_clone(const wget_iri *iri)
 	clone->connection_part = wget_strdup(iri->connection_part);
 
 	// adjust pointers
-	if (iri->host_allocated)
-		clone->host = wget_strdup(iri->host);
-	else
-		clone->host = iri->host ? (char *)clone + (size_t) (iri->host - (const char *)iri) : NULL;
+	// not adjust host, it is interned
 
 	clone->display = iri->display ? (char *)clone + (size_t) (iri->display - (const char *)iri): NULL;
 	// not adjust scheme, it is a pointer to a static string
@@ -979,8 +984,8 @@ int wget_iri_compare(wget_iri *iri1, wget_iri *iri2)
 	if ((n = iri1->port - iri2->port))
 		return n;
 
-	// host is already lowercase, no need to call strcasecmp()
-	if ((n = strcmp(iri1->host, iri2->host)))
+	// host is already lowercase and interned, only different hosts need strcmp()
+	if (iri1->host != iri2->host && (n = strcmp(iri1->host, iri2->host)))
 		return n;
 
 	// if ((n = wget_strcasecmp(iri1->fragment, iri2->fragment)))
@@ -375,6 +375,17 @@ void wget_tcp_set_connect_timeout(wget_tcp *tcp, int timeout)
 	(tcp ? tcp : &_global_tcp)->connect_timeout = timeout;
 }
 
+/**
+ * \param[in] tcp A TCP connection.
+ * \return The timeout value that was set with wget_tcp_set_connect_timeout().
+ *
+ * Get the timeout value that was set with wget_tcp_set_connect_timeout().
+ */
+int wget_tcp_get_connect_timeout(wget_tcp *tcp)
+{
+	return (tcp ? tcp : &_global_tcp)->connect_timeout;
+}
+
 /**
  * \param[in] tcp A TCP connection.
  * \param[in] timeout The timeout value.
@@ -819,12 +830,19 @@ ssize_t wget_tcp_read(wget_tcp *tcp, char *buf, size_t count)
 	if (tcp->ssl_session) {
 		rc = wget_ssl_read_timeout(tcp->ssl_session, buf, count, tcp->timeout);
 	} else {
-		if (tcp->timeout) {
+		// read first, the socket is non-blocking: poll() only when there is nothing to read yet
+		rc = recvfrom(tcp->sockfd, buf, count, 0, NULL, NULL);
+
+#if EAGAIN != EWOULDBLOCK
+		if (rc < 0 && tcp->timeout && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+#else
+		if (rc < 0 && tcp->timeout && errno == EAGAIN) {
+#endif
 			if ((rc = wget_ready_2_read(tcp->sockfd, tcp->timeout)) <= 0)
 				return rc;
-		}
 
-		rc = recvfrom(tcp->sockfd, buf, count, 0, NULL, NULL);
+			rc = recvfrom(tcp->sockfd, buf, count, 0, NULL, NULL);
+		}
 	}
 
 	if (rc < 0)
@@ -141,6 +141,29 @@ void wget_plugin_register_url_filter(wget_plugin_t *plugin, wget_plugin_url_filt
 	plugin->vtable->register_url_filter(plugin, filter_fn);
 }
 
+/**
+ * Registers a plugin function for intercepting all URLs found in a downloaded document at once.
+ *
+ * The registered function is passed the URLs together with one
+ * \ref wget_intercept_action_t "wget_intercept_action_t" per URL, which can be used just like
+ * the action of a function registered with wget_plugin_register_url_filter().
+ * URLs already accepted or rejected by a previous plugin are not passed.
+ *
+ * If both kinds of filter are registered, wget2 uses the batch filter for URLs found in documents
+ * and the per-URL filter for everything else. Otherwise the batch filter also gets single URLs, e.g.
+ * from the command line or from redirections.
+ *
+ * Unless \p flags contains #WGET_PLUGIN_THREAD_SAFE, wget2 serializes calls to \p filter_fn.
+ *
+ * \param[in] plugin The plugin handle
+ * \param[in] filter_fn The plugin function that will be passed the URLs to be fetched
+ * \param[in] flags 0 or #WGET_PLUGIN_THREAD_SAFE
+ */
+void wget_plugin_register_url_filter_batch(wget_plugin_t *plugin, wget_plugin_url_filter_batch_t *filter_fn, int flags)
+{
+	plugin->vtable->register_url_filter_batch(plugin, filter_fn, flags);
+}
+
 /**
  * Gets the source address the file was downloaded from.
  *
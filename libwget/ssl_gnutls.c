@@ -86,7 +86,8 @@ static struct _config {
 		*key_file,
 		*crl_file,
 		*ocsp_server,
-		*alpn;
+		*alpn,
+		*ca_snapshot;
 	wget_ocsp_db
 		*ocsp_cert_cache,
 		*ocsp_host_cache;
@@ -105,7 +106,8 @@ static struct _config {
 		ocsp : 1,
 		ocsp_date : 1,
 		ocsp_stapling : 1,
-		ocsp_nonce : 1;
+		ocsp_nonce : 1,
+		ca_snapshot_restrict : 1;
 } _config = {
 	.check_certificate = 1,
 	.check_hostname = 1,
@@ -139,6 +141,9 @@ static gnutls_certificate_credentials_t
 static gnutls_priority_t
 	_priority_cache;
 
+static int _init;
+static wget_thread_mutex _mutex;
+
 /**
  * \param[in] key An identifier for the config parameter (starting with `WGET_SSL_`) to set
  * \param[in] value The value for the config parameter (a NULL-terminated string)
@@ -189,6 +194,10 @@ static gnutls_priority_t
  *  ([RFC 7301](https://tools.ietf.org/html/rfc7301))
  *  that allows both the server and the client to signal which application-layer protocols they support (HTTP/2, QUIC, etc.).
  *  That information can then be used for the server to ultimately decide which protocol will be used on top of TLS.
+ *  - WGET_SSL_CA_SNAPSHOT: A path to a file that keeps the deduplicated CAs from `WGET_SSL_CA_DIRECTORY` in a single
+ *  PEM file. The snapshot is created on the first TLS connection and reused as long as the number of files and the
+ *  newest modification time of the CA source are unchanged, so the CA directory doesn't need to be parsed each time.
+ *  The system trust store ("system") is not snapshotted, its sources can't be checked for changes.
  *
  *  An invalid value for \p key will not harm the operation of TLS, but will cause
  *  a complain message to be printed to the error log stream.
@@ -204,6 +213,7 @@ void wget_ssl_set_config_string(int key, const char *value)
 	case WGET_SSL_CRL_FILE: _config.crl_file = value; break;
 	case WGET_SSL_OCSP_SERVER: _config.ocsp_server = value; break;
 	case WGET_SSL_ALPN: _config.alpn = value; break;
+	case WGET_SSL_CA_SNAPSHOT: _config.ca_snapshot = value; break;
 	default: error_printf(_("Unknown config key %d (or value must not be a string)\n"), key);
 	}
 }
@@ -272,6 +282,10 @@ void wget_ssl_set_config_object(int key, void *value)
  *
  *  - WGET_SSL_OCSP: whether or not OCSP should be used. The default is yes (1).
  *  - WGET_SSL_OCSP_STAPLING: whether or not OCSP stapling should be used. The default is yes (1).
+ *
+ *  - WGET_SSL_CA_SNAPSHOT_RESTRICT: whether only the CAs that verified a peer in an earlier run are loaded from the
+ *  `WGET_SSL_CA_SNAPSHOT` file (1) or all CAs (0). A peer with an unknown issuer is verified against all CAs of the
+ *  snapshot, the snapshot is updated in wget_ssl_deinit(). The default is no (0).
  */
 void wget_ssl_set_config_int(int key, int value)
 {
@@ -286,6 +300,7 @@ void wget_ssl_set_config_int(int key, int value)
 	case WGET_SSL_OCSP_DATE: _config.ocsp_date = (char)value; break;
 	case WGET_SSL_OCSP_STAPLING: _config.ocsp_stapling = (char)value; break;
 	case WGET_SSL_OCSP_NONCE: _config.ocsp_nonce = value; break;
+	case WGET_SSL_CA_SNAPSHOT_RESTRICT: _config.ca_snapshot_restrict = (char)value; break;
 	default: error_printf(_("Unknown config key %d (or value must not be an integer)\n"), key);
 	}
 }
@@ -914,6 +929,310 @@ out:
 	return ret; // Pubkey not found
 }
 
+/*
+ * CA snapshot
+ *
+ * Parsing a CA directory takes a noticeable part of the runtime of short wget
+ * invocations. The snapshot file keeps the trusted CAs deduplicated in a single
+ * PEM file, each preceded by a '# <SHA-256 of DER>' line.
+ * The first line identifies the source and a stamp (number of files and newest
+ * mtime), so a changed source invalidates the snapshot without parsing anything.
+ *
+ * In restricted mode the CAs that verified a peer are written first, followed by
+ * a line '#unseen' and all other CAs. Only the first part is loaded, the rest is
+ * loaded into a separate trust list when a peer has an unknown issuer.
+ */
+
+static char
+	*_snapshot; // content of the CA snapshot file
+static size_t
+	_snapshot_len;
+static wget_stringmap
+	*_seen_cas; // SHA-256 hex of CAs that verified a peer
+static gnutls_x509_trust_list_t
+	_all_cas; // all CAs of the snapshot, if only the seen CAs have been loaded
+static bool
+	_restricted, // only the seen CAs have been loaded into the credentials
+	_seen_changed;
+
+static void _ca_snapshot_header(char *header, size_t size)
+{
+	const char *dirname = _config.ca_directory;
+	long long newest = 0;
+	int nfiles = 0;
+	struct stat st;
+	DIR *dir;
+
+	if (stat(dirname, &st) == 0)
+		newest = st.st_mtime;
+
+	if ((dir = opendir(dirname))) {
+		struct dirent *dp;
+		size_t dirlen = strlen(dirname);
+
+		while ((dp = readdir(dir))) {
+			size_t len = strlen(dp->d_name);
+
+			if (len < 4 || wget_strncasecmp_ascii(dp->d_name + len - 4, ".pem", 4))
+				continue;
+
+			char fname[dirlen + 1 + len + 1];
+
+			wget_snprintf(fname, sizeof(fname), "%s/%s", dirname, dp->d_name);
+			if (stat(fname, &st) == 0 && S_ISREG(st.st_mode)) {
+				nfiles++;
+				if (st.st_mtime > newest)
+					newest = st.st_mtime;
+			}
+		}
+
+		closedir(dir);
+	}
+
+	wget_snprintf(header, size, "#wget2 CA snapshot 1 %s %d-%lld\n", _config.ca_directory, nfiles, newest);
+}
+
+static int _ca_key(gnutls_x509_crt_t crt, char *key, size_t size)
+{
+	gnutls_datum_t der;
+	unsigned char digest[32];
+
+	if (gnutls_x509_crt_export2(crt, GNUTLS_X509_FMT_DER, &der) != GNUTLS_E_SUCCESS)
+		return -1;
+
+	wget_hash_fast(WGET_DIGTYPE_SHA256, der.data, der.size, digest);
+	wget_memtohex(digest, sizeof(digest), key, size);
+	gnutls_free(der.data);
+
+	return 0;
+}
+
+// append the certificate blocks of the snapshot that are (not) in the seen list
+static void _ca_snapshot_append(wget_buffer *buf, bool seen)
+{
+	const char *p, *end;
+
+	for (p = strchr(_snapshot, '\n'); p && *++p; p = end) {
+		if (!(end = strstr(p, "\n#")))
+			end = _snapshot + _snapshot_len;
+		else
+			end++;
+
+		if (!strncmp(p, "# ", 2) && end - p > 66 && p[66] == '\n') {
+			char key[65];
+
+			wget_strscpy(key, p + 2, sizeof(key));
+			if (wget_stringmap_contains(_seen_cas, key) == seen)
+				wget_buffer_memcat(buf, p, end - p);
+		}
+
+		end--; // point to the newline
+	}
+}
+
+static int _ca_snapshot_save_cb(void *context, FILE *fp)
+{
+	wget_buffer *buf = context;
+
+	fwrite(buf->data, 1, buf->length, fp);
+
+	return ferror(fp) ? -1 : 0;
+}
+
+static void _ca_snapshot_save(void)
+{
+	wget_buffer buf;
+
+	wget_buffer_init(&buf, NULL, _snapshot_len + 16);
+
+	if (_config.ca_snapshot_restrict) {
+		const char *eol = strchr(_snapshot, '\n');
+
+		wget_buffer_memcpy(&buf, _snapshot, eol ? eol - _snapshot + 1 : _snapshot_len);
+		_ca_snapshot_append(&buf, true);
+		wget_buffer_strcat(&buf, "#unseen\n");
+		_ca_snapshot_append(&buf, false);
+	} else
+		wget_buffer_memcpy(&buf, _snapshot, _snapshot_len);
+
+	if (wget_update_file(_config.ca_snapshot, NULL, _ca_snapshot_save_cb, &buf))
+		error_printf(_("Failed to write CA snapshot '%s'\n"), _config.ca_snapshot);
+	else
+		debug_printf("Saved CA snapshot '%s'\n", _config.ca_snapshot);
+
+	wget_buffer_deinit(&buf);
+}
+
+static int _ca_snapshot_load(const char *header)
+{
+	const char *unseen = NULL, *p;
+	gnutls_datum_t datum;
+	size_t len;
+	int rc;
+
+	if (!(_snapshot = wget_read_file(_config.ca_snapshot, &len)))
+		return -1;
+
+	if (strncmp(_snapshot, header, strlen(header))) {
+		debug_printf("CA snapshot '%s' is outdated\n", _config.ca_snapshot);
+		xfree(_snapshot);
+		return -1;
+	}
+
+	_snapshot_len = len;
+
+	if (_config.ca_snapshot_restrict && (unseen = strstr(_snapshot, "\n#unseen\n"))) {
+		// the keys of the seen CAs are in front of the marker
+		for (p = strchr(_snapshot, '\n'); p && p < unseen; p = strchr(p + 1, '\n')) {
+			if (!strncmp(p, "\n# ", 3) && p + 67 <= unseen && p[67] == '\n')
+				wget_stringmap_put(_seen_cas, wget_strmemdup(p + 3, 64), NULL);
+		}
+
+		if (!wget_stringmap_size(_seen_cas))
+			unseen = NULL; // nothing seen yet, load all
+	}
+
+	datum.data = (unsigned char *) _snapshot;
+	datum.size = unseen ? (unsigned) (unseen - _snapshot + 1) : (unsigned) len;
+
+	if ((rc = gnutls_certificate_set_x509_trust_mem(_credentials, &datum, GNUTLS_X509_FMT_PEM)) <= 0) {
+		debug_printf("No CAs were found in snapshot '%s'\n", _config.ca_snapshot);
+		xfree(_snapshot);
+		return -1;
+	}
+
+	_restricted = !!unseen;
+	debug_printf("Loaded %d CAs from snapshot '%s'%s\n", rc, _config.ca_snapshot, _restricted ? " (seen CAs only)" : "");
+
+	return rc;
+}
+
+static void _ca_snapshot_create(const char *header)
+{
+#if GNUTLS_VERSION_NUMBER >= 0x030400
+	gnutls_x509_trust_list_t tlist;
+	gnutls_x509_trust_list_iter_t iter = NULL;
+	gnutls_x509_crt_t crt;
+	wget_stringmap *keys;
+	wget_buffer buf;
+	char key[65];
+
+	keys = wget_stringmap_create(256);
+	wget_buffer_init(&buf, NULL, 256 * 1024);
+	wget_buffer_strcpy(&buf, header);
+
+	gnutls_certificate_get_trust_list(_credentials, &tlist);
+
+	while (gnutls_x509_trust_list_iter_get_ca(tlist, &iter, &crt) == GNUTLS_E_SUCCESS) {
+		gnutls_datum_t pem;
+
+		// CA directories often contain the same certificate several times
+		if (_ca_key(crt, key, sizeof(key)) == 0 && !wget_stringmap_contains(keys, key)
+			&& gnutls_x509_crt_export2(crt, GNUTLS_X509_FMT_PEM, &pem) == GNUTLS_E_SUCCESS)
+		{
+			wget_stringmap_put(keys, wget_strdup(key), NULL);
+			wget_buffer_printf_append(&buf, "# %s\n", key);
+			wget_buffer_memcat(&buf, pem.data, pem.size);
+			gnutls_free(pem.data);
+		}
+
+		gnutls_x509_crt_deinit(crt);
+	}
+
+	gnutls_x509_trust_list_iter_deinit(iter);
+
+	debug_printf("Creating CA snapshot with %d CAs\n", wget_stringmap_size(keys));
+	wget_stringmap_free(&keys);
+
+	_snapshot = buf.data; // the buffer data is allocated, no need to deinit
+	_snapshot_len = buf.length;
+
+	_ca_snapshot_save();
+#else
+	(void) header;
+	debug_printf("CA snapshots need GnuTLS 3.4.0 or later\n");
+#endif
+}
+
+// remember the CA that verified the peer's chain
+static void _ca_seen(gnutls_session_t session)
+{
+#if GNUTLS_VERSION_NUMBER >= 0x030400
+	const gnutls_datum_t *cert_list;
+	unsigned int cert_list_size;
+	gnutls_x509_crt_t last, issuer;
+	char key[65];
+	int rc;
+
+	if (!(cert_list = gnutls_certificate_get_peers(session, &cert_list_size)) || !cert_list_size)
+		return;
+
+	if (gnutls_x509_crt_init(&last) != GNUTLS_E_SUCCESS)
+		return;
+
+	if (gnutls_x509_crt_import(last, &cert_list[cert_list_size - 1], GNUTLS_X509_FMT_DER) == GNUTLS_E_SUCCESS) {
+		if ((rc = gnutls_certificate_get_issuer(_credentials, last, &issuer, GNUTLS_TL_GET_COPY)) != GNUTLS_E_SUCCESS && _all_cas)
+			rc = gnutls_x509_trust_list_get_issuer(_all_cas, last, &issuer, GNUTLS_TL_GET_COPY);
+
+		if (rc == GNUTLS_E_SUCCESS) {
+			if (_ca_key(issuer, key, sizeof(key)) == 0) {
+				wget_thread_mutex_lock(_mutex);
+				if (!wget_stringmap_contains(_seen_cas, key)) {
+					wget_stringmap_put(_seen_cas, wget_strdup(key), NULL);
+					_seen_changed = 1;
+				}
+				wget_thread_mutex_unlock(_mutex);
+			}
+			gnutls_x509_crt_deinit(issuer);
+		}
+	}
+
+	gnutls_x509_crt_deinit(last);
+#else
+	(void) session;
+#endif
+}
+
+// verify the peer's chain against all CAs of the snapshot, only used in restricted mode
+static unsigned int _ca_verify_all(gnutls_session_t session, unsigned int status)
+{
+	const gnutls_datum_t *cert_list;
+	unsigned int cert_list_size, n, verify_status;
+	gnutls_x509_crt_t certs[16];
+
+	wget_thread_mutex_lock(_mutex);
+	if (!_all_cas && gnutls_x509_trust_list_init(&_all_cas, 0) == GNUTLS_E_SUCCESS) {
+		gnutls_datum_t datum = { (unsigned char *) _snapshot, (unsigned) _snapshot_len };
+
+		debug_printf("Loading all CAs from snapshot '%s'\n", _config.ca_snapshot);
+		gnutls_x509_trust_list_add_trust_mem(_all_cas, &datum, NULL, GNUTLS_X509_FMT_PEM, 0, 0);
+		if (_config.crl_file)
+			gnutls_x509_trust_list_add_trust_file(_all_cas, NULL, _config.crl_file, GNUTLS_X509_FMT_PEM, 0, 0);
+	}
+	wget_thread_mutex_unlock(_mutex);
+
+	if (!_all_cas || !(cert_list = gnutls_certificate_get_peers(session, &cert_list_size)))
+		return status;
+
+	for (n = 0; n < cert_list_size && n < countof(certs); n++) {
+		if (gnutls_x509_crt_init(&certs[n]) != GNUTLS_E_SUCCESS)
+			break;
+		if (gnutls_x509_crt_import(certs[n], &cert_list[n], GNUTLS_X509_FMT_DER) != GNUTLS_E_SUCCESS) {
+			gnutls_x509_crt_deinit(certs[n]);
+			break;
+		}
+	}
+
+	// the host name is checked by the caller
+	if (n && gnutls_x509_trust_list_verify_crt(_all_cas, certs, n, 0, &verify_status, NULL) == GNUTLS_E_SUCCESS)
+		status = verify_status;
+
+	while (n)
+		gnutls_x509_crt_deinit(certs[--n]);
+
+	return status;
+}
+
 /* This function will verify the peer's certificate, and check
  * if the hostname matches, as well as the activation, expiration dates.
  */
@@ -948,6 +1267,10 @@ static int _verify_certificate_callback(gnutls_session_t session)
 		goto out;
 	}
 
+	// only the CAs seen in earlier runs have been loaded, try the others
+	if ((status & GNUTLS_CERT_SIGNER_NOT_FOUND) && _restricted)
+		status = _ca_verify_all(session, status);
+
 //	if (wget_get_logger(WGET_LOGGER_DEBUG))
 //		_print_info(session);
 
@@ -1049,6 +1372,9 @@ static int _verify_certificate_callback(gnutls_session_t session)
 	else
 		goto out;
 
+	if (_seen_cas)
+		_ca_seen(session);
+
 	// At this point, the cert chain has been found valid regarding the locally available CA certificates and CRLs.
 	// Now, we are going to check the revocation status via OCSP
 #ifdef HAVE_GNUTLS_OCSP_H
@@ -1179,9 +1505,6 @@ out:
 	return _config.check_certificate ? ret : 0;
 }
 
-static int _init;
-static wget_thread_mutex _mutex;
-
 static void __attribute__ ((constructor)) _wget_tls_init(void)
 {
 	if (!_mutex)
@@ -1261,6 +1584,7 @@ void wget_ssl_init(void)
 
 	if (!_init) {
 		int rc, ncerts = -1;
+		char header[256];
 
 		debug_printf("GnuTLS init\n");
 		gnutls_global_init();
@@ -1268,14 +1592,29 @@ void wget_ssl_init(void)
 		gnutls_certificate_set_verify_function(_credentials, _verify_certificate_callback);
 
 		if (_config.ca_directory && *_config.ca_directory && _config.check_certificate) {
-#if GNUTLS_VERSION_NUMBER >= 0x03000d
-			if (!strcmp(_config.ca_directory, "system"))
-				ncerts = gnutls_certificate_set_x509_system_trust(_credentials);
-#else
+			bool snapshot;
+
+#if GNUTLS_VERSION_NUMBER < 0x03000d
 			if (!strcmp(_config.ca_directory, "system"))
 				_config.ca_directory = "/etc/ssl/certs";
 #endif
 
+			// The sources of the system trust store (p11-kit modules or a bundle file)
+			// are chosen when GnuTLS is built and can't be checked for changes.
+			if ((snapshot = _config.ca_snapshot && strcmp(_config.ca_directory, "system"))) {
+				if (_config.ca_snapshot_restrict)
+					_seen_cas = wget_stringmap_create(16);
+
+				_ca_snapshot_header(header, sizeof(header));
+				ncerts = _ca_snapshot_load(header);
+			} else if (_config.ca_snapshot)
+				debug_printf("CA snapshots are not supported for the system trust store\n");
+
+#if GNUTLS_VERSION_NUMBER >= 0x03000d
+			if (ncerts < 0 && !strcmp(_config.ca_directory, "system"))
+				ncerts = gnutls_certificate_set_x509_system_trust(_credentials);
+#endif
+
 			if (ncerts < 0) {
 				DIR *dir;
 
@@ -1308,6 +1647,9 @@ void wget_ssl_init(void)
 					error_printf(_("Failed to opendir %s\n"), _config.ca_directory);
 				}
 			}
+
+			if (snapshot && !_snapshot && ncerts > 0)
+				_ca_snapshot_create(header);
 		}
 
 		if (_config.crl_file) {
@@ -1386,6 +1728,16 @@ void wget_ssl_deinit(void)
 	wget_thread_mutex_lock(_mutex);
 
 	if (_init == 1) {
+		if (_snapshot && _seen_changed)
+			_ca_snapshot_save();
+
+		if (_all_cas)
+			gnutls_x509_trust_list_deinit(_all_cas, 1);
+		_all_cas = NULL;
+		wget_stringmap_free(&_seen_cas);
+		xfree(_snapshot);
+		_restricted = _seen_changed = 0;
+
 		gnutls_certificate_free_credentials(_credentials);
 		gnutls_priority_deinit(_priority_cache);
 		gnutls_global_deinit();
@@ -1710,12 +2062,12 @@ int wget_ssl_open(wget_tcp *tcp)
 	}
 
 	if (tls_stats_callback)
-		before_millisecs = wget_get_timemillis();
+		before_millisecs = wget_get_monotonic_millis();
 
 	ret = _do_handshake(session, sockfd, connect_timeout);
 
 	if (tls_stats_callback) {
-		long long after_millisecs = wget_get_timemillis();
+		long long after_millisecs = wget_get_monotonic_millis();
 		stats.tls_secs = after_millisecs - before_millisecs;
 		stats.tls_con = 1;
 #if GNUTLS_VERSION_NUMBER >= 0x030500
@@ -1885,9 +2237,7 @@ ssize_t wget_ssl_read_timeout(void *session, char *buf, size_t count, int timeou
 	for (;;) {
 		int rc;
 
-		if (gnutls_record_check_pending(session) <= 0 && (rc = wget_ready_2_read(sockfd, timeout)) <= 0)
-			return rc;
-
+		// read first, the socket is non-blocking: poll() only when there is nothing to read yet
 		nbytes = gnutls_record_recv(session, buf, count);
 
 		// If False Start + Session Resumption are enabled, we get the session data after the first read()
@@ -1908,10 +2258,13 @@ ssize_t wget_ssl_read_timeout(void *session, char *buf, size_t count, int timeou
 		if (nbytes == GNUTLS_E_REHANDSHAKE) {
 			debug_printf("*** REHANDSHAKE while reading\n");
 			if ((nbytes = _do_handshake(session, sockfd, timeout)) == 0)
-				nbytes = GNUTLS_E_AGAIN; /* restart reading */
+				continue; /* restart reading */
 		}
-		if (nbytes >= 0 || nbytes != GNUTLS_E_AGAIN)
+		if (nbytes != GNUTLS_E_AGAIN)
 			break;
+
+		if ((rc = wget_ready_2_read(sockfd, timeout)) <= 0)
+			return rc;
 	}
 
 	return nbytes < -1 ? -1 : nbytes;
@@ -1951,9 +2304,7 @@ ssize_t wget_ssl_write_timeout(void *session, const char *buf, size_t count, int
 		ssize_t nbytes;
 		int rc;
 
-		if ((rc = wget_ready_2_write(sockfd, timeout)) <= 0)
-			return rc;
-
+		// write first, poll() only if the socket buffer is full
 		if ((nbytes = gnutls_record_send(session, buf, count)) >= 0)
 			return nbytes;
 
@@ -1962,10 +2313,12 @@ ssize_t wget_ssl_write_timeout(void *session, const char *buf, size_t count, int
 			if ((nbytes = _do_handshake(session, sockfd, timeout)) == 0)
 				continue; /* restart writing */
 		}
-		if (nbytes == GNUTLS_E_AGAIN)
-			return 0; // indicate timeout
+		if (nbytes != GNUTLS_E_AGAIN)
+			return -1;
 
-		return -1;
+		// GnuTLS wants the same data again after GNUTLS_E_AGAIN
+		if ((rc = wget_ready_2_write(sockfd, timeout)) <= 0)
+			return rc;
 	}
 }
 
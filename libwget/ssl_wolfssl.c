@@ -184,6 +184,7 @@ void wget_ssl_set_config_string(int key, const char *value)
 	case WGET_SSL_CRL_FILE: _config.crl_file = value; break;
 	case WGET_SSL_OCSP_SERVER: _config.ocsp_server = value; break;
 	case WGET_SSL_ALPN: _config.alpn = value; break;
+	case WGET_SSL_CA_SNAPSHOT: break; // not supported with WolfSSL
 	default: error_printf(_("Unknown config key %d (or value must not be a string)\n"), key);
 	}
 }
@@ -264,6 +265,7 @@ void wget_ssl_set_config_int(int key, int value)
 	case WGET_SSL_PRINT_INFO: _config.print_info = (char)value; break;
 	case WGET_SSL_OCSP: _config.ocsp = (char)value; break;
 	case WGET_SSL_OCSP_STAPLING: _config.ocsp_stapling = (char)value; break;
+	case WGET_SSL_CA_SNAPSHOT_RESTRICT: break; // not supported with WolfSSL
 	default: error_printf(_("Unknown config key %d (or value must not be an integer)\n"), key);
 	}
 }
@@ -890,12 +892,12 @@ int wget_ssl_open(wget_tcp *tcp)
 	wolfSSL_set_using_nonblock(session, 1);
 
 	if (tls_stats_callback)
-		before_millisecs = wget_get_timemillis();
+		before_millisecs = wget_get_monotonic_millis();
 
 	ret = _do_handshake(session, sockfd, connect_timeout);
 
 	if (tls_stats_callback) {
-		long long after_millisecs = wget_get_timemillis();
+		long long after_millisecs = wget_get_monotonic_millis();
 		stats.tls_secs = after_millisecs - before_millisecs;
 		stats.tls_con = 1;
 		stats.false_start = 0; // WolfSSL doesn't support False Start (https://www.wolfssl.com/is-tls-false-start-going-to-take-off-2/)
@@ -289,6 +289,10 @@ void wget_millisleep(int ms)
 
 /**
  * Return the current milliseconds since the epoch.
+ *
+ * This is wall clock time and may jump when the system time is changed.
+ * Use it only for absolute timestamps (e.g. expiry of cookies or HSTS entries).
+ * For measuring durations, use wget_get_monotonic_millis() or wget_get_coarse_millis().
  */
 long long wget_get_timemillis(void)
 {
@@ -299,6 +303,50 @@ long long wget_get_timemillis(void)
 	return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
 }
 
+/**
+ * Return the milliseconds of a monotonic clock.
+ *
+ * The starting point of this clock is unspecified, so the returned value is only
+ * useful for computing durations. Unlike wget_get_timemillis(), the clock does not
+ * jump when the system time is changed.
+ *
+ * Falls back to wall clock time if the system does not have a monotonic clock.
+ */
+long long wget_get_monotonic_millis(void)
+{
+	struct timespec ts;
+
+#ifdef CLOCK_MONOTONIC
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+		return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+#endif
+
+	gettime(&ts);
+
+	return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+/**
+ * Return the milliseconds of a cheap, low resolution monotonic clock.
+ *
+ * The resolution is typically a few milliseconds, but reading the clock is much cheaper
+ * than wget_get_monotonic_millis(). Use it on hot paths like rate limiting or progress
+ * updates that are executed for every chunk of data.
+ *
+ * Values from this function are comparable with values from wget_get_monotonic_millis().
+ */
+long long wget_get_coarse_millis(void)
+{
+#ifdef CLOCK_MONOTONIC_COARSE
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC_COARSE, &ts) == 0)
+		return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+#endif
+
+	return wget_get_monotonic_millis();
+}
+
 G_GNUC_WGET_CONST
 static unsigned char _unhex(unsigned char c)
 {
@@ -0,0 +1,640 @@
+/*
+ * Copyright(c) 2019 Free Software Foundation, Inc.
+ *
+ * This file is part of Wget.
+ *
+ * Wget is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Wget is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Wget.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *
+ * Archive output (--archive)
+ *
+ * Instead of creating one file per download, each completed body is appended
+ * as an entry to a single tar (POSIX ustar, pax headers for long names and
+ * large files) or cpio (SVR4 'newc') archive. The entries are written by a
+ * single writer thread, the downloaders just queue them. If too much data is
+ * queued, the downloaders wait for the writer to catch up.
+ *
+ * Bodies that are too large to be kept in memory are received into an
+ * unlinked temporary file next to the archive (see archive_spool_open()),
+ * which the writer copies into the archive.
+ *
+ * Documents that may need link conversion (--convert-links) can only be
+ * written when all downloads are done. Until then they are kept in a spool
+ * file next to the archive. At the end, _convert_links() takes them out,
+ * rewrites the links and appends them to the archive.
+ *
+ * References
+ *   https://pubs.opengroup.org/onlinepubs/9699919799/utilities/pax.html
+ *   https://www.mkssoftware.com/docs/man4/cpio.4.asp
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <wget.h>
+
+#include "safe-read.h"
+#include "safe-write.h"
+
+#include "wget_main.h"
+#include "wget_options.h"
+#include "wget_archive.h"
+
+// max. number of bytes queued for the writer thread before downloaders have to wait
+#define ARCHIVE_QUEUE_MAX (64 * 1024 * 1024)
+
+typedef struct {
+	char *
+		name;
+	char *
+		data;
+	size_t
+		length;
+	int64_t
+		mtime;
+	int
+		data_fd; // temporary file holding the data instead of 'data', else -1
+} _entry_t;
+
+typedef struct {
+	off_t
+		offset; // position in the spool file
+	size_t
+		length;
+	int64_t
+		mtime;
+} _deferred_t;
+
+static wget_list
+	*queue;
+
+static wget_stringmap
+	*entries, // names of all entries, queued, written or deferred
+	*deferred; // entries kept in the spool file for link conversion
+
+static wget_thread_mutex
+	mutex;
+
+static wget_thread_cond
+	queue_cond, // signaled when an entry has been queued
+	space_cond; // signaled when the writer took an entry from the queue
+
+static wget_thread
+	writer_tid;
+
+static char
+	*archive_file,
+	*spool_file;
+
+static size_t
+	queued_bytes;
+
+static off_t
+	spool_size;
+
+static int
+	fd = -1,
+	spool_fd = -1,
+	format;
+
+static bool
+	stopping,
+	write_error;
+
+static void _free_entry(_entry_t *entry)
+{
+	xfree(entry->name);
+	xfree(entry->data);
+
+	if (entry->data_fd != -1) {
+		close(entry->data_fd);
+		entry->data_fd = -1;
+	}
+}
+
+static int _write_all(int fd_out, const char *data, size_t length)
+{
+	while (length) {
+		size_t n = safe_write(fd_out, data, length);
+
+		if (n == SAFE_WRITE_ERROR)
+			return -1;
+
+		data += n;
+		length -= n;
+	}
+
+	return 0;
+}
+
+// copy 'length' bytes from the start of fd_in to fd_out
+static int _copy_file(int fd_out, int fd_in, size_t length)
+{
+	char buf[16384];
+
+	if (lseek(fd_in, 0, SEEK_SET) == (off_t) -1)
+		return -1;
+
+	while (length) {
+		size_t n = safe_read(fd_in, buf, length < sizeof(buf) ? length : sizeof(buf));
+
+		if (n == SAFE_READ_ERROR || n == 0 || _write_all(fd_out, buf, n))
+			return -1;
+
+		length -= n;
+	}
+
+	return 0;
+}
+
+static const char _zeros[512];
+
+// write data followed by padding up to a multiple of 'align'
+static int _write_padded(const char *data, size_t length, size_t align)
+{
+	size_t pad = (align - length % align) % align;
+
+	if (_write_all(fd, data, length))
+		return -1;
+
+	return pad ? _write_all(fd, _zeros, pad) : 0;
+}
+
+// write the data of an entry (from memory or from its temporary file), padded like _write_padded()
+static int _write_data(const _entry_t *entry, size_t align)
+{
+	size_t pad = (align - entry->length % align) % align;
+
+	if (entry->data_fd == -1 ? _write_all(fd, entry->data, entry->length) : _copy_file(fd, entry->data_fd, entry->length))
+		return -1;
+
+	return pad ? _write_all(fd, _zeros, pad) : 0;
+}
+
+// number of bytes an entry holds in memory, for the backpressure on the queue
+static size_t _entry_memory(const _entry_t *entry)
+{
+	return entry->data_fd == -1 ? entry->length : 0;
+}
+
+// pax extended header record: "<length> <keyword>=<value>\n", the length includes itself
+static void _pax_record(wget_buffer *buf, const char *keyword, const char *value)
+{
+	size_t len = strlen(keyword) + strlen(value) + 3, total;
+	char digits[24];
+
+	for (total = len + 1; total != len + (size_t) wget_snprintf(digits, sizeof(digits), "%zu", total);)
+		total = len + strlen(digits);
+
+	wget_buffer_printf_append(buf, "%zu %s=%s\n", total, keyword, value);
+}
+
+static int _tar_header(const char *name, size_t size, int64_t mtime, char type)
+{
+	char header[512];
+	unsigned checksum = 0;
+	size_t namelen = strlen(name);
+
+	memset(header, 0, sizeof(header));
+
+	if (namelen <= 100) {
+		memcpy(header, name, namelen);
+	} else {
+		// split into prefix and name at a slash, the name part has max. 100 characters
+		const char *slash = strchr(name + namelen - 101, '/');
+
+		if (slash && slash - name <= 155 && slash[1]) {
+			memcpy(header + 345, name, slash - name);
+			memcpy(header, slash + 1, namelen - (slash - name) - 1);
+		} else
+			memcpy(header, name, 100); // the pax header holds the full name
+	}
+
+	wget_snprintf(header + 100, 8, "%07o", 0644);
+	wget_snprintf(header + 108, 8, "%07o", 0);
+	wget_snprintf(header + 116, 8, "%07o", 0);
+	wget_snprintf(header + 124, 12, "%011llo", (unsigned long long) (size < 077777777777ULL ? size : 0));
+	wget_snprintf(header + 136, 12, "%011llo", (unsigned long long) (mtime > 0 ? mtime : 0));
+	memset(header + 148, ' ', 8);
+	header[156] = type;
+	memcpy(header + 257, "ustar", 6);
+	memcpy(header + 263, "00", 2);
+
+	for (unsigned it = 0; it < sizeof(header); it++)
+		checksum += (unsigned char) header[it];
+	wget_snprintf(header + 148, 8, "%06o", checksum);
+
+	return _write_all(fd, header, sizeof(header));
+}
+
+static int _tar_entry(const _entry_t *entry)
+{
+	size_t namelen = strlen(entry->name);
+
+	if (namelen > 100 || entry->length >= 077777777777ULL) {
+		char sbuf[512], path[256];
+		wget_buffer buf;
+		int rc;
+
+		wget_buffer_init(&buf, sbuf, sizeof(sbuf));
+		if (namelen > 100)
+			_pax_record(&buf, "path", entry->name);
+		if (entry->length >= 077777777777ULL) {
+			char size[24];
+
+			wget_snprintf(size, sizeof(size), "%zu", entry->length);
+			_pax_record(&buf, "size", size);
+		}
+
+		wget_snprintf(path, sizeof(path), "PaxHeaders/%.80s", strrchr(entry->name, '/') ? strrchr(entry->name, '/') + 1 : entry->name);
+		rc = _tar_header(path, buf.length, entry->mtime, 'x') || _write_padded(buf.data, buf.length, 512);
+		wget_buffer_deinit(&buf);
+
+		if (rc)
+			return -1;
+	}
+
+	if (_tar_header(entry->name, entry->length, entry->mtime, '0'))
+		return -1;
+
+	return _write_data(entry, 512);
+}
+
+static int _cpio_entry(const _entry_t *entry)
+{
+	static unsigned ino;
+	char header[111];
+	size_t namesize = strlen(entry->name) + 1;
+
+	if (entry->length > 0xFFFFFFFF) {
+		error_printf(_("%s: too large for a cpio archive, skipped\n"), entry->name);
+		return 0;
+	}
+
+	wget_snprintf(header, sizeof(header), "070701%08X%08X%08X%08X%08X%08X%08X%08X%08X%08X%08X%08X%08X",
+		++ino, 0100644, 0, 0, 1, (unsigned) (entry->mtime > 0 ? entry->mtime : 0), (unsigned) entry->length,
+		0, 0, 0, 0, (unsigned) namesize, 0);
+
+	// the name is padded so that header and name end on a multiple of 4
+	if (_write_all(fd, header, 110) || _write_all(fd, entry->name, namesize))
+		return -1;
+	if ((110 + namesize) % 4 && _write_all(fd, _zeros, 4 - (110 + namesize) % 4))
+		return -1;
+
+	return _write_data(entry, 4);
+}
+
+static void _write_entry(const _entry_t *entry)
+{
+	int rc;
+
+	if (write_error)
+		return;
+
+	if (format == ARCHIVE_FORMAT_CPIO)
+		rc = _cpio_entry(entry);
+	else
+		rc = _tar_entry(entry);
+
+	if (rc) {
+		error_printf(_("Failed to write archive entry %s (%d)\n"), entry->name, errno);
+		set_exit_status(WG_EXIT_STATUS_IO);
+		write_error = 1;
+	}
+}
+
+static void *_writer_thread(void *p G_GNUC_WGET_UNUSED)
+{
+	wget_thread_mutex_lock(mutex);
+
+	for (;;) {
+		_entry_t *first = wget_list_getfirst(queue), entry;
+
+		if (!first) {
+			if (stopping)
+				break;
+
+			wget_thread_cond_wait(queue_cond, mutex, 0);
+			continue;
+		}
+
+		entry = *first;
+		wget_list_remove(&queue, first);
+		wget_thread_mutex_unlock(mutex);
+
+		_write_entry(&entry);
+
+		wget_thread_mutex_lock(mutex);
+		queued_bytes -= _entry_memory(&entry);
+		wget_thread_cond_signal(space_cond);
+		_free_entry(&entry);
+	}
+
+	wget_thread_mutex_unlock(mutex);
+
+	return NULL;
+}
+
+// queue an entry for the writer thread, takes ownership of name, data and data_fd
+static void _queue_entry(char *name, char *data, int data_fd, size_t length, int64_t mtime)
+{
+	_entry_t entry = { .name = name, .data = data, .length = length, .mtime = mtime, .data_fd = data_fd };
+
+	if (!writer_tid) {
+		// no thread support, write synchronously
+		wget_thread_mutex_lock(mutex);
+		_write_entry(&entry);
+		wget_thread_mutex_unlock(mutex);
+		_free_entry(&entry);
+		return;
+	}
+
+	wget_thread_mutex_lock(mutex);
+
+	// backpressure: wait for the writer if too much data is queued
+	while (queued_bytes && queued_bytes + _entry_memory(&entry) > ARCHIVE_QUEUE_MAX && !write_error)
+		wget_thread_cond_wait(space_cond, mutex, 0);
+
+	wget_list_append(&queue, &entry, sizeof(entry));
+	queued_bytes += _entry_memory(&entry);
+	wget_thread_cond_signal(queue_cond);
+
+	wget_thread_mutex_unlock(mutex);
+}
+
+void archive_init(void)
+{
+	wget_thread_mutex_init(&mutex);
+	wget_thread_cond_init(&queue_cond);
+	wget_thread_cond_init(&space_cond);
+}
+
+void archive_exit(void)
+{
+	wget_thread_cond_destroy(&space_cond);
+	wget_thread_cond_destroy(&queue_cond);
+	wget_thread_mutex_destroy(&mutex);
+}
+
+int archive_open(const char *fname, int archive_format)
+{
+	int rc;
+
+	if ((fd = open(fname, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0644)) == -1) {
+		error_printf(_("Failed to open archive %s (%d)\n"), fname, errno);
+		return -1;
+	}
+
+	format = archive_format;
+	archive_file = wget_strdup(fname);
+	entries = wget_stringmap_create(1024);
+	deferred = wget_stringmap_create(128);
+
+	if (config.convert_links && !config.delete_after) {
+		spool_file = wget_aprintf("%s.spool", fname);
+
+		if ((spool_fd = open(spool_file, O_RDWR | O_CREAT | O_TRUNC | O_BINARY, 0600)) == -1) {
+			error_printf(_("Failed to open spool file %s (%d)\n"), spool_file, errno);
+			archive_free();
+			return -1;
+		}
+	}
+
+	if (wget_thread_support()) {
+		if ((rc = wget_thread_start(&writer_tid, _writer_thread, NULL, 0)) != 0) {
+			error_printf(_("Failed to start archive writer thread, error %d\n"), rc);
+			archive_free();
+			return -1;
+		}
+	}
+
+	debug_printf("writing %s archive %s\n", format == ARCHIVE_FORMAT_CPIO ? "cpio" : "tar", fname);
+
+	return 0;
+}
+
+static void _add(const char *name, char *data, int data_fd, size_t length, int64_t mtime, bool defer)
+{
+	if (fd == -1) {
+		xfree(data);
+		if (data_fd != -1)
+			close(data_fd);
+		return;
+	}
+
+	if (!mtime)
+		mtime = (int64_t) time(NULL);
+
+	wget_thread_mutex_lock(mutex);
+	wget_stringmap_put(entries, wget_strdup(name), NULL);
+
+	if (defer && spool_fd != -1) {
+		_deferred_t *entry = wget_malloc(sizeof(_deferred_t));
+
+		entry->offset = spool_size;
+		entry->length = length;
+		entry->mtime = mtime;
+
+		if (lseek(spool_fd, spool_size, SEEK_SET) == (off_t) -1
+			|| (data_fd == -1 ? _write_all(spool_fd, data, length) : _copy_file(spool_fd, data_fd, length)))
+		{
+			error_printf(_("Failed to write spool file %s (%d)\n"), spool_file, errno);
+			set_exit_status(WG_EXIT_STATUS_IO);
+			xfree(entry);
+		} else {
+			spool_size += length;
+			wget_stringmap_put(deferred, wget_strdup(name), entry);
+			wget_thread_mutex_unlock(mutex);
+			xfree(data);
+			if (data_fd != -1)
+				close(data_fd);
+			return;
+		}
+	}
+
+	wget_thread_mutex_unlock(mutex);
+
+	_queue_entry(wget_strdup(name), data, data_fd, length, mtime);
+}
+
+// takes ownership of data
+void archive_add(const char *name, char *data, size_t length, int64_t mtime, bool defer)
+{
+	_add(name, data, -1, length, mtime, defer);
+}
+
+// takes ownership of data_fd, a file from archive_spool_open() holding 'length' bytes
+void archive_add_file(const char *name, int data_fd, size_t length, int64_t mtime, bool defer)
+{
+	_add(name, NULL, data_fd, length, mtime, defer);
+}
+
+// create a temporary file for a body that is too large to be kept in memory, returns -1 on error
+int archive_spool_open(void)
+{
+	char *fname;
+	int data_fd;
+
+	if (!archive_file)
+		return -1;
+
+	fname = wget_aprintf("%s.XXXXXX", archive_file);
+	if ((data_fd = mkstemp(fname)) == -1) {
+		error_printf(_("Failed to open spool file %s (%d)\n"), fname, errno);
+		set_exit_status(WG_EXIT_STATUS_IO);
+	} else
+		unlink(fname); // removed when closed
+
+	xfree(fname);
+
+	return data_fd;
+}
+
+bool archive_contains(const char *name)
+{
+	bool rc;
+
+	wget_thread_mutex_lock(mutex);
+	rc = entries && wget_stringmap_contains(entries, name);
+	wget_thread_mutex_unlock(mutex);
+
+	return rc;
+}
+
+char *archive_take_deferred(const char *name, size_t *length, int64_t *mtime)
+{
+	_deferred_t *entry;
+	char *data = NULL;
+
+	wget_thread_mutex_lock(mutex);
+
+	if (deferred && wget_stringmap_get(deferred, name, &entry)) {
+		data = wget_malloc(entry->length + 1);
+
+		if (lseek(spool_fd, entry->offset, SEEK_SET) == (off_t) -1
+			|| safe_read(spool_fd, data, entry->length) != entry->length)
+		{
+			error_printf(_("Failed to read spool file %s (%d)\n"), spool_file, errno);
+			xfree(data);
+		} else {
+			data[entry->length] = 0;
+			*length = entry->length;
+			*mtime = entry->mtime;
+		}
+
+		wget_stringmap_remove(deferred, name);
+	}
+
+	wget_thread_mutex_unlock(mutex);
+
+	return data;
+}
+
+static int _collect_name(wget_vector *names, const char *name, void *value G_GNUC_WGET_UNUSED)
+{
+	wget_vector_add(names, wget_strdup(name));
+
+	return 0;
+}
+
+void archive_close(void)
+{
+	if (fd == -1)
+		return;
+
+	// documents that have not been link-converted are appended unchanged
+	if (wget_stringmap_size(deferred)) {
+		wget_vector *names = wget_vector_create(wget_stringmap_size(deferred), NULL);
+		size_t length;
+		int64_t mtime;
+		char *data;
+
+		wget_stringmap_browse(deferred, (wget_stringmap_browse_t *) _collect_name, names);
+
+		for (int it = 0; it < wget_vector_size(names); it++) {
+			const char *name = wget_vector_get(names, it);
+
+			if ((data = archive_take_deferred(name, &length, &mtime)))
+				_queue_entry(wget_strdup(name), data, -1, length, mtime);
+		}
+
+		wget_vector_free(&names);
+	}
+
+	if (writer_tid) {
+		wget_thread_mutex_lock(mutex);
+		stopping = 1;
+		wget_thread_cond_signal(queue_cond);
+		wget_thread_mutex_unlock(mutex);
+
+		wget_thread_join(&writer_tid);
+		writer_tid = NULL;
+	}
+
+	if (!write_error) {
+		int rc;
+
+		if (format == ARCHIVE_FORMAT_CPIO) {
+			_entry_t trailer = { .name = (char *) "TRAILER!!!", .data_fd = -1 };
+
+			off_t size;
+
+			// like cpio(1), pad the archive to a multiple of 512 bytes
+			rc = _cpio_entry(&trailer)
+				|| (size = lseek(fd, 0, SEEK_CUR)) == (off_t) -1
+				|| (size % 512 && _write_all(fd, _zeros, 512 - size % 512));
+		} else
+			rc = _write_all(fd, _zeros, sizeof(_zeros)) || _write_all(fd, _zeros, sizeof(_zeros));
+
+		if (rc) {
+			error_printf(_("Failed to write archive trailer (%d)\n"), errno);
+			set_exit_status(WG_EXIT_STATUS_IO);
+		}
+	}
+
+	archive_free();
+}
+
+void archive_free(void)
+{
+	if (fd != -1) {
+		close(fd);
+		fd = -1;
+	}
+
+	if (spool_fd != -1) {
+		close(spool_fd);
+		spool_fd = -1;
+		unlink(spool_file);
+	}
+
+	for (_entry_t *entry; (entry = wget_list_getfirst(queue));) {
+		_free_entry(entry);
+		wget_list_remove(&queue, entry);
+	}
+
+	xfree(spool_file);
+	xfree(archive_file);
+	wget_stringmap_free(&entries);
+	wget_stringmap_free(&deferred);
+	queued_bytes = 0;
+	spool_size = 0;
+}
@@ -34,12 +34,15 @@
 
 #include "wget_main.h"
 #include "wget_blacklist.h"
+#include "wget_memory.h"
 
 static wget_hashmap
 	*blacklist;
 
 static wget_thread_mutex
 	mutex;
+static long long
+	memory; // accounted for --max-memory
 
 void blacklist_init(void)
 {
@@ -61,11 +64,9 @@ static unsigned int G_GNUC_WGET_NONNULL_ALL hash_iri(const wget_iri *iri)
 	unsigned int h = iri->port; // use port as SALT if hash table attacks doesn't matter
 	const unsigned char *p;
 
-	for (p = (unsigned char *)iri->scheme; p && *p; p++)
-		h = h * 101 + *p;
-
-	for (p = (unsigned char *)iri->host; p && *p; p++)
-		h = h * 101 + *p;
+	// scheme and host are unique strings, see wget_intern()
+	h = h * 101 + (unsigned int) ((uintptr_t) iri->scheme >> 3);
+	h = h * 101 + (unsigned int) ((uintptr_t) iri->host >> 3);
 
 	for (p = (unsigned char *)iri->path; p && *p; p++)
 		h = h * 101 + *p;
@@ -115,6 +116,12 @@ wget_iri *blacklist_add(wget_iri *iri)
 		if (!wget_hashmap_contains(blacklist, iri)) {
 			// info_printf("Add to blacklist: %s\n",iri->uri);
 			wget_hashmap_put(blacklist, iri, NULL); // use hashmap as a hashset (without value)
+
+			// the IRI with its parsed components and the hashmap entry
+			long long size = sizeof(wget_iri) + strlen(iri->uri) * 2 + 4 * sizeof(void *);
+			memory += size;
+			memory_account(MEMORY_BLACKLIST, size);
+
 			wget_thread_mutex_unlock(mutex);
 			return iri;
 		} else {
@@ -133,5 +140,7 @@ void blacklist_free(void)
 {
 	wget_thread_mutex_lock(mutex);
 	wget_hashmap_free(&blacklist);
+	memory_account(MEMORY_BLACKLIST, -memory);
+	memory = 0;
 	wget_thread_mutex_unlock(mutex);
 }
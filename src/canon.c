@@ -0,0 +1,400 @@
+/*
+ * Copyright(c) 2019 Free Software Foundation, Inc.
+ *
+ * This file is part of Wget.
+ *
+ * Wget is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Wget is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Wget.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *
+ * URL canonicalization rules
+ *
+ * Different URLs often address the same resource, e.g. with tracking parameters,
+ * reordered query parameters or an explicit index file name. The rules below map
+ * them to one canonical URL before it is checked against the blacklist.
+ *
+ * Rule file format, one rule per line, '#' starts a comment:
+ *   strip <host pattern> <parameter pattern>...   remove matching query parameters
+ *   sort-params <host pattern>                    sort query parameters
+ *   fold-index <host pattern> <file name>...      remove trailing index file names
+ *   fold-case <host pattern>                      lowercase the path (case-insensitive servers)
+ *
+ * Patterns are shell wildcard patterns, e.g. '*' or '*.example.com' and 'utm_*'.
+ * Scheme, host name and default port are already canonical after parsing.
+ *
+ * The rules matching a host are merged once and cached, so most URLs cost
+ * a single hash lookup plus the work of the actual transformation.
+ *
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <fnmatch.h>
+
+#include <wget.h>
+
+#include "wget_main.h"
+#include "wget_canon.h"
+
+typedef struct {
+	char *
+		host_pattern;
+	wget_vector
+		*strip, // query parameter name patterns
+		*index; // index file names
+	bool
+		sort_params : 1,
+		fold_case : 1;
+} _canon_rule_t;
+
+// all rules matching a host, merged
+typedef struct {
+	wget_vector
+		*strip, // not owned, points into the rules
+		*index; // not owned, points into the rules
+	bool
+		sort_params : 1,
+		fold_case : 1;
+} _canon_host_t;
+
+static wget_vector
+	*rules;
+
+static wget_stringmap
+	*hosts;
+
+static wget_thread_mutex
+	mutex;
+
+void canon_init(void)
+{
+	wget_thread_mutex_init(&mutex);
+}
+
+void canon_exit(void)
+{
+	wget_thread_mutex_destroy(&mutex);
+}
+
+static void _free_rule(_canon_rule_t *rule)
+{
+	if (rule) {
+		xfree(rule->host_pattern);
+		wget_vector_free(&rule->strip);
+		wget_vector_free(&rule->index);
+		xfree(rule);
+	}
+}
+
+static void _free_host(_canon_host_t *host)
+{
+	if (host) {
+		wget_vector_clear_nofree(host->strip);
+		wget_vector_free(&host->strip);
+		wget_vector_clear_nofree(host->index);
+		wget_vector_free(&host->index);
+		xfree(host);
+	}
+}
+
+// split off the next whitespace separated word
+static char *_next_word(char **linep)
+{
+	char *s = *linep, *e;
+
+	while (isspace(*s)) s++;
+	if (!*s)
+		return NULL;
+
+	for (e = s; *e && !isspace(*e); e++);
+	if (*e)
+		*e++ = 0;
+
+	*linep = e;
+	return s;
+}
+
+int canon_load(const char *fname)
+{
+	FILE *fp;
+	char *buf = NULL, *linep, *word;
+	size_t bufsize = 0;
+	ssize_t buflen;
+	int lineno = 0, rc = 0;
+
+	if (!fname || !*fname)
+		return 0;
+
+	if (!(fp = fopen(fname, "r"))) {
+		error_printf(_("Failed to open canonicalization rules '%s'\n"), fname);
+		return -1;
+	}
+
+	while ((buflen = wget_getline(&buf, &bufsize, fp)) >= 0) {
+		_canon_rule_t *rule;
+		char *directive, *pattern;
+
+		lineno++;
+		linep = buf;
+
+		if ((word = strchr(linep, '#')))
+			*word = 0; // strip comments
+
+		if (!(directive = _next_word(&linep)))
+			continue; // skip empty lines
+
+		if (!(pattern = _next_word(&linep))) {
+			error_printf(_("%s:%d: missing host pattern\n"), fname, lineno);
+			rc = -1;
+			continue;
+		}
+
+		rule = wget_calloc(1, sizeof(_canon_rule_t));
+		rule->host_pattern = wget_strdup(pattern);
+
+		if (!strcmp(directive, "strip")) {
+			rule->strip = wget_vector_create(8, NULL);
+			while ((word = _next_word(&linep)))
+				wget_vector_add(rule->strip, wget_strdup(word));
+		} else if (!strcmp(directive, "fold-index")) {
+			rule->index = wget_vector_create(4, NULL);
+			while ((word = _next_word(&linep)))
+				wget_vector_add(rule->index, wget_strdup(word));
+		} else if (!strcmp(directive, "sort-params")) {
+			rule->sort_params = 1;
+		} else if (!strcmp(directive, "fold-case")) {
+			rule->fold_case = 1;
+		} else {
+			error_printf(_("%s:%d: unknown rule '%s'\n"), fname, lineno, directive);
+			_free_rule(rule);
+			rc = -1;
+			continue;
+		}
+
+		if ((rule->strip && !wget_vector_size(rule->strip)) || (rule->index && !wget_vector_size(rule->index))) {
+			error_printf(_("%s:%d: '%s' needs at least one argument\n"), fname, lineno, directive);
+			_free_rule(rule);
+			rc = -1;
+			continue;
+		}
+
+		if (!rules) {
+			rules = wget_vector_create(16, NULL);
+			wget_vector_set_destructor(rules, (wget_vector_destructor_t *) _free_rule);
+		}
+		wget_vector_add(rules, rule);
+	}
+
+	xfree(buf);
+	fclose(fp);
+
+	debug_printf("Loaded %d canonicalization rules from '%s'\n", wget_vector_size(rules), fname);
+
+	return rc;
+}
+
+static void _add_all(wget_vector **dst, wget_vector *src)
+{
+	if (!src)
+		return;
+
+	if (!*dst)
+		*dst = wget_vector_create(8, NULL);
+
+	for (int it = 0; it < wget_vector_size(src); it++)
+		wget_vector_add(*dst, wget_vector_get(src, it));
+}
+
+// must be called with mutex locked
+static _canon_host_t *_get_host(const char *hostname)
+{
+	_canon_host_t *host;
+
+	if (hosts && wget_stringmap_get(hosts, hostname, &host))
+		return host;
+
+	host = wget_calloc(1, sizeof(_canon_host_t));
+
+	for (int it = 0; it < wget_vector_size(rules); it++) {
+		_canon_rule_t *rule = wget_vector_get(rules, it);
+
+		if (fnmatch(rule->host_pattern, hostname, 0))
+			continue;
+
+		_add_all(&host->strip, rule->strip);
+		_add_all(&host->index, rule->index);
+		host->sort_params |= rule->sort_params;
+		host->fold_case |= rule->fold_case;
+	}
+
+	if (!hosts) {
+		hosts = wget_stringmap_create(32);
+		wget_stringmap_set_value_destructor(hosts, (wget_stringmap_value_destructor_t *) _free_host);
+	}
+	wget_stringmap_put(hosts, wget_strdup(hostname), host);
+
+	return host;
+}
+
+static int G_GNUC_WGET_PURE _in_pattern_list(const wget_vector *patterns, const char *s, size_t len)
+{
+	char name[256];
+
+	if (len >= sizeof(name))
+		return 0;
+
+	memcpy(name, s, len);
+	name[len] = 0;
+
+	for (int it = 0; it < wget_vector_size(patterns); it++) {
+		if (!fnmatch(wget_vector_get(patterns, it), name, 0))
+			return 1;
+	}
+
+	return 0;
+}
+
+static int _compare_params(const void *p1, const void *p2)
+{
+	return strcmp(*(const char * const *) p1, *(const char * const *) p2);
+}
+
+// rebuild the query, returns NULL if there are no parameters left
+static char *_canon_query(const _canon_host_t *host, const char *query)
+{
+	wget_buffer buf;
+	char *params[64], *copy, *result, *s, *next;
+	int nparams = 0;
+
+	copy = wget_strdup(query);
+
+	for (s = copy; s; s = next) {
+		if ((next = strchr(s, '&')))
+			*next++ = 0;
+
+		if (!*s)
+			continue; // empty parameter, e.g. 'a=1&&b=2'
+
+		if (host->strip && _in_pattern_list(host->strip, s, strcspn(s, "=")))
+			continue;
+
+		if (nparams >= (int) countof(params)) {
+			// too many parameters to handle, keep the query as is
+			xfree(copy);
+			return wget_strdup(query);
+		}
+
+		params[nparams++] = s;
+	}
+
+	if (host->sort_params)
+		qsort(params, nparams, sizeof(params[0]), _compare_params);
+
+	wget_buffer_init(&buf, NULL, 128);
+	for (int it = 0; it < nparams; it++) {
+		if (it)
+			wget_buffer_memcat(&buf, "&", 1);
+		wget_buffer_strcat(&buf, params[it]);
+	}
+
+	result = buf.length ? wget_strmemdup(buf.data, buf.length) : NULL;
+
+	wget_buffer_deinit(&buf);
+	xfree(copy);
+
+	return result;
+}
+
+// Returns the canonical form of iri, or NULL if iri is already canonical.
+wget_iri *canon_apply(const wget_iri *iri)
+{
+	_canon_host_t *host;
+	char *path, *query = NULL, *p;
+	wget_buffer buf;
+	wget_iri *canon_iri;
+	char sbuf[256];
+
+	if (!rules || !iri->host || iri->userinfo)
+		return NULL;
+
+	wget_thread_mutex_lock(mutex);
+	host = _get_host(iri->host);
+	wget_thread_mutex_unlock(mutex);
+
+	if (!host->strip && !host->index && !host->sort_params && !host->fold_case)
+		return NULL;
+
+	path = wget_strdup(iri->path ? iri->path : "");
+
+	if (host->fold_case)
+		wget_strtolower(path);
+
+	if (host->index) {
+		const char *name = (p = strrchr(path, '/')) ? p + 1 : path;
+
+		for (int it = 0; it < wget_vector_size(host->index); it++) {
+			if (!strcmp(name, wget_vector_get(host->index, it))) {
+				*(char *) name = 0; // keep the trailing slash
+				break;
+			}
+		}
+	}
+
+	if (iri->query)
+		query = _canon_query(host, iri->query);
+
+	if (!strcmp(path, iri->path ? iri->path : "") && !wget_strcmp(query, iri->query)) {
+		xfree(query);
+		xfree(path);
+		return NULL;
+	}
+
+	wget_buffer_init(&buf, sbuf, sizeof(sbuf));
+
+	wget_buffer_printf(&buf, strchr(iri->host, ':') ? "%s://[%s]" : "%s://%s", iri->scheme, iri->host);
+	if (iri->port_given)
+		wget_buffer_printf_append(&buf, ":%hu", iri->port);
+	wget_buffer_memcat(&buf, "/", 1);
+	wget_iri_escape_path(path, &buf);
+
+	if (query) {
+		wget_buffer_memcat(&buf, "?", 1);
+		for (p = query; *p; p++) {
+			if (*p == ' ')
+				wget_buffer_memcat(&buf, "%20", 3);
+			else
+				wget_buffer_memcat(&buf, p, 1);
+		}
+	}
+
+	if ((canon_iri = wget_iri_parse(buf.data, "utf-8")))
+		debug_printf("Canonical URL %s -> %s\n", iri->uri, canon_iri->uri);
+
+	wget_buffer_deinit(&buf);
+	xfree(query);
+	xfree(path);
+
+	return canon_iri;
+}
+
+void canon_free(void)
+{
+	wget_thread_mutex_lock(mutex);
+	wget_stringmap_free(&hosts);
+	wget_vector_free(&rules);
+	wget_thread_mutex_unlock(mutex);
+}
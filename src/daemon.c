@@ -0,0 +1,467 @@
+/*
+ * Copyright(c) 2019 Free Software Foundation, Inc.
+ *
+ * This file is part of Wget.
+ *
+ * Wget is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Wget is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Wget.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *
+ * Daemon mode routines
+ *
+ * A daemon keeps the downloader machinery (and with it DNS cache, TLS sessions
+ * and keep-alive connections) alive and accepts batches of URLs on a UNIX domain socket.
+ *
+ * The protocol is line based. A client sends
+ *   URL <url>     for each URL of the batch
+ *   END           to close the batch
+ * or
+ *   QUIT          to terminate the daemon.
+ *
+ * The daemon sends back
+ *   <status> <url>          whenever a job of the batch is finished (status 0 = no response)
+ *   DONE <jobs> <errors>    when all jobs of the batch are finished
+ *
+ * Hosts that have been blocked by connection failures are unblocked with each new batch.
+ *
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifndef _WIN32
+#  include <sys/socket.h>
+#  include <sys/un.h>
+#endif
+
+#include <wget.h>
+
+#include "safe-write.h"
+
+#include "wget_main.h"
+#include "wget_options.h"
+#include "wget_daemon.h"
+
+struct DAEMON_BATCH {
+	int
+		fd, // client connection, -1 if closed
+		pending, // number of unfinished jobs (+1 while the batch is being read)
+		jobs,
+		errors;
+	bool
+		reading : 1; // batch not yet closed by the client
+};
+
+#ifndef _WIN32
+
+static wget_vector
+	*batches;
+
+static wget_thread_mutex
+	mutex;
+
+static wget_thread
+	daemon_tid;
+
+static daemon_add_url_t
+	*add_url_func;
+
+static daemon_quit_t
+	*quit_func;
+
+static daemon_batch_start_t
+	*batch_start_func;
+
+static const char
+	*socket_path;
+
+static int
+	listen_fd = -1,
+	client_fd = -1;
+
+static volatile int
+	stopping;
+
+// must be called with mutex locked
+static void G_GNUC_WGET_PRINTF_FORMAT(2,3) _batch_printf(DAEMON_BATCH *batch, const char *fmt, ...)
+{
+	wget_buffer buf;
+	char sbuf[1024];
+	va_list args;
+
+	if (batch->fd < 0)
+		return;
+
+	wget_buffer_init(&buf, sbuf, sizeof(sbuf));
+
+	va_start(args, fmt);
+	wget_buffer_vprintf(&buf, fmt, args);
+	va_end(args);
+
+	if (safe_write(batch->fd, buf.data, buf.length) == SAFE_WRITE_ERROR) {
+		// client has gone, no more notifications
+		debug_printf("Failed to write to daemon client (%d)\n", errno);
+		close(batch->fd);
+		batch->fd = -1;
+	}
+
+	wget_buffer_deinit(&buf);
+}
+
+// must be called with mutex locked
+static void _batch_finish(DAEMON_BATCH *batch)
+{
+	if (batch->fd >= 0) {
+		_batch_printf(batch, "DONE %d %d\n", batch->jobs, batch->errors);
+		if (batch->fd >= 0) {
+			close(batch->fd);
+			batch->fd = -1;
+		}
+	}
+}
+
+// must be called with mutex locked
+static void _batch_release(DAEMON_BATCH *batch)
+{
+	if (--batch->pending > 0)
+		return;
+
+	_batch_finish(batch);
+
+	for (int it = 0; it < wget_vector_size(batches); it++) {
+		if (wget_vector_get(batches, it) == batch) {
+			wget_vector_remove(batches, it); // also frees batch
+			break;
+		}
+	}
+}
+
+void daemon_batch_add_job(DAEMON_BATCH *batch)
+{
+	wget_thread_mutex_lock(mutex);
+	batch->pending++;
+	batch->jobs++;
+	wget_thread_mutex_unlock(mutex);
+}
+
+// Release a job that has been replaced by another job of the same batch, without notification.
+void daemon_batch_job_release(DAEMON_BATCH *batch)
+{
+	wget_thread_mutex_lock(mutex);
+	batch->jobs--;
+	_batch_release(batch);
+	wget_thread_mutex_unlock(mutex);
+}
+
+void daemon_batch_job_done(DAEMON_BATCH *batch, int code, const char *url)
+{
+	wget_thread_mutex_lock(mutex);
+	if (code == 0 || code >= 400)
+		batch->errors++;
+	_batch_printf(batch, "%d %s\n", code, url);
+	_batch_release(batch);
+	wget_thread_mutex_unlock(mutex);
+}
+
+// Called when the job queue is empty.
+// Jobs that are still pending can't be downloaded (e.g. blocked host), so finish their batches.
+// The batch structures are kept until the last job is gone.
+void daemon_flush(void)
+{
+	wget_thread_mutex_lock(mutex);
+	for (int it = 0; it < wget_vector_size(batches); it++) {
+		DAEMON_BATCH *batch = wget_vector_get(batches, it);
+
+		if (!batch->reading && batch->fd >= 0 && batch->pending > 0) {
+			batch->errors += batch->pending;
+			_batch_finish(batch);
+		}
+	}
+	wget_thread_mutex_unlock(mutex);
+}
+
+static void _read_batch(int fd)
+{
+	DAEMON_BATCH *batch = wget_calloc(1, sizeof(DAEMON_BATCH));
+	char *buf = NULL, *line;
+	size_t bufsize = 0;
+	ssize_t len;
+
+	batch->fd = fd;
+	batch->pending = 1; // hold the batch while reading
+	batch->reading = 1;
+
+	wget_thread_mutex_lock(mutex);
+	wget_vector_add(batches, batch);
+	wget_thread_mutex_unlock(mutex);
+
+	batch_start_func();
+
+	while (!stopping && (len = wget_fdgetline(&buf, &bufsize, fd)) >= 0) {
+		for (line = buf; len && isspace(*line); line++, len--); // skip leading spaces
+		for (;len && isspace(line[len - 1]); len--); // skip trailing spaces
+		line[len] = 0;
+
+		if (!*line)
+			continue;
+
+		if (!strncmp(line, "URL ", 4)) {
+			add_url_func(line + 4, batch);
+		} else if (!strcmp(line, "END")) {
+			break;
+		} else if (!strcmp(line, "QUIT")) {
+			info_printf(_("Daemon termination requested\n"));
+			quit_func();
+			break;
+		} else {
+			wget_thread_mutex_lock(mutex);
+			_batch_printf(batch, "ERR unknown command '%s'\n", line);
+			wget_thread_mutex_unlock(mutex);
+		}
+	}
+
+	xfree(buf);
+
+	wget_thread_mutex_lock(mutex);
+	batch->reading = 0;
+	_batch_release(batch);
+	wget_thread_mutex_unlock(mutex);
+}
+
+static void *_daemon_thread(void *p G_GNUC_WGET_UNUSED)
+{
+	while (!stopping) {
+		int fd, rc;
+
+		if ((rc = wget_ready_2_read(listen_fd, 1000)) <= 0) {
+			if (rc < 0 && errno != EINTR)
+				break;
+			continue;
+		}
+
+		if ((fd = accept(listen_fd, NULL, NULL)) < 0)
+			continue;
+
+		debug_printf("daemon: accepted client connection\n");
+		client_fd = fd;
+		_read_batch(fd);
+		client_fd = -1;
+	}
+
+	return NULL;
+}
+
+int daemon_start(const char *path, daemon_batch_start_t *batch_start, daemon_add_url_t *add_url, daemon_quit_t *quit)
+{
+	struct sockaddr_un addr;
+	struct stat st;
+	int rc;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		error_printf(_("Daemon socket path too long: '%s'\n"), path);
+		return -1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	if ((listen_fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+		error_printf(_("Failed to create daemon socket (%d)\n"), errno);
+		return -1;
+	}
+
+	if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+		unlink(path); // remove stale socket from a previous run
+
+	if (bind(listen_fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 || listen(listen_fd, 16) < 0) {
+		error_printf(_("Failed to listen on daemon socket '%s' (%d)\n"), path, errno);
+		close(listen_fd);
+		listen_fd = -1;
+		return -1;
+	}
+
+	wget_thread_mutex_init(&mutex);
+	batches = wget_vector_create(8, NULL);
+	batch_start_func = batch_start;
+	add_url_func = add_url;
+	quit_func = quit;
+	socket_path = path;
+
+	if ((rc = wget_thread_start(&daemon_tid, _daemon_thread, NULL, 0)) != 0) {
+		error_printf(_("Failed to start daemon thread, error %d\n"), rc);
+		daemon_stop();
+		return -1;
+	}
+
+	info_printf(_("Daemon listening on '%s'\n"), path);
+
+	return 0;
+}
+
+void daemon_stop(void)
+{
+	if (listen_fd < 0)
+		return;
+
+	stopping = 1;
+	if (client_fd >= 0)
+		shutdown(client_fd, SHUT_RD); // wake up a reader waiting for the client
+	if (daemon_tid)
+		wget_thread_join(&daemon_tid);
+
+	close(listen_fd);
+	listen_fd = -1;
+	unlink(socket_path);
+
+	// downloaders have stopped, anything left is unfinished
+	for (int it = 0; it < wget_vector_size(batches); it++) {
+		DAEMON_BATCH *batch = wget_vector_get(batches, it);
+
+		batch->errors += batch->pending;
+		_batch_finish(batch);
+	}
+
+	wget_vector_free(&batches);
+	wget_thread_mutex_destroy(&mutex);
+}
+
+static int _submit_url(int fd, const char *url)
+{
+	char *line = wget_aprintf("URL %s\n", url);
+	size_t rc = safe_write(fd, line, strlen(line));
+
+	xfree(line);
+	return rc == SAFE_WRITE_ERROR ? -1 : 0;
+}
+
+// Client mode: send URLs to a daemon and print the results.
+// Returns -1 on communication errors, 1 if some jobs failed, else 0.
+int daemon_submit(const char *path, const char **urls, int nurls, const char *input_file)
+{
+	struct sockaddr_un addr;
+	char *buf = NULL, *url;
+	size_t bufsize = 0;
+	ssize_t len;
+	int fd, jobs = 0, errors = -1;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		error_printf(_("Daemon socket path too long: '%s'\n"), path);
+		return -1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0 || connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+		error_printf(_("Failed to connect to daemon socket '%s' (%d)\n"), path, errno);
+		if (fd >= 0)
+			close(fd);
+		return -1;
+	}
+
+	for (int it = 0; it < nurls; it++) {
+		if (_submit_url(fd, urls[it]))
+			goto out;
+	}
+
+	if (input_file) {
+		int infd = strcmp(input_file, "-") ? open(input_file, O_RDONLY|O_BINARY) : STDIN_FILENO;
+
+		if (infd < 0) {
+			error_printf(_("Failed to open input file %s\n"), input_file);
+			goto out;
+		}
+
+		while ((len = wget_fdgetline(&buf, &bufsize, infd)) >= 0) {
+			for (url = buf; len && isspace(*url); url++, len--); // skip leading spaces
+			if (*url == '#' || len <= 0) continue; // skip empty lines and comments
+			for (;len && isspace(url[len - 1]); len--);  // skip trailing spaces
+
+			url[len] = 0;
+			if (_submit_url(fd, url))
+				break;
+		}
+
+		if (infd != STDIN_FILENO)
+			close(infd);
+	}
+
+	if (safe_write(fd, "END\n", 4) == SAFE_WRITE_ERROR)
+		goto out;
+
+	// stream the results back until the batch is done
+	while ((len = wget_fdgetline(&buf, &bufsize, fd)) >= 0) {
+		if (sscanf(buf, "DONE %d %d", &jobs, &errors) == 2)
+			break;
+
+		info_printf("%s\n", buf);
+	}
+
+	if (errors >= 0)
+		info_printf(_("Daemon finished %d jobs, %d errors\n"), jobs, errors);
+	else
+		error_printf(_("Daemon closed the connection unexpectedly\n"));
+
+out:
+	xfree(buf);
+	close(fd);
+
+	return errors < 0 ? -1 : errors > 0;
+}
+
+#else /* _WIN32 */
+
+int daemon_start(const char *path G_GNUC_WGET_UNUSED, daemon_batch_start_t *batch_start G_GNUC_WGET_UNUSED,
+	daemon_add_url_t *add_url G_GNUC_WGET_UNUSED, daemon_quit_t *quit G_GNUC_WGET_UNUSED)
+{
+	error_printf(_("Daemon mode is not supported on this platform\n"));
+	return -1;
+}
+
+void daemon_stop(void)
+{
+}
+
+void daemon_flush(void)
+{
+}
+
+void daemon_batch_add_job(DAEMON_BATCH *batch G_GNUC_WGET_UNUSED)
+{
+}
+
+void daemon_batch_job_release(DAEMON_BATCH *batch G_GNUC_WGET_UNUSED)
+{
+}
+
+void daemon_batch_job_done(DAEMON_BATCH *batch G_GNUC_WGET_UNUSED, int code G_GNUC_WGET_UNUSED, const char *url G_GNUC_WGET_UNUSED)
+{
+}
+
+int daemon_submit(const char *path G_GNUC_WGET_UNUSED, const char **urls G_GNUC_WGET_UNUSED, int nurls G_GNUC_WGET_UNUSED, const char *input_file G_GNUC_WGET_UNUSED)
+{
+	error_printf(_("Daemon mode is not supported on this platform\n"));
+	return -1;
+}
+
+#endif /* _WIN32 */
@@ -0,0 +1,616 @@
+/*
+ * Copyright(c) 2019 Free Software Foundation, Inc.
+ *
+ * This file is part of Wget.
+ *
+ * Wget is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Wget is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Wget.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *
+ * Compression dictionary store (Compression Dictionary Transport)
+ *
+ * A response with a 'Use-As-Dictionary' header marks the downloaded file as
+ * dictionary for later requests to the same origin whose path matches the
+ * given pattern. The file is copied into the dictionary directory, named by
+ * the hex SHA-256 of its content. Matching requests announce it with
+ * 'Available-Dictionary' and accept the 'dcb' / 'dcz' content encodings,
+ * which let the server send just the delta to the dictionary.
+ *
+ * The directory contains a flat index file with one dictionary per line:
+ *   <sha256 hex> <created> <origin> <match pattern> [<id>]
+ *
+ * Match patterns are shell wildcard patterns on path and query (URLPattern
+ * is not supported beyond that).
+ *
+ * References
+ *   https://datatracker.ietf.org/doc/draft-ietf-httpbis-compression-dictionary/
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <fnmatch.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <wget.h>
+
+#include "wget_main.h"
+#include "wget_utils.h"
+#include "wget_dictionary.h"
+
+// a dictionary of 100MB is already far beyond anything useful
+#define DICTIONARY_MAX_SIZE (100 * 1024 * 1024)
+
+typedef struct {
+	char *
+		origin; // scheme://host:port
+	char *
+		match; // pattern for path and query
+	char *
+		id; // value for 'Dictionary-ID' or NULL
+	char
+		hash[65]; // hex SHA-256, also the file name
+	int64_t
+		created; // time of creation in seconds since epoch
+} _dictionary_t;
+
+// content of a stored dictionary, loaded and hashed once when first offered
+typedef struct {
+	char *
+		data;
+	size_t
+		length;
+	unsigned char
+		digest[32]; // SHA-256 of data
+	char *
+		b64; // base64 of digest for 'Available-Dictionary'
+} _dictionary_data_t;
+
+static wget_vector
+	*dictionaries;
+
+static wget_stringmap
+	*loaded; // hex SHA-256 -> _dictionary_data_t, kept until exit since requests reference the data
+
+static char
+	*directory,
+	*index_file;
+
+static wget_thread_mutex
+	mutex;
+
+static time_t
+	load_time;
+
+void dictionary_init(void)
+{
+	wget_thread_mutex_init(&mutex);
+}
+
+void dictionary_exit(void)
+{
+	wget_thread_mutex_destroy(&mutex);
+}
+
+static void _free_dictionary(_dictionary_t *dict)
+{
+	if (dict) {
+		xfree(dict->origin);
+		xfree(dict->match);
+		xfree(dict->id);
+		xfree(dict);
+	}
+}
+
+static void _free_dictionary_data(_dictionary_data_t *data)
+{
+	if (data) {
+		xfree(data->data);
+		xfree(data->b64);
+		xfree(data);
+	}
+}
+
+static char *G_GNUC_WGET_NONNULL_ALL _origin(const wget_iri *iri)
+{
+	return wget_aprintf(strchr(iri->host, ':') ? "%s://[%s]:%hu" : "%s://%s:%hu", iri->scheme, iri->host, iri->port);
+}
+
+// must be called with mutex locked
+static void _dictionary_put(_dictionary_t *dict)
+{
+	if (!dictionaries) {
+		dictionaries = wget_vector_create(16, NULL);
+		wget_vector_set_destructor(dictionaries, (wget_vector_destructor_t *) _free_dictionary);
+	}
+
+	// a new dictionary for the same pattern replaces the old one
+	for (int it = 0; it < wget_vector_size(dictionaries); it++) {
+		_dictionary_t *old = wget_vector_get(dictionaries, it);
+
+		if (!strcmp(old->origin, dict->origin) && !strcmp(old->match, dict->match)) {
+			if (old->created > dict->created) {
+				_free_dictionary(dict);
+				return;
+			}
+
+			wget_vector_remove(dictionaries, it);
+			break;
+		}
+	}
+
+	wget_vector_add(dictionaries, dict);
+}
+
+// parse an sf-string, returns a pointer behind the closing quote
+static const char *_parse_string(const char *s, char **out)
+{
+	wget_buffer buf;
+	char sbuf[128];
+
+	wget_buffer_init(&buf, sbuf, sizeof(sbuf));
+
+	for (s++; *s && *s != '"'; s++) {
+		if (*s == '\\' && s[1])
+			s++;
+		wget_buffer_memcat(&buf, s, 1);
+	}
+
+	*out = wget_strmemdup(buf.data, buf.length);
+	wget_buffer_deinit(&buf);
+
+	return *s ? s + 1 : s;
+}
+
+// Use-As-Dictionary: match="/app.*.js", match-dest=("script"), id="v1", type=raw
+static int _parse_use_as_dictionary(const char *s, char **match, char **id)
+{
+	int raw = 1;
+
+	*match = *id = NULL;
+
+	while (*s) {
+		const char *key;
+		size_t keylen;
+
+		while (isspace(*s) || *s == ',') s++;
+
+		for (key = s; *s && *s != '=' && *s != ',' && !isspace(*s); s++);
+		keylen = s - key;
+
+		if (*s == '=') {
+			s++;
+			if (*s == '"') {
+				char *value;
+
+				s = _parse_string(s, &value);
+				if (keylen == 5 && !memcmp(key, "match", 5) && !*match)
+					*match = value;
+				else if (keylen == 2 && !memcmp(key, "id", 2) && !*id)
+					*id = value;
+				else
+					xfree(value);
+			} else if (*s == '(') {
+				// inner list, e.g. match-dest - we are not a browser, ignore it
+				while (*s && *s != ')') {
+					if (*s == '"') {
+						char *value;
+						s = _parse_string(s, &value);
+						xfree(value);
+					} else s++;
+				}
+				if (*s) s++;
+			} else {
+				const char *value = s;
+
+				while (*s && *s != ',' && *s != ';' && !isspace(*s)) s++;
+				if (keylen == 4 && !memcmp(key, "type", 4))
+					raw = (s - value == 3 && !memcmp(value, "raw", 3));
+			}
+		}
+
+		// skip parameters
+		while (*s && *s != ',') {
+			if (*s == '"') {
+				char *value;
+				s = _parse_string(s, &value);
+				xfree(value);
+			} else s++;
+		}
+	}
+
+	if (!raw || !*match || !**match) {
+		xfree(*match);
+		xfree(*id);
+		return -1;
+	}
+
+	return 0;
+}
+
+// resolve the match pattern against the URL of the dictionary, returns NULL if unusable
+static char *_resolve_match(const wget_iri *iri, const char *origin, const char *match)
+{
+	const char *p;
+
+	if ((p = strstr(match, "://"))) {
+		// absolute pattern, only same origin is allowed
+		wget_iri *match_iri;
+		char *match_origin, *path = NULL;
+
+		if (!(match_iri = wget_iri_parse(match, "utf-8")))
+			return NULL;
+
+		match_origin = _origin(match_iri);
+		if (!strcmp(match_origin, origin))
+			path = wget_aprintf("/%s%s%s", match_iri->path ? match_iri->path : "", match_iri->query ? "?" : "", match_iri->query ? match_iri->query : "");
+
+		xfree(match_origin);
+		wget_iri_free(&match_iri);
+		return path;
+	}
+
+	if (*match == '/')
+		return wget_strdup(match);
+
+	// relative to the directory of the dictionary URL
+	if (iri->path && (p = strrchr(iri->path, '/')))
+		return wget_aprintf("/%.*s/%s", (int) (p - iri->path), iri->path, match);
+
+	return wget_aprintf("/%s", match);
+}
+
+static int G_GNUC_WGET_NONNULL_ALL _dictionary_save_entry(FILE *fp, const _dictionary_t *dict)
+{
+	wget_fprintf(fp, "%s %lld %s %s%s%s\n", dict->hash, (long long) dict->created, dict->origin, dict->match,
+		dict->id ? " " : "", dict->id ? dict->id : "");
+	return 0;
+}
+
+static int _dictionary_load(G_GNUC_WGET_UNUSED void *ctx, FILE *fp)
+{
+	struct stat st;
+	char *buf = NULL, *linep, *p;
+	size_t bufsize = 0;
+	ssize_t buflen;
+
+	// if the file hasn't changed since the last read there's no need to reload
+	if (fstat(fileno(fp), &st) == 0) {
+		if (st.st_mtime != load_time)
+			load_time = st.st_mtime;
+		else
+			return 0;
+	}
+
+	while ((buflen = wget_getline(&buf, &bufsize, fp)) >= 0) {
+		_dictionary_t *dict;
+		char *fields[4];
+		int nfields;
+
+		linep = buf;
+
+		while (isspace(*linep)) linep++; // ignore leading whitespace
+		if (!*linep || *linep == '#')
+			continue; // skip empty lines and comments
+
+		// strip off \r\n
+		while (buflen > 0 && (buf[buflen - 1] == '\n' || buf[buflen - 1] == '\r'))
+			buf[--buflen] = 0;
+
+		for (nfields = 0; nfields < 4 && *linep; nfields++) {
+			for (p = linep; *linep && !isspace(*linep); linep++);
+			if (*linep)
+				*linep++ = 0;
+			fields[nfields] = p;
+		}
+
+		if (nfields < 4 || strlen(fields[0]) != 64) {
+			error_printf(_("Failed to parse dictionary index line: '%s'\n"), buf);
+			continue;
+		}
+
+		dict = wget_calloc(1, sizeof(_dictionary_t));
+		wget_strscpy(dict->hash, fields[0], sizeof(dict->hash));
+		dict->created = atoll(fields[1]);
+		dict->origin = wget_strdup(fields[2]);
+		dict->match = wget_strdup(fields[3]);
+		if (*linep) {
+			for (p = linep; *linep && !isspace(*linep); linep++);
+			dict->id = wget_strmemdup(p, linep - p);
+		}
+
+		wget_thread_mutex_lock(mutex);
+		_dictionary_put(dict);
+		wget_thread_mutex_unlock(mutex);
+	}
+
+	xfree(buf);
+
+	if (ferror(fp)) {
+		load_time = 0; // reload on next call to this function
+		return -1;
+	}
+
+	return 0;
+}
+
+static int _dictionary_save(G_GNUC_WGET_UNUSED void *ctx, FILE *fp)
+{
+	fputs("#Compression dictionary index 1.0 file\n", fp);
+	fputs("#Generated by Wget2 " PACKAGE_VERSION ". Edit at your own risk.\n", fp);
+	fputs("# <sha256> <created> <origin> <match> [<id>]\n", fp);
+
+	wget_thread_mutex_lock(mutex);
+	for (int it = 0; it < wget_vector_size(dictionaries); it++)
+		_dictionary_save_entry(fp, wget_vector_get(dictionaries, it));
+	wget_thread_mutex_unlock(mutex);
+
+	return ferror(fp) ? -1 : 0;
+}
+
+int dictionary_load(const char *dir)
+{
+	char *path;
+
+	if (!dir || !*dir)
+		return 0;
+
+	path = wget_strdup(dir);
+	mkdir_path(path, false);
+	xfree(path);
+
+	directory = wget_strdup(dir);
+	index_file = wget_aprintf("%s/index", dir);
+
+	if (access(index_file, R_OK))
+		return 0; // nothing stored yet
+
+	if (wget_update_file(index_file, _dictionary_load, NULL, NULL)) {
+		error_printf(_("Failed to read dictionary index '%s'\n"), index_file);
+		return -1;
+	}
+
+	debug_printf("Loaded %d compression dictionaries from '%s'\n", wget_vector_size(dictionaries), dir);
+	return 0;
+}
+
+int dictionary_save(void)
+{
+	if (!index_file || !wget_vector_size(dictionaries))
+		return 0;
+
+	if (wget_update_file(index_file, _dictionary_load, _dictionary_save, NULL)) {
+		error_printf(_("Failed to write dictionary index '%s'\n"), index_file);
+		return -1;
+	}
+
+	debug_printf("Saved %d compression dictionaries into '%s'\n", wget_vector_size(dictionaries), index_file);
+	return 0;
+}
+
+void dictionary_add(const wget_iri *iri, const char *use_as_dictionary, const char *fname)
+{
+	_dictionary_t *dict;
+	char *match, *id, *data, *origin, *dict_fname;
+	unsigned char digest[32];
+	size_t size;
+
+	if (!directory || !iri->host)
+		return;
+
+	if (_parse_use_as_dictionary(use_as_dictionary, &match, &id)) {
+		debug_printf("Ignoring Use-As-Dictionary: %s\n", use_as_dictionary);
+		return;
+	}
+
+	origin = _origin(iri);
+	dict = wget_calloc(1, sizeof(_dictionary_t));
+	dict->origin = origin;
+	dict->id = id;
+	dict->match = _resolve_match(iri, origin, match);
+	xfree(match);
+
+	// the index file is space separated, see _dictionary_save_entry()
+	if (!dict->match || strpbrk(dict->match, " \t\r\n") || (dict->id && strpbrk(dict->id, " \t\r\n"))) {
+		_free_dictionary(dict);
+		return;
+	}
+
+	if (!(data = wget_read_file(fname, &size)) || !size || size > DICTIONARY_MAX_SIZE) {
+		xfree(data);
+		_free_dictionary(dict);
+		return;
+	}
+
+	wget_hash_fast(WGET_DIGTYPE_SHA256, data, size, digest);
+	wget_memtohex(digest, sizeof(digest), dict->hash, sizeof(dict->hash));
+	dict->created = time(NULL);
+
+	dict_fname = wget_aprintf("%s/%s", directory, dict->hash);
+	if (access(dict_fname, F_OK)) {
+		FILE *fp;
+
+		if ((fp = fopen(dict_fname, "wb"))) {
+			if (fwrite(data, 1, size, fp) != size) {
+				error_printf(_("Failed to write compression dictionary '%s'\n"), dict_fname);
+				fclose(fp);
+				unlink(dict_fname);
+				_free_dictionary(dict);
+				dict = NULL;
+			} else
+				fclose(fp);
+		} else {
+			error_printf(_("Failed to open '%s' for writing\n"), dict_fname);
+			_free_dictionary(dict);
+			dict = NULL;
+		}
+	}
+
+	if (dict) {
+		debug_printf("Stored %s as compression dictionary %s for %s%s\n", iri->uri, dict->hash, dict->origin, dict->match);
+
+		wget_thread_mutex_lock(mutex);
+		_dictionary_put(dict);
+		wget_thread_mutex_unlock(mutex);
+	}
+
+	xfree(dict_fname);
+	xfree(data);
+}
+
+const char *dictionary_encodings(void)
+{
+#if defined WITH_BROTLIDEC && defined HAVE_BROTLIDECODERATTACHDICTIONARY && defined WITH_ZSTD
+	return "dcb, dcz";
+#elif defined WITH_BROTLIDEC && defined HAVE_BROTLIDECODERATTACHDICTIONARY
+	return "dcb";
+#elif defined WITH_ZSTD
+	return "dcz";
+#else
+	return NULL;
+#endif
+}
+
+// returns the content of the dictionary \p hash, reading it from disk on first use
+static _dictionary_data_t *_dictionary_data(const char *hash)
+{
+	_dictionary_data_t *data = NULL, *old;
+	char *fname, hex[65];
+
+	wget_thread_mutex_lock(mutex);
+	wget_stringmap_get(loaded, hash, &data);
+	wget_thread_mutex_unlock(mutex);
+
+	if (data)
+		return data;
+
+	// read and hash outside the lock, the files may be large
+	data = wget_calloc(1, sizeof(_dictionary_data_t));
+	fname = wget_aprintf("%s/%s", directory, hash);
+
+	if (!(data->data = wget_read_file(fname, &data->length))) {
+		debug_printf("Compression dictionary '%s' has gone\n", fname);
+		_free_dictionary_data(data);
+		xfree(fname);
+		return NULL;
+	}
+
+	wget_hash_fast(WGET_DIGTYPE_SHA256, data->data, data->length, data->digest);
+	wget_memtohex(data->digest, sizeof(data->digest), hex, sizeof(hex));
+
+	if (strcmp(hex, hash)) {
+		error_printf(_("Compression dictionary '%s' has been modified\n"), fname);
+		_free_dictionary_data(data);
+		xfree(fname);
+		return NULL;
+	}
+	xfree(fname);
+
+	data->b64 = wget_base64_encode_alloc((const char *) data->digest, sizeof(data->digest));
+
+	wget_thread_mutex_lock(mutex);
+	if (!loaded) {
+		loaded = wget_stringmap_create(16);
+		wget_stringmap_set_value_destructor(loaded, (wget_stringmap_value_destructor_t *) _free_dictionary_data);
+	}
+	if (wget_stringmap_get(loaded, hash, &old)) {
+		// another thread has been faster
+		_free_dictionary_data(data);
+		data = old;
+	} else
+		wget_stringmap_put(loaded, wget_strdup(hash), data);
+	wget_thread_mutex_unlock(mutex);
+
+	return data;
+}
+
+int dictionary_offer(wget_http_request *req, const wget_iri *iri)
+{
+	_dictionary_t *best = NULL;
+	_dictionary_data_t *data;
+	char *origin, *resource;
+	char hash[65], *id = NULL;
+
+	if (!dictionary_encodings() || !wget_vector_size(dictionaries) || !iri->host)
+		return 0;
+
+	origin = _origin(iri);
+	resource = wget_aprintf("/%s%s%s", iri->path ? iri->path : "", iri->query ? "?" : "", iri->query ? iri->query : "");
+
+	// the most specific (longest) matching pattern wins
+	wget_thread_mutex_lock(mutex);
+	for (int it = 0; it < wget_vector_size(dictionaries); it++) {
+		_dictionary_t *dict = wget_vector_get(dictionaries, it);
+
+		if (!strcmp(dict->origin, origin) && !fnmatch(dict->match, resource, 0)
+			&& (!best || strlen(dict->match) > strlen(best->match)))
+			best = dict;
+	}
+	if (best) {
+		wget_strscpy(hash, best->hash, sizeof(hash));
+		id = wget_strdup(best->id);
+	}
+	wget_thread_mutex_unlock(mutex);
+
+	xfree(resource);
+	xfree(origin);
+
+	if (!best)
+		return 0;
+
+	if (!(data = _dictionary_data(hash))) {
+		xfree(id);
+		return 0;
+	}
+
+	req->dictionary = data->data;
+	req->dictionary_length = data->length;
+	req->dictionary_hash = data->digest;
+
+	wget_http_add_header_printf(req, "Available-Dictionary", ":%s:", data->b64);
+
+	if (id) {
+		wget_buffer buf;
+
+		// serialize as sf-string
+		wget_buffer_init(&buf, NULL, 64);
+		wget_buffer_memcat(&buf, "\"", 1);
+		for (const char *p = id; *p; p++) {
+			if (*p == '"' || *p == '\\')
+				wget_buffer_memcat(&buf, "\\", 1);
+			wget_buffer_memcat(&buf, p, 1);
+		}
+		wget_buffer_memcat(&buf, "\"", 1);
+		wget_http_add_header(req, "Dictionary-ID", buf.data);
+		wget_buffer_deinit(&buf);
+		xfree(id);
+	}
+
+	return 1;
+}
+
+void dictionary_free(void)
+{
+	wget_thread_mutex_lock(mutex);
+	wget_vector_free(&dictionaries);
+	wget_stringmap_free(&loaded);
+	wget_thread_mutex_unlock(mutex);
+
+	xfree(index_file);
+	xfree(directory);
+}
@@ -25,6 +25,10 @@
  *
  * Each entry in hosts has it's own job queue. This allows to re-use
  * a connection for subsequent requests without expensive searching.
+ *
+ * Most queued jobs are plain links found while crawling. Until a downloader
+ * takes them, they are kept as compact QUEUED_JOB records in a per-host
+ * array. The full JOB is only built by host_get_job().
  */
 
 #include <config.h>
@@ -38,6 +42,29 @@
 #include "wget_options.h"
 #include "wget_job.h"
 #include "wget_stats.h"
+#include "wget_memory.h"
+#include "wget_daemon.h"
+#include "wget_rtt.h"
+
+// compact form of a job that has not been handed out yet
+struct QUEUED_JOB {
+	wget_iri
+		*iri, // owned by the blacklist
+		*referer;
+	unsigned long long
+		id,
+		parent_id;
+	int
+		level;
+	bool
+		derived_filename : 1,
+		head_first : 1,
+		requested_by_user : 1,
+		ignore_patterns : 1,
+		sitemap : 1,
+		requisite : 1,
+		http_fallback : 1;
+};
 
 static wget_hashmap
 	*hosts;
@@ -58,8 +85,6 @@ void host_exit(void)
 
 static int _host_compare(const HOST *host1, const HOST *host2)
 {
-	int n;
-
 	// If we use SCHEME here, we would eventually download robots.txt twice,
 	//   e.g. for http://example.com and second for https://example.com.
 	// This only makes sense when having the scheme and/or port within the directory name.
@@ -67,9 +92,9 @@ static int _host_compare(const HOST *host1, const HOST *host2)
 	if (host1->scheme != host2->scheme)
 		return host1->scheme < host2->scheme ? -1 : 1;
 
-	// host is already lowercase, no need to call strcasecmp()
-	if ((n = wget_strcmp(host1->host, host2->host)))
-		return n;
+	// host is interned, see wget_intern()
+	if (host1->host != host2->host)
+		return host1->host < host2->host ? -1 : 1;
 
 	return host1->port < host2->port ? -1 : (host1->port > host2->port ? 1 : 0);
 }
@@ -80,17 +105,14 @@ __attribute__((no_sanitize("integer")))
 static unsigned int _host_hash(const HOST *host)
 {
 	unsigned int hash = host->port; // use port as SALT if hash table attacks doesn't matter
-	const unsigned char *p;
 
 	// We use SCHEME here, so we would eventually download robots.txt twice,
 	//   e.g. for http://example.com and a second time for https://example.com.
 	// Not unlikely that both are the same... but maybe they are not.
 
-	for (p = (unsigned char *)host->scheme; p && *p; p++)
-		hash = hash * 101 + *p;
-
-	for (p = (unsigned char *)host->host; p && *p; p++)
-		hash = hash * 101 + *p;
+	// scheme and host are unique strings, see wget_intern()
+	hash = hash * 101 + (unsigned int) ((uintptr_t) host->scheme >> 3);
+	hash = hash * 101 + (unsigned int) ((uintptr_t) host->host >> 3);
 
 	return hash;
 }
@@ -146,6 +168,138 @@ struct _find_free_job_context {
 	long long pause;
 };
 
+// Small parts of a sparse download (metalink repair, zsync update) are requested
+// together with one multi-range request. Stop when the parts sum up to a normal chunk,
+// so that large downloads are still spread over several downloaders.
+static void _claim_ranges(JOB *job, int it, PART *part)
+{
+	off_t max_length = config.chunk_size ? (off_t) config.chunk_size : 1024 * 1024;
+	off_t length = part->length;
+	int nranges = 1;
+
+	part->next = NULL;
+	part->received = 0;
+
+	// the server failed on a multi-range request before
+	if (job->host && job->host->single_range)
+		return;
+
+	while (++it < wget_vector_size(job->parts) && nranges < config.max_ranges) {
+		PART *next = wget_vector_get(job->parts, it);
+
+		if (next->done)
+			continue;
+
+		if (next->inuse || length + next->length > max_length)
+			break;
+
+		next->inuse = 1;
+		next->used_by = part->used_by;
+		next->next = NULL;
+		next->received = 0;
+		part = part->next = next;
+		length += next->length;
+		nranges++;
+	}
+}
+
+// estimated memory of a queued job
+static int _job_memory(const JOB *job)
+{
+	return (int) (sizeof(JOB) + (job->local_filename ? strlen(job->local_filename) + 1 : 0));
+}
+
+// whether the job can be kept as QUEUED_JOB without losing information
+static bool _job_is_compact(const JOB *job)
+{
+	return !job->metalink && !job->parts && !job->original_url && !job->proxy_challenges
+		&& !job->sig_req && !job->sig_filename && !job->remaining_sig_ext && !job->batch && !job->if_range
+		&& !job->redirection_level && !job->robotstxt && !job->challenges_alloc
+		&& job->challenges == (config.auth_no_challenge ? config.default_challenges : NULL)
+		&& (job->derived_filename || !job->local_filename);
+}
+
+static void _add_pending_job(HOST *host, const JOB *job)
+{
+	if (host->pending_last == host->pending_size) {
+		if (host->pending_first >= host->pending_size / 2 && host->pending_first > 0) {
+			// reuse the space of the jobs already handed out
+			memmove(host->pending, host->pending + host->pending_first,
+				(host->pending_last - host->pending_first) * sizeof(QUEUED_JOB));
+			host->pending_last -= host->pending_first;
+			host->pending_first = 0;
+		} else {
+			host->pending_size = host->pending_size ? host->pending_size * 2 : 16;
+			host->pending = wget_realloc(host->pending, host->pending_size * sizeof(QUEUED_JOB));
+		}
+	}
+
+	host->pending[host->pending_last++] = (QUEUED_JOB) {
+		.iri = job->iri,
+		.referer = job->referer,
+		.id = job->id,
+		.parent_id = job->parent_id,
+		.level = job->level,
+		.derived_filename = job->derived_filename,
+		.head_first = job->head_first,
+		.requested_by_user = job->requested_by_user,
+		.ignore_patterns = job->ignore_patterns,
+		.sitemap = job->sitemap,
+		.requisite = job->requisite,
+		.http_fallback = job->http_fallback
+	};
+
+	memory_account(MEMORY_QUEUE, sizeof(QUEUED_JOB));
+
+	// the local filename is computed again when the job is handed out
+	wget_free((void *) job->local_filename);
+}
+
+static void _pending_jobs_free(HOST *host)
+{
+	memory_account(MEMORY_QUEUE, -(long long) ((host->pending_last - host->pending_first) * sizeof(QUEUED_JOB)));
+	xfree(host->pending);
+	host->pending_first = host->pending_last = host->pending_size = 0;
+}
+
+// build the full JOB of a pending job and move it to the queue
+static JOB *_materialize_job(HOST *host, const QUEUED_JOB *queued)
+{
+	JOB job = {
+		.iri = queued->iri,
+		.referer = queued->referer,
+		.host = host,
+		.id = queued->id,
+		.parent_id = queued->parent_id,
+		.level = queued->level,
+		.derived_filename = queued->derived_filename,
+		.head_first = queued->head_first,
+		.requested_by_user = queued->requested_by_user,
+		.ignore_patterns = queued->ignore_patterns,
+		.sitemap = queued->sitemap,
+		.requisite = queued->requisite,
+		.http_fallback = queued->http_fallback
+	}, *jobp;
+
+	if (queued->derived_filename)
+		job.local_filename = get_local_filename(job.iri);
+
+	if (config.auth_no_challenge)
+		job.challenges = config.default_challenges;
+
+	job.queue_memory = _job_memory(&job);
+	memory_account(MEMORY_QUEUE, job.queue_memory - (long long) sizeof(QUEUED_JOB));
+
+	if (host->pending_first == host->pending_last)
+		_pending_jobs_free(host);
+
+	jobp = wget_list_append(&host->queue, &job, sizeof(JOB));
+
+	debug_printf("%s: %p %s\n", __func__, (void *)jobp, jobp->iri->uri);
+
+	return jobp;
+}
+
 static int _search_queue_for_free_job(struct _find_free_job_context *ctx, JOB *job)
 {
 	if (job->parts) {
@@ -155,6 +309,7 @@ static int _search_queue_for_free_job(struct _find_free_job_context *ctx, JOB *j
 			if (!part->inuse) {
 				part->inuse = 1;
 				part->used_by = wget_thread_self();
+				_claim_ranges(job, it, part);
 				job->part = part;
 				ctx->job = job;
 				debug_printf("dequeue chunk %d/%d %s\n", it + 1, wget_vector_size(job->parts), job->metalink->name);
@@ -204,9 +359,15 @@ static int G_GNUC_WGET_NONNULL_ALL _search_host_for_free_job(struct _find_free_j
 		return 0; // someone is still working on robots.txt
 	}
 
-	// find next job to do
+	// find next job to do, jobs to be retried come first
 	wget_list_browse(host->queue, (wget_list_browse_t *) _search_queue_for_free_job, ctx);
 
+	if (!ctx->job && host->pending_first < host->pending_last) {
+		JOB *job = _materialize_job(host, &host->pending[host->pending_first++]);
+
+		_search_queue_for_free_job(ctx, job);
+	}
+
 	return !!ctx->job; // 1=found a job, 0=no free job
 }
 
@@ -223,7 +384,7 @@ static int G_GNUC_WGET_NONNULL_ALL _search_host_for_free_job(struct _find_free_j
  */
 JOB *host_get_job(HOST *host, long long *pause)
 {
-	struct _find_free_job_context ctx = { .now = wget_get_timemillis() };
+	struct _find_free_job_context ctx = { .now = wget_get_coarse_millis() };
 
 	if (host) {
 		_search_host_for_free_job(&ctx, host);
@@ -291,6 +452,8 @@ void host_release_jobs(HOST *host)
  * This function creates a shallow copy of \p job and appends
  * it to the host's job queue. This means for the caller that
  * he cares for free'ing \p job without free'ing any pointers within.
+ *
+ * Simple jobs are stored as compact QUEUED_JOB, see _job_is_compact().
  */
 void host_add_job(HOST *host, const JOB *job)
 {
@@ -300,17 +463,24 @@ void host_add_job(HOST *host, const JOB *job)
 
 	wget_thread_mutex_lock(hosts_mutex);
 
-	jobp = wget_list_append(&host->queue, job, sizeof(JOB));
 	host->qsize++;
 	if (!host->blocked)
 		qsize++;
 
-	jobp->host = host;
-
-	if (jobp->iri)
-		debug_printf("%s: %p %s\n", __func__, (void *)jobp, jobp->iri->uri);
-	else if (jobp->metalink)
-		debug_printf("%s: %p %s\n", __func__, (void *)jobp, jobp->metalink->name);
+	if (_job_is_compact(job)) {
+		_add_pending_job(host, job);
+		debug_printf("%s: pending %s\n", __func__, job->iri->uri);
+	} else {
+		jobp = wget_list_append(&host->queue, job, sizeof(JOB));
+		jobp->host = host;
+		jobp->queue_memory = _job_memory(jobp);
+		memory_account(MEMORY_QUEUE, jobp->queue_memory);
+
+		if (jobp->iri)
+			debug_printf("%s: %p %s\n", __func__, (void *)jobp, jobp->iri->uri);
+		else if (jobp->metalink)
+			debug_printf("%s: %p %s\n", __func__, (void *)jobp, jobp->metalink->name);
+	}
 
 	debug_printf("%s: qsize %d host-qsize=%d\n", __func__, qsize, host->qsize);
 
@@ -332,6 +502,8 @@ void host_add_robotstxt_job(HOST *host, wget_iri *iri, bool http_fallback)
 	job->host = host;
 	job->robotstxt = 1;
 	job->local_filename = get_local_filename(job->iri);
+	job->queue_memory = _job_memory(job);
+	memory_account(MEMORY_QUEUE, job->queue_memory);
 
 	wget_thread_mutex_lock(hosts_mutex);
 	host->robot_job = job;
@@ -345,10 +517,26 @@ void host_add_robotstxt_job(HOST *host, wget_iri *iri, bool http_fallback)
 	wget_thread_mutex_unlock(hosts_mutex);
 }
 
+static bool _disallowed_by_robots(HOST *host, const wget_iri *iri)
+{
+	for (int it = 0, n = wget_robots_get_path_count(host->robots); it < n; it++) {
+		wget_string *path = wget_robots_get_path(host->robots, it);
+
+		if (path->len && !strncmp(path->p + 1, iri->path ? iri->path : "", path->len - 1)) {
+			info_printf(_("URL '%s' not followed (disallowed by robots.txt)\n"), iri->uri);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
 static void _host_remove_job(HOST *host, JOB *job)
 {
 	debug_printf("%s: %p\n", __func__, (void *)job);
 
+	memory_account(MEMORY_QUEUE, -job->queue_memory);
+
 	if (job == host->robot_job) {
 		// Special handling for automatic robots.txt jobs
 		// ==============================================
@@ -359,9 +547,24 @@ static void _host_remove_job(HOST *host, JOB *job)
 		// If any of these links that are disallowed have been explicitly requested by the user,
 		// we still should download them. This holds true for sitemaps as well.
 		if (host->robots) {
+			int kept = host->pending_first;
+
+			for (int it = host->pending_first; it < host->pending_last; it++) {
+				QUEUED_JOB *queued = &host->pending[it];
+
+				if (!queued->requested_by_user && !queued->sitemap && _disallowed_by_robots(host, queued->iri)) {
+					memory_account(MEMORY_QUEUE, -(long long) sizeof(QUEUED_JOB));
+					host->qsize--;
+					if (!host->blocked)
+						qsize--;
+				} else
+					host->pending[kept++] = *queued;
+			}
+			host->pending_last = kept;
+
 			JOB *next, *thejob = wget_list_getfirst(host->queue);
 
-			for (int max = host->qsize - 1; max > 0; max--, thejob = next) {
+			for (int max = host->qsize - 1 - (host->pending_last - host->pending_first); max > 0; max--, thejob = next) {
 				next = wget_list_getnext(thejob);
 
 				if (thejob->requested_by_user)
@@ -370,14 +573,10 @@ static void _host_remove_job(HOST *host, JOB *job)
 				if (thejob->sitemap)
 						continue;
 
-				for (int it = 0, n = wget_robots_get_path_count(host->robots); it < n; it++) {
-					wget_string *path = wget_robots_get_path(host->robots, it);
-
-					if (path->len && !strncmp(path->p + 1, thejob->iri->path ? thejob->iri->path : "", path->len - 1)) {
-						info_printf(_("URL '%s' not followed (disallowed by robots.txt)\n"), thejob->iri->uri);
-						_host_remove_job(host, thejob);
-						break;
-					}
+				if (_disallowed_by_robots(host, thejob->iri)) {
+					if (thejob->batch)
+						daemon_batch_job_done(thejob->batch, 0, thejob->iri->uri);
+					_host_remove_job(host, thejob);
 				}
 			}
 		}
@@ -419,7 +618,7 @@ void host_increase_failure(HOST *host)
 {
 	wget_thread_mutex_lock(hosts_mutex);
 	host->failures++;
-	host->retry_ts = wget_get_timemillis() + host->failures * 1000;
+	host->retry_ts = wget_get_coarse_millis() + host->failures * 1000;
 	debug_printf("%s: %s failures=%d\n", __func__, host->host, host->failures);
 
 	if (config.tries && host->failures >= config.tries) {
@@ -456,6 +655,124 @@ void host_reset_failure(HOST *host)
 	wget_thread_mutex_unlock(hosts_mutex);
 }
 
+static int _host_unblock(void *ctx G_GNUC_WGET_UNUSED, HOST *host)
+{
+	host->failures = 0;
+	host->retry_ts = 0;
+	if (host->blocked) {
+		host->blocked = 0;
+		qsize += host->qsize;
+	}
+
+	return 0;
+}
+
+/**
+ * Reset the failure state of all hosts, e.g. when the daemon starts a new batch.
+ */
+void hosts_unblock(void)
+{
+	wget_thread_mutex_lock(hosts_mutex);
+	wget_hashmap_browse(hosts, (wget_hashmap_browse_t *) _host_unblock, NULL);
+	debug_printf("%s: qsize=%d\n", __func__, qsize);
+	wget_thread_mutex_unlock(hosts_mutex);
+}
+
+static int _collect_batch_job(wget_vector *jobs, JOB *job)
+{
+	if (job->batch && !job->inuse)
+		wget_vector_add(jobs, job);
+
+	return 0;
+}
+
+static int _remove_blocked_batch_jobs(void *ctx G_GNUC_WGET_UNUSED, HOST *host)
+{
+	if (host->blocked && host->queue) {
+		wget_vector *jobs = wget_vector_create(8, NULL);
+
+		wget_list_browse(host->queue, (wget_list_browse_t *) _collect_batch_job, jobs);
+
+		for (int it = 0; it < wget_vector_size(jobs); it++) {
+			JOB *job = wget_vector_get(jobs, it);
+
+			daemon_batch_job_done(job->batch, 0, job->iri->uri);
+			_host_remove_job(host, job);
+		}
+
+		wget_vector_clear_nofree(jobs);
+		wget_vector_free(&jobs);
+	}
+
+	return 0;
+}
+
+/**
+ * Remove the jobs of daemon batches from blocked hosts and report them as failed.
+ *
+ * Called when nothing else can be downloaded, else these batches would never finish.
+ */
+void host_remove_blocked_batch_jobs(void)
+{
+	wget_thread_mutex_lock(hosts_mutex);
+	wget_hashmap_browse(hosts, (wget_hashmap_browse_t *) _remove_blocked_batch_jobs, NULL);
+	wget_thread_mutex_unlock(hosts_mutex);
+}
+
+void host_connect_sample(HOST *host, long long ms)
+{
+	wget_thread_mutex_lock(hosts_mutex);
+	rtt_update(&host->connect_srtt, &host->connect_rttvar, &host->connect_samples, ms);
+	wget_thread_mutex_unlock(hosts_mutex);
+}
+
+void host_response_sample(HOST *host, long long ms)
+{
+	wget_thread_mutex_lock(hosts_mutex);
+	rtt_update(&host->response_srtt, &host->response_rttvar, &host->response_samples, ms);
+	wget_thread_mutex_unlock(hosts_mutex);
+}
+
+void host_throughput_sample(HOST *host, long long bytes, long long ms)
+{
+	// small bodies say more about the latency than about the bandwidth
+	if (bytes < ADAPTIVE_WINDOW || ms <= 0)
+		return;
+
+	long long rate = bytes * 1000 / ms;
+
+	wget_thread_mutex_lock(hosts_mutex);
+	if (host->throughput)
+		host->throughput += (rate - host->throughput) / 8;
+	else
+		host->throughput = rate;
+	wget_thread_mutex_unlock(hosts_mutex);
+}
+
+int host_connect_timeout(HOST *host)
+{
+	int timeout;
+
+	wget_thread_mutex_lock(hosts_mutex);
+	timeout = rtt_timeout(host->connect_srtt, host->connect_rttvar, host->connect_samples, host->failures, 0, config.connect_timeout);
+	wget_thread_mutex_unlock(hosts_mutex);
+
+	return timeout;
+}
+
+int host_read_timeout(HOST *host)
+{
+	int timeout;
+
+	wget_thread_mutex_lock(hosts_mutex);
+	// on slow links, allow for the time to receive a full TCP window
+	timeout = rtt_timeout(host->response_srtt, host->response_rttvar, host->response_samples, host->failures,
+		host->throughput > 0 ? ADAPTIVE_WINDOW * 1000LL / host->throughput : 0, config.read_timeout);
+	wget_thread_mutex_unlock(hosts_mutex);
+
+	return timeout;
+}
+
 /**
  * @return Whether the job queue is empty or not.
  */
@@ -469,6 +786,7 @@ int queue_empty(void)
 
 static int _queue_free_func(void *context G_GNUC_WGET_UNUSED, JOB *job)
 {
+	memory_account(MEMORY_QUEUE, -job->queue_memory);
 	job_free(job);
 	return 0;
 }
@@ -478,7 +796,9 @@ void host_queue_free(HOST *host)
 	wget_thread_mutex_lock(hosts_mutex);
 	wget_list_browse(host->queue, (wget_list_browse_t *) _queue_free_func, NULL);
 	wget_list_free(&host->queue);
+	_pending_jobs_free(host);
 	if (host->robot_job) {
+		memory_account(MEMORY_QUEUE, -host->robot_job->queue_memory);
 		job_free(host->robot_job);
 		xfree(host->robot_job);
 	}
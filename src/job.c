@@ -49,6 +49,9 @@ void job_free(JOB *job)
 	wget_vector_free(&job->parts);
 	wget_list_free(&job->remaining_sig_ext);
 	xfree(job->sig_req);
+	xfree(job->if_range);
+	xfree(job->zsync_target);
+	xfree(job->archive_name);
 	xfree(job->local_filename);
 	xfree(job->sig_filename);
 }
@@ -277,6 +280,47 @@ int job_validate_file(JOB *job)
 	return 0;
 }
 
+// Documents whose links feed the crawl should not wait behind large files
+// on a shared HTTP/2 connection. Returns the RFC 9218 urgency for a job.
+int job_urgency(const JOB *job, bool *incremental)
+{
+	static const char *doc_ext[] = { "html", "htm", "xhtml", "shtml", "css", "xml", "php", "asp", "aspx", "jsp" };
+	const char *path = job->iri->path, *name, *ext;
+
+	*incremental = 0;
+
+	if (job->robotstxt)
+		return 0;
+
+	if (job->sitemap)
+		return 1;
+
+	if (job->part) {
+		// chunks of large files can share the bandwidth
+		*incremental = 1;
+		return 5;
+	}
+
+	// directory indexes and extension-less paths are most likely documents
+	if (!path)
+		return 1;
+
+	if ((name = strrchr(path, '/')))
+		name++;
+	else
+		name = path;
+
+	if (!*name || !(ext = strrchr(name, '.')))
+		return 1;
+
+	for (unsigned it = 0; it < countof(doc_ext); it++) {
+		if (!wget_strcasecmp_ascii(ext + 1, doc_ext[it]))
+			return 1;
+	}
+
+	return job->requisite ? 2 : 3;
+}
+
 JOB *job_init(JOB *job, wget_iri *iri, bool http_fallback)
 {
 	static unsigned long long jobid;
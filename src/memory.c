@@ -0,0 +1,126 @@
+/*
+ * Copyright(c) 2019 Free Software Foundation, Inc.
+ *
+ * This file is part of Wget.
+ *
+ * Wget is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Wget is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Wget.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *
+ * Memory accounting (--max-memory)
+ *
+ * The data structures that grow with the size of a crawl report their
+ * (estimated) allocations here. When the sum comes near the budget, the
+ * downloaders apply backpressure: they stop taking new jobs until the
+ * in-flight responses are processed, and bodies that are also written to
+ * a file are no longer buffered in memory.
+ */
+
+#include <config.h>
+
+#include <wget.h>
+
+#include "wget_main.h"
+#include "wget_options.h"
+#include "wget_memory.h"
+
+// backpressure starts at this percentage of the budget
+#define MEMORY_HIGH_WATER 90
+
+static const char *category_names[MEMORY_CATEGORIES] = {
+	[MEMORY_BODY] = "bodies",
+	[MEMORY_CONNECTION] = "connections",
+	[MEMORY_CONVERSION] = "conversions",
+	[MEMORY_QUEUE] = "queue",
+	[MEMORY_BLACKLIST] = "blacklist",
+};
+
+static long long
+	used[MEMORY_CATEGORIES],
+	peak[MEMORY_CATEGORIES],
+	total,
+	total_peak;
+static bool
+	pressure;
+static wget_thread_mutex
+	mutex;
+
+void memory_init(void)
+{
+	wget_thread_mutex_init(&mutex);
+}
+
+void memory_exit(void)
+{
+	wget_thread_mutex_destroy(&mutex);
+}
+
+/**
+ * \param[in] category One of the MEMORY_* categories
+ * \param[in] bytes Number of bytes allocated, negative if released
+ *
+ * Account an allocation (or release) of a category.
+ */
+void memory_account(int category, long long bytes)
+{
+	if (!bytes)
+		return;
+
+	wget_thread_mutex_lock(mutex);
+
+	used[category] += bytes;
+	if (used[category] > peak[category])
+		peak[category] = used[category];
+
+	total += bytes;
+	if (total > total_peak)
+		total_peak = total;
+
+	if (config.max_memory) {
+		bool over = total >= config.max_memory / 100 * MEMORY_HIGH_WATER;
+
+		if (over != pressure) {
+			pressure = over;
+			debug_printf("memory %s: %lld bytes in use\n", over ? "pressure" : "relieved", total);
+		}
+	}
+
+	wget_thread_mutex_unlock(mutex);
+}
+
+/**
+ * \return Whether the memory in use is near the budget given by --max-memory
+ */
+bool memory_pressure(void)
+{
+	bool ret;
+
+	wget_thread_mutex_lock(mutex);
+	ret = pressure;
+	wget_thread_mutex_unlock(mutex);
+
+	return ret;
+}
+
+void memory_print(void)
+{
+	char buf[16];
+
+	if (!config.max_memory)
+		return;
+
+	info_printf(_("Memory peak: %s\n"), wget_human_readable(buf, sizeof(buf), total_peak));
+
+	for (int it = 0; it < MEMORY_CATEGORIES; it++)
+		info_printf("  %-12s %s\n", category_names[it], wget_human_readable(buf, sizeof(buf), peak[it]));
+}
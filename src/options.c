@@ -57,6 +57,11 @@
 #include "wget_options.h"
 #include "wget_dl.h"
 #include "wget_plugin.h"
+#include "wget_canon.h"
+#include "wget_dictionary.h"
+#include "wget_archive.h"
+#include "wget_redirect.h"
+#include "wget_robots_cache.h"
 #include "wget_stats.h"
 #include "wget_testing.h"
 #include "wget_utils.h"
@@ -975,6 +980,24 @@ static int parse_report_speed_type(option_t opt, const char *val, G_GNUC_WGET_UN
 	return 0;
 }
 
+static int parse_archive_format(option_t opt, const char *val, G_GNUC_WGET_UNUSED const char invert)
+{
+	if (!wget_strcasecmp_ascii(val, "tar"))
+		*((char *)opt->var) = ARCHIVE_FORMAT_TAR;
+	else if (!wget_strcasecmp_ascii(val, "cpio"))
+		*((char *)opt->var) = ARCHIVE_FORMAT_CPIO;
+	else if (!val[0]) {
+		error_printf(_("Missing required type specifier\n"));
+		return -1;
+	}
+	else {
+		error_printf(_("Invalid type specifier: %s\n"), val);
+		return -1;
+	}
+
+	return 0;
+}
+
 static int parse_https_enforce(option_t opt, const char *val, G_GNUC_WGET_UNUSED const char invert)
 {
 	if (!wget_strcasecmp_ascii(val, "hard"))
@@ -1062,6 +1085,12 @@ static int parse_compression(option_t opt, const char *val, const char invert)
 				return -1;
 			}
 
+			if (type == wget_content_encoding_dcb || type == wget_content_encoding_dcz) {
+				// only valid together with Available-Dictionary
+				wget_error_printf(_("Compression type %s is negotiated by --dictionary-dir\n"), wget_content_encoding_to_name(type));
+				return -1;
+			}
+
 #ifndef WITH_ZLIB
 			if (type == wget_content_encoding_gzip || type == wget_content_encoding_deflate)
 				not_built = 1;
@@ -1140,8 +1169,11 @@ struct config config = {
 	.connect_timeout = -1,
 	.dns_timeout = -1,
 	.read_timeout = 900 * 1000, // 900s
+	.max_ranges = 16,
 	.max_redirect = 20,
+	.redirect_cache_maxage = 30 * 24 * 3600, // 30 days
 	.max_threads = 5,
+	.partitions = 1,
 	.dns_caching = 1,
 	.tcp_fastopen = 1,
 	.user_agent = PACKAGE_NAME"/"PACKAGE_VERSION,
@@ -1172,6 +1204,7 @@ struct config config = {
 #if defined WITH_LIBNGHTTP2
 	.http2 = 1,
 	.http2_request_window = 30,
+	.http2_priority = 1,
 #endif
 	.ocsp = 1,
 	.ocsp_date = 1,
@@ -1212,6 +1245,12 @@ static const struct optionw options[] = {
 		{ "Regex matching accepted URLs.\n"
 		}
 	},
+	{ "adaptive-timeout", &config.adaptive_timeout, parse_bool, -1, 0,
+		SECTION_DOWNLOAD,
+		{ "Derive connect and read timeouts from the\n",
+		  "response times of each host. (default: off)\n"
+		}
+	},
 	{ "adjust-extension", &config.adjust_extension, parse_bool, -1, 'E',
 		SECTION_HTTP,
 		{ "Append extension to saved file (.html or .css).\n",
@@ -1223,6 +1262,18 @@ static const struct optionw options[] = {
 		{ "File where messages are appended to, '-' for STDOUT\n"
 		}
 	},
+	{ "archive", &config.archive, parse_filename, 1, 0,
+		SECTION_DOWNLOAD,
+		{ "Write all downloaded files into this archive\n",
+		  "instead of the file system.\n"
+		}
+	},
+	{ "archive-format", &config.archive_format, parse_archive_format, 1, 0,
+		SECTION_DOWNLOAD,
+		{ "Format of the --archive file: tar or cpio.\n",
+		  "(default: tar)\n"
+		}
+	},
 	{ "ask-password", &config.askpass, parse_bool, -1, 0,
 		SECTION_DOWNLOAD,
 		{ "Print prompt for password\n"
@@ -1266,11 +1317,30 @@ static const struct optionw options[] = {
 		{ "Directory with PEM CA certificates.\n"
 		}
 	},
+	{ "ca-snapshot", &config.ca_snapshot, parse_filename, 1, 0,
+		SECTION_SSL,
+		{ "File to keep a deduplicated copy of the CA\n",
+		  "certificates for faster startup. Only used with\n",
+		  "a custom --ca-directory. (default: none)\n"
+		}
+	},
+	{ "ca-snapshot-restrict", &config.ca_snapshot_restrict, parse_bool, -1, 0,
+		SECTION_SSL,
+		{ "Load only CAs from the snapshot that verified\n",
+		  "a server before. (default: off)\n"
+		}
+	},
 	{ "cache", &config.cache, parse_bool, -1, 0,
 		SECTION_DOWNLOAD,
 		{ "Enabled using of server cache. (default: on)\n"
 		}
 	},
+	{ "canonicalize-rules", &config.canonicalize_rules, parse_filename, 1, 0,
+		SECTION_DOWNLOAD,
+		{ "File with rules to map equivalent URLs\n",
+		  "to one canonical URL.\n"
+		}
+	},
 	{ "certificate", &config.cert_file, parse_string, 1, 0,
 		SECTION_SSL,
 		{ "File with client certificate.\n"
@@ -1380,6 +1450,18 @@ static const struct optionw options[] = {
 		{ "Cut HTTP GET vars from URLs. (default: off)\n"
 		}
 	},
+	{ "daemon", &config.daemon, parse_filename, 1, 0,
+		SECTION_STARTUP,
+		{ "Run as daemon, accepting batches of URLs\n",
+		  "on the given UNIX domain socket.\n"
+		}
+	},
+	{ "daemon-submit", &config.daemon_submit, parse_filename, 1, 0,
+		SECTION_STARTUP,
+		{ "Send URLs to a daemon listening on the given\n",
+		  "UNIX domain socket and print the results.\n"
+		}
+	},
 	{ "debug", &config.debug, parse_bool, -1, 'd',
 		SECTION_STARTUP,
 		{ "Print debugging messages.(default: off)\n"
@@ -1405,6 +1487,14 @@ static const struct optionw options[] = {
 		{ "Don't save downloaded files. (default: off)\n"
 		}
 	},
+	{ "dictionary-dir", &config.dictionary_dir, parse_filename, 1, 0,
+		SECTION_HTTP,
+		{ "Directory to keep compression dictionaries in.\n",
+		  "Files sent with 'Use-As-Dictionary' are stored there\n",
+		  "and offered for matching requests to receive\n",
+		  "'dcb' / 'dcz' compressed deltas. (default: off)\n"
+		}
+	},
 	{ "directories", &config.directories, parse_bool, -1, 0,
 		SECTION_DIRECTORY,
 		{ "Create hierarchy of directories when retrieving\n",
@@ -1642,6 +1732,12 @@ static const struct optionw options[] = {
 		{ "Only use HTTP/2 protocol, error if server doesn't offer it. (default: off)\n"
 		}
 	},
+	{ "http2-priority", &config.http2_priority, parse_bool, -1, 0,
+		SECTION_DOWNLOAD,
+		{ "Prioritize HTTP/2 streams of documents over\n",
+		  "large files. (default: on)\n"
+		}
+	},
 	{ "http2-request-window", &config.http2_request_window, parse_integer, 1, 0,
 		SECTION_DOWNLOAD,
 		{ "Max. number of parallel streams per HTTP/2\n",
@@ -1757,6 +1853,18 @@ static const struct optionw options[] = {
 		{ "Loads a plugin with a given path.\n"
 		}
 	},
+	{ "max-memory", &config.max_memory, parse_numbytes, 1, 0,
+		SECTION_DOWNLOAD,
+		{ "Memory budget for buffers and queues, 0 = no limit.\n",
+		  "(default: 0)\n"
+		}
+	},
+	{ "max-ranges", &config.max_ranges, parse_integer, 1, 0,
+		SECTION_DOWNLOAD,
+		{ "Max. number of byte ranges combined into one request\n",
+		  "when repairing or updating parts of a file. (default: 16)\n"
+		}
+	},
 	{ "max-redirect", &config.max_redirect, parse_integer, 1, 0,
 		SECTION_DOWNLOAD,
 		{ "Max. number of redirections to follow.\n",
@@ -1856,6 +1964,13 @@ static const struct optionw options[] = {
 		{ "Ascend above parent directory. (default: on)\n"
 		}
 	},
+	{ "partitions", &config.partitions, parse_integer, 1, 0,
+		SECTION_DOWNLOAD,
+		{ "Split a recursive download across the given\n",
+		  "number of processes, partitioned by domain.\n",
+		  "(default: 1)\n"
+		}
+	},
 	{ "password", &config.password, parse_string, 1, 0,
 		SECTION_DOWNLOAD,
 		{ "Password for Authentication.\n",
@@ -1961,6 +2076,23 @@ static const struct optionw options[] = {
 		{ "Recursive download. (default: off)\n"
 		}
 	},
+	{ "redirect-cache", &config.redirect_cache, parse_bool, -1, 0,
+		SECTION_HTTP,
+		{ "Remember permanent redirections (301, 308)\n",
+		  "and request the target directly. (default: off)\n"
+		}
+	},
+	{ "redirect-cache-file", &config.redirect_cache_file, parse_filename, 1, 0,
+		SECTION_HTTP,
+		{ "Set file for redirect caching. (default: none)\n"
+		}
+	},
+	{ "redirect-cache-maxage", &config.redirect_cache_maxage, parse_integer, 1, 0,
+		SECTION_HTTP,
+		{ "Max. age of cached redirections in seconds,\n",
+		  "0 = forever. (default: 2592000 = 30 days)\n"
+		}
+	},
 	{ "referer", &config.referer, parse_string, 1, 0,
 		SECTION_HTTP,
 		{ "Include Referer: url in HTTP request.\n",
@@ -2024,6 +2156,12 @@ static const struct optionw options[] = {
 		  "downloads. (default: on)\n"
 		}
 	},
+	{ "robots-cache-file", &config.robots_cache_file, parse_filename, 1, 0,
+		SECTION_DOWNLOAD,
+		{ "Set file for caching robots.txt rules.\n",
+		  "(default: none)\n"
+		}
+	},
 	{ "save-content-on", &config.save_content_on, parse_stringlist, 1, 0,
 		SECTION_DOWNLOAD,
 		{ "Specify a list of response codes that requires it's\n",
@@ -2086,6 +2224,13 @@ static const struct optionw options[] = {
 		  "--stats-ocsp=[FORMAT:]FILE\n"
 		}
 	},
+	{ "stats-redirect", &config.stats_redirect_args, parse_stats, 1, 0,
+		SECTION_STARTUP,
+		{ "Print redirect cache stats. (default: off)\n",
+		  "Additional format supported:\n",
+		  "--stats-redirect=[FORMAT:]FILE\n"
+		}
+	},
 	{ "stats-server", &config.stats_server_args, parse_stats, 1, 0,
 		SECTION_STARTUP,
 		{ "Print server stats. (default: off)\n",
@@ -2145,6 +2290,36 @@ static const struct optionw options[] = {
 		  "(default: ~/.wget-session)\n"
 		}
 	},
+	{ "trap-dir-budget", &config.trap_dir_budget, parse_integer, 1, 0,
+		SECTION_DOWNLOAD,
+		{ "Max. number of URLs followed per directory\n",
+		  "when downloading recursively. (default: 0 = no limit)\n"
+		}
+	},
+	{ "trap-fingerprint", &config.trap_fingerprint, parse_bool, -1, 0,
+		SECTION_DOWNLOAD,
+		{ "Don't follow links of pages with the same content\n",
+		  "as an earlier page. (default: off)\n"
+		}
+	},
+	{ "trap-host-budget", &config.trap_host_budget, parse_integer, 1, 0,
+		SECTION_DOWNLOAD,
+		{ "Max. number of URLs followed per host\n",
+		  "when downloading recursively. (default: 0 = no limit)\n"
+		}
+	},
+	{ "trap-path-repeat", &config.trap_path_repeat, parse_integer, 1, 0,
+		SECTION_DOWNLOAD,
+		{ "Max. occurrences of the same path segment\n",
+		  "in followed URLs, e.g. /a/b/a/b/. (default: 0 = no limit)\n"
+		}
+	},
+	{ "trap-query-values", &config.trap_query_values, parse_integer, 1, 0,
+		SECTION_DOWNLOAD,
+		{ "Max. number of different values of each query\n",
+		  "parameter per path. (default: 0 = no limit)\n"
+		}
+	},
 	{ "tries", &config.tries, parse_integer, 1, 't',
 		SECTION_DOWNLOAD,
 		{ "Number of tries for each download. (default 20)\n"
@@ -2224,6 +2399,13 @@ static const struct optionw options[] = {
 		SECTION_DOWNLOAD,
 		{ "Save extended file attributes. (default: off)\n"\
 		}
+	},
+	{ "zsync", &config.zsync, parse_bool, -1, 0,
+		SECTION_DOWNLOAD,
+		{ "Use downloaded .zsync control files to update\n",
+		  "the target file, fetching only changed blocks.\n",
+		  "(default: off)\n"
+		}
 	}
 };
 
@@ -3289,6 +3471,22 @@ int init(int argc, const char **argv)
 	if (config.max_threads < 1 || (config.max_threads > 1 && config.chunk_size))
 		config.max_threads = 1;
 
+	if (config.archive && (config.output_document || config.spider)) {
+		error_printf(_("--archive can't be used with --output-document or --spider\n"));
+		return -1;
+	}
+
+	if (config.partitions < 1)
+		config.partitions = 1;
+	else if (config.partitions > 1) {
+		if (config.daemon || config.output_document || !wget_strcmp(config.input_file, "-")) {
+			error_printf(_("--partitions can't be used with --daemon, --output-document or input from STDIN\n"));
+			return -1;
+		}
+
+		config.progress = 0; // each process would draw its own progress bar
+	}
+
 	// truncate output document
 	if (config.output_document && strcmp(config.output_document,"-") && !config.dont_write) {
 		int fd = open(config.output_document, O_WRONLY | O_TRUNC | O_BINARY);
@@ -3348,6 +3546,18 @@ int init(int argc, const char **argv)
 		wget_hsts_db_load(config.hsts_db);
 	}
 
+	if (config.redirect_cache && config.redirect_cache_file)
+		redirect_cache_load(config.redirect_cache_file);
+
+	if (config.robots && config.robots_cache_file)
+		robots_cache_load(config.robots_cache_file);
+
+	if (config.canonicalize_rules && canon_load(config.canonicalize_rules))
+		return -1;
+
+	if (config.dictionary_dir && dictionary_load(config.dictionary_dir))
+		return -1;
+
 #ifdef WITH_LIBHSTS
 	if (config.hsts_preload && config.hsts_preload_file) {
 		if ((rc = hsts_load_file(config.hsts_preload_file, &config.hsts_preload_data))) {
@@ -3508,6 +3718,16 @@ int init(int argc, const char **argv)
 		wget_server_set_stats_callback(stats_callback_server, config.stats_server_args->fp);
 	}
 
+	if (config.stats_redirect_args) {
+		config.stats_redirect_args->fp =
+			config.stats_redirect_args->filename && *config.stats_redirect_args->filename && strcmp(config.stats_redirect_args->filename, "-")
+			&& !config.dont_write ? fopen(config.stats_redirect_args->filename, "w") : stdout;
+		if (!config.stats_redirect_args->fp) {
+			wget_error_printf(_("Failed to open '%s' (%d)"), config.stats_redirect_args->filename, rc);
+			return -1;
+		}
+	}
+
 	if (config.stats_site_args) {
 		config.stats_site_args->fp =
 			config.stats_site_args->filename && *config.stats_site_args->filename && strcmp(config.stats_site_args->filename, "-")
@@ -3548,6 +3768,10 @@ int init(int argc, const char **argv)
 	wget_ssl_set_config_string(WGET_SSL_OCSP_SERVER, config.ocsp_server);
 	wget_ssl_set_config_string(WGET_SSL_SECURE_PROTOCOL, config.secure_protocol);
 	wget_ssl_set_config_string(WGET_SSL_CA_DIRECTORY, config.ca_directory);
+	if (config.ca_snapshot) {
+		wget_ssl_set_config_string(WGET_SSL_CA_SNAPSHOT, config.ca_snapshot);
+		wget_ssl_set_config_int(WGET_SSL_CA_SNAPSHOT_RESTRICT, config.ca_snapshot_restrict);
+	}
 	wget_ssl_set_config_string(WGET_SSL_CA_FILE, config.ca_cert);
 	wget_ssl_set_config_string(WGET_SSL_CERT_FILE, config.cert_file);
 	wget_ssl_set_config_string(WGET_SSL_KEY_FILE, config.private_key);
@@ -3630,6 +3854,7 @@ void deinit(void)
 	xfree(config.bind_address);
 	xfree(config.ca_cert);
 	xfree(config.ca_directory);
+	xfree(config.ca_snapshot);
 	xfree(config.cert_file);
 	xfree(config.cookie_suffixes);
 	xfree(config.crl_file);
@@ -3637,6 +3862,13 @@ void deinit(void)
 	xfree(config.directory_prefix);
 	xfree(config.egd_file);
 	xfree(config.hsts_file);
+	xfree(config.redirect_cache_file);
+	xfree(config.robots_cache_file);
+	xfree(config.canonicalize_rules);
+	xfree(config.dictionary_dir);
+	xfree(config.archive);
+	xfree(config.daemon);
+	xfree(config.daemon_submit);
 	xfree(config.hpkp_file);
 	xfree(config.http_password);
 	xfree(config.http_proxy);
@@ -3688,6 +3920,13 @@ void deinit(void)
 		xfree(config.stats_ocsp_args);
 	}
 
+	if (config.stats_redirect_args) {
+		if (config.stats_redirect_args->fp && config.stats_redirect_args->fp != stdout)
+			fclose(config.stats_redirect_args->fp);
+		xfree(config.stats_redirect_args->filename);
+		xfree(config.stats_redirect_args);
+	}
+
 	if (config.stats_server_args) {
 		if (config.stats_server_args->fp && config.stats_server_args->fp != stdout)
 			fclose(config.stats_server_args->fp);
@@ -0,0 +1,523 @@
+/*
+ * Copyright(c) 2019 Free Software Foundation, Inc.
+ *
+ * This file is part of Wget.
+ *
+ * Wget is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Wget is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Wget.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *
+ * Partitioned multi-process crawling
+ *
+ * The crawl is split across N worker processes. Each host belongs to exactly one
+ * process, selected by a hash of its registrable domain, so every
+ * process has its own frontier, blacklist, connections and politeness state.
+ * URLs found for a host owned by another process are forwarded through a pipe,
+ * one line per URL:
+ *   <level> <flags> <referer URL or -> <URL>   (absolute UTF-8 URLs, spaces escaped as %20)
+ *
+ * Each process counts the messages it sent and received in a shared memory
+ * segment and marks itself idle when its queue is empty. The crawl is finished
+ * when all processes are idle and no message is in flight.
+ *
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <unistd.h>
+#ifndef _WIN32
+#  include <sys/mman.h>
+#  include <sys/wait.h>
+#endif
+
+#include <wget.h>
+
+#include "safe-write.h"
+
+#include "wget_main.h"
+#include "wget_options.h"
+#include "wget_partition.h"
+
+#ifndef PIPE_BUF
+#  define PIPE_BUF 512 // minimum required by POSIX
+#endif
+
+// per-process data, shared by all processes
+typedef struct {
+	PARTITION_STATS
+		stats;
+	int
+		sent, // number of URLs forwarded to other processes
+		received, // number of URLs received from other processes
+		idle; // queue is empty
+} _partition_t;
+
+#ifndef _WIN32
+
+static _partition_t
+	*partitions;
+
+static int
+	npartitions,
+	self,
+	read_fd = -1,
+	*write_fds,
+	*aborted; // shared: stop all processes
+
+static pid_t
+	*pids;
+
+static partition_add_url_t
+	*add_url_func;
+
+static wget_thread_mutex
+	mutex,
+	counter_mutex;
+
+static wget_thread
+	reader_tid;
+
+static volatile int
+	stopping;
+
+// values in shared memory are changed by one process only, but read by all
+static int _load(int *p)
+{
+#ifdef WITH_SYNC_FETCH_AND_ADD
+	return __sync_fetch_and_add(p, 0);
+#else
+	return *(volatile int *) p;
+#endif
+}
+
+static void _store(int *p, int value)
+{
+#ifdef WITH_SYNC_FETCH_AND_ADD
+	__sync_lock_test_and_set(p, value);
+	__sync_synchronize();
+#else
+	*(volatile int *) p = value;
+#endif
+}
+
+static void _add(int *p, int n)
+{
+#ifdef WITH_SYNC_FETCH_AND_ADD
+	__sync_fetch_and_add(p, n);
+#else
+	wget_thread_mutex_lock(counter_mutex);
+	*(volatile int *) p += n;
+	wget_thread_mutex_unlock(counter_mutex);
+#endif
+}
+
+static void _process_line(char *line)
+{
+	char *referer, *url, *end;
+	int level, flags = 0;
+
+	level = (int) strtol(line, &end, 10);
+	if (*end == ' ')
+		flags = (int) strtol(end + 1, &end, 10);
+
+	if (*end != ' ' || !(url = strchr(referer = end + 1, ' '))) {
+		error_printf(_("Failed to parse partition message '%s'\n"), line);
+		return;
+	}
+	*url++ = 0;
+
+	debug_printf("partition %d: received %s\n", self, url);
+
+	// the idle flag has to be cleared before the URL is counted as received,
+	// else the other processes might see everybody idle with no URL in flight
+	wget_thread_mutex_lock(mutex);
+	_store(&partitions[self].idle, 0);
+	add_url_func(url, strcmp(referer, "-") ? referer : NULL, level, flags);
+	_add(&partitions[self].received, 1);
+	wget_thread_mutex_unlock(mutex);
+}
+
+static void *_reader_thread(void *p G_GNUC_WGET_UNUSED)
+{
+	// messages are written atomically and are never larger than PIPE_BUF
+	char buf[PIPE_BUF * 2 + 1], *line, *eol;
+	size_t length = 0;
+	ssize_t nbytes;
+
+	while (!stopping) {
+		int rc;
+
+		if ((rc = wget_ready_2_read(read_fd, 100)) <= 0) {
+			if (rc < 0 && errno != EINTR)
+				break;
+			continue;
+		}
+
+		if ((nbytes = read(read_fd, buf + length, sizeof(buf) - 1 - length)) <= 0) {
+			if (nbytes < 0 && errno == EINTR)
+				continue;
+			break;
+		}
+
+		length += nbytes;
+		buf[length] = 0;
+
+		for (line = buf; (eol = strchr(line, '\n')); line = eol + 1) {
+			*eol = 0;
+			_process_line(line);
+		}
+
+		length -= line - buf;
+		memmove(buf, line, length);
+	}
+
+	return NULL;
+}
+
+int partition_start(int n, partition_add_url_t *add_url)
+{
+	int (*fds)[2];
+	size_t size = n * sizeof(_partition_t) + sizeof(int);
+	int it, rc;
+
+	if ((partitions = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED) {
+		error_printf(_("Failed to allocate shared memory for partitions (%d)\n"), errno);
+		partitions = NULL;
+		return -1;
+	}
+	memset(partitions, 0, size);
+	aborted = (int *) (partitions + n);
+
+	fds = wget_calloc(n, sizeof(*fds));
+	for (it = 0; it < n; it++) {
+		if (pipe(fds[it]) == -1) {
+			error_printf(_("Failed to create partition pipe (%d)\n"), errno);
+			while (--it >= 0) {
+				close(fds[it][0]);
+				close(fds[it][1]);
+			}
+			xfree(fds);
+			munmap(partitions, size);
+			partitions = NULL;
+			return -1;
+		}
+	}
+
+	// the calling process is partition 0, all others are forked
+	pids = wget_calloc(n, sizeof(pid_t));
+	for (it = 1; it < n; it++) {
+		if ((pids[it] = fork()) == 0)
+			break;
+
+		if (pids[it] < 0) {
+			error_printf(_("Failed to fork partition %d (%d)\n"), it, errno);
+			while (--it > 0) {
+				kill(pids[it], SIGTERM);
+				waitpid(pids[it], NULL, 0);
+			}
+			for (it = 0; it < n; it++) {
+				close(fds[it][0]);
+				close(fds[it][1]);
+			}
+			xfree(fds);
+			xfree(pids);
+			munmap(partitions, size);
+			partitions = NULL;
+			return -1;
+		}
+	}
+
+	self = it < n ? it : 0;
+	npartitions = n;
+
+	// keep the read end of our own pipe and the write ends of all others
+	write_fds = wget_malloc(n * sizeof(int));
+	for (it = 0; it < n; it++) {
+		if (it == self) {
+			read_fd = fds[it][0];
+			close(fds[it][1]);
+			write_fds[it] = -1;
+		} else {
+			close(fds[it][0]);
+			write_fds[it] = fds[it][1];
+		}
+	}
+	xfree(fds);
+
+	wget_thread_mutex_init(&mutex);
+	wget_thread_mutex_init(&counter_mutex);
+	add_url_func = add_url;
+
+	if ((rc = wget_thread_start(&reader_tid, _reader_thread, NULL, 0)) != 0) {
+		error_printf(_("Failed to start partition reader, error %d\n"), rc);
+		partition_abort();
+		return -1;
+	}
+
+	debug_printf("partition %d of %d started (pid %d)\n", self, n, (int) getpid());
+
+	return 0;
+}
+
+int partition_self(void)
+{
+	return self;
+}
+
+// Hosts below the same registrable domain (e.g. www.example.com and cdn.example.com)
+// belong to the same partition, so per-site state like politeness stays in one process.
+// The registrable domain is taken from the (cached) Public Suffix List of the cookie database.
+// Without PSL it is approximated by the last two labels of the host name.
+int partition_of(const char *host)
+{
+	unsigned int hash = 0;
+	const char *p;
+
+	if (npartitions < 2 || !host)
+		return 0;
+
+	if (!wget_ip_is_family(host, WGET_NET_FAMILY_IPV4) && !wget_ip_is_family(host, WGET_NET_FAMILY_IPV6)) {
+		if (!(p = wget_cookie_db_registrable_domain(config.cookie_db, host))) {
+			int dots = 0;
+
+			for (p = host + strlen(host); p > host; p--) {
+				if (p[-1] == '.' && p[0] && ++dots == 2)
+					break;
+			}
+		}
+		host = p;
+	}
+
+	while (*host)
+		hash = hash * 101 + (unsigned char) *host++; // IRI host names are already lowercase
+
+	return hash % npartitions;
+}
+
+// Returns 0 if the URL has been handed over to the given partition, else -1.
+// On failure the caller should process the URL itself.
+// spaces separate the fields of a message, URLs may contain them unescaped
+static void _buffer_escape_spaces(wget_buffer *buf, const char *s)
+{
+	const char *p;
+
+	while ((p = strchr(s, ' '))) {
+		wget_buffer_memcat(buf, s, p - s);
+		wget_buffer_strcat(buf, "%20");
+		s = p + 1;
+	}
+
+	wget_buffer_strcat(buf, s);
+}
+
+int partition_forward(int partition, const char *url, const char *referer, int level, int flags)
+{
+	char sbuf[PIPE_BUF];
+	wget_buffer buf;
+	int rc = -1;
+
+	if (partition < 0 || partition >= npartitions || partition == self || write_fds[partition] < 0)
+		return -1;
+
+	if (!referer)
+		referer = "-";
+
+	// line breaks would break the message format
+	if (strpbrk(url, "\r\n") || strpbrk(referer, "\r\n"))
+		return -1;
+
+	wget_buffer_init(&buf, sbuf, sizeof(sbuf));
+	wget_buffer_printf(&buf, "%d %d ", level, flags);
+	_buffer_escape_spaces(&buf, referer);
+	wget_buffer_memcat(&buf, " ", 1);
+	_buffer_escape_spaces(&buf, url);
+	wget_buffer_memcat(&buf, "\n", 1);
+
+	// writes of up to PIPE_BUF bytes are atomic, so no locking is needed
+	if (buf.length <= PIPE_BUF) {
+		_add(&partitions[self].sent, 1);
+
+		if (safe_write(write_fds[partition], buf.data, buf.length) != SAFE_WRITE_ERROR) {
+			debug_printf("partition %d: forwarded %s to partition %d\n", self, url, partition);
+			rc = 0;
+		} else {
+			// the other process has already gone
+			_add(&partitions[self].sent, -1);
+			close(write_fds[partition]);
+			write_fds[partition] = -1;
+		}
+	}
+
+	wget_buffer_deinit(&buf);
+
+	return rc;
+}
+
+// Returns non-zero when all partitions are finished or the crawl has been aborted.
+int partition_done(partition_idle_t *idle)
+{
+	int sent = 0, received = 0, sent2 = 0, received2 = 0;
+	int it, done = 0;
+
+	if (!partitions)
+		return 1;
+
+	if (_load(aborted))
+		return 1;
+
+	wget_thread_mutex_lock(mutex);
+	_store(&partitions[self].idle, idle() != 0);
+	wget_thread_mutex_unlock(mutex);
+
+	if (!_load(&partitions[self].idle))
+		return 0;
+
+	// the counters only grow, so if they are unchanged after checking the idle flags,
+	// there was no URL in flight and nobody could have become busy meanwhile
+	for (it = 0; it < npartitions; it++) {
+		sent += _load(&partitions[it].sent);
+		received += _load(&partitions[it].received);
+	}
+
+	if (sent != received)
+		return 0;
+
+	for (it = 0; it < npartitions; it++) {
+		if (!_load(&partitions[it].idle))
+			return 0;
+	}
+
+	for (it = 0; it < npartitions; it++) {
+		sent2 += _load(&partitions[it].sent);
+		received2 += _load(&partitions[it].received);
+	}
+
+	if (sent == sent2 && received == received2)
+		done = 1;
+
+	return done;
+}
+
+void partition_abort(void)
+{
+	if (aborted)
+		_store(aborted, 1);
+}
+
+// Stop this partition and publish its statistics.
+// The first process waits for all others, sums up their statistics into 'total'
+// and returns the most important exit status of the other processes.
+int partition_exit(const PARTITION_STATS *stats, PARTITION_STATS *total)
+{
+	int status = 0;
+
+	if (!partitions)
+		return 0;
+
+	stopping = 1;
+	if (reader_tid)
+		wget_thread_join(&reader_tid);
+
+	close(read_fd);
+	read_fd = -1;
+	for (int it = 0; it < npartitions; it++) {
+		if (write_fds[it] >= 0)
+			close(write_fds[it]);
+	}
+	xfree(write_fds);
+
+	partitions[self].stats = *stats;
+
+	if (self == 0) {
+		memset(total, 0, sizeof(*total));
+
+		for (int it = 1; it < npartitions; it++) {
+			int wstatus, code;
+
+			while (waitpid(pids[it], &wstatus, 0) < 0 && errno == EINTR);
+
+			if (WIFEXITED(wstatus))
+				code = WEXITSTATUS(wstatus);
+			else
+				code = WG_EXIT_STATUS_GENERIC;
+
+			// lower exit codes precede higher ones, 0 = no error
+			if (code && (!status || code < status))
+				status = code;
+		}
+
+		for (int it = 0; it < npartitions; it++) {
+			total->bytes += partitions[it].stats.bytes;
+			total->downloads += partitions[it].stats.downloads;
+			total->redirects += partitions[it].stats.redirects;
+			total->errors += partitions[it].stats.errors;
+			total->traps += partitions[it].stats.traps;
+		}
+	}
+
+	xfree(pids);
+	munmap(partitions, npartitions * sizeof(_partition_t) + sizeof(int));
+	partitions = NULL;
+	aborted = NULL;
+	wget_thread_mutex_destroy(&counter_mutex);
+	wget_thread_mutex_destroy(&mutex);
+
+	return status;
+}
+
+#else /* _WIN32 */
+
+int partition_start(int n G_GNUC_WGET_UNUSED, partition_add_url_t *add_url G_GNUC_WGET_UNUSED)
+{
+	error_printf(_("Partitioned crawling is not supported on this platform\n"));
+	return -1;
+}
+
+int partition_self(void)
+{
+	return 0;
+}
+
+int partition_of(const char *host G_GNUC_WGET_UNUSED)
+{
+	return 0;
+}
+
+int partition_forward(int partition G_GNUC_WGET_UNUSED, const char *url G_GNUC_WGET_UNUSED,
+	const char *referer G_GNUC_WGET_UNUSED, int level G_GNUC_WGET_UNUSED, int flags G_GNUC_WGET_UNUSED)
+{
+	return -1;
+}
+
+int partition_done(partition_idle_t *idle)
+{
+	return idle();
+}
+
+void partition_abort(void)
+{
+}
+
+int partition_exit(const PARTITION_STATS *stats, PARTITION_STATS *total)
+{
+	*total = *stats;
+	return 0;
+}
+
+#endif /* _WIN32 */
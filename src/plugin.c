@@ -55,6 +55,11 @@ typedef struct {
 	wget_plugin_argp_t *argp;
 	// The plugin's URL filter
 	wget_plugin_url_filter_t *url_filter;
+	// The plugin's batch URL filter
+	wget_plugin_url_filter_batch_t *url_filter_batch;
+	// Serializes calls to url_filter_batch unless it is thread-safe
+	wget_thread_mutex url_filter_batch_mutex;
+	int url_filter_batch_flags;
 	// The plugin's post processor
 	wget_plugin_post_processor_t *post_processor;
 	// Buffer to store plugin name
@@ -163,6 +168,14 @@ static void impl_register_url_filter(wget_plugin_t *p_plugin, wget_plugin_url_fi
 	priv->url_filter = fn;
 }
 
+static void impl_register_url_filter_batch(wget_plugin_t *p_plugin, wget_plugin_url_filter_batch_t *fn, int flags)
+{
+	plugin_priv_t *priv = (plugin_priv_t *) p_plugin;
+
+	priv->url_filter_batch = fn;
+	priv->url_filter_batch_flags = flags;
+}
+
 // API Exposed for plugins for intercepting downloaded files:
 typedef struct {
 	wget_downloaded_file_t parent;
@@ -310,12 +323,17 @@ static struct wget_plugin_vtable vtable = {
 
 	.add_hsts_db = impl_add_hsts_db,
 	.add_hpkp_db = impl_add_hpkp_db,
-	.add_ocsp_db = impl_add_ocsp_db
+	.add_ocsp_db = impl_add_ocsp_db,
+
+	.register_url_filter_batch = impl_register_url_filter_batch
 };
 
 // Free resources of the plugin and plugin itself
 static void plugin_free(plugin_t *plugin)
 {
+	plugin_priv_t *priv = (plugin_priv_t *) plugin;
+
+	wget_thread_mutex_destroy(&priv->url_filter_batch_mutex);
 	dl_file_close(plugin->dm);
 	wget_free(plugin);
 }
@@ -344,6 +362,9 @@ static plugin_t *_load_plugin(const char *name, const char *path, dl_error_t *e)
 	priv->finalizer = NULL;
 	priv->argp = NULL;
 	priv->url_filter = NULL;
+	priv->url_filter_batch = NULL;
+	priv->url_filter_batch_flags = 0;
+	wget_thread_mutex_init(&priv->url_filter_batch_mutex);
 	priv->post_processor = NULL;
 	wget_strscpy(priv->name_buf, name, name_len + 1);
 
@@ -568,6 +589,18 @@ int plugin_db_help_forwarded(void)
 	return plugin_help_forwarded;
 }
 
+// Calls the batch URL filter of a plugin, serialized unless the plugin declared it thread-safe
+static void call_url_filter_batch(plugin_priv_t *priv, const wget_iri **iris, wget_intercept_action_t **actions, int n)
+{
+	if (priv->url_filter_batch_flags & WGET_PLUGIN_THREAD_SAFE) {
+		priv->url_filter_batch((wget_plugin_t *) priv, iris, actions, n);
+	} else {
+		wget_thread_mutex_lock(priv->url_filter_batch_mutex);
+		priv->url_filter_batch((wget_plugin_t *) priv, iris, actions, n);
+		wget_thread_mutex_unlock(priv->url_filter_batch_mutex);
+	}
+}
+
 // Forwards a URL about to be enqueued to interested plugins
 void plugin_db_forward_url(const wget_iri *iri, struct plugin_db_forward_url_verdict *verdict)
 {
@@ -579,12 +612,17 @@ void plugin_db_forward_url(const wget_iri *iri, struct plugin_db_forward_url_ver
 		plugin_t *plugin = (plugin_t *) wget_vector_get(plugin_list, i);
 		plugin_priv_t *priv = (plugin_priv_t *) plugin;
 
-		if (priv->url_filter) {
+		if (priv->url_filter || priv->url_filter_batch) {
 			const wget_iri *cur_iri = action.verdict.alt_iri;
 			if (! cur_iri)
 				cur_iri = iri;
 
-			priv->url_filter((wget_plugin_t *) plugin, cur_iri, (wget_intercept_action_t *) &action);
+			if (priv->url_filter) {
+				priv->url_filter((wget_plugin_t *) plugin, cur_iri, (wget_intercept_action_t *) &action);
+			} else {
+				wget_intercept_action_t *p_action = (wget_intercept_action_t *) &action;
+				call_url_filter_batch(priv, &cur_iri, &p_action, 1);
+			}
 			if (action.verdict.reject || action.verdict.accept)
 				break;
 		}
@@ -593,6 +631,59 @@ void plugin_db_forward_url(const wget_iri *iri, struct plugin_db_forward_url_ver
 	*verdict = action.verdict;
 }
 
+// Forwards the URLs found in one document to interested plugins, one verdict per URL
+void plugin_db_forward_urls(const wget_iri **iris, struct plugin_db_forward_url_verdict *verdicts, int n)
+{
+	int n_plugins = wget_vector_size(plugin_list);
+
+	memset(verdicts, 0, n * sizeof(*verdicts));
+
+	if (n <= 0 || n_plugins <= 0)
+		return;
+
+	intercept_action_t *actions = wget_calloc(n, sizeof(intercept_action_t));
+	wget_intercept_action_t **pending_actions = wget_malloc(n * sizeof(wget_intercept_action_t *));
+	const wget_iri **pending_iris = wget_malloc(n * sizeof(wget_iri *));
+
+	for (int it = 0; it < n; it++)
+		actions[it].parent.vtable = &vtable;
+
+	for (int i = 0; i < n_plugins; i++) {
+		plugin_t *plugin = (plugin_t *) wget_vector_get(plugin_list, i);
+		plugin_priv_t *priv = (plugin_priv_t *) plugin;
+		int n_pending = 0;
+
+		if (!priv->url_filter_batch && !priv->url_filter)
+			continue;
+
+		// URLs accepted or rejected by a previous plugin are not passed on
+		for (int it = 0; it < n; it++) {
+			if (actions[it].verdict.reject || actions[it].verdict.accept)
+				continue;
+
+			pending_iris[n_pending] = actions[it].verdict.alt_iri ? actions[it].verdict.alt_iri : iris[it];
+			pending_actions[n_pending++] = (wget_intercept_action_t *) &actions[it];
+		}
+
+		if (!n_pending)
+			break;
+
+		if (priv->url_filter_batch) {
+			call_url_filter_batch(priv, pending_iris, pending_actions, n_pending);
+		} else {
+			for (int it = 0; it < n_pending; it++)
+				priv->url_filter((wget_plugin_t *) plugin, pending_iris[it], pending_actions[it]);
+		}
+	}
+
+	for (int it = 0; it < n; it++)
+		verdicts[it] = actions[it].verdict;
+
+	wget_free(pending_iris);
+	wget_free(pending_actions);
+	wget_free(actions);
+}
+
 // Free's all contents of plugin_db_forward_url_verdict
 void plugin_db_forward_url_verdict_free(struct plugin_db_forward_url_verdict *verdict)
 {
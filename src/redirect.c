@@ -0,0 +1,350 @@
+/*
+ * Copyright(c) 2019 Free Software Foundation, Inc.
+ *
+ * This file is part of Wget.
+ *
+ * Wget is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Wget is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Wget.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *
+ * Permanent redirect (301/308) cache
+ *
+ * Remembers permanent redirections so that later requests for the same
+ * URL are sent to the final location directly, saving a round trip.
+ * The cache can be stored to and loaded from a flat file.
+ *
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include <wget.h>
+
+#include "wget_main.h"
+#include "wget_redirect.h"
+
+typedef struct {
+	char *
+		target; // escaped absolute URL of the redirection target
+	int64_t
+		created, // time of creation in seconds since epoch
+		maxage; // max time to live in seconds, 0 = forever
+} _redirect_t;
+
+static wget_stringmap
+	*redirects;
+
+static wget_thread_mutex
+	mutex;
+
+static int
+	hits;
+
+static time_t
+	load_time;
+
+void redirect_cache_init(void)
+{
+	wget_thread_mutex_init(&mutex);
+}
+
+void redirect_cache_exit(void)
+{
+	wget_thread_mutex_destroy(&mutex);
+}
+
+static void _free_redirect(_redirect_t *redirect)
+{
+	if (redirect) {
+		xfree(redirect->target);
+		xfree(redirect);
+	}
+}
+
+// the key is the canonical form of the URL as it would be sent over the wire
+static char *G_GNUC_WGET_NONNULL_ALL _redirect_key(const wget_iri *iri)
+{
+	wget_buffer buf;
+	char sbuf[256];
+	char *key;
+
+	wget_buffer_init(&buf, sbuf, sizeof(sbuf));
+
+	wget_buffer_printf(&buf, strchr(iri->host, ':') ? "%s://[%s]" : "%s://%s", iri->scheme, iri->host);
+
+	if (iri->port_given)
+		wget_buffer_printf_append(&buf, ":%hu/", iri->port);
+	else
+		wget_buffer_memcat(&buf, "/", 1);
+
+	wget_iri_get_escaped_resource(iri, &buf);
+
+	key = wget_strmemdup(buf.data, buf.length);
+	wget_buffer_deinit(&buf);
+
+	return key;
+}
+
+static int _expired(const _redirect_t *redirect, int64_t now)
+{
+	return redirect->maxage && redirect->created + redirect->maxage < now;
+}
+
+// must be called with mutex locked
+static void _redirect_put(char *key, _redirect_t *redirect)
+{
+	if (!redirects) {
+		redirects = wget_stringmap_create(128);
+		wget_stringmap_set_value_destructor(redirects, (wget_stringmap_value_destructor_t *) _free_redirect);
+	}
+
+	wget_stringmap_put(redirects, key, redirect);
+}
+
+void redirect_cache_add(const wget_iri *from, const wget_iri *to, int64_t maxage)
+{
+	_redirect_t *redirect;
+	char *key, *target;
+
+	key = _redirect_key(from);
+	target = _redirect_key(to);
+
+	if (!strcmp(key, target)) {
+		// a redirect to itself would loop forever
+		xfree(target);
+		xfree(key);
+		return;
+	}
+
+	redirect = wget_malloc(sizeof(_redirect_t));
+	redirect->target = target;
+	redirect->created = time(NULL);
+	redirect->maxage = maxage;
+
+	debug_printf("redirect cache: add %s -> %s\n", key, target);
+
+	wget_thread_mutex_lock(mutex);
+	_redirect_put(key, redirect);
+	wget_thread_mutex_unlock(mutex);
+}
+
+char *redirect_cache_lookup(const wget_iri *iri)
+{
+	_redirect_t *redirect;
+	char *key, *target = NULL;
+
+	wget_thread_mutex_lock(mutex);
+	if (redirects) {
+		key = _redirect_key(iri);
+
+		if (wget_stringmap_get(redirects, key, &redirect)) {
+			if (_expired(redirect, time(NULL))) {
+				wget_stringmap_remove(redirects, key);
+			} else {
+				target = wget_strdup(redirect->target);
+				hits++;
+			}
+		}
+
+		xfree(key);
+	}
+	wget_thread_mutex_unlock(mutex);
+
+	return target;
+}
+
+static int _redirect_cache_load(G_GNUC_WGET_UNUSED void *ctx, FILE *fp)
+{
+	struct stat st;
+	_redirect_t *redirect, *old;
+	char *buf = NULL, *linep, *p, *key;
+	size_t bufsize = 0;
+	ssize_t buflen;
+	int64_t now = time(NULL);
+
+	// if the file hasn't changed since the last read there's no need to reload
+	if (fstat(fileno(fp), &st) == 0) {
+		if (st.st_mtime != load_time)
+			load_time = st.st_mtime;
+		else
+			return 0;
+	}
+
+	while ((buflen = wget_getline(&buf, &bufsize, fp)) >= 0) {
+		linep = buf;
+
+		while (isspace(*linep)) linep++; // ignore leading whitespace
+		if (!*linep) continue; // skip empty lines
+
+		if (*linep == '#')
+			continue; // skip comments
+
+		// strip off \r\n
+		while (buflen > 0 && (buf[buflen] == '\n' || buf[buflen] == '\r'))
+			buf[--buflen] = 0;
+
+		redirect = wget_calloc(1, sizeof(_redirect_t));
+
+		// parse source URL
+		for (p = linep; *linep && !isspace(*linep); )
+			linep++;
+		key = wget_strmemdup(p, linep - p);
+
+		// parse target URL
+		if (*linep) {
+			for (p = ++linep; *linep && !isspace(*linep); )
+				linep++;
+			redirect->target = wget_strmemdup(p, linep - p);
+		}
+
+		// parse creation time
+		if (*linep) {
+			for (p = ++linep; *linep && !isspace(*linep); )
+				linep++;
+			redirect->created = atoll(p);
+			if (redirect->created < 0 || redirect->created >= INT64_MAX / 2)
+				redirect->created = 0;
+		}
+
+		// parse max age
+		if (*linep) {
+			for (p = ++linep; *linep && !isspace(*linep); )
+				linep++;
+			redirect->maxage = atoll(p);
+			if (redirect->maxage < 0 || redirect->maxage >= INT64_MAX / 2)
+				redirect->maxage = 0; // avoid integer overflow here
+		} else {
+			error_printf(_("Failed to parse redirect cache line: '%s'\n"), buf);
+			_free_redirect(redirect);
+			xfree(key);
+			continue;
+		}
+
+		if (!*key || !redirect->target || !*redirect->target || _expired(redirect, now)) {
+			_free_redirect(redirect);
+			xfree(key);
+			continue;
+		}
+
+		wget_thread_mutex_lock(mutex);
+		if (redirects && wget_stringmap_get(redirects, key, &old) && old->created >= redirect->created) {
+			// keep the newer entry we already have in memory
+			_free_redirect(redirect);
+			xfree(key);
+		} else
+			_redirect_put(key, redirect);
+		wget_thread_mutex_unlock(mutex);
+	}
+
+	xfree(buf);
+
+	if (ferror(fp)) {
+		load_time = 0; // reload on next call to this function
+		return -1;
+	}
+
+	return 0;
+}
+
+int redirect_cache_load(const char *fname)
+{
+	if (!fname || !*fname)
+		return 0;
+
+	if (wget_update_file(fname, _redirect_cache_load, NULL, NULL)) {
+		error_printf(_("Failed to read redirect cache '%s'\n"), fname);
+		return -1;
+	}
+
+	debug_printf("Fetched redirect cache from '%s'\n", fname);
+	return 0;
+}
+
+static int G_GNUC_WGET_NONNULL_ALL _redirect_save(FILE *fp, const char *key, const _redirect_t *redirect)
+{
+	wget_fprintf(fp, "%s %s %lld %lld\n", key, redirect->target, (long long)redirect->created, (long long)redirect->maxage);
+	return 0;
+}
+
+static int _redirect_cache_save(G_GNUC_WGET_UNUSED void *ctx, FILE *fp)
+{
+	if (wget_hashmap_size(redirects) > 0) {
+		fputs("#Redirect cache 1.0 file\n", fp);
+		fputs("#Generated by Wget2 " PACKAGE_VERSION ". Edit at your own risk.\n", fp);
+		fputs("# <source URL> <target URL> <created> <max-age>\n", fp);
+
+		wget_hashmap_browse(redirects, (wget_hashmap_browse_t *) _redirect_save, fp);
+
+		if (ferror(fp))
+			return -1;
+	}
+
+	return 0;
+}
+
+// Save the redirect cache to a flat file, merging entries that have been
+// added by concurrent wget2 processes. Protected by flock().
+int redirect_cache_save(const char *fname)
+{
+	int size;
+
+	if (!fname || !*fname)
+		return -1;
+
+	if (wget_update_file(fname, _redirect_cache_load, _redirect_cache_save, NULL)) {
+		error_printf(_("Failed to write redirect cache '%s'\n"), fname);
+		return -1;
+	}
+
+	if ((size = wget_hashmap_size(redirects)))
+		debug_printf("Saved %d redirect%s into '%s'\n", size, size != 1 ? "s" : "", fname);
+	else
+		debug_printf("No redirects to save. Table is empty.\n");
+
+	return 0;
+}
+
+int redirect_cache_size(void)
+{
+	return wget_hashmap_size(redirects);
+}
+
+int redirect_cache_hits(void)
+{
+	return hits;
+}
+
+void redirect_cache_print_stats(FILE *fp, char format)
+{
+	if (format == WGET_STATS_FORMAT_HUMAN) {
+		wget_fprintf(fp, "\nRedirect Cache Statistics:\n");
+		wget_fprintf(fp, "  Hits    : %d\n", hits);
+		wget_fprintf(fp, "  Entries : %d\n", redirect_cache_size());
+	} else {
+		wget_fprintf(fp, "Hits,Entries\n");
+		wget_fprintf(fp, "%d,%d\n", hits, redirect_cache_size());
+	}
+}
+
+void redirect_cache_free(void)
+{
+	wget_thread_mutex_lock(mutex);
+	wget_stringmap_free(&redirects);
+	wget_thread_mutex_unlock(mutex);
+}
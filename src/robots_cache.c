@@ -0,0 +1,394 @@
+/*
+ * Copyright(c) 2019 Free Software Foundation, Inc.
+ *
+ * This file is part of Wget.
+ *
+ * Wget is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Wget is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Wget.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *
+ * Persistent robots.txt cache
+ *
+ * Keeps the rules of each robots.txt that applied to Wget2 (the Disallow
+ * paths and the Sitemap URLs), keyed by scheme, host and port, together with
+ * the fetch time and the validators of the response. A host with a fresh
+ * entry doesn't need to wait for robots.txt. A stale entry is revalidated
+ * with a conditional request, a '304 Not Modified' response reuses the rules.
+ *
+ * The file contains one host per line:
+ *   <origin> <fetched> <expires> <last-modified> <etag or -> [D:<path> | S:<url>]...
+ *
+ * References
+ *   https://www.rfc-editor.org/rfc/rfc9309#section-2.4 (caching)
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include <wget.h>
+
+#include "wget_main.h"
+#include "wget_robots_cache.h"
+
+// RFC 9309: crawlers should not use a cached robots.txt for more than 24 hours
+#define ROBOTS_CACHE_MAXAGE (24 * 3600)
+
+typedef struct {
+	char *
+		rules; // space separated 'D:<path>' and 'S:<url>' items, empty for 'allow all'
+	char *
+		etag; // ETag of the response or NULL
+	int64_t
+		fetched, // time of the last fetch or revalidation in seconds since epoch
+		expires, // entry is stale after this time
+		last_modified; // Last-Modified of the response or 0
+} _robots_entry_t;
+
+static wget_stringmap
+	*entries;
+
+static wget_thread_mutex
+	mutex;
+
+static int
+	hits;
+
+static bool
+	changed;
+
+static time_t
+	load_time;
+
+void robots_cache_init(void)
+{
+	wget_thread_mutex_init(&mutex);
+}
+
+void robots_cache_exit(void)
+{
+	wget_thread_mutex_destroy(&mutex);
+}
+
+static void _free_entry(_robots_entry_t *entry)
+{
+	if (entry) {
+		xfree(entry->rules);
+		xfree(entry->etag);
+		xfree(entry);
+	}
+}
+
+static char *G_GNUC_WGET_NONNULL_ALL _robots_key(const wget_iri *iri)
+{
+	return wget_aprintf(strchr(iri->host, ':') ? "%s://[%s]:%hu" : "%s://%s:%hu", iri->scheme, iri->host, iri->port);
+}
+
+// must be called with mutex locked
+static void _entry_put(char *key, _robots_entry_t *entry)
+{
+	if (!entries) {
+		entries = wget_stringmap_create(128);
+		wget_stringmap_set_value_destructor(entries, (wget_stringmap_value_destructor_t *) _free_entry);
+	}
+
+	wget_stringmap_put(entries, key, entry);
+}
+
+// rebuild the robots data from the cached rules, NULL if nothing is disallowed and there are no sitemaps
+static wget_robots *G_GNUC_WGET_NONNULL_ALL _rules_to_robots(const char *rules)
+{
+	wget_robots *robots = NULL;
+	wget_buffer buf;
+	char sbuf[1024];
+
+	if (!*rules)
+		return NULL;
+
+	wget_buffer_init(&buf, sbuf, sizeof(sbuf));
+	wget_buffer_strcpy(&buf, "User-agent: *\n");
+
+	for (const char *p = rules, *e; *p; p = e) {
+		for (e = p; *e && *e != ' '; e++);
+
+		if (p[0] == 'D' && p[1] == ':')
+			wget_buffer_printf_append(&buf, "Disallow: %.*s\n", (int) (e - p - 2), p + 2);
+		else if (p[0] == 'S' && p[1] == ':')
+			wget_buffer_printf_append(&buf, "Sitemap: %.*s\n", (int) (e - p - 2), p + 2);
+
+		while (*e == ' ') e++;
+	}
+
+	if (wget_robots_parse(&robots, buf.data, NULL) != WGET_E_SUCCESS)
+		robots = NULL;
+
+	wget_buffer_deinit(&buf);
+
+	return robots;
+}
+
+static char *_robots_to_rules(wget_robots *robots)
+{
+	wget_buffer buf;
+
+	wget_buffer_init(&buf, NULL, 128);
+
+	for (int it = 0, n = wget_robots_get_path_count(robots); it < n; it++) {
+		wget_string *path = wget_robots_get_path(robots, it);
+		wget_buffer_printf_append(&buf, "%sD:%.*s", buf.length ? " " : "", (int) path->len, path->p);
+	}
+
+	for (int it = 0, n = wget_robots_get_sitemap_count(robots); it < n; it++) {
+		const char *sitemap = wget_robots_get_sitemap(robots, it);
+		wget_buffer_printf_append(&buf, "%sS:%s", buf.length ? " " : "", sitemap);
+	}
+
+	return buf.data; // the buffer data is allocated, no need to deinit
+}
+
+bool robots_cache_lookup(const wget_iri *iri, wget_robots **robots)
+{
+	_robots_entry_t *entry;
+	char *key;
+	bool fresh = false;
+
+	key = _robots_key(iri);
+
+	wget_thread_mutex_lock(mutex);
+	if (entries && wget_stringmap_get(entries, key, &entry) && entry->expires > time(NULL)) {
+		*robots = _rules_to_robots(entry->rules);
+		fresh = true;
+		hits++;
+	}
+	wget_thread_mutex_unlock(mutex);
+
+	if (fresh)
+		debug_printf("robots cache: using cached rules for %s\n", key);
+
+	xfree(key);
+
+	return fresh;
+}
+
+void robots_cache_add_validators(wget_http_request *req, const wget_iri *iri)
+{
+	_robots_entry_t *entry;
+	char *key;
+
+	key = _robots_key(iri);
+
+	wget_thread_mutex_lock(mutex);
+	if (entries && wget_stringmap_get(entries, key, &entry)) {
+		if (entry->etag)
+			wget_http_add_header(req, "If-None-Match", entry->etag);
+
+		if (entry->last_modified) {
+			char http_date[32];
+
+			wget_http_print_date(entry->last_modified, http_date, sizeof(http_date));
+			wget_http_add_header(req, "If-Modified-Since", http_date);
+		}
+	}
+	wget_thread_mutex_unlock(mutex);
+
+	xfree(key);
+}
+
+bool robots_cache_update(const wget_iri *iri, const wget_http_response *resp, wget_robots **robots)
+{
+	_robots_entry_t *entry;
+	int64_t now = time(NULL);
+	char *key;
+	bool done = false;
+
+	if (resp->code == 304) {
+		// the cached rules are still valid
+		key = _robots_key(iri);
+
+		wget_thread_mutex_lock(mutex);
+		if (entries && wget_stringmap_get(entries, key, &entry)) {
+			wget_robots_free(robots);
+			*robots = _rules_to_robots(entry->rules);
+			entry->fetched = now;
+			entry->expires = now + ROBOTS_CACHE_MAXAGE;
+			changed = done = true;
+		}
+		wget_thread_mutex_unlock(mutex);
+
+		xfree(key);
+		return done;
+	}
+
+	if (resp->code == 200 && resp->body) {
+		wget_robots_free(robots);
+		done = wget_robots_parse(robots, resp->body->data, PACKAGE_NAME) == WGET_E_SUCCESS;
+	} else if (resp->code / 100 != 4 || resp->code == 429) {
+		return false; // server errors are not cached, the robots.txt is requested again next time
+	}
+
+	// an empty file or a 4xx response (robots.txt unavailable) means 'allow all'
+	entry = wget_calloc(1, sizeof(_robots_entry_t));
+	entry->rules = done ? _robots_to_rules(*robots) : wget_strdup("");
+	entry->etag = wget_strdup(resp->etag);
+	entry->last_modified = resp->last_modified > 0 ? resp->last_modified : 0;
+	entry->fetched = now;
+	entry->expires = now + ROBOTS_CACHE_MAXAGE;
+
+	key = _robots_key(iri);
+	debug_printf("robots cache: add %s '%s'\n", key, entry->rules);
+
+	wget_thread_mutex_lock(mutex);
+	_entry_put(key, entry);
+	changed = true;
+	wget_thread_mutex_unlock(mutex);
+
+	return done;
+}
+
+static int _robots_cache_load(G_GNUC_WGET_UNUSED void *ctx, FILE *fp)
+{
+	struct stat st;
+	_robots_entry_t *entry, *old;
+	char *buf = NULL, *linep, *p;
+	size_t bufsize = 0;
+	ssize_t buflen;
+
+	// if the file hasn't changed since the last read there's no need to reload
+	if (fstat(fileno(fp), &st) == 0) {
+		if (st.st_mtime != load_time)
+			load_time = st.st_mtime;
+		else
+			return 0;
+	}
+
+	while ((buflen = wget_getline(&buf, &bufsize, fp)) >= 0) {
+		char *fields[5];
+		int nfields;
+
+		linep = buf;
+
+		while (isspace(*linep)) linep++; // ignore leading whitespace
+		if (!*linep || *linep == '#')
+			continue; // skip empty lines and comments
+
+		// strip off \r\n
+		while (buflen > 0 && (buf[buflen - 1] == '\n' || buf[buflen - 1] == '\r'))
+			buf[--buflen] = 0;
+
+		for (nfields = 0; nfields < 5 && *linep; nfields++) {
+			for (p = linep; *linep && !isspace(*linep); linep++);
+			if (*linep)
+				*linep++ = 0;
+			fields[nfields] = p;
+		}
+
+		if (nfields < 5 || strncmp(fields[0], "http", 4)) {
+			error_printf(_("Failed to parse robots cache line: '%s'\n"), buf);
+			continue;
+		}
+
+		entry = wget_calloc(1, sizeof(_robots_entry_t));
+		entry->fetched = atoll(fields[1]);
+		entry->expires = atoll(fields[2]);
+		entry->last_modified = atoll(fields[3]);
+		if (strcmp(fields[4], "-"))
+			entry->etag = wget_strdup(fields[4]);
+		while (isspace(*linep)) linep++;
+		entry->rules = wget_strdup(linep);
+
+		if (entry->last_modified < 0)
+			entry->last_modified = 0;
+
+		wget_thread_mutex_lock(mutex);
+		if (entries && wget_stringmap_get(entries, fields[0], &old) && old->fetched >= entry->fetched) {
+			// keep the newer entry we already have in memory
+			_free_entry(entry);
+		} else
+			_entry_put(wget_strdup(fields[0]), entry);
+		wget_thread_mutex_unlock(mutex);
+	}
+
+	xfree(buf);
+
+	if (ferror(fp)) {
+		load_time = 0; // reload on next call to this function
+		return -1;
+	}
+
+	return 0;
+}
+
+int robots_cache_load(const char *fname)
+{
+	if (!fname || !*fname)
+		return 0;
+
+	if (wget_update_file(fname, _robots_cache_load, NULL, NULL)) {
+		error_printf(_("Failed to read robots cache '%s'\n"), fname);
+		return -1;
+	}
+
+	debug_printf("Fetched robots cache from '%s'\n", fname);
+	return 0;
+}
+
+static int G_GNUC_WGET_NONNULL_ALL _entry_save(FILE *fp, const char *key, const _robots_entry_t *entry)
+{
+	wget_fprintf(fp, "%s %lld %lld %lld %s %s\n", key, (long long) entry->fetched, (long long) entry->expires,
+		(long long) entry->last_modified, entry->etag ? entry->etag : "-", entry->rules);
+	return 0;
+}
+
+static int _robots_cache_save(G_GNUC_WGET_UNUSED void *ctx, FILE *fp)
+{
+	if (wget_hashmap_size(entries) > 0) {
+		fputs("#Robots cache 1.0 file\n", fp);
+		fputs("#Generated by Wget2 " PACKAGE_VERSION ". Edit at your own risk.\n", fp);
+		fputs("# <origin> <fetched> <expires> <last-modified> <etag> [D:<path> | S:<sitemap>]...\n", fp);
+
+		wget_hashmap_browse(entries, (wget_hashmap_browse_t *) _entry_save, fp);
+
+		if (ferror(fp))
+			return -1;
+	}
+
+	return 0;
+}
+
+// Save the robots cache to a flat file, merging entries that have been
+// added by concurrent wget2 processes. Protected by flock().
+int robots_cache_save(const char *fname)
+{
+	if (!fname || !*fname || !changed)
+		return 0;
+
+	if (wget_update_file(fname, _robots_cache_load, _robots_cache_save, NULL)) {
+		error_printf(_("Failed to write robots cache '%s'\n"), fname);
+		return -1;
+	}
+
+	debug_printf("Saved %d robots.txt entries into '%s' (%d hits)\n", wget_hashmap_size(entries), fname, hits);
+	return 0;
+}
+
+void robots_cache_free(void)
+{
+	wget_thread_mutex_lock(mutex);
+	wget_stringmap_free(&entries);
+	wget_thread_mutex_unlock(mutex);
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright(c) 2019 Free Software Foundation, Inc.
+ *
+ * This file is part of Wget.
+ *
+ * Wget is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Wget is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Wget.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *
+ * Adaptive timeout estimator (--adaptive-timeout)
+ *
+ * Connection setup time and time to the response header are smoothed per host like
+ * TCP does it for the RTT (RFC 6298): SRTT and RTTVAR with gains 1/8 and 1/4.
+ * The timeout is a multiple of SRTT + 4 * RTTVAR, doubled with each consecutive
+ * failure of the host and clamped by the user's --connect-timeout / --read-timeout.
+ *
+ */
+
+#include <config.h>
+
+#include <limits.h>
+
+#include "wget_rtt.h"
+
+/**
+ * \param[in,out] srtt Smoothed round trip time in ms
+ * \param[in,out] rttvar Round trip time variation in ms
+ * \param[in,out] samples Number of samples taken so far
+ * \param[in] ms New sample in ms, negative values are ignored
+ *
+ * Add a sample to the estimator.
+ */
+void rtt_update(int *srtt, int *rttvar, int *samples, long long ms)
+{
+	int rtt = ms > INT_MAX / 8 ? INT_MAX / 8 : (int) ms;
+
+	if (rtt < 0)
+		return;
+
+	if ((*samples)++ == 0) {
+		*srtt = rtt;
+		*rttvar = rtt / 2;
+	} else {
+		*rttvar += ((*srtt > rtt ? *srtt - rtt : rtt - *srtt) - *rttvar) / 4;
+		*srtt += (rtt - *srtt) / 8;
+	}
+}
+
+/**
+ * \param[in] srtt Smoothed round trip time in ms
+ * \param[in] rttvar Round trip time variation in ms
+ * \param[in] samples Number of samples taken so far
+ * \param[in] failures Number of consecutive failures of the host
+ * \param[in] extra Additional time in ms, e.g. to receive a full TCP window
+ * \param[in] limit User's timeout in ms, <= 0 means no limit
+ * \return Timeout in ms
+ *
+ * Until enough samples have been taken, \p limit is returned unchanged.
+ */
+int rtt_timeout(int srtt, int rttvar, int samples, int failures, long long extra, int limit)
+{
+	long long timeout;
+
+	if (samples < ADAPTIVE_MIN_SAMPLES)
+		return limit;
+
+	timeout = ((long long) srtt + 4LL * rttvar) * ADAPTIVE_FACTOR + extra;
+	timeout <<= failures < ADAPTIVE_MAX_BACKOFF ? (failures > 0 ? failures : 0) : ADAPTIVE_MAX_BACKOFF;
+
+	if (timeout < ADAPTIVE_MIN_TIMEOUT)
+		timeout = ADAPTIVE_MIN_TIMEOUT;
+
+	if (limit > 0 && timeout > limit)
+		timeout = limit;
+
+	return (int) (timeout > INT_MAX ? INT_MAX : timeout);
+}
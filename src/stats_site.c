@@ -57,7 +57,7 @@ typedef struct {
 		encoding,
 		method; //!< STATS_METHOD_*
 	const char*
-		mime_type;
+		mime_type; //!< interned, see wget_intern()
 	bool
 		redirect : 1; //!< Was this a redirection ?
 	time_t
@@ -81,7 +81,6 @@ static void free_stats(void *stats)
 	site_stats_t *s = stats;
 
 	if (s) {
-		xfree(s->mime_type);
 		xfree(s);
 	}
 }
@@ -161,7 +160,7 @@ void stats_site_add(wget_http_response *resp, wget_gpg_info_t *gpg_info)
 	doc->status = resp->code;
 	doc->encoding = resp->content_encoding;
 	doc->redirect = !!job->redirection_level;
-	doc->mime_type = wget_strdup(resp->content_type);
+	doc->mime_type = wget_intern(resp->content_type);
 	doc->last_modified = resp->last_modified;
 
 	// Set the request start time (since this is the first request for the doc)
@@ -0,0 +1,372 @@
+/*
+ * Copyright(c) 2019 Free Software Foundation, Inc.
+ *
+ * This file is part of Wget.
+ *
+ * Wget is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Wget is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Wget.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *
+ * Crawler trap detection
+ *
+ * Infinite calendars, session IDs in paths and ever-changing query parameters
+ * generate an unlimited number of URLs for a limited number of pages.
+ * Each detector in the table below looks at a new URL and may reject it.
+ * URLs that pass all detectors are accounted for the budgets.
+ *
+ * Additionally, pages with the same content as a page downloaded before
+ * under a different URL are detected, so their links aren't followed again.
+ *
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <wget.h>
+
+#include "wget_main.h"
+#include "wget_options.h"
+#include "wget_trap.h"
+
+typedef const char *_trap_detector_t(const wget_iri *iri);
+
+typedef struct {
+	_trap_detector_t
+		*detect;
+	const char *
+		name;
+	int
+		rejected;
+} _trap_t;
+
+static wget_stringmap
+	*host_urls, // host -> number of URLs
+	*dir_urls, // host/dir/ -> number of URLs
+	*query_values, // host/path?name -> set of values
+	*fingerprints; // content digest -> URL
+
+static wget_thread_mutex
+	mutex;
+
+static int
+	duplicate_pages;
+
+void trap_init(void)
+{
+	wget_thread_mutex_init(&mutex);
+}
+
+void trap_exit(void)
+{
+	wget_thread_mutex_destroy(&mutex);
+}
+
+static int _get_count(wget_stringmap *map, const char *key)
+{
+	int *count;
+
+	if (map && wget_stringmap_get(map, key, &count))
+		return *count;
+
+	return 0;
+}
+
+static void _increment_count(wget_stringmap **map, const char *key)
+{
+	int *count;
+
+	if (!*map)
+		*map = wget_stringmap_create(128);
+
+	if (wget_stringmap_get(*map, key, &count))
+		(*count)++;
+	else {
+		count = wget_malloc(sizeof(int));
+		*count = 1;
+		wget_stringmap_put(*map, wget_strdup(key), count);
+	}
+}
+
+// key for the directory of iri, e.g. 'example.com/a/b/'
+static char *_dir_key(const wget_iri *iri)
+{
+	const char *path = iri->path ? iri->path : "", *p = strrchr(path, '/');
+
+	return wget_aprintf("%s/%.*s", iri->host, p ? (int) (p - path + 1) : 0, path);
+}
+
+static const char *_detect_path_repeat(const wget_iri *iri)
+{
+	const char *path = iri->path, *s, *e;
+
+	if (!config.trap_path_repeat || !path)
+		return NULL;
+
+	// count the occurrences of each segment, e.g. 'a' in /a/b/a/b/a/b
+	for (s = path; *s; s = *e ? e + 1 : e) {
+		size_t len;
+		int n = 0;
+
+		if (!(e = strchr(s, '/')))
+			e = s + strlen(s);
+
+		if (!(len = e - s))
+			continue;
+
+		for (const char *p = path; *p; ) {
+			const char *q = strchr(p, '/');
+
+			if (!q)
+				q = p + strlen(p);
+
+			if ((size_t) (q - p) == len && !memcmp(p, s, len))
+				n++;
+
+			p = *q ? q + 1 : q;
+		}
+
+		if (n > config.trap_path_repeat)
+			return _("repeated path segments");
+	}
+
+	return NULL;
+}
+
+// Split the query parameter starting at s into key 'host/path?name' and value.
+// Returns the start of the next parameter.
+static const char *_query_param(const wget_iri *iri, const char *s, char **key, char **value)
+{
+	const char *e, *eq;
+
+	if (!(e = strchr(s, '&')))
+		e = s + strlen(s);
+
+	if (!(eq = memchr(s, '=', e - s)))
+		eq = e;
+
+	*key = wget_aprintf("%s/%s?%.*s", iri->host, iri->path ? iri->path : "", (int) (eq - s), s);
+	*value = eq < e ? wget_strmemdup(eq + 1, e - eq - 1) : wget_strdup("");
+
+	return *e ? e + 1 : e;
+}
+
+static const char *_detect_query_values(const wget_iri *iri)
+{
+	const char *reason = NULL;
+	wget_stringmap *values;
+	char *key, *value;
+
+	if (!config.trap_query_values || !iri->query)
+		return NULL;
+
+	// each query parameter may only have a limited number of different values per path
+	for (const char *s = iri->query; *s && !reason; ) {
+		s = _query_param(iri, s, &key, &value);
+
+		if (query_values && wget_stringmap_get(query_values, key, &values)
+			&& !wget_stringmap_contains(values, value)
+			&& wget_stringmap_size(values) >= config.trap_query_values)
+		{
+			reason = _("too many query parameter values");
+		}
+
+		xfree(value);
+		xfree(key);
+	}
+
+	return reason;
+}
+
+static const char *_detect_host_budget(const wget_iri *iri)
+{
+	if (config.trap_host_budget && _get_count(host_urls, iri->host) >= config.trap_host_budget)
+		return _("host budget exceeded");
+
+	return NULL;
+}
+
+static const char *_detect_dir_budget(const wget_iri *iri)
+{
+	const char *reason = NULL;
+
+	if (config.trap_dir_budget) {
+		char *key = _dir_key(iri);
+
+		if (_get_count(dir_urls, key) >= config.trap_dir_budget)
+			reason = _("directory budget exceeded");
+
+		xfree(key);
+	}
+
+	return reason;
+}
+
+static _trap_t traps[] = {
+	{ _detect_path_repeat, "path-repeat", 0 },
+	{ _detect_query_values, "query-values", 0 },
+	{ _detect_dir_budget, "dir-budget", 0 },
+	{ _detect_host_budget, "host-budget", 0 },
+};
+
+static void _free_values(wget_stringmap *values)
+{
+	wget_stringmap_free(&values);
+}
+
+// account an accepted URL for the budgets and query value limits
+static void _account(const wget_iri *iri)
+{
+	if (config.trap_host_budget)
+		_increment_count(&host_urls, iri->host);
+
+	if (config.trap_dir_budget) {
+		char *key = _dir_key(iri);
+		_increment_count(&dir_urls, key);
+		xfree(key);
+	}
+
+	if (config.trap_query_values && iri->query) {
+		wget_stringmap *values;
+		char *key, *value;
+
+		if (!query_values) {
+			query_values = wget_stringmap_create(128);
+			wget_stringmap_set_value_destructor(query_values, (wget_stringmap_value_destructor_t *) _free_values);
+		}
+
+		for (const char *s = iri->query; *s; ) {
+			s = _query_param(iri, s, &key, &value);
+
+			if (!wget_stringmap_get(query_values, key, &values)) {
+				values = wget_stringmap_create(16);
+				wget_stringmap_put(query_values, key, values);
+			} else
+				xfree(key);
+
+			if (wget_stringmap_contains(values, value))
+				xfree(value);
+			else
+				wget_stringmap_put(values, value, NULL);
+		}
+	}
+}
+
+// Returns the reason if iri looks like a crawler trap, else NULL.
+const char *trap_check_url(const wget_iri *iri)
+{
+	const char *reason = NULL;
+
+	wget_thread_mutex_lock(mutex);
+
+	for (unsigned it = 0; it < countof(traps) && !reason; it++) {
+		if ((reason = traps[it].detect(iri)))
+			traps[it].rejected++;
+	}
+
+	if (!reason)
+		_account(iri);
+
+	wget_thread_mutex_unlock(mutex);
+
+	return reason;
+}
+
+static int _check_fingerprint(const wget_iri *iri, const char *hex)
+{
+	const char *uri;
+	int duplicate = 0;
+
+	wget_thread_mutex_lock(mutex);
+	if (!fingerprints)
+		fingerprints = wget_stringmap_create(128);
+
+	if (wget_stringmap_get(fingerprints, hex, &uri)) {
+		if (strcmp(uri, iri->uri)) {
+			debug_printf("'%s' has the same content as '%s'\n", iri->uri, uri);
+			duplicate_pages++;
+			duplicate = 1;
+		}
+	} else
+		wget_stringmap_put(fingerprints, wget_strdup(hex), wget_strdup(iri->uri));
+	wget_thread_mutex_unlock(mutex);
+
+	return duplicate;
+}
+
+// Returns 1 if the same content has already been seen under a different URL.
+int trap_check_content(const wget_iri *iri, const char *data, size_t length)
+{
+	unsigned char digest[20];
+	char hex[sizeof(digest) * 2 + 1];
+
+	if (!config.trap_fingerprint)
+		return 0;
+
+	if (wget_hash_fast(WGET_DIGTYPE_SHA1, data, length, digest))
+		return 0;
+
+	wget_memtohex(digest, sizeof(digest), hex, sizeof(hex));
+
+	return _check_fingerprint(iri, hex);
+}
+
+// Same as trap_check_content() for a body that has only been saved to fname.
+int trap_check_content_file(const wget_iri *iri, const char *fname)
+{
+	char hex[20 * 2 + 1];
+
+	if (!config.trap_fingerprint)
+		return 0;
+
+	if (wget_hash_file("sha1", fname, hex, sizeof(hex)))
+		return 0;
+
+	return _check_fingerprint(iri, hex);
+}
+
+int trap_rejected(void)
+{
+	int n = duplicate_pages;
+
+	for (unsigned it = 0; it < countof(traps); it++)
+		n += traps[it].rejected;
+
+	return n;
+}
+
+void trap_print(void)
+{
+	if (!trap_rejected())
+		return;
+
+	info_printf(_("Crawler traps: %d URLs rejected, %d duplicate pages not parsed\n"),
+		trap_rejected() - duplicate_pages, duplicate_pages);
+
+	for (unsigned it = 0; it < countof(traps); it++) {
+		if (traps[it].rejected)
+			info_printf("  %-12s: %d\n", traps[it].name, traps[it].rejected);
+	}
+}
+
+void trap_free(void)
+{
+	wget_thread_mutex_lock(mutex);
+	wget_stringmap_free(&host_urls);
+	wget_stringmap_free(&dir_urls);
+	wget_stringmap_free(&query_values);
+	wget_stringmap_free(&fingerprints);
+	wget_thread_mutex_unlock(mutex);
+}
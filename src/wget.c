@@ -72,6 +72,16 @@
 #include "wget_job.h"
 #include "wget_options.h"
 #include "wget_blacklist.h"
+#include "wget_redirect.h"
+#include "wget_robots_cache.h"
+#include "wget_canon.h"
+#include "wget_dictionary.h"
+#include "wget_daemon.h"
+#include "wget_partition.h"
+#include "wget_trap.h"
+#include "wget_zsync.h"
+#include "wget_archive.h"
+#include "wget_memory.h"
 #include "wget_host.h"
 #include "wget_bar.h"
 #include "wget_xattr.h"
@@ -92,6 +102,7 @@
 #define URL_FLG_REQUISITE       (1<<3)
 #define URL_FLG_SIGNATURE_REQ   (1<<4)
 #define URL_FLG_NO_BLACKLISTING (1<<5)
+#define URL_FLG_FORWARDED       (1<<6)
 
 #define _CONTENT_TYPE_HTML 1
 typedef struct {
@@ -107,6 +118,7 @@ typedef struct {
 		content_type;
 } _conversion_t;
 static wget_vector *conversions;
+static long long conversion_memory; // accounted for --max-memory, protected by conversion_mutex
 
 typedef struct {
 	int
@@ -121,6 +133,8 @@ typedef struct {
 		nchunks; // chunk downloads with 200 response
 	long long
 		bytes_body_uncompressed; // uncompressed bytes in body
+	long long
+		bytes_body_skipped; // bytes of unneeded bodies drained or not read at all
 } _statistics_t;
 static _statistics_t stats;
 
@@ -128,6 +142,8 @@ static int G_GNUC_WGET_NONNULL((1)) _prepare_file(wget_http_response *resp, cons
 		wget_iri *uri, wget_iri *original_url, int ignore_patterns, wget_buffer *partial_content,
 		size_t max_partial_content, char **actual_file_name, const char *path);
 
+static int
+	add_url(JOB *job, const char *encoding, const char *url, int flags);
 static void
 	sitemap_parse_xml(JOB *job, const char *data, const char *encoding, wget_iri *base),
 	sitemap_parse_xml_gz(JOB *job, wget_buffer *data, const char *encoding, wget_iri *base),
@@ -165,7 +181,9 @@ static void
 static wget_thread_mutex
 	quota_mutex;
 static long long
-	quota;
+	quota,
+	quota_reserved, // announced bytes (Content-Length) of running transfers not yet received
+	quota_exempted; // number of transfers that have been started with no quota used, never reset like quota itself
 static int
 	hsts_changed,
 	hpkp_changed;
@@ -322,6 +340,23 @@ static long long quota_modify_read(size_t nbytes)
 	return _fetch_and_add_longlong(&quota, (long long)nbytes);
 }
 
+// Reserve nbytes of the download quota for a transfer that is about to start.
+// Returns -1 if the transfer doesn't fit into the remaining quota, 1 for the first transfer
+// started with no quota used or reserved (so quota never affects downloading a single file), else 0.
+static int quota_reserve(long long nbytes)
+{
+	long long reserved = _fetch_and_add_longlong(&quota_reserved, nbytes);
+	long long used = _fetch_and_add_longlong(&quota, 0) + reserved;
+
+	if (used > 0 && (used >= config.quota || used + nbytes > config.quota)) {
+		_fetch_and_add_longlong(&quota_reserved, -nbytes);
+		return -1;
+	}
+
+	// only one transfer is exempt, concurrent transfers of unknown size all see used == 0
+	return used == 0 && _fetch_and_add_longlong(&quota_exempted, 1) == 0;
+}
+
 static void nop(int sig)
 {
 	if (sig == SIGTERM) {
@@ -362,6 +397,13 @@ static void _wget_init(void)
 {
 	wget_global_init(0);
 	blacklist_init();
+	redirect_cache_init();
+	robots_cache_init();
+	canon_init();
+	dictionary_init();
+	trap_init();
+	archive_init();
+	memory_init();
 	host_init();
 
 	wget_thread_mutex_init(&downloader_mutex);
@@ -412,6 +454,13 @@ static void _wget_init(void)
 static void _wget_deinit(void)
 {
 	host_exit();
+	redirect_cache_exit();
+	robots_cache_exit();
+	canon_exit();
+	dictionary_exit();
+	trap_exit();
+	archive_exit();
+	memory_exit();
 	blacklist_exit();
 
 	wget_thread_mutex_destroy(&downloader_mutex);
@@ -426,6 +475,28 @@ static void _wget_deinit(void)
 	wget_thread_cond_destroy(&worker_cond);
 }
 
+/*
+ * Whether to free all resources on exit.
+ *
+ * Walking and freeing millions of IRIs, jobs and hashmap entries can take
+ * several seconds after the last download finished. Production runs leave that
+ * to the OS, which releases the process memory wholesale. The test suite,
+ * valgrind runs (wget2_noinstall) and sanitizer builds need a complete teardown
+ * to make real leaks visible.
+ */
+static bool _full_teardown(const char *argv0)
+{
+#if defined __SANITIZE_ADDRESS__
+	return true;
+#elif defined __has_feature
+#  if __has_feature(address_sanitizer) || __has_feature(memory_sanitizer)
+	return true;
+#  endif
+#endif
+
+	return is_testing() || wget_match_tail(argv0, "wget2_noinstall");
+}
+
 /* Check if 'subdir' is a subdirectory of 'dir'.
  * E.g. if 'dir' is `/something', match_subdir() will return true if and
  * only if 'subdir' begins with `/something/' or is exactly '/something'.
@@ -679,16 +750,116 @@ static void parse_localfile(JOB *job, const char *fname, const char *encoding, c
 	}
 }
 
+// Follow the chain of cached permanent redirections for iri.
+// Returns the IRI of the final target or NULL if there is no cached redirection.
+static wget_iri *follow_cached_redirects(const wget_iri *iri)
+{
+	wget_iri *target = NULL;
+	char *url;
+
+	for (int n = 0; n < config.max_redirect && (url = redirect_cache_lookup(target ? target : iri)); n++) {
+		wget_iri *next = wget_iri_parse(url, "utf-8");
+
+		if (!next) {
+			xfree(url);
+			break;
+		}
+
+		debug_printf("Cached redirect %s -> %s\n", target ? target->uri : iri->uri, url);
+		xfree(url);
+		wget_iri_free(&target);
+		target = next;
+	}
+
+	return target;
+}
+
+// Remember domain and directory of a URL given by the user, to limit recursion.
+// Must be called with downloader_mutex locked.
+static void add_start_url_limits(wget_iri *iri)
+{
+	if (!config.recursive)
+		return;
+
+	if (!config.span_hosts && config.domains) {
+		if (wget_vector_find(config.domains, iri->host) == -1)
+			wget_vector_add(config.domains, wget_strdup(iri->host));
+	}
+
+	if (!config.parent) {
+		char *p;
+
+		if (!parents)
+			parents = wget_vector_create(4, NULL);
+
+		// calc length of directory part in iri->path (including last /)
+		if (!iri->path || !(p = strrchr(iri->path, '/')))
+			iri->dirlen = 0;
+		else
+			iri->dirlen = p - iri->path + 1;
+
+		wget_vector_add(parents, iri);
+	}
+}
+
 // Add URLs given by user (command line, file or -i option).
 // Needs to be thread-save.
-static void add_url_to_queue(const char *url, wget_iri *base, const char *encoding, int flags)
+// Create the robots.txt job for a new host, unless the rules are in the robots cache.
+// Returns true if the cached rules have been used.
+static bool _add_robotstxt_job(HOST *host, wget_iri *iri, const char *encoding, bool http_fallback)
 {
-	wget_iri *iri;
+	wget_iri *robot_iri;
+
+	if (config.robots_cache_file && robots_cache_lookup(iri, &host->robots))
+		return true;
+
+	// create a special job for downloading robots.txt (before anything else)
+	robot_iri = wget_iri_parse_base(iri, "/robots.txt", encoding);
+
+	if (blacklist_add(robot_iri))
+		host_add_robotstxt_job(host, robot_iri, http_fallback);
+
+	return false;
+}
+
+// Returns true if the path of iri is disallowed by robots
+static bool _robots_disallowed(wget_robots *robots, const wget_iri *iri)
+{
+	if (robots && iri->path) {
+		// info_printf("%s: checking '%s' / '%s'\n", __func__, iri->path, iri->uri);
+		for (int it = 0, n = wget_robots_get_path_count(robots); it < n; it++) {
+			wget_string *path = wget_robots_get_path(robots, it);
+			// info_printf("%s: checked robot path '%.*s' / '%s' / '%s'\n", __func__, (int)path->len, path->path, iri->path, iri->uri);
+			if (path->len && !strncmp(path->p + 1, iri->path, path->len - 1))
+				return true;
+		}
+	}
+
+	return false;
+}
+
+// add sitemaps to be downloaded (format https://www.sitemaps.org/protocol.html)
+static void _add_sitemaps(JOB *job, wget_robots *robots)
+{
+	// Sitemaps are not relevant as page requisites
+	if (config.page_requisites)
+		return;
+
+	for (int it = 0, n = wget_robots_get_sitemap_count(robots); it < n; it++) {
+		const char *sitemap = wget_robots_get_sitemap(robots, it);
+		debug_printf("adding sitemap '%s'\n", sitemap);
+		add_url(job, "utf-8", sitemap, URL_FLG_SITEMAP); // see https://www.sitemaps.org/protocol.html#escaping
+	}
+}
+
+static void add_url_to_queue(const char *url, wget_iri *base, const char *encoding, int flags, DAEMON_BATCH *batch)
+{
+	wget_iri *iri, *canon_iri, *cached_iri, *orig_iri = NULL;
 	JOB *new_job = NULL, job_buf;
 	HOST *host;
 	const char *local_filename;
 	struct plugin_db_forward_url_verdict plugin_verdict;
-	bool http_fallback = 0;
+	bool http_fallback = 0, robots_cached = 0;
 
 	iri = wget_iri_parse_base(base, url, encoding);
 
@@ -710,9 +881,20 @@ static void add_url_to_queue(const char *url, wget_iri *base, const char *encodi
 		plugin_verdict.alt_iri = NULL;
 	}
 
+	if (config.canonicalize_rules && (canon_iri = canon_apply(iri))) {
+		wget_iri_free(&iri);
+		iri = canon_iri;
+	}
+
+	if (config.redirect_cache && (cached_iri = follow_cached_redirects(iri))) {
+		orig_iri = iri;
+		iri = cached_iri;
+	}
+
 	if (iri->scheme != WGET_IRI_SCHEME_HTTP && iri->scheme != WGET_IRI_SCHEME_HTTPS) {
 		error_printf(_("URI scheme not supported: '%s'\n"), url);
 		wget_iri_free(&iri);
+		wget_iri_free(&orig_iri);
 		plugin_db_forward_url_verdict_free(&plugin_verdict);
 		return;
 	}
@@ -729,6 +911,7 @@ static void add_url_to_queue(const char *url, wget_iri *base, const char *encodi
 		if (!(flags & URL_FLG_NO_BLACKLISTING)) {
 			// we know this URL already
 			wget_thread_mutex_unlock(downloader_mutex);
+			wget_iri_free(&orig_iri);
 			plugin_db_forward_url_verdict_free(&plugin_verdict);
 			return;
 		}
@@ -739,6 +922,16 @@ static void add_url_to_queue(const char *url, wget_iri *base, const char *encodi
 		// download from this scheme://domain are explicitly not wanted
 		debug_printf("not requesting '%s'. (Exclude Domains)\n", iri->uri);
 		wget_thread_mutex_unlock(downloader_mutex);
+		wget_iri_free(&orig_iri);
+		plugin_db_forward_url_verdict_free(&plugin_verdict);
+		return;
+	}
+
+	if (config.partitions > 1 && partition_of(iri->host) != partition_self()) {
+		// every partition reads the same start URLs, the owner of the host downloads it
+		add_start_url_limits(iri);
+		wget_thread_mutex_unlock(downloader_mutex);
+		wget_iri_free(&orig_iri);
 		plugin_db_forward_url_verdict_free(&plugin_verdict);
 		return;
 	}
@@ -746,10 +939,15 @@ static void add_url_to_queue(const char *url, wget_iri *base, const char *encodi
 	if (plugin_verdict.alt_local_filename) {
 		local_filename = plugin_verdict.alt_local_filename;
 		plugin_verdict.alt_local_filename = NULL;
+	} else if (orig_iri && !config.trust_server_names) {
+		// name the file after the requested URL, just like a normal redirection does
+		local_filename = get_local_filename(orig_iri);
 	} else {
 		local_filename = get_local_filename(iri);
 	}
 
+	wget_iri_free(&orig_iri);
+
 	if (!config.clobber && local_filename && access(local_filename, F_OK) == 0) {
 		debug_printf("not requesting '%s'. (File already exists)\n", iri->uri);
 		wget_thread_mutex_unlock(downloader_mutex);
@@ -766,38 +964,13 @@ static void add_url_to_queue(const char *url, wget_iri *base, const char *encodi
 		if (config.recursive && config.robots) {
 			if (!config.clobber && local_filename && access(local_filename, F_OK) == 0) {
 				debug_printf("not requesting '%s'. (File already exists)\n", iri->uri);
-			} else {
-				// create a special job for downloading robots.txt (before anything else)
-				wget_iri *robot_iri = wget_iri_parse_base(iri, "/robots.txt", encoding);
-
-				if (blacklist_add(robot_iri))
-					host_add_robotstxt_job(host, robot_iri, http_fallback);
-			}
+			} else
+				robots_cached = _add_robotstxt_job(host, iri, encoding, http_fallback);
 		}
 	} else
 		host = host_get(iri);
 
-	if (config.recursive) {
-		if (!config.span_hosts && config.domains) {
-			if (wget_vector_find(config.domains, iri->host) == -1)
-				wget_vector_add(config.domains, wget_strdup(iri->host));
-		}
-
-		if (!config.parent) {
-			char *p;
-
-			if (!parents)
-				parents = wget_vector_create(4, NULL);
-
-			// calc length of directory part in iri->path (including last /)
-			if (!iri->path || !(p = strrchr(iri->path, '/')))
-				iri->dirlen = 0;
-			else
-				iri->dirlen = p - iri->path + 1;
-
-			wget_vector_add(parents, iri);
-		}
-	}
+	add_start_url_limits(iri);
 
 	new_job = job_init(&job_buf, iri, http_fallback);
 	new_job->local_filename = local_filename;
@@ -827,28 +1000,30 @@ static void add_url_to_queue(const char *url, wget_iri *base, const char *encodi
 		new_job->challenges_alloc = false;
 	}
 
+	if (batch) {
+		new_job->batch = batch;
+		daemon_batch_add_job(batch);
+	}
+
 	host_add_job(host, new_job);
 
 	wget_thread_mutex_unlock(downloader_mutex);
 
+	if (robots_cached)
+		_add_sitemaps(NULL, host->robots);
+
 	plugin_db_forward_url_verdict_free(&plugin_verdict);
 }
 
-// Add URLs parsed from downloaded files
-// Needs to be thread-safe
-static void add_url(JOB *job, const char *encoding, const char *url, int flags)
+// Parse a URL found in a downloaded file, returns NULL if it is not going to be followed
+static wget_iri *_parse_url(JOB *job, const char *encoding, const char *url, int flags)
 {
-	JOB *new_job = NULL, job_buf;
 	wget_iri *iri;
-	HOST *host;
-	const char *local_filename = NULL;
-	struct plugin_db_forward_url_verdict plugin_verdict;
-	bool http_fallback = 0;
 
 	if (flags & URL_FLG_REDIRECTION) { // redirect
 		if (job && job->redirection_level >= config.max_redirect) {
 			debug_printf("not requesting '%s'. (Max Redirections exceeded)\n", url);
-			return;
+			return NULL;
 		}
 	}
 
@@ -867,19 +1042,28 @@ static void add_url(JOB *job, const char *encoding, const char *url, int flags)
 	else
 		iri = wget_iri_parse(url, encoding);
 
-	if (!iri) {
+	if (!iri)
 		error_printf(_("Cannot resolve URI '%s'\n"), url);
-		return;
-	}
 
-	// Allow plugins to intercept URL
-	plugin_db_forward_url(iri, &plugin_verdict);
+	return iri;
+}
+
+// Add a parsed URL after the plugins had their say, takes ownership of iri and verdict
+static int _add_url(JOB *job, DAEMON_BATCH *batch, const char *encoding, const char *url, int flags, wget_iri *iri, struct plugin_db_forward_url_verdict *verdict)
+{
+	JOB *new_job = NULL, job_buf;
+	wget_iri *canon_iri, *cached_iri, *orig_iri = NULL;
+	HOST *host;
+	const char *local_filename = NULL;
+	struct plugin_db_forward_url_verdict plugin_verdict = *verdict;
+	bool http_fallback = 0, derived_filename = 0, robots_cached = 0;
+	int partition = -1, queued = 0;
 
 	if (plugin_verdict.reject) {
 		debug_printf("not requesting '%s'. (Plugin Verdict)\n", url);
 		plugin_db_forward_url_verdict_free(&plugin_verdict);
 		wget_iri_free(&iri);
-		return;
+		return 0;
 	}
 
 	if (plugin_verdict.alt_iri) {
@@ -889,18 +1073,31 @@ static void add_url(JOB *job, const char *encoding, const char *url, int flags)
 		plugin_verdict.alt_iri = NULL;
 	}
 
+	// map equivalent URLs to one canonical URL before blacklisting
+	if (config.canonicalize_rules && (canon_iri = canon_apply(iri))) {
+		wget_iri_free(&iri);
+		iri = canon_iri;
+	}
+
+	if (config.redirect_cache && (cached_iri = follow_cached_redirects(iri))) {
+		orig_iri = iri;
+		iri = cached_iri;
+	}
+
 	if (iri->scheme != WGET_IRI_SCHEME_HTTP && iri->scheme != WGET_IRI_SCHEME_HTTPS) {
 		info_printf(_("URL '%s' not followed (unsupported scheme '%s')\n"), url, iri->scheme);
 		wget_iri_free(&iri);
+		wget_iri_free(&orig_iri);
 		plugin_db_forward_url_verdict_free(&plugin_verdict);
-		return;
+		return 0;
 	}
 
 	if (config.https_only && iri->scheme != WGET_IRI_SCHEME_HTTPS) {
 		info_printf(_("URL '%s' not followed (https-only requested)\n"), url);
 		wget_iri_free(&iri);
+		wget_iri_free(&orig_iri);
 		plugin_db_forward_url_verdict_free(&plugin_verdict);
-		return;
+		return 0;
 	}
 
 	if (iri->scheme == WGET_IRI_SCHEME_HTTP && config.https_enforce && !(flags & URL_FLG_SKIPFALLBACK)) {
@@ -959,12 +1156,25 @@ static void add_url(JOB *job, const char *encoding, const char *url, int flags)
 		}
 	}
 
+	// redirections and signatures are bound to the current job, everything else goes to the host's owner
+	if (config.partitions > 1 && !(flags & (URL_FLG_REDIRECTION | URL_FLG_SIGNATURE_REQ | URL_FLG_FORWARDED))) {
+		if ((partition = partition_of(iri->host)) != partition_self())
+			goto out; // forward after unlocking, writing to the pipe may block
+		partition = -1;
+	}
+
 	if (!config.output_document) {
 		if (plugin_verdict.alt_local_filename) {
 			local_filename = plugin_verdict.alt_local_filename;
 			plugin_verdict.alt_local_filename = NULL;
 		} else if (!(flags & URL_FLG_REDIRECTION) || config.trust_server_names || !job) {
-			local_filename = get_local_filename(iri);
+			// a cached redirection is named after the requested URL, just like a normal redirection
+			if (orig_iri && !config.trust_server_names)
+				local_filename = get_local_filename(orig_iri);
+			else {
+				local_filename = get_local_filename(iri);
+				derived_filename = 1;
+			}
 		} else {
 			local_filename = wget_strdup(job->local_filename);
 		}
@@ -977,8 +1187,9 @@ static void add_url(JOB *job, const char *encoding, const char *url, int flags)
 			}
 			// do not 'goto out;' here
 			xfree(local_filename);
+			wget_iri_free(&orig_iri);
 			plugin_db_forward_url_verdict_free(&plugin_verdict);
-			return;
+			return 0;
 		}
 	}
 
@@ -987,25 +1198,18 @@ static void add_url(JOB *job, const char *encoding, const char *url, int flags)
 		if (config.recursive && config.robots) {
 			if (!config.clobber && local_filename && access(local_filename, F_OK) == 0) {
 				debug_printf("not requesting '%s' (File already exists)\n", iri->uri);
-			} else {
-				// create a special job for downloading robots.txt (before anything else)
-				wget_iri *robot_iri = wget_iri_parse_base(iri, "/robots.txt", encoding);
-
-				if (blacklist_add(robot_iri))
-					host_add_robotstxt_job(host, robot_iri, http_fallback);
+			} else if ((robots_cached = _add_robotstxt_job(host, iri, encoding, http_fallback))
+				&& _robots_disallowed(host->robots, iri))
+			{
+				// the cached rules are known right away, no need to wait for robots.txt
+				info_printf(_("URL '%s' not followed (disallowed by robots.txt)\n"), iri->uri);
+				goto out;
 			}
 		}
 	} else if ((host = host_get(iri))) {
-		if (host->robots && iri->path) {
-			// info_printf("%s: checking '%s' / '%s'\n", __func__, iri->path, iri->uri);
-			for (int it = 0, n = wget_robots_get_path_count(host->robots); it < n; it++) {
-				wget_string *path = wget_robots_get_path(host->robots, it);
-				// info_printf("%s: checked robot path '%.*s' / '%s' / '%s'\n", __func__, (int)path->len, path->path, iri->path, iri->uri);
-				if (path->len && !strncmp(path->p + 1, iri->path ? iri->path : "", path->len - 1)) {
-					info_printf(_("URL '%s' not followed (disallowed by robots.txt)\n"), iri->uri);
-					goto out;
-				}
-			}
+		if (_robots_disallowed(host->robots, iri)) {
+			info_printf(_("URL '%s' not followed (disallowed by robots.txt)\n"), iri->uri);
+			goto out;
 		}
 	} else {
 		// this should really not ever happen
@@ -1034,8 +1238,19 @@ static void add_url(JOB *job, const char *encoding, const char *url, int flags)
 		}
 	}
 
+	// last check, only URLs that are queued count against the trap budgets
+	if (config.recursive && !(flags & URL_FLG_REDIRECTION)) {
+		const char *reason = trap_check_url(iri);
+
+		if (reason) {
+			info_printf(_("URL '%s' not followed (%s)\n"), iri->uri, reason);
+			goto out;
+		}
+	}
+
 	new_job = job_init(&job_buf, iri, http_fallback);
 	new_job->local_filename = local_filename;
+	new_job->derived_filename = derived_filename;
 	local_filename = NULL;
 
 	if (job) {
@@ -1093,8 +1308,18 @@ static void add_url(JOB *job, const char *encoding, const char *url, int flags)
 	if (flags & URL_FLG_SITEMAP)
 		new_job->sitemap = 1;
 
+	if (flags & URL_FLG_REQUISITE)
+		new_job->requisite = 1;
+
+	// jobs derived from a daemon batch job belong to the same batch
+	if (batch) {
+		new_job->batch = batch;
+		daemon_batch_add_job(batch);
+	}
+
 	// now add the new job to the queue (thread-safe))
 	host_add_job(host, new_job);
+	queued = 1;
 
 	// and wake up all waiting threads
 	wget_thread_cond_signal(worker_cond);
@@ -1102,12 +1327,99 @@ static void add_url(JOB *job, const char *encoding, const char *url, int flags)
 out:
 	xfree(local_filename);
 	wget_thread_mutex_unlock(downloader_mutex);
+	wget_iri_free(&orig_iri);
 	plugin_db_forward_url_verdict_free(&plugin_verdict);
+
+	if (robots_cached)
+		_add_sitemaps(NULL, host->robots);
+
+	if (partition >= 0) {
+		// iri is owned by the blacklist, its URI is absolute and UTF-8 encoded
+		if (partition_forward(partition, iri->uri, job ? job->iri->uri : NULL, job ? job->level : 0, flags | URL_FLG_FORWARDED))
+			info_printf(_("URL '%s' not followed (failed to forward to partition %d)\n"), url, partition);
+	}
+
+	return queued;
+}
+
+// Add a URL, the new job joins the daemon batch (may be NULL)
+// Needs to be thread-safe
+// Returns 1 if a new job has been queued, else 0.
+static int _add_url_to_batch(JOB *job, DAEMON_BATCH *batch, const char *encoding, const char *url, int flags)
+{
+	struct plugin_db_forward_url_verdict plugin_verdict;
+	wget_iri *iri;
+
+	if (!(iri = _parse_url(job, encoding, url, flags)))
+		return 0;
+
+	// Allow plugins to intercept URL
+	plugin_db_forward_url(iri, &plugin_verdict);
+
+	return _add_url(job, batch, encoding, url, flags, iri, &plugin_verdict);
+}
+
+// Add URLs parsed from downloaded files
+// Needs to be thread-safe
+// Returns 1 if a new job has been queued, else 0.
+static int add_url(JOB *job, const char *encoding, const char *url, int flags)
+{
+	return _add_url_to_batch(job, job ? job->batch : NULL, encoding, url, flags);
+}
+
+// Add all URLs parsed from one downloaded file, plugins get them as one batch
+// Needs to be thread-safe
+static void add_urls(JOB *job, const char *encoding, wget_vector *urls, int flags)
+{
+	int n = wget_vector_size(urls), n_iris = 0;
+
+	if (n <= 0)
+		return;
+
+	wget_iri **iris = wget_malloc(n * sizeof(wget_iri *));
+	const char **iri_urls = wget_malloc(n * sizeof(char *));
+	struct plugin_db_forward_url_verdict *verdicts = wget_malloc(n * sizeof(struct plugin_db_forward_url_verdict));
+
+	for (int it = 0; it < n; it++) {
+		const char *url = wget_vector_get(urls, it);
+
+		if ((iris[n_iris] = _parse_url(job, encoding, url, flags)))
+			iri_urls[n_iris++] = url;
+	}
+
+	// Allow plugins to intercept the URLs
+	plugin_db_forward_urls((const wget_iri **) iris, verdicts, n_iris);
+
+	for (int it = 0; it < n_iris; it++)
+		_add_url(job, job ? job->batch : NULL, encoding, iri_urls[it], flags, iris[it], &verdicts[it]);
+
+	xfree(verdicts);
+	xfree(iri_urls);
+	xfree(iris);
+}
+
+// take the data out of a heap allocated buffer and free the buffer
+static char *_buffer_take_data(wget_buffer **buf, size_t *length)
+{
+	char *data;
+
+	*length = (*buf)->length;
+
+	if ((*buf)->release_data) {
+		data = wget_realloc((*buf)->data, *length + 1); // give back the unused capacity
+		(*buf)->release_data = 0;
+	} else
+		data = wget_memdup((*buf)->data, *length + 1);
+
+	wget_buffer_free(buf);
+
+	return data;
 }
 
 static void _convert_links(void)
 {
 	FILE *fpout = NULL;
+	wget_buffer *converted = NULL; // converted document for --archive
 	wget_buffer buf;
 	char sbuf[1024];
 
@@ -1116,12 +1428,19 @@ static void _convert_links(void)
 	// cycle through all documents where links have been found
 	for (int it = 0; it < wget_vector_size(conversions); it++) {
 		_conversion_t *conversion = wget_vector_get(conversions, it);
-		const char *data, *data_ptr;
+		char *data;
+		const char *data_ptr;
 		size_t data_length;
+		int64_t mtime = 0;
 
 		wget_info_printf(_("convert %s %s %s\n"), conversion->filename, conversion->base_url->uri, conversion->encoding);
 
-		if (!(data = data_ptr = wget_read_file(conversion->filename, &data_length))) {
+		if (config.archive)
+			data_ptr = data = archive_take_deferred(conversion->filename, &data_length, &mtime);
+		else
+			data_ptr = data = wget_read_file(conversion->filename, &data_length);
+
+		if (!data) {
 			wget_error_printf(_("%s not found (%d)\n"), conversion->filename, errno);
 			continue;
 		}
@@ -1147,7 +1466,7 @@ static void _convert_links(void)
 
 				const char *filename = get_local_filename(iri);
 
-				if (access(filename, W_OK) == 0) {
+				if (config.archive ? archive_contains(filename) : access(filename, W_OK) == 0) {
 					const char *linkpath = filename, *dir = NULL, *p1, *p2;
 					const char *docpath = conversion->filename;
 
@@ -1176,8 +1495,21 @@ static void _convert_links(void)
 				}
 
 				if (buf.length != url->len || strncmp(buf.data, url->p, url->len)) {
-					// conversion takes place, write to disk
-					if (!fpout) {
+					// conversion takes place, write to disk (or collect for the archive)
+					if (config.archive) {
+						if (!converted) {
+							if (config.backup_converted) {
+								char dstfile[strlen(conversion->filename) + 5 + 1];
+
+								wget_snprintf(dstfile, sizeof(dstfile), "%s.orig", conversion->filename);
+								archive_add(dstfile, wget_memdup(data, data_length), data_length, mtime, 0);
+							}
+							converted = wget_buffer_alloc(data_length + 1024);
+						}
+						wget_buffer_memcat(converted, data_ptr, url->p - data_ptr);
+						wget_buffer_memcat(converted, buf.data, buf.length);
+						data_ptr = url->p + url->len;
+					} else if (!fpout) {
 						if (config.backup_converted) {
 							char dstfile[strlen(conversion->filename) + 5 + 1];
 
@@ -1205,6 +1537,14 @@ static void _convert_links(void)
 			fwrite(data_ptr, 1, (data + data_length) - data_ptr, fpout);
 			fclose(fpout);
 			fpout = NULL;
+		} else if (converted) {
+			size_t length;
+
+			wget_buffer_memcat(converted, data_ptr, (data + data_length) - data_ptr);
+			archive_add(conversion->filename, _buffer_take_data(&converted, &length), length, mtime, 0);
+		} else if (config.archive) {
+			archive_add(conversion->filename, data, data_length, mtime, 0);
+			data = NULL;
 		}
 
 		xfree(data);
@@ -1232,7 +1572,7 @@ static void print_progress_report(long long start_time)
 		char quota_buf[16];
 		char speed_buf[16];
 		char rs_type = (config.report_speed == WGET_REPORT_SPEED_BYTES) ? 'B' : 'b';
-		long long tdiff = wget_get_timemillis() - start_time;
+		long long tdiff = wget_get_monotonic_millis() - start_time;
 		if (!tdiff) tdiff = 1;
 		// The time is in milliseconds, so upscale
 		unsigned int mod = 1000 * ((config.report_speed == WGET_REPORT_SPEED_BYTES) ? 1 : 8);
@@ -1254,6 +1594,83 @@ static void print_progress_report(long long start_time)
 	}
 }
 
+// Called from the daemon thread when a new batch starts.
+// Host failures of earlier batches must not block the new one.
+static void daemon_batch_start(void)
+{
+	hosts_unblock();
+}
+
+// Called from the daemon thread for each URL of a batch.
+// Just like input_thread() no blacklisting is done, so later batches may download a resource again.
+static void daemon_add_url(const char *url, DAEMON_BATCH *batch)
+{
+	add_url_to_queue(url, config.base, config.local_encoding, URL_FLG_NO_BLACKLISTING, batch);
+
+	if (nthreads < config.max_threads && nthreads < queue_size())
+		// wake up main thread to recalculate # of workers
+		wget_thread_cond_signal(main_cond);
+	else
+		// wake up all workers to check for
+		wget_thread_cond_signal(worker_cond);
+}
+
+static void daemon_quit(void)
+{
+	terminate = 1;
+	wget_thread_cond_signal(main_cond);
+}
+
+static wget_stringmap
+	*forward_referers; // referer IRIs of forwarded URLs, referenced by the jobs until the queue runs empty
+
+static void _free_referer(wget_iri *iri)
+{
+	wget_iri_free(&iri);
+}
+
+// Called from the partition reader thread for each URL forwarded by another partition.
+static void partition_add_url(const char *url, const char *referer, int level, int flags)
+{
+	JOB job_buf, *job = NULL;
+	wget_iri *iri = NULL;
+
+	if (referer) {
+		if (!forward_referers) {
+			forward_referers = wget_stringmap_create(128);
+			wget_stringmap_set_value_destructor(forward_referers, (wget_stringmap_value_destructor_t *) _free_referer);
+		}
+
+		if (!wget_stringmap_get(forward_referers, referer, &iri) && (iri = wget_iri_parse(referer, "utf-8")))
+			wget_stringmap_put(forward_referers, wget_strdup(referer), iri);
+	}
+
+	if (iri) {
+		// a stand-in for the job on the other partition that found the URL
+		job = memset(&job_buf, 0, sizeof(job_buf));
+		job->iri = iri;
+		job->level = level;
+	}
+
+	add_url(job, "utf-8", url, flags);
+
+	if (nthreads < config.max_threads && nthreads < queue_size())
+		// wake up main thread to recalculate # of workers
+		wget_thread_cond_signal(main_cond);
+}
+
+// Called by partition_done() with the partition mutex held, so no URL is added meanwhile.
+static int partition_idle(void)
+{
+	if (!queue_empty())
+		return 0;
+
+	// no job references the referers of forwarded URLs anymore
+	wget_stringmap_clear(forward_referers);
+
+	return 1;
+}
+
 int main(int argc, const char **argv)
 {
 	int n, rc;
@@ -1269,8 +1686,25 @@ int main(int argc, const char **argv)
 	}
 	set_exit_status(WG_EXIT_STATUS_NO_ERROR);
 
+	if (config.daemon_submit) {
+		// client mode: let a running daemon do the work
+		if ((rc = daemon_submit(config.daemon_submit, argv + n, argc - n, config.input_file)) < 0)
+			set_exit_status(WG_EXIT_STATUS_GENERIC);
+		else if (rc > 0)
+			set_exit_status(WG_EXIT_STATUS_REMOTE);
+		goto out;
+	}
+
+	if (config.partitions > 1) {
+		// fork before any thread is started, all processes read the same start URLs
+		if (partition_start(config.partitions, partition_add_url)) {
+			set_exit_status(WG_EXIT_STATUS_GENERIC);
+			goto out;
+		}
+	}
+
 	for (; n < argc; n++) {
-		add_url_to_queue(argv[n], config.base, config.local_encoding, 0);
+		add_url_to_queue(argv[n], config.base, config.local_encoding, 0, NULL);
 	}
 
 	if (config.input_file) {
@@ -1314,7 +1748,7 @@ int main(int argc, const char **argv)
 					// debug_printf("len=%zd url=%s\n", len, buf);
 
 					url[len] = 0;
-					add_url_to_queue(buf, config.base, config.input_encoding, 0);
+					add_url_to_queue(buf, config.base, config.input_encoding, 0, NULL);
 				}
 				xfree(buf);
 			} else {
@@ -1338,7 +1772,7 @@ int main(int argc, const char **argv)
 					// debug_printf("len=%zd url=%s\n", len, buf);
 
 					url[len] = 0;
-					add_url_to_queue(url, config.base, config.input_encoding, 0);
+					add_url_to_queue(url, config.base, config.input_encoding, 0, NULL);
 				}
 				xfree(buf);
 				close(fd);
@@ -1347,11 +1781,33 @@ int main(int argc, const char **argv)
 		}
 	}
 
-	if (queue_size() == 0 && !input_tid) {
+	if (config.daemon && daemon_start(config.daemon, daemon_batch_start, daemon_add_url, daemon_quit)) {
+		set_exit_status(WG_EXIT_STATUS_GENERIC);
+		goto out;
+	}
+
+	if (queue_size() == 0 && !input_tid && !config.daemon && config.partitions <= 1) {
 		error_printf(_("Nothing to do - goodbye\n"));
 		goto out;
 	}
 
+	if (config.archive) {
+		int rc;
+
+		// each partition process writes its own archive
+		if (config.partitions > 1) {
+			char *fname = wget_aprintf("%s.%d", config.archive, partition_self());
+			rc = archive_open(fname, config.archive_format);
+			xfree(fname);
+		} else
+			rc = archive_open(config.archive, config.archive_format);
+
+		if (rc) {
+			set_exit_status(WG_EXIT_STATUS_IO);
+			goto out;
+		}
+	}
+
 	// At this point, all values have been initialized and all URLs read.
 	// Perform any sanity checking or extra initialization here.
 
@@ -1380,7 +1836,7 @@ int main(int argc, const char **argv)
 	if (config.progress) {
 		if (bar_init()) {
 			wget_logger_set_stream(wget_get_logger(WGET_LOGGER_INFO), NULL);
-			start_time = wget_get_timemillis();
+			start_time = wget_get_monotonic_millis();
 		}
 	}
 
@@ -1390,8 +1846,16 @@ int main(int argc, const char **argv)
 
 	while (!terminate) {
 		// queue_print();
-		if (queue_empty() && !input_tid) {
-			break;
+		if (config.partitions > 1) {
+			// wait until all partitions are idle
+			if (partition_done(partition_idle))
+				break;
+		} else if (queue_empty() && !input_tid) {
+			if (!config.daemon)
+				break;
+
+			host_remove_blocked_batch_jobs(); // report jobs that can't be downloaded
+			daemon_flush(); // finish batches with jobs that can't be downloaded
 		}
 
 		for (;nthreads < config.max_threads && nthreads < queue_size(); nthreads++) {
@@ -1418,13 +1882,15 @@ int main(int argc, const char **argv)
 		}
 
 		// here we sit and wait for an event from our worker threads
-		wget_thread_cond_wait(main_cond, main_mutex, 0);
+		// (partitions poll, since other processes don't signal us)
+		wget_thread_cond_wait(main_cond, main_mutex, config.partitions > 1 ? 100 : 0);
 		debug_printf("%s: wake up\n", __func__);
 	}
 	debug_printf("%s: done\n", __func__);
 
-	// stop downloaders
+	// stop downloaders (and other partitions if we stop early)
 	terminate = 1;
+	partition_abort();
 	wget_thread_cond_signal(worker_cond);
 	wget_thread_mutex_unlock(main_mutex);
 
@@ -1436,18 +1902,57 @@ int main(int argc, const char **argv)
 			error_printf(_("Failed to wait for downloader #%d (%d %d)\n"), n, rc, errno);
 	}
 
+	daemon_stop();
+
 	print_progress_report(start_time);
-	if (!config.progress && (config.recursive || config.page_requisites || (config.input_file && quota != 0)) && quota) {
+	if (config.partitions > 1) {
+		PARTITION_STATS own = {
+			.bytes = quota,
+			.downloads = stats.ndownloads,
+			.redirects = stats.nredirects,
+			.errors = stats.nerrors,
+			.traps = trap_rejected()
+		}, total;
+
+		// the first partition waits for all others and prints the summary
+		if ((rc = partition_exit(&own, &total)) > 0)
+			set_exit_status((exit_status_t) rc);
+
+		if (partition_self() == 0 && (config.recursive || config.page_requisites || config.input_file) && total.bytes) {
+			info_printf(_("Downloaded: %d files, %s bytes, %d redirects, %d errors\n"),
+				total.downloads, wget_human_readable(quota_buf, sizeof(quota_buf), total.bytes), total.redirects, total.errors);
+			if (total.traps)
+				info_printf(_("Crawler traps: %d URLs or pages rejected\n"), total.traps);
+		}
+	} else if (!config.progress && (config.recursive || config.page_requisites || (config.input_file && quota != 0)) && quota) {
 		info_printf(_("Downloaded: %d files, %s bytes, %d redirects, %d errors\n"),
 			stats.ndownloads, wget_human_readable(quota_buf, sizeof(quota_buf), quota), stats.nredirects, stats.nerrors);
+		if (stats.bytes_body_skipped)
+			info_printf(_("Skipped: %s bytes of unneeded response bodies\n"),
+				wget_human_readable(quota_buf, sizeof(quota_buf), stats.bytes_body_skipped));
 	}
 
+	if (config.partitions <= 1)
+		trap_print();
+
+	if (config.redirect_cache)
+		debug_printf("Redirect cache: %d hits, %d entries\n", redirect_cache_hits(), redirect_cache_size());
+
 	if (config.save_cookies)
 		wget_cookie_db_save(config.cookie_db, config.save_cookies);
 
 	if (config.hsts && config.hsts_file && hsts_changed)
 		wget_hsts_db_save(config.hsts_db);
 
+	if (config.redirect_cache && config.redirect_cache_file && redirect_cache_size())
+		redirect_cache_save(config.redirect_cache_file);
+
+	if (config.robots && config.robots_cache_file)
+		robots_cache_save(config.robots_cache_file);
+
+	if (config.dictionary_dir)
+		dictionary_save();
+
 	if (config.hpkp && config.hpkp_file && hpkp_changed)
 		wget_hpkp_db_save(config.hpkp_db);
 
@@ -1465,16 +1970,32 @@ int main(int argc, const char **argv)
 
 	if (config.convert_links && !config.delete_after) {
 		_convert_links();
-		wget_vector_free(&conversions);
+		if (_full_teardown(argv[0]))
+			wget_vector_free(&conversions);
+		memory_account(MEMORY_CONVERSION, -conversion_memory);
 	}
 
+	if (config.archive)
+		archive_close();
+
 	if (config.stats_site_args)
 		site_stats_print();
 
+	if (config.stats_redirect_args)
+		redirect_cache_print_stats(config.stats_redirect_args->fp, config.stats_redirect_args->format);
+
+	memory_print();
+
  out:
-	if (is_testing() || wget_match_tail(argv[0], "wget2_noinstall")) {
+	if (_full_teardown(argv[0])) {
 		// freeing to avoid disguising valgrind output
 		blacklist_free();
+		redirect_cache_free();
+		robots_cache_free();
+		canon_free();
+		dictionary_free();
+		trap_free();
+		archive_free();
 		hosts_free();
 		host_ips_free();
 		xfree(downloaders);
@@ -1484,6 +2005,7 @@ int main(int argc, const char **argv)
 		wget_vector_free(&parents);
 		wget_hashmap_free(&known_urls);
 		wget_stringmap_free(&etags);
+		wget_stringmap_free(&forward_referers);
 
 		deinit();
 		_wget_deinit(); // destroy any resources belonging to this object file
@@ -1515,7 +2037,7 @@ void *input_thread(void *p G_GNUC_WGET_UNUSED)
 	char *buf = NULL;
 
 	while ((len = wget_fdgetline(&buf, &bufsize, STDIN_FILENO)) >= 0) {
-		add_url_to_queue(buf, config.base, config.local_encoding, URL_FLG_NO_BLACKLISTING);
+		add_url_to_queue(buf, config.base, config.local_encoding, URL_FLG_NO_BLACKLISTING, NULL);
 
 		if (nthreads < config.max_threads && nthreads < queue_size())
 			// wake up main thread to recalculate # of workers
@@ -1536,6 +2058,17 @@ void *input_thread(void *p G_GNUC_WGET_UNUSED)
 	return NULL;
 }
 
+// estimated memory of a connection: receive buffer, socket and TLS buffers
+#define CONNECTION_MEMORY (128 * 1024)
+
+static void close_connection(DOWNLOADER *downloader)
+{
+	memory_account(MEMORY_CONNECTION, -downloader->conn_memory);
+	downloader->conn_memory = 0;
+
+	wget_http_close(&downloader->conn);
+}
+
 static int try_connection(DOWNLOADER *downloader, wget_iri *iri)
 {
 	wget_http_connection *conn;
@@ -1572,10 +2105,25 @@ static int try_connection(DOWNLOADER *downloader, wget_iri *iri)
 		}
 
 		debug_printf("close connection %s\n", wget_http_get_host(conn));
-		wget_http_close(&downloader->conn);
+		close_connection(downloader);
 	}
 
-	if ((rc = wget_http_open(&downloader->conn, iri)) == WGET_E_SUCCESS) {
+	HOST *host = config.adaptive_timeout ? host_get(iri) : NULL;
+
+	if (host) {
+		long long start = wget_get_monotonic_millis();
+
+		if ((rc = wget_http_open_timeout(&downloader->conn, iri, host_connect_timeout(host))) == WGET_E_SUCCESS) {
+			host_connect_sample(host, wget_get_monotonic_millis() - start);
+			wget_http_set_timeout(downloader->conn, host_read_timeout(host));
+		}
+	} else
+		rc = wget_http_open(&downloader->conn, iri);
+
+	if (rc == WGET_E_SUCCESS) {
+		downloader->conn_memory = CONNECTION_MEMORY;
+		memory_account(MEMORY_CONNECTION, downloader->conn_memory);
+
 		debug_printf("established connection %s\n",
 			wget_http_get_host(downloader->conn));
 	} else {
@@ -1585,6 +2133,15 @@ static int try_connection(DOWNLOADER *downloader, wget_iri *iri)
 	return rc;
 }
 
+// give back the parts that have been claimed together with 'part' for a multi-range request
+static void release_ranges(PART *part)
+{
+	for (PART *next = part->next; next; next = next->next)
+		next->inuse = 0;
+
+	part->next = NULL;
+}
+
 static int establish_connection(DOWNLOADER *downloader, wget_iri **iri)
 {
 	int rc = WGET_E_UNKNOWN;
@@ -1629,7 +2186,11 @@ static int establish_connection(DOWNLOADER *downloader, wget_iri **iri)
 				if (rc == WGET_E_SUCCESS) {
 
 					// Add mirror URI to hosts
-					host_add(mirror->iri);
+					HOST *host = host_add(mirror->iri);
+
+					// fall back to single ranges for servers that failed on multi-range requests
+					if (part->next && host && host->single_range)
+						release_ranges(part);
 
 					if (iri)
 						*iri = mirror->iri;
@@ -1646,14 +2207,14 @@ static int establish_connection(DOWNLOADER *downloader, wget_iri **iri)
 
 	if (rc == WGET_E_HANDSHAKE || rc == WGET_E_CERTIFICATE || rc == WGET_E_TLS_DISABLED) {
 		// TLS  failure
-		wget_http_close(&downloader->conn);
+		close_connection(downloader);
 		if (!downloader->job->http_fallback) {
 			host_final_failure(downloader->job->host);
 			set_exit_status(WG_EXIT_STATUS_TLS);
 		}
 	} else if (rc == WGET_E_CONNECT) {
 		/* failed to connect */
-		wget_http_close(&downloader->conn);
+		close_connection(downloader);
 		if (!config.retry_connrefused && !downloader->job->http_fallback) {
 			host_final_failure(downloader->job->host);
 			set_exit_status(WG_EXIT_STATUS_NETWORK);
@@ -1680,6 +2241,9 @@ static void add_statistics(wget_http_response *resp)
 	else
 		_atomic_increment_int(&stats.nerrors);
 
+	if (resp->body_skipped)
+		_fetch_and_add_longlong(&stats.bytes_body_skipped, (long long) resp->body_skipped);
+
 	if (config.stats_site_args)
 		stats_site_add(resp, NULL);
 }
@@ -1723,7 +2287,7 @@ static int process_response_header(wget_http_response *resp)
 	// For HTTP2 connections this flag is always set.
 	debug_printf("keep_alive=%d\n", resp->keep_alive);
 	if (!resp->keep_alive)
-		wget_http_close(&downloader->conn);
+		close_connection(downloader);
 
 	// do some statistics
 	add_statistics(resp);
@@ -1803,6 +2367,15 @@ static int process_response_header(wget_http_response *resp)
 
 		wget_iri_relative_to_abs(iri, resp->location, strlen(resp->location), &uri_buf);
 
+		if (uri_buf.length && config.redirect_cache && (resp->code == 301 || resp->code == 308)) {
+			wget_iri *target = wget_iri_parse(uri_buf.data, "utf-8");
+
+			if (target && (target->scheme == WGET_IRI_SCHEME_HTTP || target->scheme == WGET_IRI_SCHEME_HTTPS))
+				redirect_cache_add(iri, target, config.redirect_cache_maxage);
+
+			wget_iri_free(&target);
+		}
+
 		if (uri_buf.length)
 			add_url(job, "utf-8", uri_buf.data, URL_FLG_REDIRECTION);
 
@@ -1896,14 +2469,18 @@ static void process_response_part(wget_http_response *resp)
 	DOWNLOADER *downloader = job->downloader;
 	PART *part = job->part;
 
-	// just update number bytes read (body only) for display purposes
-	if (resp->body)
-		quota_modify_read(resp->cur_downloaded);
-
 	if (resp->code != 200 && resp->code != 206) {
 		print_status(downloader, "part %d download error %d\n", part->id, resp->code);
 	} else if (!resp->body) {
 		print_status(downloader, "part %d download error 'empty body'\n", part->id);
+	} else if (part->next) {
+		// multi-range request: the parts are written to the file as their ranges come in
+		for (PART *p = part; p; p = p->next) {
+			if (p->received) {
+				print_status(downloader, "part %d downloaded\n", p->id);
+				p->done = 1;
+			}
+		}
 	} else if (resp->body->length != (size_t)part->length) {
 		print_status(downloader, "part %d download error '%zu bytes of %lld expected'\n",
 			part->id, resp->body->length, (long long)part->length);
@@ -1912,6 +2489,30 @@ static void process_response_part(wget_http_response *resp)
 		part->done = 1; // set this when downloaded ok
 	}
 
+	if (part->next) {
+		bool all_received = 1;
+
+		for (PART *p = part->next; p; p = p->next) {
+			if (!p->done) {
+				print_status(downloader, "part %d failed\n", p->id);
+				p->inuse = 0; // reload again later
+				all_received = 0;
+			}
+		}
+
+		// the server ignored or rejected the multi-range request, use single ranges from now on
+		if ((!part->done || !all_received) && !resp->content_type_boundary) {
+			HOST *host = host_get(job->iri);
+
+			if (host && !host->single_range) {
+				debug_printf("%s does not support multi-range requests\n", job->iri->host);
+				host->single_range = 1;
+			}
+		}
+
+		part->next = NULL;
+	}
+
 	if (part->done) {
 		// check if all parts are done (downloaded + hash-checked)
 		int all_done = 1, it;
@@ -1939,6 +2540,7 @@ static void process_response_part(wget_http_response *resp)
 					bar_print(downloader->id, "Checksum OK");
 				else
 					debug_printf("checksum ok\n");
+				zsync_commit(job);
 				job->done = 1; // we are done with this job, main state machine will remove it
 			} else {
 				if (config.progress)
@@ -1958,10 +2560,6 @@ static void process_response(wget_http_response *resp)
 	JOB *job = resp->req->user_data;
 	int process_decision = 0, recurse_decision = 0;
 
-	// just update number bytes read (body only) for display purposes
-	if (resp->body)
-		quota_modify_read(resp->cur_downloaded);
-
 	// check if we got a RFC 6249 Metalink response
 	// HTTP/1.1 302 Found
 	// Date: Fri, 20 Apr 2012 15:00:40 GMT
@@ -2049,6 +2647,27 @@ static void process_response(wget_http_response *resp)
 		}
 	}
 
+	if (config.zsync && resp->code == 200 && job->local_filename && !config.output_document
+		&& zsync_is_control(resp->content_type, job->iri))
+	{
+		// update the target file from the local copy and fetch the missing blocks
+		wget_vector *parts;
+
+		if ((job->metalink = zsync_prepare(job->iri, job->local_filename,
+			config.chunk_size ? (off_t) config.chunk_size : 1024 * 1024, &parts, &job->zsync_target)))
+		{
+			job->parts = parts;
+
+			if (wget_vector_size(parts) || !job_validate_file(job)) {
+				// wake up sleeping workers
+				wget_thread_cond_signal(worker_cond);
+				job->done = 0; // do not remove this job from queue yet
+			} else
+				zsync_commit(job);
+		}
+		return;
+	}
+
 	// Forward response to plugins
 	if (resp->code == 200 || resp->code == 206 || resp->code == 416 || (resp->code == 304 && config.timestamping)) {
 		process_decision = job->local_filename || resp->body ? 1 : 0;
@@ -2091,23 +2710,30 @@ static void process_response(wget_http_response *resp)
 		}
 	}
 
+	// keep the file as compression dictionary for later downloads
+	if (config.dictionary_dir && resp->code == 200 && resp->use_as_dictionary
+		&& job->local_filename && !config.output_document && !config.spider)
+	{
+		dictionary_add(job->iri, resp->use_as_dictionary, job->local_filename);
+	}
+
 	if (job->robotstxt &&
-			// Only if a file was downloaded
-			resp->body &&
+			// Only if the cached rules are still valid or a file was downloaded
+			((config.robots_cache_file && robots_cache_update(job->iri, resp, &job->host->robots)) ||
 			// Parse the robots file and only if it was successful
-			(wget_robots_parse(&job->host->robots, resp->body->data, PACKAGE_NAME) == WGET_E_SUCCESS) &&
-			// Sitemaps are not relevant as page requisites
-			!config.page_requisites)
+			(resp->body && wget_robots_parse(&job->host->robots, resp->body->data, PACKAGE_NAME) == WGET_E_SUCCESS)))
 	{
-		// add sitemaps to be downloaded (format https://www.sitemaps.org/protocol.html)
-		for (int it = 0, n = wget_robots_get_sitemap_count(job->host->robots); it < n; it++) {
-			const char *sitemap = wget_robots_get_sitemap(job->host->robots, it);
-			debug_printf("adding sitemap '%s'\n", sitemap);
-			add_url(job, "utf-8", sitemap, URL_FLG_SITEMAP); // see https://www.sitemaps.org/protocol.html#escaping
-		}
+		_add_sitemaps(job, job->host->robots);
 	} else if (resp->code == 200 || resp->code == 206) {
 		if (process_decision && recurse_decision) {
-			if (resp->content_type && resp->body) {
+			if (job->body_spilled && trap_check_content_file(job->iri, job->sig_filename)) {
+				info_printf(_("Links of '%s' not followed (same content as an earlier page)\n"), job->iri->uri);
+			} else if (job->body_spilled) {
+				// the body was not kept in memory, see _get_body()
+				parse_localfile(job, job->sig_filename, resp->content_type_encoding ? resp->content_type_encoding : config.remote_encoding, resp->content_type, job->iri);
+			} else if (resp->content_type && resp->body && trap_check_content(job->iri, resp->body->data, resp->body->length)) {
+				info_printf(_("Links of '%s' not followed (same content as an earlier page)\n"), job->iri->uri);
+			} else if (resp->content_type && resp->body) {
 				if (!wget_strcasecmp_ascii(resp->content_type, "text/html")) {
 					html_parse(job, job->level, resp->body->data, resp->body->length, resp->content_type_encoding ? resp->content_type_encoding : config.remote_encoding, job->iri);
 				} else if (!wget_strcasecmp_ascii(resp->content_type, "application/xhtml+xml")) {
@@ -2210,7 +2836,13 @@ static void _fallback_to_http(JOB *job)
 {
 	if (!job->robotstxt) {
 		char *http_url = wget_aprintf("http://%s", job->iri->uri + 8);
-		add_url(NULL, "utf-8", http_url, URL_FLG_SKIPFALLBACK);
+
+		// the fallback job is added like a start URL, but joins the daemon batch of this job
+		if (!_add_url_to_batch(NULL, job->batch, "utf-8", http_url, URL_FLG_SKIPFALLBACK) && job->batch)
+			daemon_batch_job_done(job->batch, 0, job->iri->uri);
+		else if (job->batch)
+			daemon_batch_job_release(job->batch);
+
 		host_remove_job(job->host, job);
 		xfree(http_url);
 	} else {
@@ -2218,6 +2850,49 @@ static void _fallback_to_http(JOB *job)
 	}
 }
 
+// pass the body memory of a downloader on to the memory budget
+static void _report_body_memory(DOWNLOADER *downloader)
+{
+	memory_account(MEMORY_BODY, downloader->body_memory - downloader->body_reported);
+	downloader->body_reported = downloader->body_memory;
+}
+
+// free a response and release its body from the memory accounting
+// whether an archive entry has to wait for link conversion, see archive_take_deferred()
+static bool _archive_defer(wget_http_response *resp)
+{
+	return config.convert_links && !config.delete_after && resp->content_type
+		&& (!wget_strcasecmp_ascii(resp->content_type, "text/html")
+		|| !wget_strcasecmp_ascii(resp->content_type, "application/xhtml+xml")
+		|| !wget_strcasecmp_ascii(resp->content_type, "text/css"));
+}
+
+// hand the body of a processed response over to the archive (without copying)
+static void _archive_response(DOWNLOADER *downloader, JOB *job, wget_http_response *resp)
+{
+	size_t length;
+	char *data;
+
+	downloader->body_memory -= resp->body->size;
+	_report_body_memory(downloader);
+
+	data = _buffer_take_data(&resp->body, &length);
+	archive_add(job->archive_name, data, length, resp->last_modified, _archive_defer(resp));
+
+	xfree(job->archive_name);
+}
+
+static void _free_response(DOWNLOADER *downloader, wget_http_response **resp)
+{
+	if ((*resp)->body) {
+		downloader->body_memory -= (*resp)->body->size;
+		_report_body_memory(downloader);
+	}
+
+	wget_http_free_request(&(*resp)->req);
+	wget_http_free_response(resp);
+}
+
 enum actions {
 	ACTION_GET_JOB = 1,
 	ACTION_GET_RESPONSE = 2,
@@ -2230,7 +2905,7 @@ void *downloader_thread(void *p)
 	wget_http_response *resp = NULL;
 	JOB *job;
 	HOST *host = NULL;
-	int pending = 0, max_pending = 1, locked;
+	int pending = 0, max_pending = 1, locked, status;
 	long long pause = 0;
 	enum actions action = ACTION_GET_JOB;
 	char http_code[7];
@@ -2244,12 +2919,27 @@ void *downloader_thread(void *p)
 
 		switch (action) {
 		case ACTION_GET_JOB: // Get a job, connect, send request
+			// near the memory budget, finish the requests in flight before sending new ones.
+			// One downloader keeps going, so that memory held by queued jobs doesn't stall us.
+			if (memory_pressure()) {
+				if (pending) {
+					wget_thread_mutex_unlock(main_mutex); locked = 0;
+					action = ACTION_GET_RESPONSE;
+					break;
+				}
+
+				if (downloader->id > 0 && wget_thread_support()) {
+					wget_thread_cond_wait(worker_cond, main_mutex, 100); locked = 1;
+					break;
+				}
+			}
+
 			if (!(job = host_get_job(host, &pause))) {
 				if (pending) {
 					wget_thread_mutex_unlock(main_mutex); locked = 0;
 					action = ACTION_GET_RESPONSE;
 				} else if (host) {
-					wget_http_close(&downloader->conn);
+					close_connection(downloader);
 					host = NULL;
 				} else {
 					if (!wget_thread_support()) {
@@ -2328,8 +3018,7 @@ void *downloader_thread(void *p)
 				wget_snprintf(http_code, sizeof(http_code), "%d", resp->code);
 				if (check_mime_list(config.http_retry_on_status, http_code)) {
 					print_status(downloader, "Got a HTTP Code %d. Retrying...", resp->code);
-					wget_http_free_request(&resp->req);
-					wget_http_free_response(&resp);
+					_free_response(downloader, &resp);
 				}
 			}
 
@@ -2340,10 +3029,19 @@ void *downloader_thread(void *p)
 				break;
 			}
 
-			host_reset_failure(host);
-
 			job = resp->req->user_data;
 
+			// the connection broke within the body, try again from where the file ends
+			if (resp->truncated && job->if_range && !terminate) {
+				print_status(downloader, "Transfer of %s interrupted, resuming\n", job->iri->uri);
+				_free_response(downloader, &resp);
+				host_increase_failure(host);
+				action = ACTION_ERROR;
+				break;
+			}
+
+			host_reset_failure(host);
+
 			// general response check to see if we need further processing
 			if (process_response_header(resp) == 0) {
 				if (job->head_first)
@@ -2354,13 +3052,18 @@ void *downloader_thread(void *p)
 					process_response(resp); // GET + POST request/response
 			}
 
-			wget_http_free_request(&resp->req);
-			wget_http_free_response(&resp);
+			if (job->archive_name && resp->body)
+				_archive_response(downloader, job, resp);
+
+			status = resp->code;
+			_free_response(downloader, &resp);
 
 			wget_thread_mutex_lock(main_mutex); locked = 1;
 
 			// download of single-part file complete, remove from job queue
 			if (job->done) {
+				if (job->batch)
+					daemon_batch_job_done(job->batch, status, job->iri->uri);
 				host_remove_job(host, job);
 			} else {
 				job->inuse = 0;
@@ -2374,7 +3077,11 @@ void *downloader_thread(void *p)
 			break;
 
 		case ACTION_ERROR:
-			wget_http_close(&downloader->conn);
+			close_connection(downloader);
+
+			// the bodies of the requests in flight are gone with the connection
+			downloader->body_memory = 0;
+			_report_body_memory(downloader);
 
 			wget_thread_mutex_lock(main_mutex); locked = 1;
 			host_release_jobs(host);
@@ -2394,7 +3101,7 @@ void *downloader_thread(void *p)
 out:
 	if (locked)
 		wget_thread_mutex_unlock(main_mutex);
-	wget_http_close(&downloader->conn);
+	close_connection(downloader);
 
 	// if we terminate, tell the other downloaders
 	wget_thread_cond_signal(worker_cond);
@@ -2422,8 +3129,16 @@ static void _remember_for_conversion(const char *filename, wget_iri *base_url, i
 	conversion->content_type = content_type;
 	conversion->parsed = parsed;
 
+	// rough estimate of what is kept until _convert_links()
+	long long size = sizeof(_conversion_t) + strlen(filename) + sizeof(wget_iri) + strlen(base_url->uri) * 2
+		+ sizeof(wget_html_parsed_result) + (long long) wget_vector_size(parsed->uris) * sizeof(wget_html_parsed_url);
+
+	memory_account(MEMORY_CONVERSION, size);
+
 	wget_thread_mutex_lock(conversion_mutex);
 
+	conversion_memory += size;
+
 	if (!conversions) {
 		conversions = wget_vector_create(128, NULL);
 		wget_vector_set_destructor(conversions, _free_conversion_entry);
@@ -2486,6 +3201,7 @@ static int _normalize_uri(wget_iri *base, wget_string *url, const char *encoding
 void html_parse(JOB *job, int level, const char *html, size_t html_len, const char *encoding, wget_iri *base)
 {
 	wget_iri *allocated_base = NULL;
+	wget_vector *urls;
 	const char *reason;
 	char *utf8 = NULL;
 	wget_buffer buf;
@@ -2564,6 +3280,7 @@ void html_parse(JOB *job, int level, const char *html, size_t html_len, const ch
 	info_printf(_("URI content encoding = '%s' (%s)\n"), encoding, reason);
 
 	wget_buffer_init(&buf, sbuf, sizeof(sbuf));
+	urls = wget_vector_create(32, NULL);
 
 	if (parsed->base.p) {
 		if (_normalize_uri(base, &parsed->base, encoding, &buf) == 0) {
@@ -2614,11 +3331,14 @@ void html_parse(JOB *job, int level, const char *html, size_t html_len, const ch
 		else {
 			// Blacklist for URLs before they are processed
 			if (wget_hashmap_put(known_urls, wget_strmemdup(buf.data, buf.length), NULL) == 0)
-				add_url(job, "utf-8", buf.data, page_requisites ? URL_FLG_REQUISITE : 0);
+				wget_vector_add(urls, wget_strmemdup(buf.data, buf.length));
 		}
 	}
 	wget_thread_mutex_unlock(known_urls_mutex);
 
+	add_urls(job, "utf-8", urls, page_requisites ? URL_FLG_REQUISITE : 0);
+	wget_vector_free(&urls);
+
 	wget_buffer_deinit(&buf);
 
 	if (convert_links && !config.delete_after) {
@@ -2651,11 +3371,12 @@ void html_parse_localfile(JOB *job, int level, const char *fname, const char *en
 
 void sitemap_parse_xml(JOB *job, const char *data, const char *encoding, wget_iri *base)
 {
-	wget_vector *urls, *sitemap_urls;
+	wget_vector *urls, *sitemap_urls, *found;
 	const char *p;
 	size_t baselen = 0;
 
 	wget_sitemap_get_urls_inline(data, &urls, &sitemap_urls);
+	found = wget_vector_create(32, NULL);
 
 	if (base) {
 		if ((p = strrchr(base->uri, '/')))
@@ -2684,11 +3405,16 @@ void sitemap_parse_xml(JOB *job, const char *data, const char *encoding, wget_ir
 			continue;
 		}
 
-		add_url(job, encoding, p, 0);
+		wget_vector_add(found, wget_strdup(p));
 	}
+	wget_thread_mutex_unlock(known_urls_mutex);
+
+	add_urls(job, encoding, found, 0);
+	wget_vector_clear(found);
 
 	// process the sitemap index urls here
 	info_printf(_("found %d sitemap url(s) (base=%s)\n"), wget_vector_size(sitemap_urls), base ? base->uri : NULL);
+	wget_thread_mutex_lock(known_urls_mutex);
 	for (int it = 0; it < wget_vector_size(sitemap_urls); it++) {
 		wget_string *url = wget_vector_get(sitemap_urls, it);
 
@@ -2701,10 +3427,13 @@ void sitemap_parse_xml(JOB *job, const char *data, const char *encoding, wget_ir
 			continue;
 		}
 
-		add_url(job, encoding, p, URL_FLG_SITEMAP);
+		wget_vector_add(found, wget_strdup(p));
 	}
 	wget_thread_mutex_unlock(known_urls_mutex);
 
+	add_urls(job, encoding, found, URL_FLG_SITEMAP);
+
+	wget_vector_free(&found);
 	wget_vector_free(&urls);
 	wget_vector_free(&sitemap_urls);
 	// wget_sitemap_free_urls_inline(&res);
@@ -2786,6 +3515,7 @@ void sitemap_parse_text(JOB *job, const char *data, const char *encoding, wget_i
 
 static void _add_urls(JOB *job, wget_vector *urls, const char *encoding, wget_iri *base)
 {
+	wget_vector *found;
 	const char *p;
 	size_t baselen = 0;
 
@@ -2798,6 +3528,7 @@ static void _add_urls(JOB *job, wget_vector *urls, const char *encoding, wget_ir
 
 	info_printf(_("found %d url(s) (base=%s)\n"), wget_vector_size(urls), base ? base->uri : NULL);
 
+	found = wget_vector_create(32, NULL);
 	wget_thread_mutex_lock(known_urls_mutex);
 	for (int it = 0; it < wget_vector_size(urls); it++) {
 		wget_string *url = wget_vector_get(urls, it);
@@ -2814,9 +3545,12 @@ static void _add_urls(JOB *job, wget_vector *urls, const char *encoding, wget_ir
 			continue;
 		}
 
-		add_url(job, encoding, p, 0);
+		wget_vector_add(found, wget_strdup(p));
 	}
 	wget_thread_mutex_unlock(known_urls_mutex);
+
+	add_urls(job, encoding, found, 0);
+	wget_vector_free(&found);
 }
 
 void atom_parse(JOB *job, const char *data, const char *encoding, wget_iri *base)
@@ -2907,16 +3641,26 @@ struct css_context {
 		*encoding;
 	wget_buffer
 		uri_buf;
+	wget_vector
+		*urls;
 	char
 		encoding_allocated;
 };
 
+// URLs are passed on in batches, each batch with the encoding it has been found with
+static void _css_add_urls(struct css_context *ctx)
+{
+	add_urls(ctx->job, ctx->encoding, ctx->urls, URL_FLG_REQUISITE);
+	wget_vector_clear(ctx->urls);
+}
+
 static void _css_parse_encoding(void *context, const char *encoding, size_t len)
 {
 	struct css_context *ctx = context;
 
 	// take only the first @charset rule
 	if (!ctx->encoding_allocated && wget_strncasecmp_ascii(ctx->encoding, encoding, len)) {
+		_css_add_urls(ctx);
 		ctx->encoding = wget_strmemdup(encoding, len);
 		ctx->encoding_allocated = 1;
 		info_printf(_("URI content encoding = '%s'\n"), ctx->encoding);
@@ -2935,7 +3679,7 @@ static void _css_parse_uri(void *context, const char *url, size_t len, size_t po
 	if (!ctx->base && !ctx->uri_buf.length)
 		info_printf(_("URL '%.*s' not followed (missing base URI)\n"), (int)len, url);
 	else
-		add_url(ctx->job, ctx->encoding, ctx->uri_buf.data, URL_FLG_REQUISITE);
+		wget_vector_add(ctx->urls, wget_strmemdup(ctx->uri_buf.data, ctx->uri_buf.length));
 }
 
 void css_parse(JOB *job, const char *data, size_t len, const char *encoding, wget_iri *base)
@@ -2945,11 +3689,14 @@ void css_parse(JOB *job, const char *data, size_t len, const char *encoding, wge
 	char sbuf[1024];
 
 	wget_buffer_init(&context.uri_buf, sbuf, sizeof(sbuf));
+	context.urls = wget_vector_create(32, NULL);
 
 	if (encoding)
 		info_printf(_("URI content encoding = '%s'\n"), encoding);
 
 	wget_css_parse_buffer(data, len, _css_parse_uri, _css_parse_encoding, &context);
+	_css_add_urls(&context);
+	wget_vector_free(&context.urls);
 
 	if (context.encoding_allocated)
 		xfree(context.encoding);
@@ -2964,11 +3711,14 @@ void css_parse_localfile(JOB *job, const char *fname, const char *encoding, wget
 	char sbuf[1024];
 
 	wget_buffer_init(&context.uri_buf, sbuf, sizeof(sbuf));
+	context.urls = wget_vector_create(32, NULL);
 
 	if (encoding)
 		info_printf(_("URI content encoding = '%s'\n"), encoding);
 
 	wget_css_parse_file(fname, _css_parse_uri, _css_parse_encoding, &context);
+	_css_add_urls(&context);
+	wget_vector_free(&context.urls);
 
 	if (context.encoding_allocated)
 		xfree(context.encoding);
@@ -3089,7 +3839,6 @@ static int G_GNUC_WGET_NONNULL((1)) _prepare_file(wget_http_response *resp, cons
 	char *alloced_fname = NULL;
 	int fd, multiple = 0, oflag = flag;
 	size_t fname_length;
-	long long old_quota;
 
 	if (!fname)
 		return -1;
@@ -3109,14 +3858,9 @@ static int G_GNUC_WGET_NONNULL((1)) _prepare_file(wget_http_response *resp, cons
 		return -1;
 	}
 
-	// - optimistic approach expects data being written without error
-	// - to be Wget compatible: quota_modify_read() returns old quota value
-	old_quota = quota_modify_read(config.save_headers ? resp->header->length : 0);
-
-	if (config.quota && old_quota >= config.quota) {
-		debug_printf("not saved '%s' (quota of %lld reached)\n", fname, config.quota);
-		return -1;
-	}
+	// the body is added to the quota while being received, see _get_body()
+	if (config.save_headers)
+		quota_modify_read(resp->header->length);
 
 	if (fname == config.output_document) {
 		// <fname> can only be NULL if config.delete_after is set
@@ -3203,6 +3947,13 @@ static int G_GNUC_WGET_NONNULL((1)) _prepare_file(wget_http_response *resp, cons
 		}
 	}
 
+	if (config.archive) {
+		// the body becomes an archive entry, see _archive_response() and _archive_spool()
+		*actual_file_name = wget_strdup(fname);
+		xfree(alloced_fname);
+		return -3;
+	}
+
 	wget_thread_mutex_lock(savefile_mutex);
 
 	fname_length += 16;
@@ -3327,28 +4078,194 @@ static int G_GNUC_WGET_NONNULL((1)) _prepare_file(wget_http_response *resp, cons
 	return fd;
 }
 
+// bodies larger than this are downgraded to background priority on HTTP/2
+#define HTTP2_LARGE_BODY (1024 * 1024)
+
+// bytes received between two reports of the body memory to the --max-memory accounting
+#define MEMORY_BATCH (256 * 1024)
+
+// a Last-Modified date is a strong validator if it is this many seconds older than the Date (RFC 9110 8.8.2.2)
+#define STRONG_LAST_MODIFIED 60
+
 // context used for header and body callback
 struct _body_callback_context {
 	JOB *job;
+	DOWNLOADER *downloader;
 	wget_buffer *body;
 	uint64_t max_memory;
 	uint64_t length;
+	uint64_t length_reported; // 'length' when the body memory was last reported, see _account_body()
+	size_t body_accounted; // size of 'body' accounted to the downloader
 	int outfd;
+	int archive_fd; // --archive: temporary file with a body too large to be kept in memory, else -1
 	int progress_slot;
 	long long limit_debt_bytes;
 	long long limit_prev_time_ms;
+	long long quota_reserved; // part of the quota reservation not yet received
+	uint64_t quota_accounted; // bytes of resp->cur_downloaded added to the quota
+	off_t range_start; // part downloads: file range written
+	off_t range_end; //   since the last seek
+	HOST *host; // --adaptive-timeout: host to account response times to
+	long long request_ts; // request sent
+	long long header_ts; // response header received
+	bool quota_exempt; // admitted without any quota used, never aborted
+	bool memory_pressure; // memory_pressure() at the last report, see _account_body()
 };
 
+// mark the parts of a multi-range request that are covered by the range just written
+static void _mark_received_parts(struct _body_callback_context *ctx)
+{
+	for (PART *part = ctx->job->part; part; part = part->next) {
+		if (part->position >= ctx->range_start && part->position + part->length <= ctx->range_end)
+			part->received = 1;
+	}
+}
+
+// check that [start, end) is covered by the parts claimed for this request (adjacent parts may be merged into one range)
+static bool _range_claimed(PART *claimed, off_t start, off_t end)
+{
+	while (start < end) {
+		PART *part;
+
+		for (part = claimed; part; part = part->next) {
+			if (start >= part->position && start < part->position + part->length)
+				break;
+		}
+
+		if (!part)
+			return 0;
+
+		start = part->position + part->length;
+	}
+
+	return 1;
+}
+
+// Add newly received bytes to the quota, consuming the transfer's reservation first.
+// Returns 1 if the transfer exceeds the quota and should be aborted, else 0.
+static int quota_account(struct _body_callback_context *ctx, wget_http_response *resp)
+{
+	long long nbytes = (long long) (resp->cur_downloaded - ctx->quota_accounted);
+	long long old_quota, from_reservation;
+
+	if (nbytes <= 0)
+		return 0;
+
+	ctx->quota_accounted = resp->cur_downloaded;
+	old_quota = quota_modify_read((size_t) nbytes);
+
+	if (!config.quota)
+		return 0;
+
+	from_reservation = nbytes < ctx->quota_reserved ? nbytes : ctx->quota_reserved;
+	if (from_reservation) {
+		ctx->quota_reserved -= from_reservation;
+		_fetch_and_add_longlong(&quota_reserved, -from_reservation);
+	}
+
+	return !ctx->quota_exempt && nbytes > from_reservation && old_quota + nbytes > config.quota;
+}
+
+// Link headers with rel=preload or rel=modulepreload (on 103 Early Hints or the final response)
+// announce requisites before the document has been parsed, so their download overlaps its transfer.
+static void _add_preload_links(JOB *job, wget_http_response *resp)
+{
+	wget_vector *urls;
+	wget_buffer buf;
+	char sbuf[1024];
+
+	if (!resp->links || !config.recursive || (config.level && job->level >= config.level + config.page_requisites))
+		return;
+
+	urls = wget_vector_create(8, NULL);
+	wget_buffer_init(&buf, sbuf, sizeof(sbuf));
+	wget_thread_mutex_lock(known_urls_mutex);
+
+	for (int it = 0; it < wget_vector_size(resp->links); it++) {
+		wget_http_link *link = wget_vector_get(resp->links, it);
+
+		if (link->rel != link_rel_preload && link->rel != link_rel_modulepreload)
+			continue;
+
+		if (!wget_iri_relative_to_abs(job->iri, link->uri, strlen(link->uri), &buf)) {
+			error_printf(_("Cannot resolve relative URI %s\n"), link->uri);
+			continue;
+		}
+
+		// Blacklist for URLs before they are processed
+		if (wget_hashmap_put(known_urls, wget_strmemdup(buf.data, buf.length), NULL) == 0) {
+			debug_printf("preload %s\n", buf.data);
+			wget_vector_add(urls, wget_strmemdup(buf.data, buf.length));
+		}
+	}
+
+	wget_thread_mutex_unlock(known_urls_mutex);
+
+	add_urls(job, "utf-8", urls, URL_FLG_REQUISITE);
+	wget_vector_free(&urls);
+
+	wget_buffer_deinit(&buf);
+}
+
+static int _get_interim_header(wget_http_response *resp, void *context)
+{
+	struct _body_callback_context *ctx = (struct _body_callback_context *)context;
+
+	if (config.server_response)
+		info_printf(_("# got interim response %d\n"), resp->code);
+
+	if (resp->code == 103)
+		_add_preload_links(ctx->job, resp);
+
+	return 0;
+}
+
 static int _get_header(wget_http_response *resp, void *context)
 {
 	struct _body_callback_context *ctx = (struct _body_callback_context *)context;
 	PART *part;
-	const char *dest = NULL, *name;
+	const char *dest = NULL, *name = NULL;
+	char *resume_filename = NULL;
 	int ret = 0;
+	bool keep_resume = 0;
 #ifdef _WIN32
 	char *fname_allocated = NULL;
 #endif
 
+	if ((resp->code == 200 || resp->code == 206) && !ctx->job->head_first)
+		_add_preload_links(ctx->job, resp);
+
+	// a large body turned up, let other streams on the connection go first
+	if (config.http2_priority && resp->req->priority_urgency < 5 && ctx->job->downloader->conn
+		&& wget_http_get_protocol(ctx->job->downloader->conn) == WGET_PROTOCOL_HTTP_2_0
+		&& resp->content_length_valid && resp->content_length > HTTP2_LARGE_BODY
+		&& !(resp->content_type && (!wget_strcasecmp_ascii(resp->content_type, "text/html")
+			|| !wget_strcasecmp_ascii(resp->content_type, "text/css"))))
+	{
+		debug_printf("lower priority of %s (%llu bytes)\n", ctx->job->iri->uri, (unsigned long long) resp->content_length);
+		wget_http_update_priority(ctx->job->downloader->conn, resp->req, 5, 1);
+	}
+
+	if (ctx->host) {
+		ctx->header_ts = wget_get_monotonic_millis();
+		host_response_sample(ctx->host, ctx->header_ts - ctx->request_ts);
+		wget_http_set_timeout(ctx->job->downloader->conn, host_read_timeout(ctx->host));
+	}
+
+	if (config.quota && wget_strcasecmp_ascii(resp->req->method, "HEAD")) {
+		long long nbytes = resp->content_length_valid ? (long long) resp->content_length : 0;
+		int rc = quota_reserve(nbytes);
+
+		if (rc < 0) {
+			debug_printf("not requesting body of '%s' (quota of %lld reached)\n", ctx->job->iri->uri, config.quota);
+			ret = -1;
+			goto out;
+		}
+
+		ctx->quota_reserved = nbytes;
+		ctx->quota_exempt = rc == 1;
+	}
+
 	bool metalink = config.metalink && resp->content_type
 	    && (!wget_strcasecmp_ascii(resp->content_type, "application/metalink4+xml") ||
 		!wget_strcasecmp_ascii(resp->content_type, "application/metalink+xml"));
@@ -3369,6 +4286,7 @@ static int _get_header(wget_http_response *resp, void *context)
 			ret = -1;
 			goto out;
 		}
+		ctx->range_start = ctx->range_end = part->position;
 	}
 	else if (config.content_disposition && resp->content_filename) {
 #ifdef _WIN32
@@ -3379,9 +4297,28 @@ static int _get_header(wget_http_response *resp, void *context)
 #else
 		name = dest = resp->content_filename;
 #endif
+	} else if (ctx->job->if_range && ctx->job->sig_filename && !config.output_document) {
+		// a transfer that broke off goes on in the file it has been written to, see http_create_request()
+		if (resp->code == 206) {
+			resume_filename = ctx->job->sig_filename;
+			ctx->job->sig_filename = NULL;
+			name = dest = resume_filename;
+		} else if (resp->code == 200) {
+			// the file has changed in between, start over
+			resume_filename = ctx->job->sig_filename;
+			ctx->job->sig_filename = NULL;
+			unlink(resume_filename);
+			name = dest = ctx->job->local_filename;
+		} else {
+			// e.g. 503: keep the partial file and its validator for the next try, don't save the error body
+			name = ctx->job->sig_filename;
+			keep_resume = 1;
+		}
 	} else
 		name = dest = config.output_document ? config.output_document : ctx->job->local_filename;
 
+	xfree(ctx->job->archive_name); // left over from a previous response
+
 	if (dest
 		&& ((config.save_content_on && check_status_code_list(config.save_content_on, resp->code))
 		|| (!config.save_content_on
@@ -3400,10 +4337,42 @@ static int _get_header(wget_http_response *resp, void *context)
 			&ctx->job->sig_filename,
 			ctx->job->iri->path);
 
-		if (ctx->outfd == -1)
+		if (ctx->outfd == -3) {
+			ctx->outfd = -1;
+			ctx->job->archive_name = wget_strdup(ctx->job->sig_filename);
+		} else if (ctx->outfd == -1)
 			ret = -1;
 	}
 
+	// remember a strong validator to resume the file if the transfer breaks, see http_create_request()
+	if (!keep_resume)
+		xfree(ctx->job->if_range);
+	if (ctx->outfd >= 0 && dest && (dest == ctx->job->local_filename || dest == resume_filename)
+		&& !config.output_document && ctx->job->sig_filename
+		&& (resp->code == 206 || (resp->code == 200 && resp->accept_ranges))
+		&& resp->content_encoding == wget_content_encoding_identity)
+	{
+		char http_date[32];
+
+		if (resp->etag && wget_strncmp(resp->etag, "W/", 2))
+			ctx->job->if_range = wget_strdup(resp->etag);
+		else if (resp->last_modified && resp->date - resp->last_modified >= STRONG_LAST_MODIFIED) {
+			wget_http_print_date(resp->last_modified, http_date, sizeof(http_date));
+			ctx->job->if_range = wget_strdup(http_date);
+		}
+	}
+
+	// a body that is neither saved nor parsed is not worth the bandwidth, libwget drains or cancels it
+	if (!ret && ctx->outfd < 0 && !ctx->job->archive_name && resp->code != 200 && resp->code != 206
+		&& wget_strcasecmp_ascii(resp->req->method, "HEAD"))
+	{
+		debug_printf("skip body of '%s' (status %d)\n", ctx->job->iri->uri, resp->code);
+		resp->skip_body = 1;
+
+		if (config.server_response && resp->header)
+			info_printf(_("# got header %zu bytes:\n%s\n"), resp->header->length, resp->header->data);
+	}
+
 //	info_printf("Opened %d\n", ctx->outfd);
 
 #ifdef _WIN32
@@ -3433,6 +4402,8 @@ out:
 		xfree(filename);
 	}
 
+	xfree(resume_filename);
+
 	return ret;
 }
 
@@ -3477,7 +4448,7 @@ static void limit_transfer_rate(struct _body_callback_context *ctx, size_t read_
 
 	ctx->limit_debt_bytes += (long long) read_bytes;
 
-	curr_time_ms = wget_get_timemillis();
+	curr_time_ms = wget_get_coarse_millis();
 	if (ctx->limit_prev_time_ms != 0) {
 		elapsed_ms = (curr_time_ms - ctx->limit_prev_time_ms);
 		ctx->limit_debt_bytes -= elapsed_ms * thread_rate_limit / 1000;
@@ -3492,12 +4463,62 @@ static void limit_transfer_rate(struct _body_callback_context *ctx, size_t read_
 	sleep_ms = ctx->limit_debt_bytes * 1000 / thread_rate_limit;
 	wget_millisleep(sleep_ms);
 
-	ctx->limit_prev_time_ms = wget_get_timemillis();
+	ctx->limit_prev_time_ms = wget_get_coarse_millis();
 	elapsed_ms = ctx->limit_prev_time_ms - curr_time_ms;
 	ctx->limit_debt_bytes = (sleep_ms - elapsed_ms) * thread_rate_limit / 1000;
 }
 
 
+// account the growth of the body buffer to the downloader, and to the memory budget once per
+// MEMORY_BATCH bytes received (or if 'flush'), so the accounting mutex isn't taken for each chunk
+static void _account_body(struct _body_callback_context *ctx, bool flush)
+{
+	ctx->downloader->body_memory += (long long) ctx->body->size - (long long) ctx->body_accounted;
+	ctx->body_accounted = ctx->body->size;
+
+	if (flush || ctx->length - ctx->length_reported >= MEMORY_BATCH) {
+		ctx->length_reported = ctx->length;
+		_report_body_memory(ctx->downloader);
+		ctx->memory_pressure = memory_pressure();
+	}
+}
+
+// whether the body doesn't need to be kept in memory because it can be parsed from the saved file
+static bool _body_can_spill(struct _body_callback_context *ctx, wget_http_response *resp)
+{
+	// with --output-document the file is stdout or has the bodies of all downloads in it
+	if (ctx->outfd < 0 || config.output_document || !ctx->job->sig_filename || ctx->job->part
+		|| !ctx->max_memory || ctx->job->robotstxt || ctx->job->sitemap || !resp->content_type)
+	{
+		return 0;
+	}
+
+	return !wget_strcasecmp_ascii(resp->content_type, "text/html")
+		|| !wget_strcasecmp_ascii(resp->content_type, "application/xhtml+xml")
+		|| !wget_strcasecmp_ascii(resp->content_type, "text/css");
+}
+
+// --archive: receive a body that is too large to be kept in memory into a temporary file
+static int _archive_spool(struct _body_callback_context *ctx, const char *data, size_t length)
+{
+	if (ctx->archive_fd == -1) {
+		// the body buffer holds everything received before this chunk
+		if ((ctx->archive_fd = archive_spool_open()) == -1)
+			return -1;
+
+		if (ctx->body->length && safe_write(ctx->archive_fd, ctx->body->data, ctx->body->length) != ctx->body->length)
+			goto write_error;
+	}
+
+	if (safe_write(ctx->archive_fd, data, length) == length)
+		return 0;
+
+write_error:
+	error_printf(_("Failed to write spool file for %s (%d)\n"), ctx->job->archive_name, errno);
+	set_exit_status(WG_EXIT_STATUS_IO);
+	return -1;
+}
+
 static int _get_body(wget_http_response *resp, void *context, const char *data, size_t length)
 {
 	struct _body_callback_context *ctx = (struct _body_callback_context *)context;
@@ -3510,6 +4531,37 @@ static int _get_body(wget_http_response *resp, void *context, const char *data,
 
 	ctx->length += length;
 
+	// never write a range we didn't ask for, the server could place data anywhere in the file
+	if (ctx->outfd >= 0 && ctx->job->part && resp->range_valid
+		&& !_range_claimed(ctx->job->part, (off_t) resp->range_position, (off_t) (resp->range_position + length)))
+	{
+		HOST *host = host_get(ctx->job->iri);
+
+		error_printf(_("Unrequested range %lld-%lld from %s\n"),
+			resp->range_position, resp->range_position + (long long) length - 1, ctx->job->iri->host);
+
+		if (host && !host->single_range) {
+			debug_printf("%s does not support multi-range requests\n", ctx->job->iri->host);
+			host->single_range = 1;
+		}
+
+		return -1;
+	}
+
+	// the ranges of a multipart/byteranges response (or a full 200 response) may need a seek
+	if (ctx->outfd >= 0 && ctx->job->part && (resp->range_valid || resp->code == 200)
+		&& (off_t) resp->range_position != ctx->range_end)
+	{
+		_mark_received_parts(ctx);
+
+		if (lseek(ctx->outfd, (off_t) resp->range_position, SEEK_SET) == (off_t) -1) {
+			set_exit_status(WG_EXIT_STATUS_IO);
+			return -1;
+		}
+
+		ctx->range_start = ctx->range_end = (off_t) resp->range_position;
+	}
+
 	if (ctx->outfd >= 0) {
 		size_t written = safe_write(ctx->outfd, data, length);
 
@@ -3531,11 +4583,31 @@ static int _get_body(wget_http_response *resp, void *context, const char *data,
 			set_exit_status(WG_EXIT_STATUS_IO);
 			return -1;
 		}
+
+		ctx->range_end += written;
+	}
+
+	// near the memory budget, stop buffering what can be parsed from the file later on
+	if (!ctx->job->body_spilled && ctx->memory_pressure && _body_can_spill(ctx, resp)) {
+		debug_printf("memory pressure: parse '%s' from file\n", ctx->job->sig_filename);
+		ctx->job->body_spilled = 1;
+		wget_buffer_free(&ctx->body);
+		ctx->body = wget_buffer_alloc(0);
 	}
 
-	if (ctx->max_memory == 0 || ctx->length < ctx->max_memory)
+	if (ctx->job->archive_name && ctx->max_memory && ctx->length >= ctx->max_memory && _archive_spool(ctx, data, length))
+		return -1;
+
+	if (!ctx->job->body_spilled && (ctx->max_memory == 0 || ctx->length < ctx->max_memory))
 		wget_buffer_memcat(ctx->body, data, length); // append new data to body
 
+	_account_body(ctx, 0);
+
+	if (quota_account(ctx, resp)) {
+		info_printf(_("Quota of %lld bytes reached - aborting download of '%s'\n"), config.quota, ctx->job->iri->uri);
+		return -1; // libwget stops receiving this response (HTTP/1.1) or resets the stream (HTTP/2)
+	}
+
 	if (config.progress) {
 		bar_set_downloaded(ctx->progress_slot, resp->cur_downloaded - resp->accounted_for);
 		resp->accounted_for = resp->cur_downloaded;
@@ -3617,21 +4689,15 @@ static wget_http_request *http_create_request(wget_iri *iri, JOB *job)
 	if (!(req = wget_http_create_request(iri, method)))
 		return req;
 
-	if (config.continue_download || config.timestamping) {
-		const char *local_filename = config.output_document ? config.output_document : job->local_filename;
+	const char *local_filename = config.output_document ? config.output_document : job->local_filename;
 
+	if (config.continue_download || config.timestamping) {
 		/* We never want to continue the robots job. Always grab a fresh copy
 		 * from the server. */
 		if (job->robotstxt == true) {
 			unlink(local_filename);
 		}
 
-		if (config.continue_download) {
-			long long file_size = get_file_size(local_filename);
-			if (file_size > 0)
-				wget_http_add_header_printf(req, "Range", "bytes=%lld-", file_size);
-		}
-
 		if (config.timestamping) {
 			bool found_mtime = 0;
 			time_t mtime = 0;
@@ -3660,6 +4726,24 @@ static wget_http_request *http_create_request(wget_iri *iri, JOB *job)
 
 	}
 
+	// continue a partial file (-c) or resume a transfer that broke off
+	if (config.continue_download || job->if_range) {
+		// a broken transfer is resumed in the file that has been written, see _get_header()
+		long long file_size = get_file_size(job->if_range && job->sig_filename ? job->sig_filename : local_filename);
+
+		if (file_size > 0) {
+			wget_http_add_header_printf(req, "Range", "bytes=%lld-", file_size);
+
+			// a changed file comes as '200 OK' and is downloaded from the start
+			if (job->if_range)
+				wget_http_add_header(req, "If-Range", job->if_range);
+		}
+	}
+
+	// revalidate a stale robots cache entry, '304 Not Modified' keeps the cached rules
+	if (job->robotstxt && config.robots_cache_file)
+		robots_cache_add_validators(req, iri);
+
 	// 20.06.2012: www.google.de only sends gzip responses with one of the
 	// following header lines in the request.
 	// User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:10.0.5) Gecko/20100101 Firefox/10.0.5 Iceweasel/10.0.5
@@ -3677,6 +4761,9 @@ static wget_http_request *http_create_request(wget_iri *iri, JOB *job)
 
 	wget_buffer_reset(&buf);
 
+	// offer a stored compression dictionary, the server may then send a 'dcb' / 'dcz' delta
+	bool dictionary = config.dictionary_dir && !config.no_compression && !job->head_first && dictionary_offer(req, iri);
+
 	// if compression is specified
 	if (config.compression) {
 		for (int it = 0; it < config.compression_methods[wget_content_encoding_max]; it++) {
@@ -3686,8 +4773,11 @@ static wget_http_request *http_create_request(wget_iri *iri, JOB *job)
 			wget_buffer_strcat(&buf, encoding_method);
 		}
 
-		if (buf.length)
+		if (buf.length) {
+			if (dictionary)
+				wget_buffer_printf_append(&buf, ", %s", dictionary_encodings());
 			wget_http_add_header(req, "Accept-Encoding", buf.data);
+		}
 	}
 
 	// no valid types provided or just default Accept-Encoding
@@ -3710,6 +4800,8 @@ static wget_http_request *http_create_request(wget_iri *iri, JOB *job)
 
 		if (!buf.length)
 			wget_buffer_strcat(&buf, "identity");
+		else if (dictionary)
+			wget_buffer_printf_append(&buf, ", %s", dictionary_encodings());
 
 		wget_http_add_header(req, "Accept-Encoding", buf.data);
 	}
@@ -3756,9 +4848,21 @@ static wget_http_request *http_create_request(wget_iri *iri, JOB *job)
 		_add_authorize_header(req, job->proxy_challenges, config.http_proxy_username, config.http_proxy_password, 1);
 	}
 
-	if (job->part)
-		wget_http_add_header_printf(req, "Range", "bytes=%llu-%llu",
-			(unsigned long long) job->part->position, (unsigned long long) job->part->position + job->part->length - 1);
+	if (job->part) {
+		wget_buffer_strcpy(&buf, "bytes=");
+
+		for (PART *part = job->part; part;) {
+			unsigned long long first = part->position, last = part->position + part->length - 1;
+
+			// merge adjacent parts into one range
+			for (part = part->next; part && (unsigned long long) part->position == last + 1; part = part->next)
+				last += part->length;
+
+			wget_buffer_printf_append(&buf, "%llu-%llu%s", first, last, part ? "," : "");
+		}
+
+		wget_http_add_header(req, "Range", buf.data);
+	}
 
 	// add cookies
 	if (config.cookies) {
@@ -3810,6 +4914,14 @@ static wget_http_request *http_create_request(wget_iri *iri, JOB *job)
 		}
 	}
 
+	if (config.http2_priority) {
+		bool incremental;
+		int urgency = job_urgency(job, &incremental);
+
+		wget_http_request_set_int(req, WGET_HTTP_PRIORITY_URGENCY, urgency);
+		wget_http_request_set_int(req, WGET_HTTP_PRIORITY_INCREMENTAL, incremental);
+	}
+
 	wget_buffer_deinit(&buf);
 
 	return req;
@@ -3827,7 +4939,15 @@ int http_send_request(wget_iri *iri, wget_iri *original_url, DOWNLOADER *downloa
 		// If the Content-Type header gives us not a parseable type, we are done.
 		print_status(downloader, "[%d] Checking '%s' ...\n", downloader->id, iri->uri);
 	} else {
-		if (job->part)
+		if (job->part && job->part->next) {
+			int nparts = 0;
+
+			for (PART *part = job->part; part; part = part->next)
+				nparts++;
+
+			print_status(downloader, "downloading %d parts starting with %d/%d %s from %s\n",
+				nparts, job->part->id, wget_vector_size(job->parts), job->metalink->name, iri->host);
+		} else if (job->part)
 			print_status(downloader, "downloading part %d/%d (%lld-%lld) %s from %s\n",
 				job->part->id, wget_vector_size(job->parts),
 				(long long)job->part->position, (long long)(job->part->position + job->part->length - 1),
@@ -3853,17 +4973,26 @@ int http_send_request(wget_iri *iri, wget_iri *original_url, DOWNLOADER *downloa
 	struct _body_callback_context *context = wget_calloc(1, sizeof(struct _body_callback_context));
 
 	context->job = downloader->job;
+	context->downloader = downloader;
 	context->max_memory = downloader->job->part ? 0 : ((uint64_t) 10) * (1 << 20);
 	context->outfd = -1;
+	context->archive_fd = -1;
 	context->body = wget_buffer_alloc(102400);
 	context->length = 0;
+	if (!context->job->part)
+		context->job->body_spilled = 0;
+	_account_body(context, 1);
 	context->progress_slot = downloader->id;
 	context->job->original_url = original_url;
 	context->limit_debt_bytes = 0;
-	context->limit_prev_time_ms = wget_get_timemillis();
+	context->limit_prev_time_ms = wget_get_coarse_millis();
+	if (config.adaptive_timeout && (context->host = host_get(iri)))
+		context->request_ts = wget_get_monotonic_millis();
 
 	// set callback functions
 	wget_http_request_set_header_cb(req, _get_header, context);
+	if (config.recursive)
+		wget_http_request_set_interim_cb(req, _get_interim_header, context);
 	wget_http_request_set_body_cb(req, _get_body, context);
 
 	// keep the received response header in 'resp->header'
@@ -3882,8 +5011,17 @@ wget_http_response *http_receive_response(wget_http_connection *conn)
 	struct _body_callback_context *context = resp->req->body_user_data;
 
 	resp->body = context->body;
+	_account_body(context, 1); // released with the response, see _free_response()
+
+	// account bytes not seen by _get_body() and release the unused part of the quota reservation
+	quota_account(context, resp);
+	if (context->quota_reserved)
+		_fetch_and_add_longlong(&quota_reserved, -context->quota_reserved);
 
 	if (context->outfd >= 0) {
+		if (context->job->part)
+			_mark_received_parts(context);
+
 		if (resp->last_modified) {
 			/* If program was aborted, we store file times one second less than the server time.
 			 * So a later download with -N would start over instead of leaving incomplete data.
@@ -3905,6 +5043,25 @@ wget_http_response *http_receive_response(wget_http_connection *conn)
 		context->outfd = -1;
 	}
 
+	if (context->host && context->header_ts)
+		host_throughput_sample(context->host, (long long) resp->cur_downloaded, wget_get_monotonic_millis() - context->header_ts);
+
+	// incomplete bodies are not archived, complete ones are handed over after processing, see _archive_response()
+	if (context->job->archive_name && (terminate || resp->truncated || resp->body_aborted
+		|| (resp->content_length_valid && resp->cur_downloaded < resp->content_length)))
+	{
+		xfree(context->job->archive_name);
+	} else if (context->job->archive_name && context->archive_fd != -1) {
+		// too large for memory, the body buffer only has the beginning for parsing
+		archive_add_file(context->job->archive_name, context->archive_fd, (size_t) context->length,
+			resp->last_modified, _archive_defer(resp));
+		context->archive_fd = -1;
+		xfree(context->job->archive_name);
+	}
+
+	if (context->archive_fd != -1)
+		close(context->archive_fd);
+
 	if (config.progress)
 		bar_slot_deregister(context->progress_slot);
 
@@ -0,0 +1,46 @@
+/*
+ * Copyright(c) 2019 Free Software Foundation, Inc.
+ *
+ * This file is part of Wget.
+ *
+ * Wget is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Wget is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Wget.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *
+ * Header file for the archive output
+ *
+ */
+
+#ifndef SRC_WGET_ARCHIVE_H
+#define SRC_WGET_ARCHIVE_H
+
+#include <wget.h>
+
+// types for --archive-format
+enum {
+	ARCHIVE_FORMAT_TAR,
+	ARCHIVE_FORMAT_CPIO
+};
+
+void archive_init(void);
+void archive_exit(void);
+int archive_open(const char *fname, int format) G_GNUC_WGET_NONNULL_ALL;
+void archive_close(void);
+void archive_add(const char *name, char *data, size_t length, int64_t mtime, bool defer) G_GNUC_WGET_NONNULL((1));
+void archive_add_file(const char *name, int data_fd, size_t length, int64_t mtime, bool defer) G_GNUC_WGET_NONNULL((1));
+int archive_spool_open(void);
+bool archive_contains(const char *name) G_GNUC_WGET_NONNULL_ALL;
+char *archive_take_deferred(const char *name, size_t *length, int64_t *mtime) G_GNUC_WGET_NONNULL_ALL;
+void archive_free(void);
+
+#endif /* SRC_WGET_ARCHIVE_H */
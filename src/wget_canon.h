@@ -0,0 +1,35 @@
+/*
+ * Copyright(c) 2019 Free Software Foundation, Inc.
+ *
+ * This file is part of Wget.
+ *
+ * Wget is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Wget is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Wget.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *
+ * Header file for URL canonicalization rules
+ *
+ */
+
+#ifndef SRC_WGET_CANON_H
+#define SRC_WGET_CANON_H
+
+#include <wget.h>
+
+void canon_init(void);
+void canon_exit(void);
+int canon_load(const char *fname);
+wget_iri *canon_apply(const wget_iri *iri) G_GNUC_WGET_NONNULL_ALL;
+void canon_free(void);
+
+#endif /* SRC_WGET_CANON_H */
@@ -0,0 +1,46 @@
+/*
+ * Copyright(c) 2019 Free Software Foundation, Inc.
+ *
+ * This file is part of Wget.
+ *
+ * Wget is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Wget is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Wget.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *
+ * Header file for daemon mode routines
+ *
+ */
+
+#ifndef SRC_WGET_DAEMON_H
+#define SRC_WGET_DAEMON_H
+
+#include <wget.h>
+
+typedef struct DAEMON_BATCH DAEMON_BATCH;
+
+// called by the daemon when a client starts a new batch
+typedef void daemon_batch_start_t(void);
+// called by the daemon for each URL of a batch
+typedef void daemon_add_url_t(const char *url, DAEMON_BATCH *batch);
+// called by the daemon when a client requests termination
+typedef void daemon_quit_t(void);
+
+int daemon_start(const char *path, daemon_batch_start_t *batch_start, daemon_add_url_t *add_url, daemon_quit_t *quit);
+void daemon_stop(void);
+void daemon_flush(void);
+void daemon_batch_add_job(DAEMON_BATCH *batch) G_GNUC_WGET_NONNULL_ALL;
+void daemon_batch_job_release(DAEMON_BATCH *batch) G_GNUC_WGET_NONNULL_ALL;
+void daemon_batch_job_done(DAEMON_BATCH *batch, int code, const char *url) G_GNUC_WGET_NONNULL_ALL;
+int daemon_submit(const char *path, const char **urls, int nurls, const char *input_file);
+
+#endif /* SRC_WGET_DAEMON_H */
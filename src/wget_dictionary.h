@@ -0,0 +1,38 @@
+/*
+ * Copyright(c) 2019 Free Software Foundation, Inc.
+ *
+ * This file is part of Wget.
+ *
+ * Wget is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Wget is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Wget.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *
+ * Header file for the compression dictionary store
+ *
+ */
+
+#ifndef SRC_WGET_DICTIONARY_H
+#define SRC_WGET_DICTIONARY_H
+
+#include <wget.h>
+
+void dictionary_init(void);
+void dictionary_exit(void);
+int dictionary_load(const char *dir);
+int dictionary_save(void);
+void dictionary_add(const wget_iri *iri, const char *use_as_dictionary, const char *fname) G_GNUC_WGET_NONNULL_ALL;
+const char *dictionary_encodings(void);
+int dictionary_offer(wget_http_request *req, const wget_iri *iri) G_GNUC_WGET_NONNULL_ALL;
+void dictionary_free(void);
+
+#endif /* SRC_WGET_DICTIONARY_H */
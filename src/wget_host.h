@@ -34,6 +34,9 @@
 struct JOB;
 typedef struct JOB JOB;
 
+struct QUEUED_JOB;
+typedef struct QUEUED_JOB QUEUED_JOB;
+
 // everything host/domain specific should go here
 typedef struct {
 	const char
@@ -44,16 +47,29 @@ typedef struct {
 	wget_robots
 		*robots;
 	wget_list
-		*queue; // host specific job queue
+		*queue; // host specific queue of jobs handed out to downloaders
+	QUEUED_JOB
+		*pending; // compact records of jobs not handed out yet
 	long long
-		retry_ts; // timestamp of earliest retry in milliseconds
+		retry_ts, // timestamp of earliest retry in milliseconds
+		throughput; // smoothed transfer rate in bytes/s (--adaptive-timeout)
 	int
-		qsize, // number of jobs in queue
-		failures; // number of consequent connection failures
+		qsize, // number of jobs in queue, including pending ones
+		pending_first, // index of the next pending job
+		pending_last, // index after the last pending job
+		pending_size, // number of allocated pending records
+		failures, // number of consequent connection failures
+		connect_srtt, // smoothed connection setup time in ms (--adaptive-timeout)
+		connect_rttvar, //   and its mean deviation
+		connect_samples,
+		response_srtt, // smoothed time to the response header in ms (--adaptive-timeout)
+		response_rttvar, //   and its mean deviation
+		response_samples;
 	uint16_t
 		port;
 	bool
-		blocked : 1; // host may be blocked after too many errors or even one final error
+		blocked : 1, // host may be blocked after too many errors or even one final error
+		single_range : 1; // host does not support multi-range requests
 } HOST;
 
 void host_init(void);
@@ -72,6 +88,13 @@ void hosts_free(void);
 void host_increase_failure(HOST *host) G_GNUC_WGET_NONNULL((1));
 void host_final_failure(HOST *host) G_GNUC_WGET_NONNULL((1));
 void host_reset_failure(HOST *host) G_GNUC_WGET_NONNULL((1));
+void hosts_unblock(void);
+void host_remove_blocked_batch_jobs(void);
+void host_connect_sample(HOST *host, long long ms) G_GNUC_WGET_NONNULL((1));
+void host_response_sample(HOST *host, long long ms) G_GNUC_WGET_NONNULL((1));
+void host_throughput_sample(HOST *host, long long bytes, long long ms) G_GNUC_WGET_NONNULL((1));
+int host_connect_timeout(HOST *host) G_GNUC_WGET_NONNULL((1));
+int host_read_timeout(HOST *host) G_GNUC_WGET_NONNULL((1));
 
 int queue_size(void) G_GNUC_WGET_PURE;
 int queue_empty(void) G_GNUC_WGET_PURE;
@@ -32,21 +32,26 @@
 
 #include <wget.h>
 #include "wget_host.h"
+#include "wget_daemon.h"
 
 // file part to download
-typedef struct {
+typedef struct PART PART;
+struct PART {
 	off_t
 		position;
 	off_t
 		length;
+	PART
+		*next; // next part requested with the same multi-range request
 	int
 		id;
 	wget_thread_id
 		used_by;
 	bool
 		inuse : 1,
-		done : 1;
-} PART;
+		done : 1,
+		received : 1; // all bytes of a multi-range request part have been written
+};
 
 typedef struct DOWNLOADER DOWNLOADER;
 
@@ -78,11 +83,16 @@ struct JOB {
 		*local_filename;
 	char
 		*sig_filename, // Signature information. Meaning depends on sig_req.
-		*sig_req; // The base URI for the file that we need to verify.
+		*sig_req, // The base URI for the file that we need to verify.
+		*if_range, // validator of the file being written, to resume it after an interruption
+		*zsync_target, // file to be replaced by the metalink file once it has been validated
+		*archive_name; // --archive: entry name of the body, added when the response has been processed
 	PART
 		*part; // current chunk to download
 	DOWNLOADER
 		*downloader;
+	DAEMON_BATCH
+		*batch; // daemon batch this job belongs to
 
 	wget_thread_id
 		used_by; // keep track of who uses this job, for host_release_jobs()
@@ -94,16 +104,20 @@ struct JOB {
 		redirection_level, // number of redirections occurred to create this job
 		auth_failure_count, // number of times server has returned a 401 response
 		mirror_pos, // where to look up the next (metalink) mirror to use
-		piece_pos; // where to look up the next (metalink) piece to download
+		piece_pos, // where to look up the next (metalink) piece to download
+		queue_memory; // accounted for --max-memory while queued
 	bool
 		challenges_alloc : 1, // Indicate whether the challenges vector is owned by the JOB
 		inuse : 1, // if job is already in use, 'used_by' holds the thread id of the downloader
 		done : 1, // if job has to be retried, else it is done and can be removed (used by the downloader threads)
 		sitemap : 1, // URL is a sitemap to be scanned in recursive mode
+		requisite : 1, // URL is a page requisite (-p) or found in CSS
+		body_spilled : 1, // body not kept in memory (--max-memory), parse the saved file
 		robotstxt : 1, // URL is a robots.txt to be scanned
 		head_first : 1, // first check mime type by using a HEAD request
 		requested_by_user : 1, // download even if disallowed by robots.txt
 		ignore_patterns : 1, // Ignore accept/reject patterns
+		derived_filename : 1, // local_filename is get_local_filename(iri), see host_add_job()
 		http_fallback : 1; // When true, we try again on error, using HTTP (instead of HTTPS)
 };
 
@@ -118,6 +132,10 @@ struct DOWNLOADER {
 		*buf;
 	size_t
 		bufsize;
+	long long
+		conn_memory, // accounted for the open connection (--max-memory)
+		body_memory, // bodies of the responses in flight
+		body_reported; // part of body_memory passed to memory_account(), see _report_body_memory()
 	int
 		id;
 	wget_thread_cond
@@ -130,5 +148,6 @@ JOB *job_init(JOB *job, wget_iri *iri, bool http_fallback) G_GNUC_WGET_NONNULL((
 int job_validate_file(JOB *job) G_GNUC_WGET_NONNULL((1));
 void job_create_parts(JOB *job) G_GNUC_WGET_NONNULL((1));
 void job_free(JOB *job) G_GNUC_WGET_NONNULL((1));
+int job_urgency(const JOB *job, bool *incremental) G_GNUC_WGET_NONNULL_ALL;
 
 #endif /* SRC_WGET_JOB_H */
@@ -0,0 +1,45 @@
+/*
+ * Copyright(c) 2019 Free Software Foundation, Inc.
+ *
+ * This file is part of Wget.
+ *
+ * Wget is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Wget is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Wget.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *
+ * Header file for the memory accounting
+ *
+ */
+
+#ifndef SRC_WGET_MEMORY_H
+#define SRC_WGET_MEMORY_H
+
+#include <wget.h>
+
+// categories of memory that grow with the size of a crawl
+enum {
+	MEMORY_BODY, // response bodies kept in memory
+	MEMORY_CONNECTION, // connections with their buffers
+	MEMORY_CONVERSION, // parse results kept for --convert-links
+	MEMORY_QUEUE, // queued jobs
+	MEMORY_BLACKLIST, // URLs already seen
+	MEMORY_CATEGORIES
+};
+
+void memory_init(void);
+void memory_exit(void);
+void memory_account(int category, long long bytes);
+bool memory_pressure(void);
+void memory_print(void);
+
+#endif /* SRC_WGET_MEMORY_H */
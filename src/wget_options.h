@@ -106,6 +106,14 @@ struct config {
 		*system_config,
 		*user_config,
 		*hsts_file,
+		*redirect_cache_file,
+		*robots_cache_file,
+		*ca_snapshot,
+		*canonicalize_rules,
+		*dictionary_dir,
+		*archive,
+		*daemon,
+		*daemon_submit,
 		*hsts_preload_file,
 		*hpkp_file,
 		*tls_session_file,
@@ -152,6 +160,7 @@ struct config {
 	stats_args
 		*stats_dns_args,
 		*stats_ocsp_args,
+		*stats_redirect_args,
 		*stats_server_args,
 		*stats_site_args,
 		*stats_tls_args;
@@ -162,6 +171,7 @@ struct config {
 		chunk_size;
 	long long
 		quota,
+		max_memory,
 		limit_rate; // bytes
 	bool
 		no_compression,
@@ -179,8 +189,15 @@ struct config {
 		connect_timeout, // ms
 		dns_timeout, // ms
 		read_timeout, // ms
+		max_ranges, // max. number of ranges per request for chunked downloads
 		max_redirect,
+		redirect_cache_maxage, // s
 		max_threads,
+		partitions, // number of crawler processes
+		trap_path_repeat, // max. occurrences of a path segment
+		trap_query_values, // max. values per query parameter
+		trap_host_budget, // max. URLs per host
+		trap_dir_budget, // max. URLs per directory
 		ocsp_date,
 		ocsp_nonce;
 	unsigned short
@@ -195,6 +212,7 @@ struct config {
 		netrc,
 		http2,
 		http2_only,
+		http2_priority,
 		ocsp_stapling,
 		ocsp,
 		mirror,
@@ -206,6 +224,7 @@ struct config {
 		hpkp,                  // HTTP Public Key Pinning (HPKP)
 		random_wait,
 		trust_server_names,
+		trap_fingerprint,
 		robots,
 		parent,
 		https_only,
@@ -242,6 +261,7 @@ struct config {
 		tcp_fastopen,
 		check_certificate,
 		check_hostname,
+		ca_snapshot_restrict,
 		cert_type,             // SSL_X509_FMT_PEM or SSL_X509_FMT_DER (=ASN1)
 		private_key_type,      // SSL_X509_FMT_PEM or SSL_X509_FMT_DER (=ASN1)
 		span_hosts,
@@ -266,6 +286,10 @@ struct config {
 		verify_sig,
 		https_enforce,
 		retry_connrefused,
+		redirect_cache,
+		zsync,
+		adaptive_timeout,
+		archive_format,
 		unlink;
 };
 
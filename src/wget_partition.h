@@ -0,0 +1,52 @@
+/*
+ * Copyright(c) 2019 Free Software Foundation, Inc.
+ *
+ * This file is part of Wget.
+ *
+ * Wget is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Wget is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Wget.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *
+ * Header file for partitioned multi-process crawling
+ *
+ */
+
+#ifndef SRC_WGET_PARTITION_H
+#define SRC_WGET_PARTITION_H
+
+#include <wget.h>
+
+typedef struct {
+	long long
+		bytes;
+	int
+		downloads,
+		redirects,
+		errors,
+		traps; // rejected crawler trap URLs and pages
+} PARTITION_STATS;
+
+// called for each URL forwarded from another partition
+typedef void partition_add_url_t(const char *url, const char *referer, int level, int flags);
+// returns non-zero if the calling process has nothing left to do
+typedef int partition_idle_t(void);
+
+int partition_start(int n, partition_add_url_t *add_url);
+int partition_self(void) G_GNUC_WGET_PURE;
+int partition_of(const char *host) G_GNUC_WGET_PURE;
+int partition_forward(int partition, const char *url, const char *referer, int level, int flags);
+int partition_done(partition_idle_t *idle);
+void partition_abort(void);
+int partition_exit(const PARTITION_STATS *stats, PARTITION_STATS *total);
+
+#endif /* SRC_WGET_PARTITION_H */
@@ -90,6 +90,9 @@ struct plugin_db_forward_url_verdict {
 // Forwards a URL about to be enqueued to interested plugins
 void plugin_db_forward_url(const wget_iri *iri, struct plugin_db_forward_url_verdict *verdict);
 
+// Forwards the URLs found in one document to interested plugins, one verdict per URL
+void plugin_db_forward_urls(const wget_iri **iris, struct plugin_db_forward_url_verdict *verdicts, int n);
+
 // Free's all contents of plugin_db_forward_url_verdict
 void plugin_db_forward_url_verdict_free(struct plugin_db_forward_url_verdict *verdict);
 
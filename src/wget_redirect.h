@@ -0,0 +1,40 @@
+/*
+ * Copyright(c) 2019 Free Software Foundation, Inc.
+ *
+ * This file is part of Wget.
+ *
+ * Wget is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Wget is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Wget.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *
+ * Header file for the permanent redirect cache
+ *
+ */
+
+#ifndef SRC_WGET_REDIRECT_H
+#define SRC_WGET_REDIRECT_H
+
+#include <wget.h>
+
+void redirect_cache_init(void);
+void redirect_cache_exit(void);
+void redirect_cache_add(const wget_iri *from, const wget_iri *to, int64_t maxage) G_GNUC_WGET_NONNULL_ALL;
+char *redirect_cache_lookup(const wget_iri *iri) G_GNUC_WGET_NONNULL_ALL;
+int redirect_cache_load(const char *fname);
+int redirect_cache_save(const char *fname);
+int redirect_cache_size(void) G_GNUC_WGET_PURE;
+int redirect_cache_hits(void) G_GNUC_WGET_PURE;
+void redirect_cache_print_stats(FILE *fp, char format) G_GNUC_WGET_NONNULL_ALL;
+void redirect_cache_free(void);
+
+#endif /* SRC_WGET_REDIRECT_H */
@@ -0,0 +1,38 @@
+/*
+ * Copyright(c) 2019 Free Software Foundation, Inc.
+ *
+ * This file is part of Wget.
+ *
+ * Wget is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Wget is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Wget.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *
+ * Header file for the persistent robots.txt cache
+ *
+ */
+
+#ifndef SRC_WGET_ROBOTS_CACHE_H
+#define SRC_WGET_ROBOTS_CACHE_H
+
+#include <wget.h>
+
+void robots_cache_init(void);
+void robots_cache_exit(void);
+bool robots_cache_lookup(const wget_iri *iri, wget_robots **robots) G_GNUC_WGET_NONNULL_ALL;
+void robots_cache_add_validators(wget_http_request *req, const wget_iri *iri) G_GNUC_WGET_NONNULL_ALL;
+bool robots_cache_update(const wget_iri *iri, const wget_http_response *resp, wget_robots **robots) G_GNUC_WGET_NONNULL_ALL;
+int robots_cache_load(const char *fname);
+int robots_cache_save(const char *fname);
+void robots_cache_free(void);
+
+#endif /* SRC_WGET_ROBOTS_CACHE_H */
@@ -0,0 +1,38 @@
+/*
+ * Copyright(c) 2019 Free Software Foundation, Inc.
+ *
+ * This file is part of Wget.
+ *
+ * Wget is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Wget is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Wget.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *
+ * Header file for the adaptive timeout estimator
+ *
+ */
+
+#ifndef SRC_WGET_RTT_H
+#define SRC_WGET_RTT_H
+
+#include <wget.h>
+
+#define ADAPTIVE_MIN_SAMPLES 3
+#define ADAPTIVE_FACTOR 4
+#define ADAPTIVE_MIN_TIMEOUT 3000 // ms, allows for a SYN retransmission
+#define ADAPTIVE_MAX_BACKOFF 4 // max. number of doublings on consecutive failures
+#define ADAPTIVE_WINDOW (64 * 1024) // bytes expected to arrive between two reads at worst
+
+void rtt_update(int *srtt, int *rttvar, int *samples, long long ms) G_GNUC_WGET_NONNULL_ALL;
+int rtt_timeout(int srtt, int rttvar, int samples, int failures, long long extra, int limit) G_GNUC_WGET_CONST;
+
+#endif /* SRC_WGET_RTT_H */
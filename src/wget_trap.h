@@ -0,0 +1,38 @@
+/*
+ * Copyright(c) 2019 Free Software Foundation, Inc.
+ *
+ * This file is part of Wget.
+ *
+ * Wget is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Wget is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Wget.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *
+ * Header file for crawler trap detection
+ *
+ */
+
+#ifndef SRC_WGET_TRAP_H
+#define SRC_WGET_TRAP_H
+
+#include <wget.h>
+
+void trap_init(void);
+void trap_exit(void);
+const char *trap_check_url(const wget_iri *iri) G_GNUC_WGET_NONNULL_ALL;
+int trap_check_content(const wget_iri *iri, const char *data, size_t length) G_GNUC_WGET_NONNULL_ALL;
+int trap_check_content_file(const wget_iri *iri, const char *fname) G_GNUC_WGET_NONNULL_ALL;
+int trap_rejected(void) G_GNUC_WGET_PURE;
+void trap_print(void);
+void trap_free(void);
+
+#endif /* SRC_WGET_TRAP_H */
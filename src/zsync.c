@@ -0,0 +1,472 @@
+/*
+ * Copyright(c) 2019 Free Software Foundation, Inc.
+ *
+ * This file is part of Wget.
+ *
+ * Wget is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Wget is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Wget.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *
+ * zsync block-delta updates
+ *
+ * A .zsync control file holds a weak rolling checksum and a (truncated) MD4
+ * checksum for each block of the target file. The existing local file is
+ * scanned with the rolling checksum, blocks found anywhere in it are copied
+ * to their new position and only the missing ranges are downloaded by the
+ * usual chunk/metalink machinery into a temporary file. The SHA-1 of the
+ * complete file is checked at the end, just like a metalink file hash, and only
+ * then the temporary file replaces the old one.
+ *
+ * References
+ *   http://zsync.moria.org.uk/paper/
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#include <wget.h>
+
+#include "md4.h"
+#include "safe-read.h"
+#include "safe-write.h"
+
+#include "wget_main.h"
+#include "wget_job.h"
+#include "wget_zsync.h"
+
+typedef struct {
+	uint32_t
+		rsum; // masked weak checksum
+	unsigned char
+		checksum[16]; // truncated MD4
+	int
+		next; // next block in the same hash bucket
+} _zsync_block_t;
+
+typedef struct {
+	const char
+		*url,
+		*filename;
+	char
+		sha1[41];
+	off_t
+		length;
+	size_t
+		blocksize;
+	uint32_t
+		rsum_mask;
+	int
+		nblocks,
+		seq_matches,
+		rsum_bytes,
+		checksum_bytes,
+		nbuckets,
+		*buckets;
+	_zsync_block_t
+		*blocks;
+} _zsync_t;
+
+int zsync_is_control(const char *content_type, const wget_iri *iri)
+{
+	if (content_type && !wget_strcasecmp_ascii(content_type, "application/x-zsync"))
+		return 1;
+
+	return iri->path && wget_match_tail(iri->path, ".zsync");
+}
+
+static void _free_mirror(wget_metalink_mirror *mirror)
+{
+	if (mirror) {
+		wget_iri_free(&mirror->iri);
+		xfree(mirror);
+	}
+}
+
+static uint32_t G_GNUC_WGET_PURE _rsum(const unsigned char *data, size_t len)
+{
+	uint16_t a = 0, b = 0;
+
+	for (size_t it = 0; it < len; it++) {
+		a += data[it];
+		b += (len - it) * data[it];
+	}
+
+	return ((uint32_t) a << 16) | b;
+}
+
+static int _bucket(const _zsync_t *zs, uint32_t rsum)
+{
+	return (int) ((rsum ^ (rsum >> 13)) & (zs->nbuckets - 1));
+}
+
+// parse the header and the block checksums, data must be 0-terminated
+static int _zsync_parse(_zsync_t *zs, char *data, size_t size)
+{
+	char *line, *eol, *value;
+	const unsigned char *p;
+
+	memset(zs, 0, sizeof(*zs));
+	zs->seq_matches = 1;
+	zs->rsum_bytes = 4;
+	zs->checksum_bytes = 16;
+
+	for (line = data; (eol = strchr(line, '\n')); line = eol + 1) {
+		*eol = 0;
+		if (eol > line && eol[-1] == '\r')
+			eol[-1] = 0;
+
+		if (!*line) {
+			line = eol + 1;
+			break; // end of header
+		}
+
+		if (!(value = strchr(line, ':')))
+			continue;
+		*value++ = 0;
+		while (*value == ' ') value++;
+
+		if (!wget_strcasecmp_ascii(line, "Filename"))
+			zs->filename = value;
+		else if (!wget_strcasecmp_ascii(line, "URL")) {
+			if (!zs->url)
+				zs->url = value; // use the first one
+		} else if (!wget_strcasecmp_ascii(line, "Blocksize"))
+			zs->blocksize = (size_t) atol(value);
+		else if (!wget_strcasecmp_ascii(line, "Length"))
+			zs->length = (off_t) atoll(value);
+		else if (!wget_strcasecmp_ascii(line, "Hash-Lengths")) {
+			if (sscanf(value, "%d,%d,%d", &zs->seq_matches, &zs->rsum_bytes, &zs->checksum_bytes) != 3)
+				zs->seq_matches = 0; // make it fail below
+		} else if (!wget_strcasecmp_ascii(line, "SHA-1"))
+			wget_strscpy(zs->sha1, value, sizeof(zs->sha1));
+	}
+
+	if (!eol || !zs->url || zs->length <= 0 || zs->blocksize < 16 || zs->blocksize > (1 << 24)
+		|| zs->seq_matches < 1 || zs->seq_matches > 2
+		|| zs->rsum_bytes < 1 || zs->rsum_bytes > 4
+		|| zs->checksum_bytes < 3 || zs->checksum_bytes > 16
+		|| strlen(zs->sha1) != 40)
+	{
+		error_printf(_("Unsupported or invalid zsync control file\n"));
+		return -1;
+	}
+
+	// Length and Blocksize come from the server: keep nblocks (and nbuckets, up to 4 * nblocks) within int
+	long long nblocks = (long long) (zs->length / zs->blocksize) + (zs->length % zs->blocksize != 0);
+
+	if (nblocks > INT_MAX / 4) {
+		error_printf(_("Unsupported or invalid zsync control file\n"));
+		return -1;
+	}
+
+	zs->nblocks = (int) nblocks;
+	zs->rsum_mask = zs->rsum_bytes == 4 ? 0xFFFFFFFF : (1U << (8 * zs->rsum_bytes)) - 1;
+
+	if ((size_t) (data + size - line) < (size_t) zs->nblocks * (zs->rsum_bytes + zs->checksum_bytes)) {
+		error_printf(_("Truncated zsync control file\n"));
+		return -1;
+	}
+
+	for (zs->nbuckets = 16; zs->nbuckets < zs->nblocks * 2; zs->nbuckets *= 2);
+	zs->buckets = wget_malloc(zs->nbuckets * sizeof(int));
+	memset(zs->buckets, 0xFF, zs->nbuckets * sizeof(int)); // all -1
+
+	zs->blocks = wget_calloc(zs->nblocks, sizeof(_zsync_block_t));
+
+	// blocks are stored as the last rsum_bytes of the big-endian weak checksum, followed by the MD4 prefix
+	p = (const unsigned char *) line;
+	for (int it = 0; it < zs->nblocks; it++) {
+		_zsync_block_t *block = &zs->blocks[it];
+		int bucket;
+
+		for (int n = 0; n < zs->rsum_bytes; n++)
+			block->rsum = (block->rsum << 8) | *p++;
+		memcpy(block->checksum, p, zs->checksum_bytes);
+		p += zs->checksum_bytes;
+
+		bucket = _bucket(zs, block->rsum);
+		block->next = zs->buckets[bucket];
+		zs->buckets[bucket] = it;
+	}
+
+	return 0;
+}
+
+static void _zsync_free(_zsync_t *zs)
+{
+	xfree(zs->buckets);
+	xfree(zs->blocks);
+}
+
+static int _checksum_matches(const _zsync_t *zs, int blockno, const unsigned char *data)
+{
+	unsigned char md4[16];
+
+	md4_buffer((const char *) data, zs->blocksize, md4);
+
+	return !memcmp(md4, zs->blocks[blockno].checksum, zs->checksum_bytes);
+}
+
+// copy blocks found in the old file into the new file, returns the number of blocks reused
+static int _zsync_reuse(const _zsync_t *zs, int oldfd, int newfd, bool *have)
+{
+	size_t bs = zs->blocksize, bufsize = bs * 32, len = 0, pos = 0;
+	unsigned char *buf = wget_malloc(bufsize);
+	uint16_t a = 0, b = 0;
+	bool eof = false, valid = false;
+	off_t offset = 0; // file offset of buf[0]
+	int reused = 0;
+
+	for (;;) {
+		// keep two blocks ahead of pos available for rolling and sequential matches
+		if (!eof && len - pos < 2 * bs) {
+			size_t nbytes;
+
+			memmove(buf, buf + pos, len - pos);
+			offset += pos;
+			len -= pos;
+			pos = 0;
+
+			nbytes = safe_read(oldfd, buf + len, bufsize - len);
+			if (nbytes == SAFE_READ_ERROR || nbytes == 0) {
+				// zsync pads the last block with zeros
+				eof = true;
+				if (bufsize - len < bs) {
+					buf = wget_realloc(buf, bufsize += bs);
+				}
+				memset(buf + len, 0, bs);
+				len += bs;
+			} else
+				len += nbytes;
+		}
+
+		if (pos + bs > len || (eof && pos >= len - bs))
+			break; // window starts in the padding
+
+		if (!valid) {
+			uint32_t r = _rsum(buf + pos, bs);
+
+			a = r >> 16;
+			b = r & 0xFFFF;
+			valid = true;
+		}
+
+		uint32_t rsum = (((uint32_t) a << 16) | b) & zs->rsum_mask;
+		bool matched = false;
+
+		for (int it = zs->buckets[_bucket(zs, rsum)]; it >= 0; it = zs->blocks[it].next) {
+			if (zs->blocks[it].rsum != rsum || !_checksum_matches(zs, it, buf + pos))
+				continue;
+
+			// with short checksums, zsync expects the following block to match as well
+			if (zs->seq_matches > 1 && it + 1 < zs->nblocks
+				&& (pos + 2 * bs > len || !_checksum_matches(zs, it + 1, buf + pos + bs)))
+				continue;
+
+			if (!have[it]) {
+				off_t target = (off_t) it * bs;
+				size_t n = (zs->length - target) < (off_t) bs ? (size_t) (zs->length - target) : bs;
+
+				if (lseek(newfd, target, SEEK_SET) == (off_t) -1 || safe_write(newfd, buf + pos, n) != n) {
+					error_printf(_("Failed to write (errno=%d)\n"), errno);
+					xfree(buf);
+					return -1;
+				}
+
+				have[it] = true;
+				reused++;
+			}
+
+			matched = true; // identical blocks may occur several times, keep searching
+		}
+
+		if (matched) {
+			pos += bs;
+			valid = false;
+		} else {
+			// roll the checksum one byte forward
+			unsigned char out = buf[pos], in = buf[pos + bs];
+
+			a += in - out;
+			b += a - bs * out;
+			pos++;
+		}
+	}
+
+	debug_printf("zsync: reused %d of %d blocks from offset range 0-%lld\n", reused, zs->nblocks, (long long) (offset + pos));
+	xfree(buf);
+
+	return reused;
+}
+
+// name of the local target file: strip '.zsync' or use the Filename header in the same directory
+static char *_target_filename(const _zsync_t *zs, const char *fname)
+{
+	size_t len = strlen(fname);
+	const char *p;
+
+	if (len > 6 && wget_match_tail(fname, ".zsync"))
+		return wget_strmemdup(fname, len - 6);
+
+	if (!zs->filename || !*zs->filename || strchr(zs->filename, '/') || !strcmp(zs->filename, ".") || !strcmp(zs->filename, ".."))
+		return NULL;
+
+	if ((p = strrchr(fname, '/')))
+		return wget_aprintf("%.*s/%s", (int) (p - fname), fname, zs->filename);
+
+	return wget_strdup(zs->filename);
+}
+
+wget_metalink *zsync_prepare(wget_iri *base, const char *fname, off_t max_part, wget_vector **parts, char **replace)
+{
+	_zsync_t zs;
+	wget_metalink *metalink = NULL;
+	wget_metalink_hash hash;
+	wget_metalink_mirror *mirror;
+	char *data, *target = NULL, *tmp = NULL;
+	bool *have = NULL;
+	size_t size;
+	int oldfd, newfd, reused = 0;
+
+	*parts = NULL;
+	*replace = NULL;
+
+	if (!(data = wget_read_file(fname, &size)))
+		return NULL;
+
+	if (_zsync_parse(&zs, data, size))
+		goto out;
+
+	if (!(target = _target_filename(&zs, fname))) {
+		error_printf(_("Cannot determine target file name for '%s'\n"), fname);
+		goto out;
+	}
+
+	have = wget_calloc(zs.nblocks, sizeof(bool));
+
+	// build the new file next to the old one, the old one is replaced when the new one has been validated
+	if ((oldfd = open(target, O_RDONLY | O_BINARY)) != -1) {
+		tmp = wget_aprintf("%s.zsync-tmp", target);
+
+		if ((newfd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0644)) != -1) {
+			reused = _zsync_reuse(&zs, oldfd, newfd, have);
+			close(newfd);
+		} else {
+			error_printf(_("Failed to open '%s' for writing\n"), tmp);
+			reused = -1;
+		}
+		close(oldfd);
+
+		if (reused < 0) {
+			unlink(tmp);
+			goto out;
+		}
+
+		if (wget_truncate(tmp, zs.length)) {
+			error_printf(_("Failed to truncate '%s' (errno=%d)\n"), tmp, errno);
+			unlink(tmp);
+			goto out;
+		}
+	}
+
+	info_printf(_("zsync: %d of %d blocks of '%s' reused\n"), reused, zs.nblocks, target);
+
+	// the missing ranges are downloaded into the temporary file, see zsync_commit()
+	metalink = wget_calloc(1, sizeof(wget_metalink));
+	metalink->size = zs.length;
+	if (tmp) {
+		metalink->name = tmp;
+		*replace = target;
+		tmp = target = NULL;
+	} else {
+		metalink->name = target;
+		target = NULL;
+	}
+
+	memset(&hash, 0, sizeof(hash));
+	wget_strscpy(hash.type, "sha1", sizeof(hash.type));
+	wget_strscpy(hash.hash_hex, zs.sha1, sizeof(hash.hash_hex));
+	metalink->hashes = wget_vector_create(1, NULL);
+	wget_vector_add_memdup(metalink->hashes, &hash, sizeof(hash));
+
+	mirror = wget_calloc(1, sizeof(wget_metalink_mirror));
+	wget_strscpy(mirror->location, "-", sizeof(mirror->location));
+	if (!(mirror->iri = wget_iri_parse_base(base, zs.url, "utf-8"))) {
+		error_printf(_("Invalid URL '%s' in '%s'\n"), zs.url, fname);
+		xfree(mirror);
+		if (*replace)
+			unlink(metalink->name);
+		xfree(*replace);
+		wget_metalink_free(&metalink);
+		goto out;
+	}
+	metalink->mirrors = wget_vector_create(1, NULL);
+	wget_vector_set_destructor(metalink->mirrors, (wget_vector_destructor_t *) _free_mirror);
+	wget_vector_add(metalink->mirrors, mirror);
+
+	// merge missing blocks into ranges of at most max_part bytes
+	*parts = wget_vector_create(16, NULL);
+	for (int it = 0; it < zs.nblocks; ) {
+		PART part;
+
+		if (have[it]) {
+			it++;
+			continue;
+		}
+
+		memset(&part, 0, sizeof(part));
+		part.position = (off_t) it * zs.blocksize;
+		part.id = wget_vector_size(*parts) + 1;
+
+		for (; it < zs.nblocks && !have[it] && (part.length == 0 || part.length + (off_t) zs.blocksize <= max_part); it++)
+			part.length += zs.blocksize;
+
+		if (part.position + part.length > zs.length)
+			part.length = zs.length - part.position;
+
+		wget_vector_add_memdup(*parts, &part, sizeof(part));
+	}
+
+	debug_printf("zsync: %d ranges to download from %s\n", wget_vector_size(*parts), mirror->iri->uri);
+
+out:
+	_zsync_free(&zs);
+	xfree(have);
+	xfree(tmp);
+	xfree(target);
+	xfree(data);
+
+	return metalink;
+}
+
+// replace the old target file by the validated new one
+void zsync_commit(JOB *job)
+{
+	if (!job->zsync_target)
+		return;
+
+	if (rename(job->metalink->name, job->zsync_target))
+		error_printf(_("Failed to replace '%s' (errno=%d)\n"), job->zsync_target, errno);
+	else
+		debug_printf("zsync: replaced '%s'\n", job->zsync_target);
+
+	xfree(job->zsync_target);
+}
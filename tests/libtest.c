@@ -71,6 +71,8 @@
 #  define file_load_err(fname, msg) wget_error_printf_exit("Couldn't load '%s' : %s\n", fname, msg)
 #endif
 
+#define MULTIPART_BOUNDARY "LIBTEST_BYTERANGES_BOUNDARY"
+
 static int
 	http_server_port,
 	https_server_port,
@@ -223,8 +225,9 @@ static ssize_t _callback (void *cls, uint64_t pos, char *buf, size_t buf_size)
 	if (pos >= param->response_size)
 		return MHD_CONTENT_READER_END_OF_STREAM;
 
-	// divide data into two chunks
-	buf_size = (param->response_size / 2) + 1;
+	// divide data into two chunks, larger data into chunks of at most buf_size bytes
+	if (buf_size > (param->response_size / 2) + 1)
+		buf_size = (param->response_size / 2) + 1;
 	if (buf_size < (param->response_size - pos))
 		size_to_copy = buf_size;
 	else
@@ -235,6 +238,23 @@ static ssize_t _callback (void *cls, uint64_t pos, char *buf, size_t buf_size)
 	return size_to_copy;
 }
 
+// like _callback(), but the connection is closed after response_size bytes of a longer body
+static ssize_t _cut_callback(void *cls, uint64_t pos, char *buf, size_t buf_size)
+{
+	struct ResponseContentCallbackParam *const param =
+		(struct ResponseContentCallbackParam *)cls;
+
+	if (pos >= param->response_size)
+		return MHD_CONTENT_READER_END_WITH_ERROR;
+
+	if (buf_size > param->response_size - pos)
+		buf_size = param->response_size - pos;
+
+	memcpy(buf, param->response_data + pos, buf_size);
+
+	return buf_size;
+}
+
 static void _free_callback_param(void *cls)
 {
 	wget_free(cls);
@@ -402,7 +422,7 @@ static int _answer_to_connection(
 		wget_buffer_strcat(url_full, "index.html");
 
 	// it1 = iteration for urls data
-	unsigned int found = 0, chunked = 0;
+	unsigned int found = 0, chunked = 0, multipart_response = 0;
 	for (unsigned it1 = 0; it1 < nurls && !found; it1++) {
 		if (urls[it1].http_only && https)
 			continue;
@@ -585,10 +605,60 @@ static int _answer_to_connection(
 				}
 			}
 
-			if (modified && urls[it1].modified <= modified) {
+			if (urls[it1].cut_after && !urls[it1].cut) {
+				// announce the whole body, but break the connection within it
+				struct ResponseContentCallbackParam *callback_param = wget_malloc(sizeof(struct ResponseContentCallbackParam));
+
+				callback_param->response_data = urls[it1].body;
+				callback_param->response_size = urls[it1].cut_after;
+
+				response = MHD_create_response_from_callback(body_length,
+					1024, &_cut_callback, callback_param, &_free_callback_param);
+				ret = MHD_queue_response(connection, MHD_HTTP_OK, response);
+				urls[it1].cut = 1;
+			}
+			else if (urls[it1].cut && urls[it1].code_after_cut) {
+				unsigned code = (unsigned) atoi(urls[it1].code_after_cut);
+
+				// a 200 ignores the Range header, like a server whose file has changed
+				if (code == MHD_HTTP_OK)
+					response = MHD_create_response_from_buffer(body_length, (void *) urls[it1].body, MHD_RESPMEM_MUST_COPY);
+				else
+					response = MHD_create_response_from_buffer(0, (void *) "", MHD_RESPMEM_PERSISTENT);
+				ret = MHD_queue_response(connection, code, response);
+			}
+			else if (urls[it1].cut && !*header_range->data) {
+				// the transfer has to be resumed
+				response = MHD_create_response_from_buffer(0, (void *) "", MHD_RESPMEM_PERSISTENT);
+				ret = MHD_queue_response(connection, MHD_HTTP_BAD_REQUEST, response);
+			}
+			else if (modified && urls[it1].modified <= modified) {
 				response = MHD_create_response_from_buffer(0, (void *) "", MHD_RESPMEM_PERSISTENT);
 				ret = MHD_queue_response(connection, MHD_HTTP_NOT_MODIFIED, response);
 			}
+			else if (*header_range->data && strchr(header_range->data, ',')) {
+				// multi-range request, answer with multipart/byteranges (RFC 7233 appendix A)
+				wget_buffer *multipart = wget_buffer_alloc(1024);
+				const char *s = strchr(header_range->data, '=') + 1;
+
+				for (; s; s = strchr(s, ',') ? strchr(s, ',') + 1 : NULL) {
+					size_t first = (size_t) atoll(s), last = (size_t) atoll(strchr(s, '-') + 1);
+
+					if (last >= body_length)
+						last = body_length - 1;
+
+					wget_buffer_printf_append(multipart, "\r\n--" MULTIPART_BOUNDARY "\r\nContent-Range: bytes %zu-%zu/%zu\r\n\r\n",
+						first, last, body_length);
+					wget_buffer_memcat(multipart, urls[it1].body + first, last - first + 1);
+				}
+				wget_buffer_strcat(multipart, "\r\n--" MULTIPART_BOUNDARY "--\r\n");
+
+				response = MHD_create_response_from_buffer(multipart->length, multipart->data, MHD_RESPMEM_MUST_COPY);
+				MHD_add_response_header(response, MHD_HTTP_HEADER_CONTENT_TYPE, "multipart/byteranges; boundary=" MULTIPART_BOUNDARY);
+				ret = MHD_queue_response(connection, MHD_HTTP_PARTIAL_CONTENT, response);
+				wget_buffer_free(&multipart);
+				multipart_response = 1;
+			}
 			else if (*header_range->data) {
 				if (!strcmp(to_bytes_string, "-"))
 					to_bytes = body_length - 1;
@@ -620,7 +690,9 @@ static int _answer_to_connection(
 					if (header) {
 						const char *header_value = strchr(header, ':');
 						const char *header_key = wget_strmemdup(header, header_value - header);
-						MHD_add_response_header(response, header_key, header_value + 2);
+						// the type of the parts is not given in the multipart/byteranges response
+						if (!multipart_response || wget_strcasecmp_ascii(header_key, "Content-Type"))
+							MHD_add_response_header(response, header_key, header_value + 2);
 						wget_xfree(header_key);
 					}
 				}
@@ -150,6 +150,13 @@ typedef struct {
 		http_only : 1;
 	bool
 		header_alloc[10]; // if header[n] has been allocated internally (and need to be freed on exit)
+
+	size_t
+		cut_after; // the first response closes the connection after this many bytes of the body
+	const char *
+		code_after_cut; // status code of the responses after the cut, NULL to answer Range requests only
+	bool
+		cut : 1; // if the body has already been cut off once
 } wget_test_url_t;
 
 WGETAPI void wget_test_stop_server(void);
@@ -0,0 +1,185 @@
+/*
+ * Copyright(c) 2019 Free Software Foundation, Inc.
+ *
+ * This file is part of libwget.
+ *
+ * Libwget is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Libwget is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libwget.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *
+ * Tests the archive output (--archive).
+ */
+
+#include <config.h>
+
+#include <stdlib.h> // exit()
+#include <string.h>
+#include "libtest.h"
+
+// append a POSIX ustar entry: header block, data padded to a multiple of 512
+static size_t _tar_entry(char *archive, size_t len, const char *name, const char *data, unsigned mtime)
+{
+	char *header = archive + len;
+	size_t datalen = strlen(data);
+	unsigned checksum = 0;
+
+	memcpy(header, name, strlen(name));
+	memcpy(header + 100, "0000644", 7);
+	memcpy(header + 108, "0000000", 7);
+	memcpy(header + 116, "0000000", 7);
+	wget_snprintf(header + 124, 12, "%011o", (unsigned) datalen);
+	wget_snprintf(header + 136, 12, "%011o", mtime);
+	memset(header + 148, ' ', 8);
+	header[156] = '0';
+	memcpy(header + 257, "ustar", 6);
+	memcpy(header + 263, "00", 2);
+
+	for (int it = 0; it < 512; it++)
+		checksum += (unsigned char) header[it];
+	wget_snprintf(header + 148, 8, "%06o", checksum);
+
+	memcpy(header + 512, data, datalen);
+
+	return len + 512 + (datalen + 511) / 512 * 512;
+}
+
+// append a SVR4 'newc' cpio entry: header and name as well as the data are padded to multiples of 4
+static size_t _cpio_entry(char *archive, size_t len, unsigned ino, const char *name, const char *data, unsigned mtime)
+{
+	size_t namesize = strlen(name) + 1, datalen = strlen(data);
+
+	len += wget_snprintf(archive + len, 111, "070701%08X%08X%08X%08X%08X%08X%08X%08X%08X%08X%08X%08X%08X",
+		ino, 0100644, 0, 0, 1, mtime, (unsigned) datalen, 0, 0, 0, 0, (unsigned) namesize, 0);
+	memcpy(archive + len, name, namesize);
+	len = (len + namesize + 3) / 4 * 4;
+	memcpy(archive + len, data, datalen);
+
+	return (len + datalen + 3) / 4 * 4;
+}
+
+int main(void)
+{
+	wget_test_url_t urls[]={
+		{	.name = "/a.txt",
+			.code = "200 Dontcare",
+			.body = "hello\n",
+			.headers = {
+				"Content-Type: text/plain",
+				"Last-Modified: Sat, 09 Oct 2004 08:30:00 GMT", // 0x4167A188
+			}
+		},
+		{	.name = "/index.html",
+			.code = "200 Dontcare",
+			.body = "<html><body><a href=\"http://localhost:{{port}}/a.txt\">a</a></body></html>",
+			.headers = {
+				"Content-Type: text/html",
+				"Last-Modified: Sat, 09 Oct 2004 08:30:00 GMT",
+			}
+		},
+		{	.name = "/big.txt",
+			.code = "200 Dontcare",
+			.headers = {
+				"Content-Type: text/plain",
+				"Last-Modified: Sat, 09 Oct 2004 08:30:00 GMT",
+			}
+		},
+	};
+
+	// larger than what is kept in memory (10 MiB), received into a temporary file
+	size_t big_size = 10 * 1024 * 1024 + 1000;
+	char *big = wget_malloc(big_size + 1);
+
+	for (size_t it = 0; it < big_size; it++)
+		big[it] = 'a' + it % 26;
+	big[big_size] = 0;
+	urls[2].body = big;
+
+	// SVR4 'newc' cpio: header, name and data padded to multiples of 4, trailer, padded to 512 bytes
+	static char archive[512];
+	size_t len = 0;
+
+	len += wget_snprintf(archive + len, sizeof(archive) - len,
+		"070701" "00000001" "000081A4" "00000000" "00000000" "00000001" "4167A188" "00000006"
+		"00000000" "00000000" "00000000" "00000000" "00000006" "00000000" "a.txt");
+	len += 1; // name terminator
+	len += wget_snprintf(archive + len, sizeof(archive) - len, "hello\n");
+	len += 2; // data padding
+	len += wget_snprintf(archive + len, sizeof(archive) - len,
+		"070701" "00000002" "000081A4" "00000000" "00000000" "00000001" "00000000" "00000000"
+		"00000000" "00000000" "00000000" "00000000" "0000000B" "00000000" "TRAILER!!!");
+
+	// functions won't come back if an error occurs
+	wget_test_start_server(
+		WGET_TEST_RESPONSE_URLS, &urls, countof(urls),
+		WGET_TEST_FEATURE_MHD,
+		0);
+
+	// the document is written into the archive, not into the file system
+	wget_test(
+		WGET_TEST_OPTIONS, "-nH --archive=out.cpio --archive-format=cpio",
+		WGET_TEST_REQUEST_URL, "a.txt",
+		WGET_TEST_EXPECTED_ERROR_CODE, 0,
+		WGET_TEST_EXPECTED_FILES, &(wget_test_file_t []) {
+			{ "out.cpio", archive, .content_length = sizeof(archive) },
+			{	NULL } },
+		0);
+
+	// tar: header and data blocks, two zero blocks at the end
+	static char tar[4 * 512];
+
+	len = _tar_entry(tar, 0, "a.txt", "hello\n", 0x4167A188);
+
+	wget_test(
+		WGET_TEST_OPTIONS, "-nH --archive=out.tar",
+		WGET_TEST_REQUEST_URL, "a.txt",
+		WGET_TEST_EXPECTED_ERROR_CODE, 0,
+		WGET_TEST_EXPECTED_FILES, &(wget_test_file_t []) {
+			{ "out.tar", tar, .content_length = len + 1024 },
+			{	NULL } },
+		0);
+
+	// with --convert-links, documents are spooled and converted when all downloads are done
+	static char cpio[1024];
+
+	len = _cpio_entry(cpio, 0, 1, "a.txt", "hello\n", 0x4167A188);
+	len = _cpio_entry(cpio, len, 2, "index.html", "<html><body><a href=\"a.txt\">a</a></body></html>", 0x4167A188);
+	len = _cpio_entry(cpio, len, 3, "TRAILER!!!", "", 0);
+	len = (len + 511) / 512 * 512;
+
+	wget_test(
+		WGET_TEST_OPTIONS, "-r -nH -k --max-threads=1 --archive=out.cpio --archive-format=cpio",
+		WGET_TEST_REQUEST_URL, "index.html",
+		WGET_TEST_EXPECTED_ERROR_CODE, 0,
+		WGET_TEST_EXPECTED_FILES, &(wget_test_file_t []) {
+			{ "out.cpio", cpio, .content_length = len },
+			{	NULL } },
+		0);
+
+	char *big_tar = wget_calloc(1, big_size + 4 * 512);
+
+	len = _tar_entry(big_tar, 0, "big.txt", big, 0x4167A188);
+
+	wget_test(
+		WGET_TEST_OPTIONS, "-nH --archive=out.tar",
+		WGET_TEST_REQUEST_URL, "big.txt",
+		WGET_TEST_EXPECTED_ERROR_CODE, 0,
+		WGET_TEST_EXPECTED_FILES, &(wget_test_file_t []) {
+			{ "out.tar", big_tar, .content_length = len + 1024 },
+			{	NULL } },
+		0);
+
+	wget_xfree(big_tar);
+	wget_xfree(big);
+
+	exit(0);
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright(c) 2019 Free Software Foundation, Inc.
+ *
+ * This file is part of libwget.
+ *
+ * Libwget is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Libwget is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libwget.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *
+ * Tests the CA snapshot file (--ca-snapshot).
+ */
+
+#include <config.h>
+
+#include <stdlib.h> // exit()
+
+#include "libtest.h"
+
+#ifdef WITH_GNUTLS
+#  include <gnutls/gnutls.h>
+#endif
+
+int main(void)
+{
+#if !(defined WITH_GNUTLS && GNUTLS_VERSION_NUMBER >= 0x030400)
+	exit(77);
+#else
+	wget_test_url_t urls[]={
+		{	.name = "/index.html",
+			.code = "200 Dontcare",
+			.body = "<html>hello</html>",
+			.headers = {
+				"Content-Type: text/html",
+			}
+		},
+	};
+	static const char *system_snapshot = "#wget2 CA snapshot 1 system 0-0\n";
+
+	// functions won't come back if an error occurs
+	wget_test_start_server(
+		WGET_TEST_RESPONSE_URLS, &urls, countof(urls),
+		WGET_TEST_FEATURE_MHD,
+		WGET_TEST_FEATURE_TLS,
+		0);
+
+	// the CAs of a CA directory are snapshotted
+	wget_test(
+		WGET_TEST_OPTIONS, "--ca-directory=" SRCDIR "/certs --ca-snapshot=ca.snapshot --no-ocsp",
+		WGET_TEST_REQUEST_URL, "https://localhost:{{sslport}}/index.html",
+		WGET_TEST_EXPECTED_ERROR_CODE, 0,
+		WGET_TEST_EXPECTED_FILES, &(wget_test_file_t []) {
+			{ urls[0].name + 1, urls[0].body },
+			{ "ca.snapshot", NULL },
+			{	NULL } },
+		0);
+
+	// the system trust store (which doesn't know the test CA) is neither snapshotted
+	// nor taken from an existing snapshot
+	wget_test(
+		WGET_TEST_OPTIONS, "--ca-directory=system --ca-snapshot=ca.snapshot --no-ocsp",
+		WGET_TEST_REQUEST_URL, "https://localhost:{{sslport}}/index.html",
+		WGET_TEST_EXPECTED_ERROR_CODE, 5,
+		WGET_TEST_EXISTING_FILES, &(wget_test_file_t []) {
+			{ "ca.snapshot", system_snapshot },
+			{	NULL } },
+		WGET_TEST_EXPECTED_FILES, &(wget_test_file_t []) {
+			{ "ca.snapshot", system_snapshot },
+			{	NULL } },
+		0);
+
+	exit(0);
+#endif
+}
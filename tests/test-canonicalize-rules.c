@@ -0,0 +1,90 @@
+/*
+ * Copyright(c) 2019 Free Software Foundation, Inc.
+ *
+ * This file is part of libwget.
+ *
+ * Libwget is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Libwget is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libwget.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *
+ * Tests the --canonicalize-rules option.
+ */
+
+#include <config.h>
+
+#include <stdlib.h> // exit()
+#include "libtest.h"
+
+int main(void)
+{
+	wget_test_url_t urls[]={
+		{	.name = "/start.html",
+			.code = "200 Dontcare",
+			.body = "<html><head></head><body>"\
+					"<a href=\"/page.html?a=1&amp;b=2\">page</a>"\
+					"<a href=\"/page.html?b=2&amp;utm_source=test&amp;a=1\">same page</a>"\
+					"<a href=\"/dir/index.html\">dir</a>"\
+					"<a href=\"/dir/\">same dir</a>"\
+					"</body></html>",
+			.headers = {
+				"Content-Type: text/html",
+			}
+		},
+		{	.name = "/page.html?a=1&b=2",
+			.code = "200 Dontcare",
+			.body = "<html>page</html>",
+			.headers = {
+				"Content-Type: text/html",
+			}
+		},
+		{	.name = "/dir/",
+			.code = "200 Dontcare",
+			.body = "<html>dir</html>",
+			.headers = {
+				"Content-Type: text/html",
+			}
+		},
+	};
+
+	wget_test_file_t rules = {
+		.name = "rules.txt",
+		.content =
+			"# drop tracking parameters\n"\
+			"strip * utm_*\n"\
+			"sort-params *\n"\
+			"fold-index * index.html\n"
+	};
+
+	// functions won't come back if an error occurs
+	wget_test_start_server(
+		WGET_TEST_RESPONSE_URLS, &urls, countof(urls),
+		WGET_TEST_FEATURE_MHD,
+		0);
+
+	wget_test(
+		WGET_TEST_OPTIONS, "-nH -r --canonicalize-rules=rules.txt",
+		WGET_TEST_REQUEST_URL, "start.html",
+		WGET_TEST_EXPECTED_ERROR_CODE, 0,
+		WGET_TEST_EXISTING_FILES, &(wget_test_file_t []) {
+			{ rules.name, rules.content },
+			{	NULL } },
+		WGET_TEST_EXPECTED_FILES, &(wget_test_file_t []) {
+			{ urls[0].name + 1, urls[0].body },
+			{ urls[1].name + 1, urls[1].body },
+			{ "dir/index.html", urls[2].body },
+			{ rules.name, rules.content },
+			{	NULL } },
+		0);
+
+	exit(0);
+}
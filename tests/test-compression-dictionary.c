@@ -0,0 +1,129 @@
+/*
+ * Copyright(c) 2019 Free Software Foundation, Inc.
+ *
+ * This file is part of libwget.
+ *
+ * Libwget is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Libwget is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libwget.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *
+ * Tests the Compression Dictionary Transport negotiation (--dictionary-dir).
+ */
+
+#include <config.h>
+
+#include <stdlib.h> // exit()
+#include <string.h>
+#include "libtest.h"
+
+// 'function version() { return 2; }\n' compressed by zstd with the body of app.v1.js as raw dictionary
+#define DCZ_FRAME "\x28\xb5\x2f\xfd\x20\x21\x65\x00\x00\x30\x66\x32\x3b\x20\x7d\x0a\x01\x00\x24\x54\x42"
+
+int main(void)
+{
+#if !(defined WITH_BROTLIDEC && defined HAVE_BROTLIDECODERATTACHDICTIONARY) && !defined WITH_ZSTD
+	exit(77); // no decoder supports dictionaries
+#endif
+
+	wget_test_url_t urls[]={
+		{	.name = "/app.v1.js",
+			.code = "200 Dontcare",
+			.body = "function version() { return 1; }\n",
+			.headers = {
+				"Content-Type: application/javascript",
+				"Use-As-Dictionary: match=\"/app.*.js\", match-dest=(\"script\"), id=\"bundle\"",
+			},
+			.unexpected_req_headers = {
+				"Available-Dictionary",
+			}
+		},
+		{	.name = "/app.v2.js",
+			.code = "200 Dontcare",
+			.body = "function version() { return 2; }\n",
+			.headers = {
+				"Content-Type: application/javascript",
+			},
+			.expected_req_headers = {
+				NULL, // set below
+				"Dictionary-ID: \"bundle\"",
+			}
+		},
+		{	.name = "/app.v3.js",
+			.code = "200 Dontcare",
+			.body = NULL, // set below
+			.headers = {
+				"Content-Type: application/javascript",
+				"Content-Encoding: dcz",
+			},
+			.expected_req_headers = {
+				NULL, // set below
+			}
+		},
+	};
+
+	unsigned char digest[32];
+	char available[128], dict_fname[80], hex[65], b64[48];
+
+	wget_hash_fast(WGET_DIGTYPE_SHA256, urls[0].body, strlen(urls[0].body), digest);
+	wget_memtohex(digest, sizeof(digest), hex, sizeof(hex));
+	wget_base64_encode(b64, (const char *) digest, sizeof(digest));
+
+	wget_snprintf(available, sizeof(available), "Available-Dictionary: :%s:", b64);
+	wget_snprintf(dict_fname, sizeof(dict_fname), "dict/%s", hex);
+	urls[1].expected_req_headers[0] = available;
+	urls[2].expected_req_headers[0] = available;
+
+	// 'dcz' stream: magic, SHA-256 of the dictionary, zstd frame
+	char dcz[8 + 32 + sizeof(DCZ_FRAME) - 1];
+	memcpy(dcz, "\x5e\x2a\x4d\x18\x20\x00\x00\x00", 8);
+	memcpy(dcz + 8, digest, 32);
+	memcpy(dcz + 40, DCZ_FRAME, sizeof(DCZ_FRAME) - 1);
+	urls[2].body = dcz;
+	urls[2].body_len = sizeof(dcz);
+
+	// functions won't come back if an error occurs
+	wget_test_start_server(
+		WGET_TEST_RESPONSE_URLS, &urls, countof(urls),
+		WGET_TEST_FEATURE_MHD,
+		0);
+
+	// the first file is stored as dictionary and offered when requesting the second
+	wget_test(
+		WGET_TEST_OPTIONS, "-nH --max-threads=1 --dictionary-dir=dict",
+		WGET_TEST_REQUEST_URLS, "app.v1.js", "app.v2.js", NULL,
+		WGET_TEST_EXPECTED_ERROR_CODE, 0,
+		WGET_TEST_EXPECTED_FILES, &(wget_test_file_t []) {
+			{ urls[0].name + 1, urls[0].body },
+			{ urls[1].name + 1, urls[1].body },
+			{ dict_fname, urls[0].body },
+			{ "dict/index", NULL }, // do not check content
+			{	NULL } },
+		0);
+
+#ifdef WITH_ZSTD
+	// a 'dcz' response is decoded with the offered dictionary
+	wget_test(
+		WGET_TEST_OPTIONS, "-nH --max-threads=1 --dictionary-dir=dict",
+		WGET_TEST_REQUEST_URLS, "app.v1.js", "app.v3.js", NULL,
+		WGET_TEST_EXPECTED_ERROR_CODE, 0,
+		WGET_TEST_EXPECTED_FILES, &(wget_test_file_t []) {
+			{ urls[0].name + 1, urls[0].body },
+			{ urls[2].name + 1, "function version() { return 2; }\n" },
+			{ dict_fname, urls[0].body },
+			{ "dict/index", NULL }, // do not check content
+			{	NULL } },
+		0);
+#endif
+
+	exit(0);
+}
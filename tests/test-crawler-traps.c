@@ -0,0 +1,128 @@
+/*
+ * Copyright(c) 2019 Free Software Foundation, Inc.
+ *
+ * This file is part of libwget.
+ *
+ * Libwget is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Libwget is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libwget.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *
+ * Tests the crawler trap detection (--trap-* options).
+ */
+
+#include <config.h>
+
+#include <stdlib.h> // exit()
+#include "libtest.h"
+
+int main(void)
+{
+	wget_test_url_t urls[]={
+		{	.name = "/index.html",
+			.code = "200 Dontcare",
+			.body = "<html><head></head><body>"\
+					"<a href=\"/a/b/a/b/page.html\">repeated twice</a>"\
+					"<a href=\"/a/b/a/b/a/b/page.html\">repeated three times</a>"\
+					"<a href=\"/cal.html?day=1\">day 1</a>"\
+					"<a href=\"/cal.html?day=2\">day 2</a>"\
+					"<a href=\"/cal.html?day=3\">day 3</a>"\
+					"</body></html>",
+			.headers = {
+				"Content-Type: text/html",
+			}
+		},
+		{	.name = "/a/b/a/b/page.html",
+			.code = "200 Dontcare",
+			.body = "<html>page</html>",
+			.headers = {
+				"Content-Type: text/html",
+			}
+		},
+		{	.name = "/a/b/a/b/a/b/page.html",
+			.code = "200 Dontcare",
+			.body = "<html>trap</html>",
+			.headers = {
+				"Content-Type: text/html",
+			}
+		},
+		{	.name = "/cal.html?day=1",
+			.code = "200 Dontcare",
+			.body = "<html>day 1</html>",
+			.headers = {
+				"Content-Type: text/html",
+			}
+		},
+		{	.name = "/cal.html?day=2",
+			.code = "200 Dontcare",
+			.body = "<html>day 2</html>",
+			.headers = {
+				"Content-Type: text/html",
+			}
+		},
+		{	.name = "/cal.html?day=3",
+			.code = "200 Dontcare",
+			.body = "<html>day 3</html>",
+			.headers = {
+				"Content-Type: text/html",
+			}
+		},
+	};
+
+	// functions won't come back if an error occurs
+	wget_test_start_server(
+		WGET_TEST_RESPONSE_URLS, &urls, countof(urls),
+		WGET_TEST_FEATURE_MHD,
+		0);
+
+	// without limits everything is downloaded
+	wget_test(
+		WGET_TEST_OPTIONS, "-nH -r",
+		WGET_TEST_REQUEST_URL, "index.html",
+		WGET_TEST_EXPECTED_ERROR_CODE, 0,
+		WGET_TEST_EXPECTED_FILES, &(wget_test_file_t []) {
+			{ urls[0].name + 1, urls[0].body },
+			{ urls[1].name + 1, urls[1].body },
+			{ urls[2].name + 1, urls[2].body },
+			{ urls[3].name + 1, urls[3].body },
+			{ urls[4].name + 1, urls[4].body },
+			{ urls[5].name + 1, urls[5].body },
+			{	NULL } },
+		0);
+
+	// --trap-path-repeat and --trap-query-values
+	wget_test(
+		WGET_TEST_OPTIONS, "-nH -r --trap-path-repeat=2 --trap-query-values=2",
+		WGET_TEST_REQUEST_URL, "index.html",
+		WGET_TEST_EXPECTED_ERROR_CODE, 0,
+		WGET_TEST_EXPECTED_FILES, &(wget_test_file_t []) {
+			{ urls[0].name + 1, urls[0].body },
+			{ urls[1].name + 1, urls[1].body },
+			{ urls[3].name + 1, urls[3].body },
+			{ urls[4].name + 1, urls[4].body },
+			{	NULL } },
+		0);
+
+	// --trap-host-budget: only the first two links are followed (start URLs don't count)
+	wget_test(
+		WGET_TEST_OPTIONS, "-nH -r --trap-host-budget=2",
+		WGET_TEST_REQUEST_URL, "index.html",
+		WGET_TEST_EXPECTED_ERROR_CODE, 0,
+		WGET_TEST_EXPECTED_FILES, &(wget_test_file_t []) {
+			{ urls[0].name + 1, urls[0].body },
+			{ urls[1].name + 1, urls[1].body },
+			{ urls[2].name + 1, urls[2].body },
+			{	NULL } },
+		0);
+
+	exit(0);
+}
@@ -0,0 +1,158 @@
+/*
+ * Copyright(c) 2019 Free Software Foundation, Inc.
+ *
+ * This file is part of libwget.
+ *
+ * Libwget is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Libwget is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libwget.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *
+ * Tests the daemon protocol (--daemon) on the UNIX domain socket.
+ */
+
+#include <config.h>
+
+#include <stdlib.h> // exit()
+#include <string.h>
+#include "libtest.h"
+
+#ifndef _WIN32
+#  include <stdio.h>
+#  include <unistd.h>
+#  include <signal.h>
+#  include <sys/socket.h>
+#  include <sys/un.h>
+#  include <sys/wait.h>
+
+#define SOCKET_NAME "wget2.sock"
+
+static FILE *_connect_daemon(void)
+{
+	struct sockaddr_un addr;
+	int fd;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, SOCKET_NAME);
+
+	// the daemon creates the socket after wget_test() started it
+	for (int it = 0; it < 300; it++) {
+		if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+			return NULL;
+
+		if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == 0)
+			return fdopen(fd, "r+");
+
+		close(fd);
+		wget_millisleep(100);
+	}
+
+	return NULL;
+}
+
+// the client side: send one batch with a failing URL, check the replies and terminate the daemon
+static int _client(void)
+{
+	char line[256], ok_url[128], missing_url[128], ok_reply[160], missing_reply[160];
+	int ok_seen = 0, missing_seen = 0, done = 0;
+	FILE *fp;
+
+	alarm(60); // don't hang forever if the daemon misbehaves
+
+	wget_snprintf(ok_url, sizeof(ok_url), "http://localhost:%d/index.html", wget_test_get_http_server_port());
+	wget_snprintf(missing_url, sizeof(missing_url), "http://localhost:%d/missing.html", wget_test_get_http_server_port());
+	wget_snprintf(ok_reply, sizeof(ok_reply), "200 %s\n", ok_url);
+	wget_snprintf(missing_reply, sizeof(missing_reply), "404 %s\n", missing_url);
+
+	if (!(fp = _connect_daemon()))
+		return 1;
+
+	fprintf(fp, "URL %s\nURL %s\nEND\n", ok_url, missing_url);
+	fflush(fp);
+
+	// the replies of the jobs come in any order, followed by DONE <jobs> <errors>
+	while (fgets(line, sizeof(line), fp)) {
+		if (!strcmp(line, ok_reply))
+			ok_seen++;
+		else if (!strcmp(line, missing_reply))
+			missing_seen++;
+		else if (!strcmp(line, "DONE 2 1\n")) {
+			done = 1;
+			break;
+		} else {
+			wget_error_printf("Unexpected daemon reply '%s'\n", line);
+			break;
+		}
+	}
+	fclose(fp);
+
+	if (ok_seen != 1 || missing_seen != 1 || !done)
+		return 1;
+
+	if (!(fp = _connect_daemon()))
+		return 1;
+
+	fputs("QUIT\n", fp);
+	fclose(fp);
+
+	return 0;
+}
+#endif
+
+int main(void)
+{
+#ifdef _WIN32
+	exit(WGET_TEST_EXIT_SKIP);
+#else
+	wget_test_url_t urls[]={
+		{	.name = "/index.html",
+			.code = "200 Dontcare",
+			.body = "<html><body>hello</body></html>",
+			.headers = {
+				"Content-Type: text/html",
+			}
+		},
+	};
+	pid_t pid;
+	int status;
+
+	// functions won't come back if an error occurs
+	wget_test_start_server(
+		WGET_TEST_RESPONSE_URLS, &urls, countof(urls),
+		WGET_TEST_FEATURE_MHD,
+		0);
+
+	if ((pid = fork()) < 0) {
+		wget_error_printf("Failed to fork\n");
+		exit(1);
+	} else if (pid == 0) {
+		_exit(_client());
+	}
+
+	// the daemon runs until the client sends QUIT, the 404 sets the exit status
+	wget_test(
+		WGET_TEST_OPTIONS, "--daemon=" SOCKET_NAME,
+		WGET_TEST_EXPECTED_ERROR_CODE, 8,
+		WGET_TEST_EXPECTED_FILES, &(wget_test_file_t []) {
+			{ urls[0].name + 1, urls[0].body },
+			{	NULL } },
+		0);
+
+	if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status)) {
+		wget_error_printf("Daemon client failed\n");
+		exit(1);
+	}
+
+	exit(0);
+#endif
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright(c) 2019 Free Software Foundation, Inc.
+ *
+ * This file is part of libwget.
+ *
+ * Libwget is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Libwget is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libwget.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *
+ * Tests the memory budget (--max-memory).
+ */
+
+#include <config.h>
+
+#include <stdlib.h> // exit()
+#include "libtest.h"
+
+int main(void)
+{
+	wget_test_url_t urls[]={
+		{	.name = "/index.html",
+			.code = "200 Dontcare",
+			.body =
+				"<html><head><title>Main Page</title><link rel=\"stylesheet\" href=\"style.css\"></head>" \
+				"<body><p>A link to a <a href=\"second.html\">second page</a>.</p></body></html>",
+			.headers = {
+				"Content-Type: text/html",
+			}
+		},
+		{	.name = "/second.html",
+			.code = "200 Dontcare",
+			.body =
+				"<html><head><title>Second Page</title></head>" \
+				"<body><img src=\"picture.png\"></body></html>",
+			.headers = {
+				"Content-Type: text/html",
+			}
+		},
+		{	.name = "/style.css",
+			.code = "200 Dontcare",
+			.body = "body { background-image: url(\"background.png\"); }",
+			.headers = {
+				"Content-Type: text/css",
+			}
+		},
+		{	.name = "/picture.png",
+			.code = "200 Dontcare",
+			.body = "picture",
+			.headers = {
+				"Content-Type: image/png",
+			}
+		},
+		{	.name = "/background.png",
+			.code = "200 Dontcare",
+			.body = "background",
+			.headers = {
+				"Content-Type: image/png",
+			}
+		},
+	};
+
+	// functions won't come back if an error occurs
+	wget_test_start_server(
+		WGET_TEST_RESPONSE_URLS, &urls, countof(urls),
+		WGET_TEST_FEATURE_MHD,
+		0);
+
+	// always over the budget: the documents are parsed from the saved files
+	wget_test(
+		WGET_TEST_OPTIONS, "-nH -r --max-memory=1",
+		WGET_TEST_REQUEST_URL, "index.html",
+		WGET_TEST_EXPECTED_ERROR_CODE, 0,
+		WGET_TEST_EXPECTED_FILES, &(wget_test_file_t []) {
+			{ urls[0].name + 1, urls[0].body },
+			{ urls[1].name + 1, urls[1].body },
+			{ urls[2].name + 1, urls[2].body },
+			{ urls[3].name + 1, urls[3].body },
+			{ urls[4].name + 1, urls[4].body },
+			{	NULL } },
+		0);
+
+	exit(0);
+}
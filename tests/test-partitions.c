@@ -0,0 +1,93 @@
+/*
+ * Copyright(c) 2019 Free Software Foundation, Inc.
+ *
+ * This file is part of libwget.
+ *
+ * Libwget is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Libwget is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libwget.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *
+ * Tests partitioned crawling (--partitions).
+ */
+
+#include <config.h>
+
+#include <stdlib.h> // exit()
+#include "libtest.h"
+
+int main(void)
+{
+#ifdef _WIN32
+	exit(WGET_TEST_EXIT_SKIP);
+#else
+	// With 3 partitions 'localhost' belongs to partition 2 and '127.0.0.1' to partition 0,
+	// so the links between the two hosts have to be forwarded from one process to the other.
+	wget_test_url_t urls[]={
+		{	.name = "/index.html",
+			.code = "200 Dontcare",
+			.body = "<html><body><a href=\"http://127.0.0.1:{{port}}/second.html\">second</a></body></html>",
+			.headers = {
+				"Content-Type: text/html",
+			}
+		},
+		{	.name = "/second.html",
+			.code = "200 Dontcare",
+			.body = "<html><body><a href=\"http://localhost:{{port}}/third.html\">third</a></body></html>",
+			.headers = {
+				"Content-Type: text/html",
+			}
+		},
+		{	.name = "/third.html",
+			.code = "200 Dontcare",
+			.body = "<html><body>third</body></html>",
+			.headers = {
+				"Content-Type: text/html",
+			}
+		},
+	};
+
+	// functions won't come back if an error occurs
+	wget_test_start_server(
+		WGET_TEST_RESPONSE_URLS, &urls, countof(urls),
+		WGET_TEST_FEATURE_MHD,
+		0);
+
+	// all processes terminate once the forwarded URLs are done (else the test times out)
+	wget_test(
+		WGET_TEST_OPTIONS, "-r -H -nH --partitions=3",
+		WGET_TEST_REQUEST_URL, "index.html",
+		WGET_TEST_EXPECTED_ERROR_CODE, 0,
+		WGET_TEST_EXPECTED_FILES, &(wget_test_file_t []) {
+			{ urls[0].name + 1, urls[0].body },
+			{ urls[1].name + 1, urls[1].body },
+			{ urls[2].name + 1, urls[2].body },
+			{	NULL } },
+		0);
+
+	// a missing page sets the exit status of the merged result
+	wget_test(
+		WGET_TEST_OPTIONS, "-r -H -nH --partitions=3",
+		WGET_TEST_REQUEST_URL, "http://127.0.0.1:{{port}}/missing.html",
+		WGET_TEST_EXPECTED_ERROR_CODE, 8,
+		0);
+
+	// combinations that can't be partitioned are refused
+	wget_test(
+		WGET_TEST_OPTIONS, "-r --partitions=2 -O out.html",
+		WGET_TEST_REQUEST_URL, "index.html",
+		WGET_TEST_EXPECTED_ERROR_CODE, 2,
+		0);
+
+	exit(0);
+#endif
+}
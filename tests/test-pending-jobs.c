@@ -0,0 +1,187 @@
+/*
+ * Copyright(c) 2019 Free Software Foundation, Inc.
+ *
+ * This file is part of libwget.
+ *
+ * Libwget is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Libwget is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libwget.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *
+ * Tests the compact queue of pending jobs (QUEUED_JOB in src/host.c).
+ */
+
+#include <config.h>
+
+#include <stdlib.h> // exit()
+#include "libtest.h"
+
+// many.html links to NPAGES pages, page NEWLINKS_AT links to NNEW more pages.
+// The per-host array of pending jobs starts with 16 entries, so it has to grow.
+// When page NEWLINKS_AT is parsed, more than half of the array has been handed out
+// and the new jobs are added after moving the remaining ones to the front.
+#define NPAGES 32
+#define NEWLINKS_AT 20
+#define NNEW 20
+
+int main(void)
+{
+	wget_test_url_t urls[8 + NPAGES + NNEW] = {
+		{	.name = "/robots.txt",
+			.code = "200 Dontcare",
+			.body =
+				"User-agent: *\n"
+				"Disallow: /secret/\n",
+			.headers = {
+				"Content-Type: text/plain",
+			}
+		},
+		// the links to 127.0.0.1 are queued before its robots.txt has been downloaded
+		{	.name = "/index.html",
+			.code = "200 Dontcare",
+			.body =
+				"<html><body>"
+				"<a href=\"http://127.0.0.1:{{port}}/secret/a.html\">secret</a>"
+				"<a href=\"http://127.0.0.1:{{port}}/ok.html\">ok</a>"
+				"</body></html>",
+			.headers = {
+				"Content-Type: text/html",
+			}
+		},
+		{	.name = "/secret/a.html",
+			.code = "200 Dontcare",
+			.body = "secret",
+			.headers = {
+				"Content-Type: text/plain",
+			}
+		},
+		{	.name = "/ok.html",
+			.code = "200 Dontcare",
+			.body = "ok",
+			.headers = {
+				"Content-Type: text/plain",
+			}
+		},
+		// the local filenames of queued jobs are computed when they are handed out
+		{	.name = "/dir/index.html",
+			.code = "200 Dontcare",
+			.body = "<html><body><a href=\"sub/a.txt\">a</a><a href=\"b.txt\">b</a></body></html>",
+			.headers = {
+				"Content-Type: text/html",
+			}
+		},
+		{	.name = "/dir/sub/a.txt",
+			.code = "200 Dontcare",
+			.body = "a",
+			.headers = {
+				"Content-Type: text/plain",
+			}
+		},
+		{	.name = "/dir/b.txt",
+			.code = "200 Dontcare",
+			.body = "b",
+			.headers = {
+				"Content-Type: text/plain",
+			}
+		},
+	};
+	wget_test_file_t expected[NPAGES + NNEW + 3];
+	wget_buffer *many = wget_buffer_alloc(1024), *newlinks = wget_buffer_alloc(1024);
+	int nurls = 7, nexpected = 0;
+
+	wget_buffer_strcpy(many, "<html><body>");
+	for (int it = 0; it < NPAGES; it++)
+		wget_buffer_printf_append(many, "<a href=\"p%d.html\">%d</a>", it, it);
+	wget_buffer_strcat(many, "</body></html>");
+
+	wget_buffer_strcpy(newlinks, "<html><body>");
+	for (int it = 0; it < NNEW; it++)
+		wget_buffer_printf_append(newlinks, "<a href=\"q%d.html\">%d</a>", it, it);
+	wget_buffer_strcat(newlinks, "</body></html>");
+
+	urls[nurls++] = (wget_test_url_t) {
+		.name = "/many.html",
+		.code = "200 Dontcare",
+		.body = many->data,
+		.headers = { "Content-Type: text/html" }
+	};
+	for (int it = 0; it < NPAGES; it++) {
+		urls[nurls++] = (wget_test_url_t) {
+			.name = wget_aprintf("/p%d.html", it),
+			.code = "200 Dontcare",
+			.body = it == NEWLINKS_AT ? newlinks->data : "page",
+			.headers = { "Content-Type: text/html" }
+		};
+	}
+	for (int it = 0; it < NNEW; it++) {
+		urls[nurls++] = (wget_test_url_t) {
+			.name = wget_aprintf("/q%d.html", it),
+			.code = "200 Dontcare",
+			.body = "new page",
+			.headers = { "Content-Type: text/html" }
+		};
+	}
+
+	// functions won't come back if an error occurs
+	wget_test_start_server(
+		WGET_TEST_RESPONSE_URLS, &urls, nurls,
+		WGET_TEST_FEATURE_MHD,
+		0);
+
+	// disallowed links are dropped from the queue when robots.txt arrives
+	wget_test(
+		WGET_TEST_OPTIONS, "-r -H -nH --max-threads=1",
+		WGET_TEST_REQUEST_URL, "index.html",
+		WGET_TEST_EXPECTED_ERROR_CODE, 0,
+		WGET_TEST_EXPECTED_FILES, &(wget_test_file_t []) {
+			{ urls[0].name + 1, urls[0].body },
+			{ urls[1].name + 1, urls[1].body },
+			{ urls[3].name + 1, urls[3].body },
+			{	NULL } },
+		0);
+
+	// more pending jobs than fit into the initial array, some added after part of it has been handed out
+	for (int it = 7; it < nurls; it++)
+		expected[nexpected++] = (wget_test_file_t) { urls[it].name + 1, urls[it].body };
+	expected[nexpected++] = (wget_test_file_t) { urls[0].name + 1, urls[0].body };
+	expected[nexpected] = (wget_test_file_t) { NULL };
+
+	wget_test(
+		WGET_TEST_OPTIONS, "-r -nH --max-threads=1",
+		WGET_TEST_REQUEST_URL, "many.html",
+		WGET_TEST_EXPECTED_ERROR_CODE, 0,
+		WGET_TEST_EXPECTED_FILES, expected,
+		0);
+
+	// --cut-dirs applies to the queued links, an existing file is kept with -nc
+	wget_test(
+		WGET_TEST_OPTIONS, "-r -nH -nc --cut-dirs=1 --max-threads=1",
+		WGET_TEST_REQUEST_URL, "dir/index.html",
+		WGET_TEST_EXPECTED_ERROR_CODE, 0,
+		WGET_TEST_EXISTING_FILES, &(wget_test_file_t []) {
+			{ "sub/a.txt", "existing" },
+			{	NULL } },
+		WGET_TEST_EXPECTED_FILES, &(wget_test_file_t []) {
+			{ urls[0].name + 1, urls[0].body },
+			{ "index.html", urls[4].body },
+			{ "sub/a.txt", "existing" },
+			{ "b.txt", urls[6].body },
+			{	NULL } },
+		0);
+
+	for (int it = 8; it < nurls; it++)
+		wget_xfree(urls[it].name);
+	wget_buffer_free(&newlinks);
+	wget_buffer_free(&many);
+
+	exit(0);
+}
@@ -355,6 +355,12 @@ static void url_filter(wget_plugin_t *plugin, const wget_iri *iri, wget_intercep
 	}
 }
 
+static void url_filter_batch(wget_plugin_t *plugin, const wget_iri **iris, wget_intercept_action_t **actions, int n)
+{
+	for (int i = 0; i < n; i++)
+		url_filter(plugin, iris[i], actions[i]);
+}
+
 static int post_processor(wget_plugin_t *plugin, wget_downloaded_file_t *file)
 {
 	plugin_data_t *d = (plugin_data_t *) plugin->plugin_data;
@@ -466,6 +472,7 @@ int wget_plugin_initializer(wget_plugin_t *plugin)
 	wget_plugin_register_finalizer(plugin, finalizer);
 
 	wget_plugin_register_url_filter(plugin, url_filter);
+	wget_plugin_register_url_filter_batch(plugin, url_filter_batch, WGET_PLUGIN_THREAD_SAFE);
 	wget_plugin_register_post_processor(plugin, post_processor);
 
 	return 0;
@@ -0,0 +1,119 @@
+/*
+ * Copyright(c) 2019 Free Software Foundation, Inc.
+ *
+ * This file is part of libwget.
+ *
+ * Libwget is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Libwget is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libwget.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *
+ * Tests the download quota (--quota) while data is received.
+ */
+
+#include <config.h>
+
+#include <stdlib.h> // exit()
+#include <string.h> // memset()
+#include <sys/stat.h> // stat()
+#include "libtest.h"
+
+#define BODY_SIZE (64 * 1024)
+
+static char
+	a_body[BODY_SIZE + 1],
+	c_body[BODY_SIZE + 1];
+
+int main(void)
+{
+	memset(a_body, 'a', BODY_SIZE);
+	memset(c_body, 'c', BODY_SIZE);
+
+	wget_test_url_t urls[]={
+		{	.name = "/index.html",
+			.code = "200 Dontcare",
+			.body = "<html><body><a href=\"a.bin\">a</a></body></html>",
+			.headers = {
+				"Content-Type: text/html",
+			}
+		},
+		{	// no Content-Length, the size is only known at the end
+			.name = "/a.bin",
+			.code = "200 Dontcare",
+			.body = a_body,
+			.headers = {
+				"Content-Type: application/octet-stream",
+				"Transfer-Encoding: chunked",
+			}
+		},
+		{	.name = "/index2.html",
+			.code = "200 Dontcare",
+			.body = "<html><body><a href=\"c.bin\">c</a></body></html>",
+			.headers = {
+				"Content-Type: text/html",
+			}
+		},
+		{	.name = "/c.bin",
+			.code = "200 Dontcare",
+			.body = c_body,
+			.headers = {
+				"Content-Type: application/octet-stream",
+			}
+		},
+	};
+	struct stat st;
+
+	// functions won't come back if an error occurs
+	wget_test_start_server(
+		WGET_TEST_RESPONSE_URLS, &urls, countof(urls),
+		WGET_TEST_FEATURE_MHD,
+		0);
+
+	// the first transfer is exempt from the quota
+	wget_test(
+		WGET_TEST_OPTIONS, "--quota=1000",
+		WGET_TEST_REQUEST_URL, "a.bin",
+		WGET_TEST_EXPECTED_ERROR_CODE, 0,
+		WGET_TEST_EXPECTED_FILES, &(wget_test_file_t []) {
+			{ urls[1].name + 1, urls[1].body },
+			{	NULL } },
+		0);
+
+	// the second transfer has no announced size and is aborted within the body
+	wget_test(
+		WGET_TEST_OPTIONS, "-r -nH --quota=16k --max-threads=1",
+		WGET_TEST_REQUEST_URL, "index.html",
+		WGET_TEST_EXPECTED_ERROR_CODE, 0,
+		WGET_TEST_EXPECTED_FILES, &(wget_test_file_t []) {
+			{ urls[0].name + 1, urls[0].body },
+			{ urls[1].name + 1, NULL },
+			{	NULL } },
+		0);
+
+	// the directory is emptied at the start of the next test, the partial file is still there
+	if (stat(urls[1].name + 1, &st) != 0 || st.st_size >= BODY_SIZE) {
+		wget_error_printf("'%s' has not been aborted by the quota\n", urls[1].name + 1);
+		exit(1);
+	}
+
+	// the second transfer announces more than the remaining quota and is not started
+	wget_test(
+		WGET_TEST_OPTIONS, "-r -nH --quota=16k --max-threads=1",
+		WGET_TEST_REQUEST_URL, "index2.html",
+		WGET_TEST_EXPECTED_ERROR_CODE, 0,
+		WGET_TEST_EXPECTED_FILES, &(wget_test_file_t []) {
+			{ urls[2].name + 1, urls[2].body },
+			{	NULL } },
+		0);
+
+	exit(0);
+}
@@ -31,6 +31,8 @@
 
 int main(void)
 {
+	char cache[256];
+
 	wget_test_url_t urls[]={
 		{	.name = "/index.html",
 			.code = "302 Redirect",
@@ -86,5 +88,36 @@ int main(void)
 			{	NULL } },
 		0);
 
+	// permanent redirections are remembered and saved
+	wget_test(
+//		WGET_TEST_KEEP_TMPFILES, 1,
+		WGET_TEST_OPTIONS, "--redirect-cache --redirect-cache-file=redirects.txt",
+		WGET_TEST_REQUEST_URL, "301.html",
+		WGET_TEST_EXPECTED_ERROR_CODE, 0,
+		WGET_TEST_EXPECTED_FILES, &(wget_test_file_t []) {
+			{ urls[2].name + 1, urls[3].body },
+			{ "redirects.txt", NULL },
+			{	NULL } },
+		0);
+
+	wget_snprintf(cache, sizeof(cache), "http://localhost:%d/301.html http://localhost:%d/with%%20spaces%%20.html 0 0\n",
+		wget_test_get_http_server_port(), wget_test_get_http_server_port());
+
+	// a cached redirection is followed without asking the server and counted as a hit
+	wget_test(
+//		WGET_TEST_KEEP_TMPFILES, 1,
+		WGET_TEST_OPTIONS, "--redirect-cache --redirect-cache-file=redirects.txt --stats-redirect=csv:stats.csv",
+		WGET_TEST_REQUEST_URL, "301.html",
+		WGET_TEST_EXPECTED_ERROR_CODE, 0,
+		WGET_TEST_EXISTING_FILES, &(wget_test_file_t []) {
+			{ "redirects.txt", cache },
+			{	NULL } },
+		WGET_TEST_EXPECTED_FILES, &(wget_test_file_t []) {
+			{ urls[2].name + 1, urls[3].body },
+			{ "redirects.txt", NULL },
+			{ "stats.csv", "Hits,Entries\n1,1\n" },
+			{	NULL } },
+		0);
+
 	exit(0);
 }
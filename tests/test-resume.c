@@ -0,0 +1,110 @@
+/*
+ * Copyright(c) 2019 Free Software Foundation, Inc.
+ *
+ * This file is part of libwget.
+ *
+ * Libwget is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Libwget is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libwget.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *
+ * Tests resuming a transfer that broke off within the body.
+ */
+
+#include <config.h>
+
+#include <stdlib.h> // exit()
+#include <string.h>
+#include "libtest.h"
+
+#define BODY_SIZE 4000
+#define CUT_AFTER 1000
+
+int main(void)
+{
+	static char body[BODY_SIZE + 1], partial[CUT_AFTER + 1];
+
+	for (int it = 0; it < BODY_SIZE; it++)
+		body[it] = 'a' + it % 26;
+	memcpy(partial, body, CUT_AFTER);
+
+	// the first response of each file breaks off after CUT_AFTER bytes
+	wget_test_url_t urls[]={
+		{	.name = "/a.txt",
+			.code = "200 Dontcare",
+			.body = body,
+			.headers = {
+				"Content-Type: text/plain",
+				"Accept-Ranges: bytes",
+				"ETag: \"v1\"",
+			},
+			.cut_after = CUT_AFTER,
+		},
+		{	.name = "/b.txt",
+			.code = "200 Dontcare",
+			.body = body,
+			.headers = {
+				"Content-Type: text/plain",
+				"Accept-Ranges: bytes",
+				"ETag: \"v1\"",
+			},
+			.cut_after = CUT_AFTER,
+			.code_after_cut = "200",
+		},
+		{	.name = "/c.txt",
+			.code = "200 Dontcare",
+			.body = body,
+			.headers = {
+				"Content-Type: text/plain",
+				"Accept-Ranges: bytes",
+				"ETag: \"v1\"",
+			},
+			.cut_after = CUT_AFTER,
+			.code_after_cut = "503",
+		},
+	};
+
+	// functions won't come back if an error occurs
+	wget_test_start_server(
+		WGET_TEST_RESPONSE_URLS, &urls, countof(urls),
+		WGET_TEST_FEATURE_MHD,
+		0);
+
+	// the retry gets a 206 and appends the rest of the body (a request without Range would get a 400)
+	wget_test(
+		WGET_TEST_REQUEST_URL, "a.txt",
+		WGET_TEST_EXPECTED_ERROR_CODE, 0,
+		WGET_TEST_EXPECTED_FILES, &(wget_test_file_t []) {
+			{ "a.txt", body },
+			{	NULL } },
+		0);
+
+	// the retry gets a 200, the partial file is replaced
+	wget_test(
+		WGET_TEST_REQUEST_URL, "b.txt",
+		WGET_TEST_EXPECTED_ERROR_CODE, 0,
+		WGET_TEST_EXPECTED_FILES, &(wget_test_file_t []) {
+			{ "b.txt", body },
+			{	NULL } },
+		0);
+
+	// the retry gets an error, the partial file is kept for a later resume
+	wget_test(
+		WGET_TEST_REQUEST_URL, "c.txt",
+		WGET_TEST_EXPECTED_ERROR_CODE, 8,
+		WGET_TEST_EXPECTED_FILES, &(wget_test_file_t []) {
+			{ "c.txt", partial },
+			{	NULL } },
+		0);
+
+	exit(0);
+}
@@ -0,0 +1,152 @@
+/*
+ * Copyright(c) 2019 Free Software Foundation, Inc.
+ *
+ * This file is part of libwget.
+ *
+ * Libwget is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Libwget is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libwget.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *
+ * Tests the persistent robots.txt cache (--robots-cache-file).
+ */
+
+#include <config.h>
+
+#include <stdlib.h> // exit()
+#include "libtest.h"
+
+int main(void)
+{
+	wget_test_url_t urls[]={
+		{	.name = "/robots.txt",
+			.code = "200 Dontcare",
+			.body =
+				"User-agent: *\n"\
+				"Disallow: /subdir1/\n"\
+			,
+			.headers = {
+				"Content-Type: text/plain",
+			}
+		},
+		{	.name = "/index.html",
+			.code = "200 Dontcare",
+			.body =
+				"<html><head><title>Main Page</title><body><p>A link to" \
+				" <a href=\"/subdir1/page.html\">page in subdir1</a>." \
+				" <a href=\"/subdir2/page.html\">page in subdir2</a>." \
+				"</p></body></html>",
+			.headers = {
+				"Content-Type: text/html",
+			}
+		},
+		{	.name = "/subdir1/page.html",
+			.code = "200 Dontcare",
+			.body = "sub1"
+		},
+		{	.name = "/subdir2/page.html",
+			.code = "200 Dontcare",
+			.body = "sub2"
+		},
+		{	.name = "/span.html",
+			.code = "200 Dontcare",
+			.body =
+				"<html><head><title>Span Page</title><body><p>Links to another host" \
+				" <a href=\"http://127.0.0.1:{{port}}/subdir2/page.html\">page in subdir2</a>." \
+				" <a href=\"http://127.0.0.1:{{port}}/subdir1/page.html\">page in subdir1</a>." \
+				"</p></body></html>",
+			.headers = {
+				"Content-Type: text/html",
+			}
+		},
+	};
+	char fresh[256], stale[256], span[512];
+
+	urls[0].modified = 1097310600;
+
+	// functions won't come back if an error occurs
+	wget_test_start_server(
+		WGET_TEST_RESPONSE_URLS, &urls, countof(urls),
+		WGET_TEST_FEATURE_MHD,
+		0);
+
+	// the cache entry is keyed by scheme, host and port
+	wget_snprintf(fresh, sizeof(fresh), "http://localhost:%d %d %d 0 - D:/subdir2/\n",
+		wget_test_get_http_server_port(), 1097310600, 2000000000);
+	wget_snprintf(stale, sizeof(stale), "http://localhost:%d %d %d %d - D:/subdir2/\n",
+		wget_test_get_http_server_port(), 1097310600, 1097310600, 1097310600);
+	wget_snprintf(span, sizeof(span),
+		"http://localhost:%d %d %d 0 -\n"
+		"http://127.0.0.1:%d %d %d 0 - D:/subdir2/\n",
+		wget_test_get_http_server_port(), 1097310600, 2000000000,
+		wget_test_get_http_server_port(), 1097310600, 2000000000);
+
+	// robots.txt is fetched and its rules are cached
+	wget_test(
+		WGET_TEST_OPTIONS, "-r -nH --robots-cache-file=robots.cache",
+		WGET_TEST_REQUEST_URL, "index.html",
+		WGET_TEST_EXPECTED_ERROR_CODE, 0,
+		WGET_TEST_EXPECTED_FILES, &(wget_test_file_t []) {
+			{ urls[0].name + 1, urls[0].body },
+			{ urls[1].name + 1, urls[1].body },
+			{ urls[3].name + 1, urls[3].body },
+			{ "robots.cache", NULL },
+			{	NULL } },
+		0);
+
+	// a fresh cache entry is used without requesting robots.txt
+	wget_test(
+		WGET_TEST_OPTIONS, "-r -nH --robots-cache-file=robots.cache",
+		WGET_TEST_REQUEST_URL, "index.html",
+		WGET_TEST_EXPECTED_ERROR_CODE, 0,
+		WGET_TEST_EXISTING_FILES, &(wget_test_file_t []) {
+			{ "robots.cache", fresh },
+			{	NULL } },
+		WGET_TEST_EXPECTED_FILES, &(wget_test_file_t []) {
+			{ urls[1].name + 1, urls[1].body },
+			{ urls[2].name + 1, urls[2].body },
+			{ "robots.cache", fresh },
+			{	NULL } },
+		0);
+
+	// a stale cache entry is revalidated, '304 Not Modified' keeps the cached rules
+	wget_test(
+		WGET_TEST_OPTIONS, "-r -nH --robots-cache-file=robots.cache",
+		WGET_TEST_REQUEST_URL, "index.html",
+		WGET_TEST_EXPECTED_ERROR_CODE, 0,
+		WGET_TEST_EXISTING_FILES, &(wget_test_file_t []) {
+			{ "robots.cache", stale },
+			{	NULL } },
+		WGET_TEST_EXPECTED_FILES, &(wget_test_file_t []) {
+			{ urls[1].name + 1, urls[1].body },
+			{ urls[2].name + 1, urls[2].body },
+			{ "robots.cache", NULL },
+			{	NULL } },
+		0);
+
+	// the cached rules also apply to the first URL of a new host
+	wget_test(
+		WGET_TEST_OPTIONS, "-r -nH -H --robots-cache-file=robots.cache",
+		WGET_TEST_REQUEST_URL, "span.html",
+		WGET_TEST_EXPECTED_ERROR_CODE, 0,
+		WGET_TEST_EXISTING_FILES, &(wget_test_file_t []) {
+			{ "robots.cache", span },
+			{	NULL } },
+		WGET_TEST_EXPECTED_FILES, &(wget_test_file_t []) {
+			{ urls[4].name + 1, urls[4].body },
+			{ urls[2].name + 1, urls[2].body },
+			{ "robots.cache", NULL },
+			{	NULL } },
+		0);
+
+	exit(0);
+}
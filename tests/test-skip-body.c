@@ -0,0 +1,96 @@
+/*
+ * Copyright(c) 2019 Free Software Foundation, Inc.
+ *
+ * This file is part of libwget.
+ *
+ * Libwget is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Libwget is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libwget.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *
+ * Tests skipping the body of responses that are neither saved nor parsed.
+ */
+
+#include <config.h>
+
+#include <stdlib.h> // exit()
+#include <string.h>
+#include "libtest.h"
+
+int main(void)
+{
+	static char large[256 * 1024 + 1];
+
+	memset(large, 'x', sizeof(large) - 1);
+
+	wget_test_url_t urls[]={
+		{	.name = "/index.html",
+			.code = "200 Dontcare",
+			.body =
+				"<html><head><title>Main Page</title></head><body><p>" \
+				" <a href=\"small_404\">small</a>." \
+				" <a href=\"large_404\">large</a>." \
+				" <a href=\"second.html\">second</a>." \
+				"</p></body></html>",
+			.headers = {
+				"Content-Type: text/html",
+			}
+		},
+		{	.name = "/small_404",
+			.code = "404 Not found",
+			.body = "content of small_404",
+			.headers = { "Content-Type: text/plain" }
+		},
+		{	.name = "/large_404",
+			.code = "404 Not found",
+			.body = large,
+			.headers = { "Content-Type: text/plain" }
+		},
+		{	.name = "/second.html",
+			.code = "200 Dontcare",
+			.body = "<html><head><title>Second Page</title></head><body></body></html>",
+			.headers = { "Content-Type: text/html" }
+		},
+	};
+
+	// functions won't come back if an error occurs
+	wget_test_start_server(
+		WGET_TEST_RESPONSE_URLS, &urls, countof(urls),
+		WGET_TEST_FEATURE_MHD,
+		0);
+
+	// the small error body is drained, the large one closes the connection, both are not saved
+	wget_test(
+		WGET_TEST_OPTIONS, "-r -nH --no-robots",
+		WGET_TEST_REQUEST_URL, "index.html",
+		WGET_TEST_EXPECTED_ERROR_CODE, 8,
+		WGET_TEST_EXPECTED_FILES, &(wget_test_file_t []) {
+			{ urls[0].name + 1, urls[0].body },
+			{ urls[3].name + 1, urls[3].body },
+			{	NULL } },
+		0);
+
+	// with --content-on-error the bodies are downloaded completely
+	wget_test(
+		WGET_TEST_OPTIONS, "-r -nH --no-robots --content-on-error",
+		WGET_TEST_REQUEST_URL, "index.html",
+		WGET_TEST_EXPECTED_ERROR_CODE, 8,
+		WGET_TEST_EXPECTED_FILES, &(wget_test_file_t []) {
+			{ urls[0].name + 1, urls[0].body },
+			{ urls[1].name + 1, urls[1].body },
+			{ urls[2].name + 1, urls[2].body },
+			{ urls[3].name + 1, urls[3].body },
+			{	NULL } },
+		0);
+
+	exit(0);
+}
@@ -0,0 +1,137 @@
+/*
+ * Copyright(c) 2019 Free Software Foundation, Inc.
+ *
+ * This file is part of libwget.
+ *
+ * Libwget is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Libwget is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libwget.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *
+ * Tests the zsync block-delta update (--zsync).
+ */
+
+#include <config.h>
+
+#include <stdlib.h> // exit()
+#include <string.h>
+#include <stdint.h>
+#include "md4.h"
+#include "libtest.h"
+
+#define BLOCKSIZE 64
+#define LENGTH (5 * BLOCKSIZE + 20)
+
+static uint32_t _rsum(const unsigned char *data, size_t len)
+{
+	uint16_t a = 0, b = 0;
+
+	for (size_t it = 0; it < len; it++) {
+		a += data[it];
+		b += (len - it) * data[it];
+	}
+
+	return ((uint32_t) a << 16) | b;
+}
+
+int main(void)
+{
+	static char body[LENGTH + 1], old[2 * LENGTH], control[512 + 6 * 20];
+	unsigned char block[BLOCKSIZE], digest[20], *p;
+	char sha1[41];
+	size_t control_len;
+
+	// six blocks, the last one is partial
+	for (int it = 0; it < LENGTH; it++)
+		body[it] = 'a' + (it * 7 + it / BLOCKSIZE * 3) % 26;
+
+	// the old file has a prefix, lacks block 2 and the partial block 5
+	wget_snprintf(old, sizeof(old), "0123456789%.*s%.*s%.*s",
+		2 * BLOCKSIZE, body,
+		BLOCKSIZE, "zzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzz",
+		2 * BLOCKSIZE, body + 3 * BLOCKSIZE);
+
+	wget_hash_fast(WGET_DIGTYPE_SHA1, body, LENGTH, digest);
+	wget_memtohex(digest, sizeof(digest), sha1, sizeof(sha1));
+
+	control_len = wget_snprintf(control, sizeof(control),
+		"zsync: 0.6.2\n"\
+		"Filename: image.bin\n"\
+		"Blocksize: %d\n"\
+		"Length: %d\n"\
+		"Hash-Lengths: 1,4,16\n"\
+		"URL: image.bin\n"\
+		"SHA-1: %s\n"\
+		"\n", BLOCKSIZE, LENGTH, sha1);
+
+	p = (unsigned char *) control + control_len;
+	for (int off = 0; off < LENGTH; off += BLOCKSIZE) {
+		size_t n = LENGTH - off < BLOCKSIZE ? LENGTH - off : BLOCKSIZE;
+		uint32_t r;
+
+		memset(block, 0, sizeof(block)); // the last block is zero-padded
+		memcpy(block, body + off, n);
+
+		r = _rsum(block, BLOCKSIZE);
+		*p++ = r >> 24;
+		*p++ = r >> 16;
+		*p++ = r >> 8;
+		*p++ = r;
+		md4_buffer((const char *) block, BLOCKSIZE, p);
+		p += 16;
+	}
+	control_len = p - (unsigned char *) control;
+
+	wget_test_url_t urls[]={
+		{	.name = "/image.bin.zsync",
+			.code = "200 Dontcare",
+			.body = control,
+			.body_len = control_len,
+			.headers = {
+				"Content-Type: application/x-zsync",
+			}
+		},
+		{	.name = "/image.bin",
+			.code = "200 Dontcare",
+			.body = body,
+			.headers = {
+				"Content-Type: application/octet-stream",
+			},
+			.expected_req_headers = {
+				// blocks 2 and 5 are requested together, the answer is multipart/byteranges
+				"Range: bytes=128-191,320-339",
+			}
+		},
+	};
+
+	// functions won't come back if an error occurs
+	wget_test_start_server(
+		WGET_TEST_RESPONSE_URLS, &urls, countof(urls),
+		WGET_TEST_FEATURE_MHD,
+		0);
+
+	// the unchanged blocks are copied from the old file, the rest is fetched with range requests
+	wget_test(
+		WGET_TEST_OPTIONS, "-nH --zsync",
+		WGET_TEST_REQUEST_URL, "image.bin.zsync",
+		WGET_TEST_EXPECTED_ERROR_CODE, 0,
+		WGET_TEST_EXISTING_FILES, &(wget_test_file_t []) {
+			{ "image.bin", old },
+			{	NULL } },
+		WGET_TEST_EXPECTED_FILES, &(wget_test_file_t []) {
+			{ "image.bin", body },
+			{ "image.bin.zsync", control, .content_length = control_len },
+			{	NULL } },
+		0);
+
+	exit(0);
+}
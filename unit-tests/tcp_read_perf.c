@@ -0,0 +1,162 @@
+/*
+ * Copyright(c) 2019 Free Software Foundation, Inc.
+ *
+ * This file is part of Wget.
+ *
+ * Wget is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Wget is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Wget.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *
+ * counting poll() calls of wget_tcp_read()
+ *
+ * A child process sends <MiB> (default 64) over a loopback TCP connection,
+ * the parent reads it with wget_tcp_read() in chunks of <bufsize> (default 16384).
+ * poll() is wrapped to count the calls made by libwget.
+ *
+ * Reading before polling, poll() is only called when the socket has nothing
+ * to read. Polling before each read needed one poll() per wget_tcp_read().
+ *
+ * Usage: tcp_read_perf [<MiB> [<bufsize>]]
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#ifdef HAVE_POLL
+#	include <poll.h>
+#	include <dlfcn.h>
+#endif
+
+#include <wget.h>
+
+static long long
+	polls;
+
+#if defined HAVE_POLL && defined RTLD_NEXT
+int poll(struct pollfd *fds, nfds_t nfds, int timeout)
+{
+	static int (*real_poll)(struct pollfd *, nfds_t, int);
+
+	if (!real_poll)
+		*(void **) &real_poll = dlsym(RTLD_NEXT, "poll");
+
+	polls++;
+
+	return real_poll(fds, nfds, timeout);
+}
+#endif
+
+static void _send_data(int sockfd, long long total)
+{
+	char buf[65536];
+
+	memset(buf, 'x', sizeof(buf));
+
+	while (total > 0) {
+		ssize_t n = write(sockfd, buf, total < (long long) sizeof(buf) ? (size_t) total : sizeof(buf));
+
+		if (n <= 0) {
+			if (n < 0 && errno == EINTR)
+				continue;
+			break;
+		}
+
+		total -= n;
+	}
+}
+
+int main(int argc, const char *const *argv)
+{
+	long long total = (argc > 1 ? atoll(argv[1]) : 64) * 1024 * 1024, received = 0, reads = 0, start;
+	size_t bufsize = argc > 2 ? (size_t) atoll(argv[2]) : 16384;
+	struct sockaddr_in addr;
+	socklen_t addrlen = sizeof(addr);
+	int listenfd, sockfd, status;
+	wget_tcp *tcp;
+	char *buf;
+	pid_t pid;
+
+	if (total <= 0 || !bufsize) {
+		wget_fprintf(stderr, "Usage: %s [<MiB> [<bufsize>]]\n", argv[0]);
+		return 1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	if ((listenfd = socket(AF_INET, SOCK_STREAM, 0)) < 0
+		|| bind(listenfd, (struct sockaddr *) &addr, sizeof(addr))
+		|| listen(listenfd, 1)
+		|| getsockname(listenfd, (struct sockaddr *) &addr, &addrlen))
+	{
+		wget_fprintf(stderr, "Failed to listen on loopback (%d)\n", errno);
+		return 1;
+	}
+
+	if ((pid = fork()) < 0) {
+		wget_fprintf(stderr, "Failed to fork (%d)\n", errno);
+		return 1;
+	}
+
+	if (pid == 0) {
+		if ((sockfd = accept(listenfd, NULL, NULL)) < 0)
+			_exit(1);
+
+		_send_data(sockfd, total);
+		close(sockfd);
+		_exit(0);
+	}
+
+	close(listenfd);
+
+	tcp = wget_tcp_init();
+	wget_tcp_set_timeout(tcp, 10000);
+
+	if (wget_tcp_connect(tcp, "127.0.0.1", ntohs(addr.sin_port)) != WGET_E_SUCCESS) {
+		wget_fprintf(stderr, "Failed to connect to port %d\n", ntohs(addr.sin_port));
+		wget_tcp_deinit(&tcp);
+		waitpid(pid, &status, 0);
+		return 1;
+	}
+
+	buf = wget_malloc(bufsize);
+	polls = 0; // don't count the connection setup
+	start = wget_get_timemillis();
+
+	for (ssize_t n; (n = wget_tcp_read(tcp, buf, bufsize)) > 0; reads++)
+		received += n;
+
+	wget_printf("received %lld bytes in %lld ms\n", received, wget_get_timemillis() - start);
+	wget_printf("wget_tcp_read() calls: %lld\n", reads + 1); // plus the final one that saw EOF
+#if defined HAVE_POLL && defined RTLD_NEXT
+	wget_printf("poll() calls: %lld (polling before each read: %lld)\n", polls, reads + 1);
+#else
+	wget_printf("poll() calls: not counted on this platform\n");
+#endif
+
+	wget_xfree(buf);
+	wget_tcp_deinit(&tcp);
+	waitpid(pid, &status, 0);
+
+	return received != total;
+}
@@ -30,6 +30,7 @@
 #undef NDEBUG // always enable assertions in this test code
 #include <assert.h>
 
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -45,6 +46,9 @@
 
 #include "../src/wget_options.h"
 #include "../src/wget_log.h"
+#include "../src/wget_job.h"
+#include "../src/wget_rtt.h"
+#include "../src/wget_redirect.h"
 
 static int
 	ok,
@@ -1288,6 +1292,29 @@ next:
 		wget_iri_free(&iri);
 	}
 
+#ifdef WITH_LIBPSL
+	// the second lookup is served from the PSL cache
+	for (it = 0; it < 2; it++) {
+		const char *domain = wget_cookie_db_registrable_domain(cookies, "www.example.sa.gov.au");
+
+		if (!wget_strcmp(domain, "example.sa.gov.au") && !wget_cookie_db_registrable_domain(cookies, "sa.gov.au")) {
+			ok++;
+		} else {
+			failed++;
+			info_printf("Failed [%u]: registrable domain of www.example.sa.gov.au -> %s\n", it, domain);
+		}
+	}
+
+	// loading another list invalidates the cache
+	wget_cookie_db_load_psl(cookies, NULL);
+	if (!wget_cookie_db_registrable_domain(cookies, "www.example.sa.gov.au")) {
+		ok++;
+	} else {
+		failed++;
+		info_printf("Failed: registrable domain returned without PSL\n");
+	}
+#endif
+
 	wget_cookie_db_free(&cookies);
 }
 
@@ -1636,6 +1663,19 @@ static void test_utils(void)
 		else
 			failed++;
 	}
+
+	// the monotonic clocks must not run backwards and the coarse clock must be comparable
+	long long t1 = wget_get_monotonic_millis();
+	wget_millisleep(20);
+	long long t2 = wget_get_coarse_millis();
+	long long t3 = wget_get_monotonic_millis();
+
+	if (t2 >= t1 && t3 >= t1 + 20 && t3 - t2 < 1000)
+		ok++;
+	else {
+		info_printf("monotonic clocks failed: %lld %lld %lld\n", t1, t2, t3);
+		failed++;
+	}
 }
 
 static void test_strcasecmp_ascii(void)
@@ -2388,6 +2428,7 @@ static void test_parse_response_header(void)
 			"Server: Apache/2.2.22 (Debian)\r\n"\
 			"Date: Sun, 11 Jun 2017 09:45:54 GMT\r\n"\
 			"Content-Length: 476\r\n"\
+			"Accept-Ranges: bytes\r\n"\
 			"Connection: keep-alive\r\n"\
 			"X-Archive-Orig-last-modified: Sun, 25 May 2003 16:55:12 GMT\r\n"\
 			"Content-Type: text/plain; charset=utf-8\r\n\r\n");
@@ -2408,6 +2449,13 @@ static void test_parse_response_header(void)
 		info_printf("Content-Length mismatch.\n");
 	}
 
+	if (resp->accept_ranges)
+		ok++;
+	else {
+		failed++;
+		info_printf("Accept-Ranges not recognized.\n");
+	}
+
 	if (!strcmp(resp->content_type, "text/plain"))
 		ok++;
 	else {
@@ -2422,12 +2470,389 @@ static void test_parse_response_header(void)
 		info_printf("X-Archive-Orig-last-modified mismatch\n");
 	}
 
+	if (resp->date == 1497174354)
+		ok++;
+	else {
+		failed++;
+		info_printf("Date mismatch\n");
+	}
+
 	xfree(resp->content_type);
 	xfree(resp->content_type_encoding);
 	xfree(resp);
 	xfree(response_text);
 }
 
+static void test_priority(void)
+{
+	static const struct priority_data {
+		int
+			urgency;
+		bool
+			incremental;
+		const char *
+			field;
+		int
+			weight;
+	} priority_data[] = {
+		{ 0, 0, "u=0", 256 },
+		{ 1, 0, "u=1", 128 },
+		{ 3, 0, "u=3", 32 },
+		{ 5, 1, "u=5, i", 8 },
+		{ 7, 0, "u=7", 2 },
+		{ -1, 0, "u=0", 256 }, // clamped
+		{ 9, 1, "u=7, i", 2 }, // clamped
+	};
+	static const struct urgency_data {
+		const char *
+			url;
+		bool
+			robotstxt,
+			sitemap,
+			part,
+			requisite;
+		int
+			urgency;
+		bool
+			incremental;
+	} urgency_data[] = {
+		{ "http://example.com/robots.txt", 1, 0, 0, 0, 0, 0 },
+		{ "http://example.com/sitemap.xml.gz", 0, 1, 0, 0, 1, 0 },
+		{ "http://example.com/big.iso", 0, 0, 1, 0, 5, 1 },
+		{ "http://example.com", 0, 0, 0, 0, 1, 0 },
+		{ "http://example.com/dir/", 0, 0, 0, 1, 1, 0 },
+		{ "http://example.com/dir/page", 0, 0, 0, 0, 1, 0 },
+		{ "http://example.com/index.HTML?x=1", 0, 0, 0, 0, 1, 0 },
+		{ "http://example.com/style.css", 0, 0, 0, 1, 1, 0 },
+		{ "http://example.com/img/logo.png", 0, 0, 0, 1, 2, 0 },
+		{ "http://example.com/file.zip", 0, 0, 0, 0, 3, 0 },
+	};
+	char buf[16];
+
+	for (unsigned it = 0; it < countof(priority_data); it++) {
+		const struct priority_data *t = &priority_data[it];
+		int weight = wget_http_priority_weight(t->urgency);
+
+		wget_http_print_priority(t->urgency, t->incremental, buf, sizeof(buf));
+
+		if (!strcmp(buf, t->field) && weight == t->weight)
+			ok++;
+		else {
+			failed++;
+			info_printf("Failed [%u]: priority(%d,%d) -> '%s' %d (expected '%s' %d)\n",
+				it, t->urgency, t->incremental, buf, weight, t->field, t->weight);
+		}
+	}
+
+	wget_iri *iri = wget_iri_parse("http://example.com/", NULL);
+	wget_http_request *req = wget_http_create_request(iri, "GET");
+
+	if (wget_http_request_get_int(req, WGET_HTTP_PRIORITY_URGENCY) == -1
+		&& wget_http_request_get_int(req, WGET_HTTP_PRIORITY_INCREMENTAL) == 0)
+		ok++;
+	else {
+		failed++;
+		info_printf("Failed: new request has priority set\n");
+	}
+
+	wget_http_request_set_int(req, WGET_HTTP_PRIORITY_URGENCY, 9);
+	wget_http_request_set_int(req, WGET_HTTP_PRIORITY_INCREMENTAL, 2);
+
+	if (wget_http_request_get_int(req, WGET_HTTP_PRIORITY_URGENCY) == 7
+		&& wget_http_request_get_int(req, WGET_HTTP_PRIORITY_INCREMENTAL) == 1)
+		ok++;
+	else {
+		failed++;
+		info_printf("Failed: request priority not clamped\n");
+	}
+
+	wget_http_free_request(&req);
+	wget_iri_free(&iri);
+
+	for (unsigned it = 0; it < countof(urgency_data); it++) {
+		const struct urgency_data *t = &urgency_data[it];
+		PART part;
+		JOB job;
+		bool incremental = 1;
+		int urgency;
+
+		iri = wget_iri_parse(t->url, NULL);
+		job_init(&job, iri, 0);
+		job.robotstxt = t->robotstxt;
+		job.sitemap = t->sitemap;
+		job.requisite = t->requisite;
+		job.part = t->part ? &part : NULL;
+
+		urgency = job_urgency(&job, &incremental);
+
+		if (urgency == t->urgency && incremental == t->incremental)
+			ok++;
+		else {
+			failed++;
+			info_printf("Failed [%u]: job_urgency(%s) -> %d %d (expected %d %d)\n",
+				it, t->url, urgency, incremental, t->urgency, t->incremental);
+		}
+
+		wget_iri_free(&iri);
+	}
+}
+
+static void test_rtt(void)
+{
+	static const struct rtt_update_data {
+		long long
+			sample[3];
+		int
+			srtt,
+			rttvar,
+			samples;
+	} update_data[] = {
+		{ { 100, -1, -1 }, 100, 50, 1 },
+		{ { 100, 200, -1 }, 112, 62, 2 },
+		{ { 100, 200, 50 }, 105, 62, 3 },
+		{ { -1, -1, -1 }, 0, 0, 0 }, // negative samples are ignored
+		{ { 1000000000000LL, -1, -1 }, INT_MAX / 8, INT_MAX / 16, 1 }, // clamped
+	};
+	static const struct rtt_timeout_data {
+		int
+			srtt,
+			rttvar,
+			samples,
+			failures;
+		long long
+			extra;
+		int
+			limit,
+			result;
+	} timeout_data[] = {
+		{ 1000, 250, 2, 0, 0, 5000, 5000 }, // too few samples
+		{ 1000, 250, 2, 0, 0, 0, 0 },
+		{ 100, 50, 3, 0, 0, 0, ADAPTIVE_MIN_TIMEOUT },
+		{ 1000, 250, 3, 0, 0, 0, 8000 },
+		{ 1000, 250, 3, 0, 1000, 0, 9000 },
+		{ 1000, 250, 3, 1, 0, 0, 16000 },
+		{ 1000, 250, 3, 10, 0, 0, 8000 << ADAPTIVE_MAX_BACKOFF },
+		{ 1000, 250, 3, -1, 0, 0, 8000 },
+		{ 1000, 250, 3, 0, 0, 10000, 8000 },
+		{ 1000, 250, 3, 1, 0, 10000, 10000 }, // clamped by the user's timeout
+		{ INT_MAX / 8, INT_MAX / 16, 3, 4, 0, 0, INT_MAX },
+	};
+
+	for (unsigned it = 0; it < countof(update_data); it++) {
+		const struct rtt_update_data *t = &update_data[it];
+		int srtt = 0, rttvar = 0, samples = 0;
+
+		for (unsigned it2 = 0; it2 < countof(t->sample); it2++)
+			rtt_update(&srtt, &rttvar, &samples, t->sample[it2]);
+
+		if (srtt == t->srtt && rttvar == t->rttvar && samples == t->samples)
+			ok++;
+		else {
+			failed++;
+			info_printf("Failed [%u]: rtt_update() -> srtt=%d rttvar=%d samples=%d (expected %d %d %d)\n",
+				it, srtt, rttvar, samples, t->srtt, t->rttvar, t->samples);
+		}
+	}
+
+	for (unsigned it = 0; it < countof(timeout_data); it++) {
+		const struct rtt_timeout_data *t = &timeout_data[it];
+		int result = rtt_timeout(t->srtt, t->rttvar, t->samples, t->failures, t->extra, t->limit);
+
+		if (result == t->result)
+			ok++;
+		else {
+			failed++;
+			info_printf("Failed [%u]: rtt_timeout(%d,%d,%d,%d,%lld,%d) -> %d (expected %d)\n",
+				it, t->srtt, t->rttvar, t->samples, t->failures, t->extra, t->limit, result, t->result);
+		}
+	}
+}
+
+static void test_redirect_cache(void)
+{
+	static const struct test_data {
+		const char *
+			url;
+		const char *
+			result;
+	} test_data[] = {
+		{ "http://[::1]:8080/a", "https://example.com/b" },
+		{ "http://[::1:8080]/a", NULL }, // must not collide with [::1]:8080
+		{ "http://[::1]/a", NULL },
+		{ "http://127.0.0.1:8080/a", "http://127.0.0.1:8080/c" },
+		{ "http://127.0.0.1/a", NULL },
+	};
+	static const char *adds[][2] = {
+		{ "http://[::1]:8080/a", "https://example.com/b" },
+		{ "http://127.0.0.1:8080/a", "http://127.0.0.1:8080/c" },
+	};
+
+	redirect_cache_init();
+
+	for (unsigned it = 0; it < countof(adds); it++) {
+		wget_iri *from = wget_iri_parse(adds[it][0], NULL);
+		wget_iri *to = wget_iri_parse(adds[it][1], NULL);
+
+		redirect_cache_add(from, to, 0);
+		wget_iri_free(&to);
+		wget_iri_free(&from);
+	}
+
+	for (unsigned it = 0; it < countof(test_data); it++) {
+		const struct test_data *t = &test_data[it];
+		wget_iri *iri = wget_iri_parse(t->url, NULL);
+		char *result = redirect_cache_lookup(iri);
+
+		if ((!result && !t->result) || (result && t->result && !strcmp(result, t->result)))
+			ok++;
+		else {
+			failed++;
+			info_printf("Failed [%u]: redirect_cache_lookup(%s) -> %s (expected %s)\n",
+				it, t->url, result ? result : "NULL", t->result ? t->result : "NULL");
+		}
+
+		wget_xfree(result);
+		wget_iri_free(&iri);
+	}
+
+	redirect_cache_free();
+	redirect_cache_exit();
+}
+
+static void test_parse_content_range(void)
+{
+	static const struct test_data {
+		const char *
+			value;
+		long long
+			first,
+			last;
+		int
+			result;
+	} test_data[] = {
+		{ "bytes 0-499/1234", 0, 499, 0 },
+		{ "bytes 500-999/*", 500, 999, 0 },
+		{ "  bytes   21010-47021/47022", 21010, 47021, 0 },
+		{ "10-20/11", 10, 20, 0 }, // missing unit, seen in the wild
+		{ "bytes */1234", 0, 0, -1 },
+		{ "bytes 20-10/30", 0, 0, -1 },
+		{ "bytes 5-", 0, 0, -1 },
+		{ "", 0, 0, -1 },
+	};
+
+	for (unsigned it = 0; it < countof(test_data); it++) {
+		const struct test_data *t = &test_data[it];
+		long long first = 0, last = 0;
+		int result = wget_http_parse_content_range(t->value, &first, &last);
+
+		if (result == t->result && (result || (first == t->first && last == t->last)))
+			ok++;
+		else {
+			failed++;
+			info_printf("Failed [%u]: wget_http_parse_content_range(%s) -> %d %lld-%lld (expected %d %lld-%lld)\n",
+				it, t->value, result, first, last, t->result, t->first, t->last);
+		}
+	}
+
+	char *response_text = wget_strdup(
+			"HTTP/1.1 206 Partial Content\r\n"\
+			"Content-Length: 476\r\n"\
+			"Content-Type: multipart/byteranges; boundary=THIS_STRING_SEPARATES\r\n\r\n");
+
+	wget_http_response *resp = wget_http_parse_response_header(response_text);
+
+	if (resp->content_type_boundary && !strcmp(resp->content_type_boundary, "THIS_STRING_SEPARATES"))
+		ok++;
+	else {
+		failed++;
+		info_printf("multipart/byteranges boundary mismatch.\n");
+	}
+
+	wget_http_free_response(&resp);
+	xfree(response_text);
+}
+
+static void test_parse_preload_links(void)
+{
+	static const struct test_data {
+		const char *
+			uri;
+		int
+			rel;
+	} test_data[] = {
+		{ "/style.css", link_rel_preload },
+		{ "/app.js", link_rel_modulepreload },
+		{ "/font.woff2", link_rel_preload },
+	};
+	char *response_text = wget_strdup(
+			"HTTP/1.1 103 Early Hints\r\n"\
+			"Link: </style.css>; rel=preload; as=style, </app.js>; rel=modulepreload\r\n"\
+			"Link: </next.html>; rel=prefetch\r\n"\
+			"Link: </font.woff2>; rel=\"preload nofollow\"; as=font; crossorigin\r\n\r\n");
+
+	wget_http_response *resp = wget_http_parse_response_header(response_text);
+
+	if (resp->code == 103 && wget_vector_size(resp->links) == (int) countof(test_data))
+		ok++;
+	else {
+		failed++;
+		info_printf("Failed: 103 response with %d links (expected %zu)\n", wget_vector_size(resp->links), countof(test_data));
+	}
+
+	for (unsigned it = 0; it < countof(test_data) && it < (unsigned) wget_vector_size(resp->links); it++) {
+		const struct test_data *t = &test_data[it];
+		wget_http_link *link = wget_vector_get(resp->links, it);
+
+		if (!strcmp(link->uri, t->uri) && (int) link->rel == t->rel)
+			ok++;
+		else {
+			failed++;
+			info_printf("Failed [%u]: link %s rel %d (expected %s rel %d)\n", it, link->uri, (int) link->rel, t->uri, t->rel);
+		}
+	}
+
+	wget_http_free_response(&resp);
+	xfree(response_text);
+}
+
+static void test_intern(void)
+{
+	char buf[] = "www.example.com";
+	const char *a = wget_intern("www.example.com");
+	const char *b = wget_intern(buf);
+	const char *c = wget_intern_mem("www.example.com/path", 15);
+	const char *d = wget_intern("example.com");
+
+	if (a && a == b && a == c && a != buf && !strcmp(a, buf))
+		ok++;
+	else {
+		failed++;
+		info_printf("Failed: equal strings are not interned to the same pointer\n");
+	}
+
+	if (d && d != a && !strcmp(d, "example.com"))
+		ok++;
+	else {
+		failed++;
+		info_printf("Failed: different strings are interned to the same pointer\n");
+	}
+
+	wget_iri *iri1 = wget_iri_parse("http://WWW.example.com/a", NULL);
+	wget_iri *iri2 = wget_iri_parse("https://www.example.com:8080/b", NULL);
+	wget_iri *iri3 = wget_iri_clone(iri2);
+
+	if (iri1 && iri2 && iri3 && iri1->host == a && iri2->host == a && iri3->host == a)
+		ok++;
+	else {
+		failed++;
+		info_printf("Failed: IRI hosts are not interned\n");
+	}
+
+	wget_iri_free(&iri3);
+	wget_iri_free(&iri2);
+	wget_iri_free(&iri1);
+}
+
 static unsigned alloc_flags;
 
 static void *test_malloc(size_t size)
@@ -2518,6 +2943,12 @@ int main(int argc, const char **argv)
 	test_robots();
 	test_set_proxy();
 	test_parse_response_header();
+	test_parse_content_range();
+	test_rtt();
+	test_redirect_cache();
+	test_priority();
+	test_parse_preload_links();
+	test_intern();
 
 	selftest_options() ? failed++ : ok++;
 